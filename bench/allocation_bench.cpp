@@ -0,0 +1,141 @@
+// Copyright 2022 Long Le Phi. All rights reserved.
+// Use of this source code is governed by a MIT license that can be
+// found in the LICENSE file.
+
+#include <benchmark/benchmark.h>
+#include <atomic>
+#include <cstdlib>
+#include <map>
+#include <memory>
+#include <new>
+#include <string>
+#include <vector>
+#include "definitions.hpp"
+#include "feed_parser.hpp"
+#include "input_lines.hpp"
+#include "instrument_feeds_worker.hpp"
+#include "peak_memory.hpp"
+#include "soa_book.hpp"
+
+// the replaced operators below pair malloc and free, which gcc cannot see
+// through once they are inlined.
+#if defined(__GNUC__) && !defined(__clang__)
+#  pragma GCC diagnostic ignored "-Wmismatched-new-delete"
+#endif
+
+namespace {
+  // number of global allocations of the whole benchmark binary.
+  std::atomic<size_t> allocations{0};
+}   // namespace
+
+auto operator new(const std::size_t size) -> void* {
+  allocations.fetch_add(1, std::memory_order_relaxed);
+  if (auto* address = std::malloc(size == 0 ? 1 : size); address != nullptr) {
+    return address;
+  }
+  throw std::bad_alloc{};
+}
+
+void operator delete(void* address) noexcept {
+  std::free(address);
+}
+
+void operator delete(void* address, std::size_t /*size*/) noexcept {
+  std::free(address);
+}
+
+namespace longlp {
+  namespace {
+    // every parsed record of the input lines
+    auto InputRecords() -> const std::vector<FeedRecord>& {
+      static const auto records = [] {
+        std::vector<FeedRecord> result{};
+        for (const auto& line : InputLines()) {
+          if (!ParseFeedLine(line, result.emplace_back())) {
+            result.pop_back();
+          }
+        }
+        return result;
+      }();
+      return records;
+    }
+
+    // Replay the records through one worker per symbol, the way the manager
+    // did before the storage recycling: every message is a heap allocated
+    // copy and every book update returns its own output string.
+    void ReplayAllocatingMessages(const std::vector<FeedRecord>& records) {
+      std::map<std::string, InstrumentFeedsWorker> workers{};
+      for (const auto& record : records) {
+        auto& worker = workers[record.symbol];
+        if (record.type == FeedRecord::Type::kBook) {
+          benchmark::DoNotOptimize(worker.UpdateBookChangesUnsafe(
+            std::make_unique<OrderBookRecord>(record.book)));
+        }
+        else {
+          worker.RecordNewTrade(std::make_unique<TradeRecord>(record.trade));
+        }
+      }
+    }
+
+    // Replay the records through one worker per symbol, reusing the book
+    // storage which is given back by the workers.
+    void ReplayRecycledMessages(const std::vector<FeedRecord>& records) {
+      std::map<std::string, InstrumentFeedsWorker> workers{};
+      OrderBookRecord book{};
+      for (const auto& record : records) {
+        auto& worker = workers[record.symbol];
+        if (record.type == FeedRecord::Type::kBook) {
+          book.bids.assign(record.book.bids.begin(), record.book.bids.end());
+          book.asks.assign(record.book.asks.begin(), record.book.asks.end());
+          benchmark::DoNotOptimize(worker.UpdateBookChanges(book));
+        }
+        else {
+          worker.RecordNewTrade(record.trade);
+        }
+      }
+    }
+
+    // Same as above, with the books of up to 16 levels per side stored inline
+    // as structures of arrays.
+    void ReplayInlineBooks(const std::vector<FeedRecord>& records) {
+      std::map<std::string, BasicInstrumentFeedsWorker<BookT<16>>> workers{};
+      BookT<16> book{};
+      for (const auto& record : records) {
+        auto& worker = workers[record.symbol];
+        if (record.type == FeedRecord::Type::kBook) {
+          ToBook(record.book, book);
+          benchmark::DoNotOptimize(worker.UpdateBookChanges(book));
+        }
+        else {
+          worker.RecordNewTrade(record.trade);
+        }
+      }
+    }
+
+    template <auto Replay>
+    void BM_ReplayInputRecords(benchmark::State& state) {
+      const auto& records = InputRecords();
+
+      const auto start = allocations.load(std::memory_order_relaxed);
+      for (auto _ : state) {
+        Replay(records);
+        benchmark::ClobberMemory();
+      }
+      const auto count = allocations.load(std::memory_order_relaxed) - start;
+
+      const auto messages = state.iterations() *
+                            static_cast<int64_t>(records.size());
+      state.SetItemsProcessed(messages);
+      state.counters["allocs_per_msg"] =
+        static_cast<double>(count) / static_cast<double>(messages);
+      state.counters["max_rss_kb"] = PeakResidentKilobytes();
+    }
+  }   // namespace
+
+  BENCHMARK_TEMPLATE(BM_ReplayInputRecords, ReplayAllocatingMessages)
+    ->Name("ReplayInputRecords/Allocating");
+  BENCHMARK_TEMPLATE(BM_ReplayInputRecords, ReplayRecycledMessages)
+    ->Name("ReplayInputRecords/Recycled");
+  BENCHMARK_TEMPLATE(BM_ReplayInputRecords, ReplayInlineBooks)
+    ->Name("ReplayInputRecords/InlineBooks");
+}   // namespace longlp
@@ -0,0 +1,39 @@
+// Copyright 2022 Long Le Phi. All rights reserved.
+// Use of this source code is governed by a MIT license that can be
+// found in the LICENSE file.
+
+#include "feed_parser.hpp"
+
+#include <benchmark/benchmark.h>
+#include <fmt/format.h>
+#include "input_lines.hpp"
+
+namespace longlp {
+  namespace {
+    template <auto Parse>
+    void BM_ParseInputLines(benchmark::State& state) {
+      const auto& lines = InputLines();
+      size_t bytes      = 0;
+      for (const auto& line : lines) {
+        bytes += line.size();
+      }
+
+      FeedRecord record{};
+      for (auto _ : state) {
+        for (const auto& line : lines) {
+          benchmark::DoNotOptimize(Parse(line, record));
+        }
+        benchmark::ClobberMemory();
+      }
+
+      state.SetItemsProcessed(state.iterations() *
+                              static_cast<int64_t>(lines.size()));
+      state.SetBytesProcessed(state.iterations() * static_cast<int64_t>(bytes));
+    }
+  }   // namespace
+
+  BENCHMARK_TEMPLATE(BM_ParseInputLines, ParseFeedLineInPlace)
+    ->Name("ParseFeedLine/InPlace");
+  BENCHMARK_TEMPLATE(BM_ParseInputLines, ParseFeedLineJson)
+    ->Name("ParseFeedLine/Json");
+}   // namespace longlp
@@ -0,0 +1,36 @@
+// Copyright 2022 Long Le Phi. All rights reserved.
+// Use of this source code is governed by a MIT license that can be
+// found in the LICENSE file.
+
+#ifndef INPUT_LINES_HPP_
+#define INPUT_LINES_HPP_
+
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <vector>
+#include "longlp_config.hpp"
+
+namespace longlp {
+  // every line of the json files in data/input
+  inline auto InputLines() -> const std::vector<std::string>& {
+    static const auto lines = [] {
+      std::vector<std::string> result{};
+      const auto input_dir = std::filesystem::path{config::data_dir} / "input";
+      for (const auto& entry :
+           std::filesystem::directory_iterator{input_dir}) {
+        if (entry.path().extension() != ".json") {
+          continue;
+        }
+        std::ifstream opener(entry.path());
+        for (std::string line{}; std::getline(opener, line);) {
+          result.emplace_back(std::move(line));
+        }
+      }
+      return result;
+    }();
+    return lines;
+  }
+}   // namespace longlp
+
+#endif   // INPUT_LINES_HPP_
@@ -0,0 +1,120 @@
+// Copyright 2022 Long Le Phi. All rights reserved.
+// Use of this source code is governed by a MIT license that can be
+// found in the LICENSE file.
+
+#include "instrument_feeds_worker.hpp"
+
+#include <benchmark/benchmark.h>
+#include <string>
+#include <type_traits>
+#include "book_analytics.hpp"
+#include "definitions.hpp"
+#include "soa_book.hpp"
+
+namespace longlp {
+  namespace {
+    // A book of |depth| levels per side around the price of 100.00.
+    auto MakeBook(const int64_t depth) -> OrderBookRecord {
+      OrderBookRecord book{};
+      for (int64_t i = 0; i < depth; ++i) {
+        book.bids.push_back({ToPrice(100.0) - i, ToQuantity(100.0), 1});
+        book.asks.push_back({ToPrice(100.01) + i, ToQuantity(100.0), 1});
+      }
+      return book;
+    }
+
+    // Change the quantity of |churn| percent of the levels of |book|.
+    void ChurnBook(OrderBookRecord& book, const int64_t churn) {
+      if (churn == 0) {
+        return;
+      }
+      const auto stride = static_cast<size_t>(100 / churn);
+      for (size_t i = 0; i < book.bids.size(); i += stride) {
+        book.bids[i].quantity += ToQuantity(1.0);
+        book.asks[i].quantity += ToQuantity(1.0);
+      }
+    }
+
+    // Return |book| as a |Book|.
+    template <typename Book>
+    auto AsBook(const OrderBookRecord& book) -> Book {
+      if constexpr (std::is_same_v<Book, OrderBookRecord>) {
+        return book;
+      }
+      else {
+        Book result{};
+        ToBook(book, result);
+        return result;
+      }
+    }
+
+    // Diff books of state.range(0) levels per side, state.range(1) percent
+    // of the levels changing between two books.
+    template <typename Book>
+    void BM_CompareSideListChange(benchmark::State& state) {
+      const auto depth = state.range(0);
+      const auto churn = state.range(1);
+
+      BasicInstrumentFeedsWorker<Book> worker{};
+      auto first = AsBook<Book>(MakeBook(depth));
+      worker.UpdateBookChanges(first);
+
+      // the live book and |book| swap their storage at every update, so
+      // the worker alternates between both books.
+      auto churned = MakeBook(depth);
+      ChurnBook(churned, churn);
+      auto book = AsBook<Book>(churned);
+
+      std::string output{};
+      for (auto _ : state) {
+        output.clear();
+        worker.UpdateBookChanges(book, output);
+        benchmark::DoNotOptimize(output.data());
+      }
+      state.SetItemsProcessed(state.iterations());
+    }
+
+    // Record bursts of state.range(0) aggressive buy trades, each burst is
+    // followed by the book which classifies it. The analytics of the books
+    // are recorded if state.range(1) is 1.
+    void BM_TradeBurst(benchmark::State& state) {
+      const auto burst = state.range(0);
+
+      InstrumentFeedsWorker worker{};
+      BookAnalytics analytics{AnalyticsOptions{}};
+      if (state.range(1) == 1) {
+        analytics.Output().Open("/dev/null");
+        worker.AttachAnalytics(&analytics);
+      }
+      auto first = MakeBook(10);
+      worker.UpdateBookChanges(first);
+      auto book = MakeBook(10);
+
+      std::string output{};
+      for (auto _ : state) {
+        for (int64_t i = 0; i < burst; ++i) {
+          // every trade has its own price, so none is merged.
+          worker.RecordNewTrade(
+            TradeRecord{ToQuantity(10.0), ToPrice(100.01) + i});
+        }
+        output.clear();
+        worker.UpdateBookChanges(book, output);
+        benchmark::DoNotOptimize(output.data());
+      }
+      state.SetItemsProcessed(state.iterations() * (burst + 1));
+    }
+  }   // namespace
+
+  BENCHMARK_TEMPLATE(BM_CompareSideListChange, OrderBookRecord)
+    ->ArgNames({"depth", "churn"})
+    ->ArgsProduct({{10, 100, 1000}, {0, 10, 50, 100}});
+  BENCHMARK_TEMPLATE(BM_CompareSideListChange, BookT<16>)
+    ->ArgNames({"depth", "churn"})
+    ->ArgsProduct({{10, 100}, {0, 10, 100}});
+  BENCHMARK_TEMPLATE(BM_CompareSideListChange, BookT<64>)
+    ->ArgNames({"depth", "churn"})
+    ->ArgsProduct({{10, 100}, {0, 10, 100}});
+  BENCHMARK(BM_TradeBurst)
+    ->ArgNames({"burst", "analytics"})
+    ->ArgsProduct({{1, 10, 100, 1000}, {0, 1}});
+}   // namespace longlp
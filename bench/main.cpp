@@ -0,0 +1,40 @@
+// Copyright 2022 Long Le Phi. All rights reserved.
+// Use of this source code is governed by a MIT license that can be
+// found in the LICENSE file.
+
+#include <benchmark/benchmark.h>
+#include <algorithm>
+#include <cstdint>
+#include <filesystem>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Run the benchmarks as benchmark_main does, but the results are also
+// written as json to order-book-watcher-bench.json next to the executable,
+// i.e. in the build directory, unless another --benchmark_out is given, so
+// the builds can be compared.
+auto main(int32_t argc, char** argv) -> int32_t {
+  std::vector<char*> args(argv, argv + argc);
+
+  const auto out_path = std::filesystem::path{argv[0]}.parent_path() /
+                        "order-book-watcher-bench.json";
+  std::string out_arg{"--benchmark_out=" + out_path.string()};
+  std::string format_arg{"--benchmark_out_format=json"};
+  const auto has_out = std::any_of(args.begin(), args.end(), [](char* arg) {
+    return std::string_view{arg}.rfind("--benchmark_out=", 0) == 0;
+  });
+  if (!has_out) {
+    args.emplace_back(out_arg.data());
+    args.emplace_back(format_arg.data());
+  }
+
+  auto count = static_cast<int32_t>(args.size());
+  benchmark::Initialize(&count, args.data());
+  if (benchmark::ReportUnrecognizedArguments(count, args.data())) {
+    return 1;
+  }
+  benchmark::RunSpecifiedBenchmarks();
+  benchmark::Shutdown();
+  return 0;
+}
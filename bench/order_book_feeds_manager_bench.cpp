@@ -0,0 +1,411 @@
+// Copyright 2022 Long Le Phi. All rights reserved.
+// Use of this source code is governed by a MIT license that can be
+// found in the LICENSE file.
+
+#include "order_book_feeds_manager.hpp"
+
+#include <benchmark/benchmark.h>
+#include <fmt/format.h>
+#include <algorithm>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <thread>
+#include <vector>
+#include "feed_generator.hpp"
+
+namespace longlp {
+  namespace {
+    constexpr auto kSymbols = 64U;
+    constexpr auto kLines   = 50000U;
+    constexpr auto kDepth   = 5U;
+
+    constexpr auto kHotSymbolMessages = 100000U;
+
+    // A synthetic feed of kLines lines over kSymbols symbols, every 8th
+    // message of a symbol is a pair of trades at its best ask. It is written
+    // once into the temporary directory.
+    auto SyntheticFeedFile() -> const std::string& {
+      static const auto path = [] {
+        const auto file = std::filesystem::temp_directory_path() /
+                          "order_book_feeds_manager_bench.json";
+        std::ofstream writer(file);
+
+        uint64_t state      = 42;
+        const auto next_int = [&state](const uint64_t bound) {
+          state = state * 6364136223846793005ULL + 1442695040888963407ULL;
+          return (state >> 33U) % bound;
+        };
+
+        const auto write_side = [&](const double best, const double step) {
+          writer << '[';
+          for (auto level = 0U; level < kDepth; ++level) {
+            writer << fmt::format(
+              R"({}{{"count":1, "quantity":{}, "price":{:.2f}}})",
+              level == 0 ? "" : ", ",
+              (next_int(10) + 1) * 100,
+              best + step * level);
+          }
+          writer << ']';
+        };
+
+        for (uint64_t line = 0; line < kLines; ++line) {
+          // every symbol starts with a book
+          const auto symbol = line < kSymbols ? line : next_int(kSymbols);
+          const auto price  = 50.0 + static_cast<double>(symbol);
+          if (line >= kSymbols && next_int(8) == 0) {
+            for (auto trade = 0U; trade < 2; ++trade) {
+              writer << fmt::format(
+                R"({{"trade":{{"symbol":"S{:03}", "quantity":100, )"
+                R"("price":{:.2f}}}}})"
+                "\n",
+                symbol,
+                price + 0.01);
+            }
+          }
+
+          writer << fmt::format(R"({{"book":{{"symbol":"S{:03}", "bid": )",
+                                symbol);
+          write_side(price, -0.01);
+          writer << R"(, "ask": )";
+          write_side(price + 0.01, 0.01);
+          writer << "}}\n";
+        }
+        return file.string();
+      }();
+      return path;
+    }
+
+    // A generated feed of 200 symbols drawn with a steep Zipf popularity, so
+    // a few hot symbols have most of the messages. It is written once into
+    // the temporary directory.
+    auto ZipfFeedFile() -> const std::string& {
+      static const auto path = [] {
+        const auto file = std::filesystem::temp_directory_path() /
+                          "order_book_feeds_manager_bench_zipf.json";
+        FeedGeneratorOptions options{};
+        options.seed          = 42;
+        options.symbols       = 200;
+        options.messages      = 100000;
+        options.zipf_exponent = 1.2;
+
+        std::ofstream writer(file);
+        GenerateFeed(options, writer);
+        return file.string();
+      }();
+      return path;
+    }
+
+    // A generated feed of a single symbol, which has all the messages.
+    auto HotSymbolFeedFile() -> const std::string& {
+      static const auto path = [] {
+        const auto file = std::filesystem::temp_directory_path() /
+                          "order_book_feeds_manager_bench_hot.json";
+        FeedGeneratorOptions options{};
+        options.seed     = 42;
+        options.symbols  = 1;
+        options.messages = kHotSymbolMessages;
+
+        std::ofstream writer(file);
+        GenerateFeed(options, writer);
+        return file.string();
+      }();
+      return path;
+    }
+
+    // A generated feed of 2000 symbols, so there are more output files than
+    // the writer keeps open.
+    auto ManySymbolsFeedFile() -> const std::string& {
+      static const auto path = [] {
+        const auto file = std::filesystem::temp_directory_path() /
+                          "order_book_feeds_manager_bench_many.json";
+        FeedGeneratorOptions options{};
+        options.seed     = 42;
+        options.symbols  = 2000;
+        options.messages = 200000;
+
+        std::ofstream writer(file);
+        GenerateFeed(options, writer);
+        return file.string();
+      }();
+      return path;
+    }
+
+    // A generated feed of 20000 symbols with a few books each, most of the
+    // output files are small.
+    auto ManySmallSymbolsFeedFile() -> const std::string& {
+      static const auto path = [] {
+        const auto file = std::filesystem::temp_directory_path() /
+                          "order_book_feeds_manager_bench_small.json";
+        FeedGeneratorOptions options{};
+        options.seed     = 42;
+        options.symbols  = 20000;
+        options.messages = 200000;
+
+        std::ofstream writer(file);
+        GenerateFeed(options, writer);
+        return file.string();
+      }();
+      return path;
+    }
+
+    auto OutputDirectory() -> std::string {
+      const auto directory = std::filesystem::temp_directory_path() /
+                             "order_book_feeds_manager_bench";
+      std::filesystem::create_directories(directory);
+      return directory.string();
+    }
+
+    // Parse then run the synthetic feed with state.range(0) threads.
+    void BM_TwoPhase(benchmark::State& state) {
+      const auto& input  = SyntheticFeedFile();
+      const auto output  = OutputDirectory();
+      const auto threads = static_cast<size_t>(state.range(0));
+
+      for (auto _ : state) {
+        OrderBookFeedsManager manager{};
+        manager.InitFeedsAndGenerateTaskFlow({input}, output);
+        manager.RunTaskFlow(threads);
+      }
+      state.SetItemsProcessed(state.iterations() * kLines);
+    }
+
+    // Run the synthetic feed on state.range(0) shards.
+    void BM_Sharded(benchmark::State& state) {
+      const auto& input = SyntheticFeedFile();
+      const auto output = OutputDirectory();
+      const auto shards = static_cast<size_t>(state.range(0));
+
+      for (auto _ : state) {
+        OrderBookFeedsManager manager{};
+        benchmark::DoNotOptimize(
+          manager.RunShardedFeeds({input}, output, shards, 4096));
+      }
+      state.SetItemsProcessed(state.iterations() * kLines);
+    }
+
+    // Parse then run the Zipf feed with state.range(0) threads, with a task
+    // per message chained to the previous task of its symbol.
+    void BM_TwoPhaseZipf(benchmark::State& state) {
+      const auto& input  = ZipfFeedFile();
+      const auto output  = OutputDirectory();
+      const auto threads = static_cast<size_t>(state.range(0));
+
+      for (auto _ : state) {
+        OrderBookFeedsManager manager{};
+        manager.InitFeedsAndGenerateTaskFlow({input}, output);
+        manager.RunTaskFlow(threads);
+      }
+    }
+
+    // Partition the Zipf feed by symbol then run one task per symbol, with
+    // state.range(0) threads and chunks.
+    void BM_PartitionedZipf(benchmark::State& state) {
+      const auto& input  = ZipfFeedFile();
+      const auto output  = OutputDirectory();
+      const auto threads = static_cast<size_t>(state.range(0));
+
+      for (auto _ : state) {
+        OrderBookFeedsManager manager{};
+        manager.RunPartitionedFeeds({input}, output, threads, threads);
+      }
+    }
+
+    // Run the Zipf feed on state.range(0) shards, the hot symbols load their
+    // shards more than the others.
+    void BM_ShardedZipf(benchmark::State& state) {
+      const auto& input = ZipfFeedFile();
+      const auto output = OutputDirectory();
+      const auto shards = static_cast<size_t>(state.range(0));
+
+      size_t messages = 0;
+      for (auto _ : state) {
+        OrderBookFeedsManager manager{};
+        messages += manager.RunShardedFeeds({input}, output, shards, 4096)
+                      .messages;
+      }
+      state.SetItemsProcessed(static_cast<int64_t>(messages));
+    }
+
+    // Run the Zipf feed on state.range(0) stealing threads, with the
+    // imbalance of their loads and the stolen symbols per run.
+    void BM_StealingZipf(benchmark::State& state) {
+      const auto& input = ZipfFeedFile();
+      const auto output = OutputDirectory();
+
+      StealingOptions options{};
+      options.threads = static_cast<size_t>(state.range(0));
+
+      size_t messages  = 0;
+      size_t steals    = 0;
+      double imbalance = 0.0;
+      for (auto _ : state) {
+        OrderBookFeedsManager manager{};
+        const auto report = manager.RunStealingFeeds({input}, output, options);
+        messages += report.messages;
+        imbalance += report.imbalance;
+        for (const auto& load : report.threads) {
+          steals += load.steals;
+        }
+      }
+      state.SetItemsProcessed(static_cast<int64_t>(messages));
+      state.counters["imbalance"] =
+        benchmark::Counter(imbalance, benchmark::Counter::kAvgIterations);
+      state.counters["steals"] = benchmark::Counter(
+        static_cast<double>(steals), benchmark::Counter::kAvgIterations);
+    }
+
+    // Stream the many symbols feed in batches of 4096 lines, each batch
+    // flushes the outputs of its symbols. They are written by the analysis
+    // threads for state.range(0) = 0, else by an asynchronous writer of
+    // backend io_uring (1) or threads (2) which keeps at most state.range(1)
+    // files open.
+    void BM_StreamingOutput(benchmark::State& state) {
+      const auto& input = ManySymbolsFeedFile();
+      const auto output = OutputDirectory();
+
+      AsyncWriterOptions options{};
+      options.backend = state.range(0) == 1 ? OutputBackend::kIoUring
+                                            : OutputBackend::kThreads;
+      options.max_open_files = static_cast<size_t>(state.range(1));
+
+      size_t opens       = 0;
+      size_t submissions = 0;
+      for (auto _ : state) {
+        OrderBookFeedsManager manager{};
+        if (state.range(0) != 0) {
+          manager.EnableAsyncOutput(options);
+        }
+        manager.StreamFeeds({input}, output, 2, 4096);
+        opens += manager.OutputReport().opens;
+        submissions += manager.OutputReport().submissions;
+      }
+      state.counters["opens"] = benchmark::Counter(
+        static_cast<double>(opens), benchmark::Counter::kAvgIterations);
+      state.counters["submissions"] = benchmark::Counter(
+        static_cast<double>(submissions), benchmark::Counter::kAvgIterations);
+    }
+
+    const auto kMaxThreads =
+      static_cast<int64_t>(std::max(std::thread::hardware_concurrency(), 1U));
+
+    // Run state.range(0) copies of the synthetic feed as consecutive files in
+    // the mapped mode, one chunk per file, so the parsing parallelism only
+    // comes from the files.
+    void BM_MappedFiles(benchmark::State& state) {
+      const std::vector<std::string> inputs(
+        static_cast<size_t>(state.range(0)),
+        SyntheticFeedFile());
+      const auto output = OutputDirectory();
+
+      for (auto _ : state) {
+        OrderBookFeedsManager manager{};
+        manager.RunMappedFeeds(inputs,
+                               output,
+                               static_cast<size_t>(kMaxThreads),
+                               1,
+                               0);
+      }
+      state.SetItemsProcessed(state.iterations() * state.range(0) * kLines);
+    }
+
+    // Run the single symbol feed in the mapped mode with state.range(0)
+    // threads, its books are split into segments of state.range(1) books,
+    // or classified by a single task for 0.
+    void BM_MappedHotSymbol(benchmark::State& state) {
+      const auto& input = HotSymbolFeedFile();
+      const auto output = OutputDirectory();
+
+      for (auto _ : state) {
+        OrderBookFeedsManager manager{};
+        manager.RunMappedFeeds({input},
+                               output,
+                               static_cast<size_t>(state.range(0)),
+                               static_cast<size_t>(state.range(0)),
+                               static_cast<size_t>(state.range(1)));
+      }
+      state.SetItemsProcessed(state.iterations() * kHotSymbolMessages);
+    }
+
+    // Partition the 20000 symbols feed, whose outputs are written into one
+    // file per symbol for state.range(0) = 0, else into a consolidated
+    // output of binary (1) or text (2) records.
+    void BM_ConsolidatedOutput(benchmark::State& state) {
+      const auto& input = ManySmallSymbolsFeedFile();
+      const auto output = OutputDirectory();
+
+      ConsolidatedOptions options{};
+      options.format = state.range(0) == 2 ? RecordFormat::kText
+                                           : RecordFormat::kBinary;
+
+      for (auto _ : state) {
+        OrderBookFeedsManager manager{};
+        if (state.range(0) != 0) {
+          manager.EnableConsolidatedOutput(options);
+        }
+        manager.RunPartitionedFeeds({input},
+                                    output,
+                                    static_cast<size_t>(kMaxThreads),
+                                    static_cast<size_t>(kMaxThreads));
+      }
+    }
+  }   // namespace
+
+  BENCHMARK(BM_TwoPhase)
+    ->ArgName("threads")
+    ->RangeMultiplier(2)
+    ->Range(1, kMaxThreads)
+    ->Unit(benchmark::kMillisecond)
+    ->UseRealTime();
+  BENCHMARK(BM_Sharded)
+    ->ArgName("shards")
+    ->RangeMultiplier(2)
+    ->Range(1, kMaxThreads)
+    ->Unit(benchmark::kMillisecond)
+    ->UseRealTime();
+  BENCHMARK(BM_TwoPhaseZipf)
+    ->ArgName("threads")
+    ->RangeMultiplier(2)
+    ->Range(1, kMaxThreads)
+    ->Unit(benchmark::kMillisecond)
+    ->UseRealTime();
+  BENCHMARK(BM_PartitionedZipf)
+    ->ArgName("threads")
+    ->RangeMultiplier(2)
+    ->Range(1, kMaxThreads)
+    ->Unit(benchmark::kMillisecond)
+    ->UseRealTime();
+  BENCHMARK(BM_ShardedZipf)
+    ->ArgName("shards")
+    ->RangeMultiplier(2)
+    ->Range(1, kMaxThreads)
+    ->Unit(benchmark::kMillisecond)
+    ->UseRealTime();
+  BENCHMARK(BM_StealingZipf)
+    ->ArgName("threads")
+    ->RangeMultiplier(2)
+    ->Range(1, kMaxThreads)
+    ->Unit(benchmark::kMillisecond)
+    ->UseRealTime();
+  BENCHMARK(BM_MappedHotSymbol)
+    ->ArgNames({"threads", "segment_books"})
+    ->ArgsProduct({benchmark::CreateRange(1, kMaxThreads, 2), {0, 4096}})
+    ->Unit(benchmark::kMillisecond)
+    ->UseRealTime();
+  BENCHMARK(BM_StreamingOutput)
+    ->ArgNames({"backend", "max_open_files"})
+    ->ArgsProduct({{0, 1, 2}, {256, 4096}})
+    ->Unit(benchmark::kMillisecond)
+    ->UseRealTime();
+  BENCHMARK(BM_ConsolidatedOutput)
+    ->ArgName("format")
+    ->DenseRange(0, 2)
+    ->Unit(benchmark::kMillisecond)
+    ->UseRealTime();
+  BENCHMARK(BM_MappedFiles)
+    ->ArgName("files")
+    ->RangeMultiplier(2)
+    ->Range(1, 8)
+    ->Unit(benchmark::kMillisecond)
+    ->UseRealTime();
+}   // namespace longlp
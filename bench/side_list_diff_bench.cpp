@@ -0,0 +1,56 @@
+// Copyright 2022 Long Le Phi. All rights reserved.
+// Use of this source code is governed by a MIT license that can be
+// found in the LICENSE file.
+
+#include "side_list_diff.hpp"
+
+#include <benchmark/benchmark.h>
+#include <cstdint>
+#include "definitions.hpp"
+
+namespace longlp {
+  namespace {
+    // A bid side of |depth| levels from the price of 100.00.
+    auto MakeSide(const int64_t depth) -> SideList {
+      SideList result{};
+      for (int64_t i = 0; i < depth; ++i) {
+        result.push_back({ToPrice(100.0) - i, ToQuantity(100.0), 1});
+      }
+      return result;
+    }
+
+    // Diff sides of state.range(0) levels, state.range(1) of them changing
+    // their quantity, spread over the side.
+    template <DiffKernel kernel>
+    void BM_DiffSideList(benchmark::State& state) {
+      const auto depth   = state.range(0);
+      const auto changes = state.range(1);
+
+      const auto old_side = MakeSide(depth);
+      auto new_side       = MakeSide(depth);
+      for (int64_t i = 0; i < changes; ++i) {
+        new_side[static_cast<size_t>(i * depth / changes)].quantity +=
+          ToQuantity(1.0);
+      }
+
+      for (auto _ : state) {
+        Volume total = 0;
+        DiffSideList<Side::kBuy, kernel>(
+          old_side,
+          new_side,
+          [&total](const Intention /*intention*/,
+                   const Volume quantity,
+                   const Price /*price*/) { total += quantity; });
+        benchmark::DoNotOptimize(total);
+      }
+      state.SetItemsProcessed(state.iterations() * depth);
+    }
+  }   // namespace
+
+  BENCHMARK_TEMPLATE(BM_DiffSideList, DiffKernel::kScalar)
+    ->ArgNames({"depth", "changes"})
+    ->ArgsProduct({{10, 100, 1000}, {0, 1, 4}});
+  BENCHMARK_TEMPLATE(BM_DiffSideList, DiffKernel::kBlock)
+    ->ArgNames({"depth", "changes"})
+    ->ArgsProduct({{10, 100, 1000}, {0, 1, 4}});
+}   // namespace longlp
@@ -0,0 +1,528 @@
+// Copyright 2022 Long Le Phi. All rights reserved.
+// Use of this source code is governed by a MIT license that can be
+// found in the LICENSE file.
+
+#include "async_writer.hpp"
+
+#include <fmt/core.h>
+#include <algorithm>
+#include <cerrno>
+#include <string_view>
+#include <utility>
+#include "output_file.hpp"
+
+#if defined(__linux__)
+#  include <linux/io_uring.h>
+#  include <sys/mman.h>
+#  include <sys/syscall.h>
+#  include <sys/uio.h>
+#  include <unistd.h>
+#endif
+
+namespace longlp {
+  namespace {
+    using Clock = std::chrono::steady_clock;
+  }   // namespace
+
+#if defined(__linux__)
+  // A minimal io_uring of vectored writes, set up with the raw system calls
+  // so there is no dependency on liburing. It is only used by the thread of
+  // the writer.
+  class AsyncWriter::Ring {
+   public:
+    // Return nullptr if the kernel has no io_uring, or if it is disabled.
+    static auto Create(const uint32_t entries) -> std::unique_ptr<Ring> {
+      auto ring = std::make_unique<Ring>();
+      return ring->Setup(entries) ? std::move(ring) : nullptr;
+    }
+
+    Ring()                               = default;
+    Ring(const Ring&)                    = delete;
+    auto operator=(const Ring&) -> Ring& = delete;
+    Ring(Ring&&)                         = delete;
+    auto operator=(Ring&&) -> Ring&      = delete;
+
+    ~Ring() {
+      if (sqes_ != nullptr) {
+        munmap(sqes_, sqes_size_);
+      }
+      if (cq_ring_ != nullptr && cq_ring_ != sq_ring_) {
+        munmap(cq_ring_, cq_ring_size_);
+      }
+      if (sq_ring_ != nullptr) {
+        munmap(sq_ring_, sq_ring_size_);
+      }
+      if (descriptor_ >= 0) {
+        close(descriptor_);
+      }
+    }
+
+    auto Entries() const -> uint32_t {
+      return entries_;
+    }
+
+    // Queue a write of |vector| to |descriptor| at |offset|. There must be
+    // less than Entries() writes in flight.
+    void PrepareWrite(const int descriptor,
+                      const iovec& vector,
+                      const uint64_t offset,
+                      const uint64_t user_data) {
+      const auto tail  = *sq_tail_;
+      const auto index = tail & sq_mask_;
+      auto& sqe        = sqes_[index];
+      sqe              = io_uring_sqe{};
+      sqe.opcode       = IORING_OP_WRITEV;
+      sqe.fd           = descriptor;
+      sqe.addr         = reinterpret_cast<uint64_t>(&vector);
+      sqe.len          = 1;
+      sqe.off          = offset;
+      sqe.user_data    = user_data;
+      sq_array_[index] = index;
+      __atomic_store_n(sq_tail_, tail + 1, __ATOMIC_RELEASE);
+      ++prepared_;
+    }
+
+    // Submit the prepared writes, and wait for |wait| completions. The
+    // writes which the kernel cannot take yet stay prepared, they are
+    // submitted by the next call once some completions are reaped. Return
+    // false on failure, then none of the prepared writes is submitted.
+    auto Submit(const uint32_t wait) -> bool {
+      const auto flags = wait > 0 ? IORING_ENTER_GETEVENTS : 0U;
+      for (;;) {
+        const auto result = syscall(__NR_io_uring_enter,
+                                    descriptor_,
+                                    prepared_,
+                                    wait,
+                                    flags,
+                                    nullptr,
+                                    0);
+        if (result >= 0) {
+          prepared_ -= static_cast<uint32_t>(result);
+          return true;
+        }
+        if (errno == EAGAIN || errno == EBUSY) {
+          return true;
+        }
+        if (errno != EINTR) {
+          return false;
+        }
+      }
+    }
+
+    // number of the prepared writes which are not submitted yet, they are
+    // the last prepared ones.
+    auto Prepared() const -> uint32_t {
+      return prepared_;
+    }
+
+    // Drop the prepared writes which are not submitted.
+    void Discard() {
+      __atomic_store_n(sq_tail_, *sq_tail_ - prepared_, __ATOMIC_RELEASE);
+      prepared_ = 0;
+    }
+
+    // Call |complete(user_data, result)| for every completed write.
+    template <typename Complete>
+    void Reap(Complete&& complete) {
+      auto head       = *cq_head_;
+      const auto tail = __atomic_load_n(cq_tail_, __ATOMIC_ACQUIRE);
+      for (; head != tail; ++head) {
+        const auto& cqe = cqes_[head & cq_mask_];
+        complete(cqe.user_data, cqe.res);
+      }
+      __atomic_store_n(cq_head_, head, __ATOMIC_RELEASE);
+    }
+
+   private:
+    auto Setup(const uint32_t entries) -> bool {
+      io_uring_params params{};
+      const auto descriptor =
+        syscall(__NR_io_uring_setup, std::max(entries, 1U), &params);
+      if (descriptor < 0) {
+        return false;
+      }
+      descriptor_ = static_cast<int>(descriptor);
+      entries_    = params.sq_entries;
+
+      sq_ring_size_ =
+        params.sq_off.array + params.sq_entries * sizeof(uint32_t);
+      cq_ring_size_ =
+        params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+      const auto single_map = (params.features & IORING_FEAT_SINGLE_MMAP) != 0;
+      if (single_map) {
+        sq_ring_size_ = cq_ring_size_ = std::max(sq_ring_size_, cq_ring_size_);
+      }
+
+      sq_ring_ = Map(sq_ring_size_, IORING_OFF_SQ_RING);
+      cq_ring_ = single_map ? sq_ring_ : Map(cq_ring_size_, IORING_OFF_CQ_RING);
+      sqes_size_ = params.sq_entries * sizeof(io_uring_sqe);
+      sqes_ = static_cast<io_uring_sqe*>(Map(sqes_size_, IORING_OFF_SQES));
+      if (sq_ring_ == nullptr || cq_ring_ == nullptr || sqes_ == nullptr) {
+        return false;
+      }
+
+      auto* sq  = static_cast<char*>(sq_ring_);
+      auto* cq  = static_cast<char*>(cq_ring_);
+      sq_tail_  = reinterpret_cast<uint32_t*>(sq + params.sq_off.tail);
+      sq_mask_  = *reinterpret_cast<uint32_t*>(sq + params.sq_off.ring_mask);
+      sq_array_ = reinterpret_cast<uint32_t*>(sq + params.sq_off.array);
+      cq_head_  = reinterpret_cast<uint32_t*>(cq + params.cq_off.head);
+      cq_tail_  = reinterpret_cast<uint32_t*>(cq + params.cq_off.tail);
+      cq_mask_  = *reinterpret_cast<uint32_t*>(cq + params.cq_off.ring_mask);
+      cqes_     = reinterpret_cast<io_uring_cqe*>(cq + params.cq_off.cqes);
+      return true;
+    }
+
+    auto Map(const size_t size, const off_t offset) const -> void* {
+      auto* address = mmap(nullptr,
+                           size,
+                           PROT_READ | PROT_WRITE,
+                           MAP_SHARED | MAP_POPULATE,
+                           descriptor_,
+                           offset);
+      return address == MAP_FAILED ? nullptr : address;
+    }
+
+    int descriptor_{-1};
+    uint32_t entries_{0};
+    uint32_t prepared_{0};
+
+    void* sq_ring_{nullptr};
+    void* cq_ring_{nullptr};
+    size_t sq_ring_size_{0};
+    size_t cq_ring_size_{0};
+    io_uring_sqe* sqes_{nullptr};
+    size_t sqes_size_{0};
+
+    uint32_t* sq_tail_{nullptr};
+    uint32_t* sq_array_{nullptr};
+    uint32_t sq_mask_{0};
+    uint32_t cq_mask_{0};
+    uint32_t* cq_head_{nullptr};
+    uint32_t* cq_tail_{nullptr};
+    io_uring_cqe* cqes_{nullptr};
+  };
+#else
+  // There is no io_uring on this platform.
+  class AsyncWriter::Ring {};
+#endif
+
+  AsyncWriter::AsyncWriter(const AsyncWriterOptions& options) :
+    options_(options) {
+    options_.max_open_files = std::max<size_t>(options_.max_open_files, 1);
+    options_.threads        = std::max<size_t>(options_.threads, 1);
+
+#if defined(__linux__)
+    if (options_.backend != OutputBackend::kThreads) {
+      ring_ = Ring::Create(static_cast<uint32_t>(
+        std::clamp<size_t>(options_.queue_depth, 1, 4096)));
+      if (ring_ == nullptr && options_.backend == OutputBackend::kIoUring) {
+        fmt::print("io_uring is not available, the outputs are written by "
+                   "threads\n");
+      }
+    }
+#else
+    if (options_.backend == OutputBackend::kIoUring) {
+      fmt::print("io_uring is only available on Linux, the outputs are "
+                 "written by threads\n");
+    }
+#endif
+
+    report_.io_uring = ring_ != nullptr;
+    positional_      = report_.io_uring;
+    if (report_.io_uring) {
+      queues_.resize(1);
+      threads_.emplace_back([this] { RunRing(); });
+      return;
+    }
+    queues_.resize(options_.threads);
+    for (size_t i = 0; i < options_.threads; ++i) {
+      threads_.emplace_back([this, i] { RunThread(i); });
+    }
+  }
+
+  AsyncWriter::~AsyncWriter() {
+    {
+      const std::lock_guard<std::mutex> lock{mutex_};
+      stopping_ = true;
+    }
+    work_.notify_all();
+    for (auto& thread : threads_) {
+      thread.join();
+    }
+
+    for (auto& file : files_) {
+      if (file.descriptor >= 0) {
+        detail::CloseDescriptor(file.descriptor);
+      }
+    }
+  }
+
+  auto AsyncWriter::AddFile(std::string path, const uint64_t size)
+    -> uint32_t {
+    const std::lock_guard<std::mutex> lock{mutex_};
+    auto& file   = files_.emplace_back();
+    file.path    = std::move(path);
+    file.created = size > 0;
+    file.size    = size;
+    return static_cast<uint32_t>(files_.size() - 1);
+  }
+
+  void AsyncWriter::Write(const uint32_t file, std::string& bytes) {
+    if (bytes.empty()) {
+      return;
+    }
+
+    std::unique_lock<std::mutex> lock{mutex_};
+    if (pending_bytes_ > 0 &&
+        pending_bytes_ + bytes.size() > options_.max_pending_bytes) {
+      const auto start = Clock::now();
+      done_.wait(lock, [this, &bytes] {
+        return pending_bytes_ == 0 ||
+               pending_bytes_ + bytes.size() <= options_.max_pending_bytes;
+      });
+      report_.stall += Clock::now() - start;
+    }
+
+    Request request{};
+    request.file = file;
+    if (!free_buffers_.empty()) {
+      request.bytes = std::move(free_buffers_.back());
+      free_buffers_.pop_back();
+    }
+    request.bytes.swap(bytes);
+    bytes.clear();
+
+    // the writes of a file are at consecutive offsets, or in order on the
+    // queue of its thread.
+    auto& target   = files_[file];
+    request.offset = target.size;
+    target.size += request.bytes.size();
+
+    pending_bytes_ += request.bytes.size();
+    ++pending_writes_;
+    queues_[file % queues_.size()].push_back(std::move(request));
+    lock.unlock();
+    work_.notify_all();
+  }
+
+  void AsyncWriter::Drain() {
+    std::unique_lock<std::mutex> lock{mutex_};
+    done_.wait(lock, [this] { return pending_writes_ == 0; });
+  }
+
+  auto AsyncWriter::Report() const -> AsyncWriterReport {
+    const std::lock_guard<std::mutex> lock{mutex_};
+    return report_;
+  }
+
+  auto AsyncWriter::Acquire(const uint32_t file) -> int {
+    auto& target = files_[file];
+    if (target.descriptor >= 0) {
+      open_files_.splice(open_files_.begin(),
+                         open_files_,
+                         target.open_position);
+      return target.descriptor;
+    }
+
+    // close the least recently written files without a write in progress.
+    for (auto it = open_files_.end();
+         open_files_.size() >= options_.max_open_files &&
+         it != open_files_.begin();) {
+      --it;
+      auto& victim = files_[*it];
+      if (victim.writing > 0) {
+        continue;
+      }
+      detail::CloseDescriptor(victim.descriptor);
+      victim.descriptor = -1;
+      it                = open_files_.erase(it);
+    }
+
+    const auto mode = !target.created   ? detail::OpenMode::kTruncate
+                      : positional_      ? detail::OpenMode::kPositional
+                                         : detail::OpenMode::kAppend;
+    target.descriptor = detail::OpenForWriting(target.path, mode);
+    if (target.descriptor < 0) {
+      fmt::print("Cannot open {}\n", target.path);
+      return -1;
+    }
+    target.created = true;
+    ++report_.opens;
+    open_files_.push_front(file);
+    target.open_position = open_files_.begin();
+    return target.descriptor;
+  }
+
+  void AsyncWriter::Complete(Request& request, const bool succeeded) {
+    if (succeeded) {
+      ++report_.writes;
+      report_.bytes += request.bytes.size();
+    }
+    else {
+      ++report_.failures;
+    }
+
+    pending_bytes_ -= request.bytes.size();
+    --pending_writes_;
+    request.bytes.clear();
+    free_buffers_.push_back(std::move(request.bytes));
+    done_.notify_all();
+  }
+
+  void AsyncWriter::RunThread(const size_t queue) {
+    std::unique_lock<std::mutex> lock{mutex_};
+    for (;;) {
+      work_.wait(lock, [this, queue] {
+        return stopping_ || !queues_[queue].empty();
+      });
+      if (queues_[queue].empty()) {
+        return;
+      }
+
+      auto request = std::move(queues_[queue].front());
+      queues_[queue].pop_front();
+      auto& file            = files_[request.file];
+      const auto descriptor = Acquire(request.file);
+      ++file.writing;
+
+      // a request of the io_uring backend may be partly written, and its
+      // file may have bytes at higher offsets already.
+      const auto bytes =
+        std::string_view{request.bytes}.substr(request.written);
+      const auto offset = request.offset + request.written;
+      lock.unlock();
+      const auto written =
+        descriptor >= 0 &&
+        (positional_ ? detail::WriteAllAt(descriptor, bytes, offset)
+                     : detail::WriteAll(descriptor, bytes));
+      lock.lock();
+
+      --file.writing;
+      Complete(request, written);
+    }
+  }
+
+  void AsyncWriter::RunRing() {
+#if defined(__linux__)
+    // the writes in flight, indexed by their user data.
+    struct InFlight {
+      Request request{};
+      iovec vector{};
+    };
+    std::vector<InFlight> slots(ring_->Entries());
+    auto& queue = queues_.front();
+    std::vector<uint64_t> free_slots{};
+    for (uint64_t i = slots.size(); i > 0; --i) {
+      free_slots.push_back(i - 1);
+    }
+    // the slots of the prepared writes which are not submitted yet
+    std::deque<uint64_t> unsubmitted{};
+
+    const auto reap = [&](const uint64_t slot, const int32_t result) {
+      auto& request = slots[slot].request;
+      --files_[request.file].writing;
+      free_slots.push_back(slot);
+
+      if (result == -EINTR || result == -EAGAIN) {
+        queue.push_front(std::move(request));
+        return;
+      }
+      if (result <= 0) {
+        Complete(request, false);
+        return;
+      }
+      request.written += static_cast<size_t>(result);
+      if (request.written < request.bytes.size()) {
+        // a short write, the rest is written at the following offset.
+        queue.push_front(std::move(request));
+        return;
+      }
+      Complete(request, true);
+    };
+
+    std::unique_lock<std::mutex> lock{mutex_};
+    for (;;) {
+      const auto in_flight = slots.size() - free_slots.size();
+      if (in_flight == 0) {
+        work_.wait(lock,
+                   [this, &queue] { return stopping_ || !queue.empty(); });
+        if (queue.empty()) {
+          return;
+        }
+      }
+
+      // the requests are written at their own offsets, in any order.
+      auto prepared = false;
+      while (!queue.empty() && !free_slots.empty()) {
+        auto request = std::move(queue.front());
+        queue.pop_front();
+        const auto descriptor = Acquire(request.file);
+        if (descriptor < 0) {
+          Complete(request, false);
+          continue;
+        }
+        ++files_[request.file].writing;
+
+        const auto slot = free_slots.back();
+        free_slots.pop_back();
+        auto& entry           = slots[slot];
+        entry.request         = std::move(request);
+        const auto written    = entry.request.written;
+        entry.vector.iov_base = entry.request.bytes.data() + written;
+        entry.vector.iov_len  = entry.request.bytes.size() - written;
+        ring_->PrepareWrite(descriptor,
+                            entry.vector,
+                            entry.request.offset + written,
+                            slot);
+        unsubmitted.push_back(slot);
+        prepared = true;
+      }
+      if (prepared) {
+        ++report_.submissions;
+      }
+
+      // wait for a completion, unless there are queued requests to submit.
+      const auto wait = free_slots.size() < slots.size() &&
+                        (queue.empty() || free_slots.empty());
+      lock.unlock();
+      const auto submitted = ring_->Submit(wait ? 1 : 0);
+      lock.lock();
+      if (!submitted) {
+        break;
+      }
+      unsubmitted.erase(unsubmitted.begin(),
+                        unsubmitted.end() - ring_->Prepared());
+      ring_->Reap(reap);
+    }
+
+    // The ring failed, the writes which are not submitted are queued again
+    // in order, then the submitted ones are waited for.
+    fmt::print("io_uring submission failed, the outputs are written by a "
+               "thread\n");
+    ring_->Discard();
+    for (auto it = unsubmitted.rbegin(); it != unsubmitted.rend(); ++it) {
+      auto& request = slots[*it].request;
+      --files_[request.file].writing;
+      free_slots.push_back(*it);
+      queue.push_front(std::move(request));
+    }
+    while (free_slots.size() < slots.size()) {
+      lock.unlock();
+      if (!ring_->Submit(1)) {
+        // the completions are still posted by the kernel.
+        std::this_thread::yield();
+      }
+      lock.lock();
+      ring_->Reap(reap);
+    }
+
+    // the files stay open for positional writes, at the offsets of the
+    // requests, since the writes of a file may complete in any order.
+    ring_.reset();
+    report_.io_uring = false;
+    lock.unlock();
+    RunThread(0);
+#endif
+  }
+}   // namespace longlp
@@ -0,0 +1,153 @@
+// Copyright 2022 Long Le Phi. All rights reserved.
+// Use of this source code is governed by a MIT license that can be
+// found in the LICENSE file.
+
+#ifndef ASYNC_WRITER_HPP_
+#define ASYNC_WRITER_HPP_
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace longlp {
+  enum class OutputBackend {
+    // io_uring when the kernel supports it, else the writer threads.
+    kAuto,
+    kIoUring,
+    kThreads,
+  };
+
+  struct AsyncWriterOptions {
+    OutputBackend backend{OutputBackend::kAuto};
+    // the least recently written files are closed beyond this number of open
+    // files, and reopened on their next write.
+    size_t max_open_files{256};
+    // io_uring: maximum number of writes in flight.
+    size_t queue_depth{64};
+    // writer threads, the files are dealt to them in turn.
+    size_t threads{2};
+    // the writes block while more bytes are waiting to be written.
+    size_t max_pending_bytes{64U << 20U};
+  };
+
+  struct AsyncWriterReport {
+    bool io_uring{false};
+    size_t writes{0};
+    size_t bytes{0};
+    // io_uring: number of batches of writes submitted to the kernel.
+    size_t submissions{0};
+    // file opens, including the reopening of the files which were closed
+    // as least recently written.
+    size_t opens{0};
+    size_t failures{0};
+    // total time the writes waited for the pending bytes to be written.
+    std::chrono::nanoseconds stall{0};
+  };
+
+  // An output stage which writes the byte buffers of many files
+  // asynchronously, so the threads which format the outputs never wait for
+  // the disk. The writes are submitted in batches through io_uring on Linux,
+  // else they are written by a few writer threads. At most |max_open_files|
+  // files are open at once, besides those with a write in progress.
+  //
+  // The writes of a file are appended in the order of the Write() calls.
+  class AsyncWriter {
+   public:
+    explicit AsyncWriter(const AsyncWriterOptions& options);
+    AsyncWriter(const AsyncWriter&)                    = delete;
+    auto operator=(const AsyncWriter&) -> AsyncWriter& = delete;
+    AsyncWriter(AsyncWriter&&)                         = delete;
+    auto operator=(AsyncWriter&&) -> AsyncWriter&      = delete;
+    // Write out every pending byte, then close the files.
+    ~AsyncWriter();
+
+    // Register the file of |path|, which is created or truncated by its
+    // first write if |size| is 0. Else the writes follow the first |size|
+    // bytes of the existing file, which should have this size. Return its
+    // identifier for Write().
+    auto AddFile(std::string path, uint64_t size) -> uint32_t;
+
+    // Append |bytes| to |file| asynchronously, from any thread. The storage
+    // of |bytes| is swapped with an empty recycled buffer. Block while
+    // |max_pending_bytes| bytes are waiting to be written.
+    void Write(uint32_t file, std::string& bytes);
+
+    // Wait until every write is done.
+    void Drain();
+
+    // the summary of the writes so far, complete after Drain().
+    auto Report() const -> AsyncWriterReport;
+
+   private:
+    class Ring;
+
+    struct File {
+      std::string path{};
+      int descriptor{-1};
+      // set once the file is created or if it is resumed, it is appended to
+      // when reopened.
+      bool created{false};
+      // writes in progress, which keep the file open
+      size_t writing{0};
+      // bytes written so far, the offset of the next io_uring write
+      uint64_t size{0};
+      // position in |open_files_| while open
+      std::list<uint32_t>::iterator open_position{};
+    };
+
+    struct Request {
+      uint32_t file{0};
+      std::string bytes{};
+      uint64_t offset{0};
+      size_t written{0};
+    };
+
+    // Return the descriptor of |file|, which is opened if needed after
+    // closing the least recently written idle files. -1 on failure.
+    // |mutex_| must be held.
+    auto Acquire(uint32_t file) -> int;
+
+    // Account the end of |request|. |mutex_| must be held.
+    void Complete(Request& request, bool succeeded);
+
+    // Write the requests of |queue| with blocking writes.
+    void RunThread(size_t queue);
+
+    // Submit the requests through |ring_|.
+    void RunRing();
+
+    AsyncWriterOptions options_;
+
+    mutable std::mutex mutex_{};
+    // notified when a request is queued, or when stopping
+    std::condition_variable work_{};
+    // notified when a request is done
+    std::condition_variable done_{};
+
+    // a deque never moves its elements, they are referenced while writing.
+    std::deque<File> files_{};
+    // the open files, most recently written first
+    std::list<uint32_t> open_files_{};
+    std::vector<std::deque<Request>> queues_{};
+    std::vector<std::string> free_buffers_{};
+    size_t pending_bytes_{0};
+    size_t pending_writes_{0};
+    AsyncWriterReport report_{};
+    bool stopping_{false};
+    // the requests are written at their offsets, as io_uring does, else
+    // they are appended in order.
+    bool positional_{false};
+
+    std::unique_ptr<Ring> ring_{nullptr};
+    std::vector<std::thread> threads_{};
+  };
+}   // namespace longlp
+
+#endif   // ASYNC_WRITER_HPP_
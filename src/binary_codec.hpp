@@ -0,0 +1,94 @@
+// Copyright 2022 Long Le Phi. All rights reserved.
+// Use of this source code is governed by a MIT license that can be
+// found in the LICENSE file.
+
+#ifndef BINARY_CODEC_HPP_
+#define BINARY_CODEC_HPP_
+
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include "definitions.hpp"
+
+namespace longlp {
+  // The encoding of the values of the binary files: the binary feeds, the
+  // checkpoints and the consolidated output. Every value is stored as it is
+  // laid out in memory, in the byte order of the host.
+  namespace detail {
+    // the levels are copied as they are laid out in a side list.
+    static_assert(std::is_trivially_copyable_v<Level> && sizeof(Level) == 16,
+                  "a level should be 16 bytes without padding");
+
+    template <typename T>
+    void Append(std::string& buffer, const T& value) {
+      static_assert(std::is_trivially_copyable_v<T>,
+                    "a value is copied as its bytes");
+      buffer.append(reinterpret_cast<const char*>(&value), sizeof(T));
+    }
+
+    // Append the levels of |side|, without their count.
+    inline void AppendSide(std::string& buffer, const SideList& side) {
+      buffer.append(reinterpret_cast<const char*>(side.data()),
+                    side.size() * sizeof(Level));
+    }
+
+    // Append the u32 length then the bytes of |value|.
+    inline void AppendString(std::string& buffer,
+                             const std::string_view value) {
+      Append(buffer, static_cast<uint32_t>(value.size()));
+      buffer.append(value);
+    }
+
+    // Read a |T| at |offset| of |content| then move |offset| past it.
+    // Return false if |content| is too short.
+    template <typename T>
+    auto Read(const std::string_view content, size_t& offset, T& value)
+      -> bool {
+      static_assert(std::is_trivially_copyable_v<T>,
+                    "a value is copied as its bytes");
+      if (content.size() - offset < sizeof(T)) {
+        return false;
+      }
+      std::memcpy(&value, content.data() + offset, sizeof(T));
+      offset += sizeof(T);
+      return true;
+    }
+
+    // Read |count| levels into |side|, the same way.
+    inline auto ReadSide(const std::string_view content,
+                         size_t& offset,
+                         const uint32_t count,
+                         SideList& side) -> bool {
+      const auto bytes = size_t{count} * sizeof(Level);
+      if (content.size() - offset < bytes) {
+        return false;
+      }
+      side.resize(count);
+      // an empty side may have no storage to copy into.
+      if (bytes > 0) {
+        std::memcpy(side.data(), content.data() + offset, bytes);
+      }
+      offset += bytes;
+      return true;
+    }
+
+    // Read a string of AppendString() into |value|, a std::string or a
+    // std::string_view of |content|.
+    template <typename String>
+    auto ReadString(const std::string_view content,
+                    size_t& offset,
+                    String& value) -> bool {
+      uint32_t length = 0;
+      if (!Read(content, offset, length) || content.size() - offset < length) {
+        return false;
+      }
+      value = content.substr(offset, length);
+      offset += length;
+      return true;
+    }
+  }   // namespace detail
+}   // namespace longlp
+
+#endif   // BINARY_CODEC_HPP_
@@ -0,0 +1,183 @@
+// Copyright 2022 Long Le Phi. All rights reserved.
+// Use of this source code is governed by a MIT license that can be
+// found in the LICENSE file.
+
+#include "binary_feed.hpp"
+
+#include <array>
+#include "binary_codec.hpp"
+#include "longlp_config.hpp"
+
+namespace longlp {
+  namespace {
+    constexpr std::array<char, 8> kMagic =
+      {'O', 'B', 'W', 'F', 'E', 'E', 'D', '1'};
+    constexpr uint32_t kVersion = 1;
+
+    // the records are written out by blocks of this size.
+    constexpr size_t kBufferBytes = 1U << 20U;
+
+    struct Header {
+      std::array<char, 8> magic{kMagic};
+      uint32_t version{kVersion};
+      int32_t price_decimals{config::price_decimals};
+      int32_t quantity_decimals{config::quantity_decimals};
+      uint32_t symbol_count{0};
+      uint64_t symbol_table_offset{0};
+      uint64_t record_count{0};
+    };
+
+    static_assert(sizeof(Header) == 40, "the header should not be padded");
+  }   // namespace
+
+  auto BinaryFeedWriter::Open(const std::string& path) -> bool {
+    file_.open(path, std::ios::binary | std::ios::trunc);
+    if (!file_.is_open()) {
+      return false;
+    }
+
+    // the header is written again once the symbol table is known.
+    symbols_ = SymbolTable{};
+    records_ = 0;
+    buffer_.clear();
+    detail::Append(buffer_, Header{});
+    FlushBuffer();
+    offset_ = sizeof(Header);
+    return true;
+  }
+
+  void BinaryFeedWriter::Write(const FeedRecord& record) {
+    auto inserted = false;
+    const auto id = symbols_.Intern(record.symbol, inserted);
+
+    detail::Append(buffer_, static_cast<uint8_t>(record.type));
+    detail::Append(buffer_, id);
+    if (record.type == FeedRecord::Type::kBook) {
+      detail::Append(buffer_, static_cast<uint32_t>(record.book.bids.size()));
+      detail::Append(buffer_, static_cast<uint32_t>(record.book.asks.size()));
+      detail::AppendSide(buffer_, record.book.bids);
+      detail::AppendSide(buffer_, record.book.asks);
+    }
+    else {
+      detail::Append(buffer_, record.trade.price);
+      detail::Append(buffer_, record.trade.quantity);
+    }
+
+    ++records_;
+    if (buffer_.size() >= kBufferBytes) {
+      FlushBuffer();
+    }
+  }
+
+  auto BinaryFeedWriter::Close() -> bool {
+    FlushBuffer();
+
+    Header header{};
+    header.symbol_count        = static_cast<uint32_t>(symbols_.Size());
+    header.symbol_table_offset = offset_;
+    header.record_count        = records_;
+
+    for (SymbolId id = 0; id < symbols_.Size(); ++id) {
+      const auto& symbol = symbols_.Name(id);
+      detail::AppendString(buffer_, symbol);
+    }
+    FlushBuffer();
+
+    file_.seekp(0);
+    file_.write(reinterpret_cast<const char*>(&header), sizeof(Header));
+    const auto written = file_.good();
+    file_.close();
+    return written;
+  }
+
+  void BinaryFeedWriter::FlushBuffer() {
+    file_.write(buffer_.data(), static_cast<std::streamsize>(buffer_.size()));
+    offset_ += buffer_.size();
+    buffer_.clear();
+  }
+
+  auto BinaryFeedReader::Open(const std::string& path) -> bool {
+    symbols_.clear();
+    records_      = {};
+    offset_       = 0;
+    record_count_ = 0;
+    failed_       = false;
+
+    if (!file_.Open(path)) {
+      return false;
+    }
+
+    const auto content = file_.View();
+    Header header{};
+    size_t offset = 0;
+    if (!detail::Read(content, offset, header) || header.magic != kMagic ||
+        header.version != kVersion ||
+        header.price_decimals != config::price_decimals ||
+        header.quantity_decimals != config::quantity_decimals ||
+        header.symbol_table_offset < sizeof(Header) ||
+        header.symbol_table_offset > content.size()) {
+      return false;
+    }
+
+    offset = header.symbol_table_offset;
+    for (auto i = 0U; i < header.symbol_count; ++i) {
+      if (!detail::ReadString(content, offset, symbols_.emplace_back())) {
+        return false;
+      }
+    }
+
+    records_      = content.substr(sizeof(Header),
+                              header.symbol_table_offset - sizeof(Header));
+    record_count_ = header.record_count;
+    return true;
+  }
+
+  auto BinaryFeedReader::Next(FeedRecord& record) -> bool {
+    SymbolId id = 0;
+    if (!Next(record, id)) {
+      return false;
+    }
+    record.symbol.assign(symbols_[id]);
+    return true;
+  }
+
+  auto BinaryFeedReader::Next(FeedRecord& record, SymbolId& symbol) -> bool {
+    if (failed_ || offset_ == records_.size()) {
+      return false;
+    }
+
+    uint8_t type = 0;
+    if (!detail::Read(records_, offset_, type) ||
+        !detail::Read(records_, offset_, symbol) ||
+        symbol >= symbols_.size()) {
+      failed_ = true;
+      return false;
+    }
+
+    auto read = false;
+    if (type == static_cast<uint8_t>(FeedRecord::Type::kBook)) {
+      record.type   = FeedRecord::Type::kBook;
+      uint32_t bids = 0;
+      uint32_t asks = 0;
+      read = detail::Read(records_, offset_, bids) &&
+             detail::Read(records_, offset_, asks) &&
+             detail::ReadSide(records_, offset_, bids, record.book.bids) &&
+             detail::ReadSide(records_, offset_, asks, record.book.asks);
+    }
+    else if (type == static_cast<uint8_t>(FeedRecord::Type::kTrade)) {
+      record.type = FeedRecord::Type::kTrade;
+      read = detail::Read(records_, offset_, record.trade.price) &&
+             detail::Read(records_, offset_, record.trade.quantity);
+    }
+
+    failed_ = !read;
+    return !failed_;
+  }
+
+  auto IsBinaryFeedFile(const std::string& path) -> bool {
+    std::ifstream opener(path, std::ios::binary);
+    std::array<char, kMagic.size()> magic{};
+    opener.read(magic.data(), static_cast<std::streamsize>(magic.size()));
+    return opener.good() && magic == kMagic;
+  }
+}   // namespace longlp
@@ -0,0 +1,99 @@
+// Copyright 2022 Long Le Phi. All rights reserved.
+// Use of this source code is governed by a MIT license that can be
+// found in the LICENSE file.
+
+#ifndef BINARY_FEED_HPP_
+#define BINARY_FEED_HPP_
+
+#include <cstdint>
+#include <fstream>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "definitions.hpp"
+#include "mapped_file.hpp"
+#include "symbol_table.hpp"
+
+namespace longlp {
+  // A compact binary replay format of the market feeds, so a capture which
+  // is replayed many times is only parsed from json once. Every value is
+  // stored in the byte order of the host.
+  //
+  //   header  magic "OBWFEED1", version, price and quantity decimals,
+  //           symbol count, symbol table offset, record count
+  //   records book:  u8 type, u32 symbol id, u32 bid count, u32 ask count,
+  //                  then the bid and ask levels (i64 price, i32 quantity,
+  //                  u32 count)
+  //           trade: u8 type, u32 symbol id, i64 price, i32 quantity
+  //   symbols u32 length then the bytes of each interned symbol, in id order
+  //
+  // The prices and quantities are the fixed-point values, thus a file can
+  // only be read with the decimals it was written with.
+  class BinaryFeedWriter {
+   public:
+    // Create or truncate |path|. Return false on failure.
+    auto Open(const std::string& path) -> bool;
+
+    void Write(const FeedRecord& record);
+
+    // Write the symbol table and the header. Return false on failure.
+    auto Close() -> bool;
+
+   private:
+    void FlushBuffer();
+
+    std::ofstream file_{};
+    SymbolTable symbols_{};
+    uint64_t records_{0};
+    uint64_t offset_{0};
+    std::string buffer_{};
+  };
+
+  // Read the records of a binary feed file through a memory mapping.
+  class BinaryFeedReader {
+   public:
+    // Map |path| and check its header. Return false if it is not a binary
+    // feed file written with the configured decimals.
+    auto Open(const std::string& path) -> bool;
+
+    // Read the next record into |record|, which keeps its storage.
+    // Return false at the end of the records, or if a record is malformed.
+    auto Next(FeedRecord& record) -> bool;
+
+    // Same as above, but the symbol of |record| is left as is and its
+    // identifier in the file is set into |symbol| instead, e.g. to map it
+    // to another table once per symbol rather than per record.
+    auto Next(FeedRecord& record, SymbolId& symbol) -> bool;
+
+    // number of the symbols of the file, the identifiers are below it.
+    auto SymbolCount() const -> size_t {
+      return symbols_.size();
+    }
+
+    auto Symbol(const SymbolId id) const -> std::string_view {
+      return symbols_[id];
+    }
+
+    // a malformed record has been read.
+    auto Failed() const -> bool {
+      return failed_;
+    }
+
+    auto RecordCount() const -> uint64_t {
+      return record_count_;
+    }
+
+   private:
+    MappedFile file_{};
+    std::vector<std::string_view> symbols_{};
+    std::string_view records_{};
+    size_t offset_{0};
+    uint64_t record_count_{0};
+    bool failed_{false};
+  };
+
+  // Whether |path| starts with the magic of a binary feed file.
+  auto IsBinaryFeedFile(const std::string& path) -> bool;
+}   // namespace longlp
+
+#endif   // BINARY_FEED_HPP_
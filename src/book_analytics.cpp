@@ -0,0 +1,161 @@
+// Copyright 2022 Long Le Phi. All rights reserved.
+// Use of this source code is governed by a MIT license that can be
+// found in the LICENSE file.
+
+#include "book_analytics.hpp"
+
+#include <fmt/format.h>
+#include <algorithm>
+#include <cmath>
+#include "longlp_config.hpp"
+
+namespace longlp {
+  namespace {
+    constexpr std::string_view kHeader =
+      "book,spread,mid,microprice,imbalance,vwap,volume\n";
+
+    // decimals of the derived values, beyond those of the feed
+    constexpr int32_t kMidDecimals        = config::price_decimals + 1;
+    constexpr int32_t kMicropriceDecimals = config::price_decimals + 2;
+    constexpr int32_t kImbalanceDecimals  = 4;
+
+    constexpr auto kPriceUnit = static_cast<double>(kPriceScale);
+
+    // sum the quantities of the best |levels| levels of |side|.
+    template <typename Side>
+    auto Depth(const Side& side, const size_t levels) -> Volume {
+      Volume depth = 0;
+      for (size_t i = 0; i < std::min(levels, side.size()); ++i) {
+        depth += side[i].quantity;
+      }
+      return depth;
+    }
+
+    // append ",<value>" to |output|, where |value| is a fixed-point value
+    // of |decimals| decimals. The integers are formatted by hand, as the
+    // outputs of the worker.
+    void AppendFixed(const int64_t value,
+                     const int32_t decimals,
+                     std::string& output) {
+      const auto scale     = static_cast<uint64_t>(detail::Pow10(decimals));
+      const auto magnitude = value < 0 ? 0U - static_cast<uint64_t>(value)
+                                       : static_cast<uint64_t>(value);
+      output += value < 0 ? ",-" : ",";
+      const fmt::format_int units{magnitude / scale};
+      output.append(units.data(), units.size());
+      if (decimals == 0) {
+        return;
+      }
+
+      // the fraction is padded with leading zeros
+      const fmt::format_int fraction{scale + magnitude % scale};
+      output += '.';
+      output.append(fraction.data() + 1, fraction.size() - 1);
+    }
+
+    // append ",<value>" with |decimals| decimals, rounded, to |output|.
+    void AppendRounded(const double value,
+                       const int32_t decimals,
+                       std::string& output) {
+      const auto scale = static_cast<double>(detail::Pow10(decimals));
+      AppendFixed(static_cast<int64_t>(std::llround(value * scale)),
+                  decimals,
+                  output);
+    }
+  }   // namespace
+
+  template <typename Book>
+  void BookAnalytics::Record(const Book& book,
+                             const std::vector<TradeRecord>& trades) {
+    TopOfBook top{};
+    const auto has_bid = !book.bids.empty();
+    const auto has_ask = !book.asks.empty();
+    if (has_bid) {
+      top.bid          = book.bids.front().price;
+      top.bid_quantity = book.bids.front().quantity;
+    }
+    if (has_ask) {
+      top.ask          = book.asks.front().price;
+      top.ask_quantity = book.asks.front().quantity;
+    }
+    top.bid_depth = Depth(book.bids, depth_levels_);
+    top.ask_depth = Depth(book.asks, depth_levels_);
+
+    if (books_ == 0 || !trades.empty() || !(top == last_)) {
+      AppendLine(top, has_bid, has_ask, trades);
+      last_ = top;
+    }
+    ++books_;
+  }
+
+  void BookAnalytics::AppendLine(const TopOfBook& top,
+                                 const bool has_bid,
+                                 const bool has_ask,
+                                 const std::vector<TradeRecord>& trades) {
+    auto& output = output_.Buffer();
+    if (books_ == 0) {
+      output += kHeader;
+    }
+    const fmt::format_int book{books_};
+    output.append(book.data(), book.size());
+
+    if (has_bid && has_ask) {
+      // the mid has one more decimal, so both are exact.
+      AppendFixed(top.ask - top.bid, config::price_decimals, output);
+      AppendFixed((top.ask + top.bid) * 5, kMidDecimals, output);
+
+      const auto bid = static_cast<double>(top.bid);
+      const auto ask = static_cast<double>(top.ask);
+
+      const auto quantity =
+        static_cast<double>(top.bid_quantity + top.ask_quantity);
+      const auto microprice =
+        quantity > 0.0
+          ? (bid * static_cast<double>(top.ask_quantity) +
+             ask * static_cast<double>(top.bid_quantity)) /
+              quantity
+          : (ask + bid) / 2.0;
+      AppendRounded(microprice / kPriceUnit, kMicropriceDecimals, output);
+    }
+    else {
+      output += ",,,";
+    }
+
+    const auto depth = top.bid_depth + top.ask_depth;
+    if (depth > 0) {
+      AppendRounded(static_cast<double>(top.bid_depth - top.ask_depth) /
+                    static_cast<double>(depth),
+                  kImbalanceDecimals,
+                  output);
+    }
+    else {
+      output += ',';
+    }
+
+    Volume volume   = 0;
+    double notional = 0.0;
+    for (const auto& trade : trades) {
+      volume += trade.quantity;
+      notional +=
+        static_cast<double>(trade.price) * static_cast<double>(trade.quantity);
+    }
+    if (volume > 0) {
+      AppendRounded(notional / static_cast<double>(volume) / kPriceUnit,
+                  kMicropriceDecimals,
+                  output);
+      AppendFixed(volume, config::quantity_decimals, output);
+    }
+    else {
+      output += ",,";
+    }
+    output += '\n';
+    output_.FlushIfFull();
+  }
+
+  template void BookAnalytics::Record(const OrderBookRecord& book,
+                                      const std::vector<TradeRecord>& trades);
+  template void BookAnalytics::Record(const BookT<16>& book,
+                                      const std::vector<TradeRecord>& trades);
+  template void BookAnalytics::Record(const BookT<64>& book,
+                                      const std::vector<TradeRecord>& trades);
+}   // namespace longlp
@@ -0,0 +1,98 @@
+// Copyright 2022 Long Le Phi. All rights reserved.
+// Use of this source code is governed by a MIT license that can be
+// found in the LICENSE file.
+
+#ifndef BOOK_ANALYTICS_HPP_
+#define BOOK_ANALYTICS_HPP_
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "definitions.hpp"
+#include "output_file.hpp"
+#include "soa_book.hpp"
+
+namespace longlp {
+  struct AnalyticsOptions {
+    // number of the best levels of each side summed by the depth imbalance
+    size_t depth_levels{5};
+  };
+
+  // The market data analytics of an instrument, computed from every book
+  // and the trades before it while the book is classified, e.g. instead of
+  // parsing the feeds again with another tool.
+  //
+  // The series is written as csv lines into its output file, with a header
+  // line first:
+  //
+  //   book,spread,mid,microprice,imbalance,vwap,volume
+  //
+  //   book        index of the book in the feed of the instrument
+  //   spread      best ask - best bid
+  //   mid         (best bid + best ask) / 2
+  //   microprice  the best prices weighted by the opposite best quantities
+  //   imbalance   (bid depth - ask depth) / (bid depth + ask depth) over the
+  //               best |depth_levels| levels, in [-1, 1]
+  //   vwap        volume weighted price of the trades since the last book
+  //   volume      total quantity of these trades
+  //
+  // A field is empty if it is undefined, e.g. the spread of a book with an
+  // empty side or the vwap without trade. A book which changes neither the
+  // best levels nor the depths, without trade, has no line.
+  class BookAnalytics {
+   public:
+    explicit BookAnalytics(const AnalyticsOptions& options) :
+      depth_levels_(options.depth_levels) {}
+
+    // Append the analytics of |book|, after |trades|, to the series.
+    template <typename Book>
+    void Record(const Book& book, const std::vector<TradeRecord>& trades);
+
+    // the file of the series, which is opened by the owner.
+    auto Output() -> OutputFile& {
+      return output_;
+    }
+
+   private:
+    // The values of the last line, a book with the same values and without
+    // trade is skipped.
+    struct TopOfBook {
+      Price bid{0};
+      Price ask{0};
+      Volume bid_quantity{0};
+      Volume ask_quantity{0};
+      Volume bid_depth{0};
+      Volume ask_depth{0};
+
+      auto operator==(const TopOfBook& other) const -> bool {
+        return bid == other.bid && ask == other.ask &&
+               bid_quantity == other.bid_quantity &&
+               ask_quantity == other.ask_quantity &&
+               bid_depth == other.bid_depth && ask_depth == other.ask_depth;
+      }
+    };
+
+    void AppendLine(const TopOfBook& top,
+                    bool has_bid,
+                    bool has_ask,
+                    const std::vector<TradeRecord>& trades);
+
+    size_t depth_levels_{0};
+    uint64_t books_{0};
+    TopOfBook last_{};
+    OutputFile output_{};
+  };
+
+  // instantiated in book_analytics.cpp
+  extern template void BookAnalytics::Record(
+    const OrderBookRecord& book,
+    const std::vector<TradeRecord>& trades);
+  extern template void BookAnalytics::Record(
+    const BookT<16>& book,
+    const std::vector<TradeRecord>& trades);
+  extern template void BookAnalytics::Record(
+    const BookT<64>& book,
+    const std::vector<TradeRecord>& trades);
+}   // namespace longlp
+
+#endif   // BOOK_ANALYTICS_HPP_
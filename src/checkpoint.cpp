@@ -0,0 +1,131 @@
+// Copyright 2022 Long Le Phi. All rights reserved.
+// Use of this source code is governed by a MIT license that can be
+// found in the LICENSE file.
+
+#include "checkpoint.hpp"
+
+#include <array>
+#include <string_view>
+#include "binary_codec.hpp"
+#include "longlp_config.hpp"
+#include "mapped_file.hpp"
+#include "output_file.hpp"
+
+namespace longlp {
+  namespace {
+    constexpr std::array<char, 8> kMagic =
+      {'O', 'B', 'W', 'C', 'K', 'P', 'T', '1'};
+    constexpr uint32_t kVersion = 1;
+
+    struct Header {
+      std::array<char, 8> magic{kMagic};
+      uint32_t version{kVersion};
+      int32_t price_decimals{config::price_decimals};
+      int32_t quantity_decimals{config::quantity_decimals};
+      uint32_t input_count{0};
+      uint32_t symbol_count{0};
+      uint32_t file{0};
+      uint64_t offset{0};
+      uint64_t line{0};
+      uint64_t lines{0};
+    };
+
+    static_assert(sizeof(Header) == 56, "the header should not be padded");
+
+    // the smallest encoded input, symbol and trade, to bound the counts of
+    // a malformed checkpoint before allocating.
+    constexpr size_t kMinInputBytes  = sizeof(uint32_t);
+    constexpr size_t kMinSymbolBytes = sizeof(uint32_t) * 4 + sizeof(uint64_t);
+    constexpr size_t kTradeBytes     = sizeof(Price) + sizeof(Quantity);
+  }   // namespace
+
+  auto SaveCheckpoint(const Checkpoint& checkpoint, const std::string& path)
+    -> bool {
+    Header header{};
+    header.input_count  = static_cast<uint32_t>(checkpoint.inputs.size());
+    header.symbol_count = static_cast<uint32_t>(checkpoint.symbols.size());
+    header.file         = checkpoint.position.file;
+    header.offset       = checkpoint.position.offset;
+    header.line         = checkpoint.position.line;
+    header.lines        = checkpoint.lines;
+
+    std::string content{};
+    detail::Append(content, header);
+    for (const auto& input : checkpoint.inputs) {
+      detail::AppendString(content, input);
+    }
+    for (const auto& symbol : checkpoint.symbols) {
+      detail::AppendString(content, symbol.symbol);
+      detail::Append(content, symbol.output_size);
+      detail::Append(content, static_cast<uint32_t>(symbol.book.bids.size()));
+      detail::Append(content, static_cast<uint32_t>(symbol.book.asks.size()));
+      detail::Append(content, static_cast<uint32_t>(symbol.trades.size()));
+      detail::AppendSide(content, symbol.book.bids);
+      detail::AppendSide(content, symbol.book.asks);
+      for (const auto& trade : symbol.trades) {
+        detail::Append(content, trade.price);
+        detail::Append(content, trade.quantity);
+      }
+    }
+    return detail::ReplaceFile(path, content);
+  }
+
+  auto LoadCheckpoint(const std::string& path, Checkpoint& checkpoint)
+    -> bool {
+    MappedFile file{};
+    if (!file.Open(path)) {
+      return false;
+    }
+    const auto content = file.View();
+
+    size_t offset = 0;
+    Header header{};
+    if (!detail::Read(content, offset, header) || header.magic != kMagic ||
+        header.version != kVersion ||
+        header.price_decimals != config::price_decimals ||
+        header.quantity_decimals != config::quantity_decimals) {
+      return false;
+    }
+    if ((content.size() - offset) / kMinInputBytes < header.input_count ||
+        (content.size() - offset) / kMinSymbolBytes < header.symbol_count) {
+      return false;
+    }
+    checkpoint.position.file   = header.file;
+    checkpoint.position.offset = header.offset;
+    checkpoint.position.line   = header.line;
+    checkpoint.lines           = header.lines;
+
+    checkpoint.inputs.resize(header.input_count);
+    for (auto& input : checkpoint.inputs) {
+      if (!detail::ReadString(content, offset, input)) {
+        return false;
+      }
+    }
+
+    checkpoint.symbols.resize(header.symbol_count);
+    for (auto& symbol : checkpoint.symbols) {
+      uint32_t bids   = 0;
+      uint32_t asks   = 0;
+      uint32_t trades = 0;
+      if (!detail::ReadString(content, offset, symbol.symbol) ||
+          !detail::Read(content, offset, symbol.output_size) ||
+          !detail::Read(content, offset, bids) ||
+          !detail::Read(content, offset, asks) ||
+          !detail::Read(content, offset, trades) ||
+          !detail::ReadSide(content, offset, bids, symbol.book.bids) ||
+          !detail::ReadSide(content, offset, asks, symbol.book.asks) ||
+          (content.size() - offset) / kTradeBytes < trades) {
+        return false;
+      }
+
+      symbol.trades.resize(trades);
+      for (auto& trade : symbol.trades) {
+        if (!detail::Read(content, offset, trade.price) ||
+            !detail::Read(content, offset, trade.quantity)) {
+          return false;
+        }
+      }
+    }
+    return offset == content.size();
+  }
+}   // namespace longlp
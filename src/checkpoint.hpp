@@ -0,0 +1,67 @@
+// Copyright 2022 Long Le Phi. All rights reserved.
+// Use of this source code is governed by a MIT license that can be
+// found in the LICENSE file.
+
+#ifndef CHECKPOINT_HPP_
+#define CHECKPOINT_HPP_
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "definitions.hpp"
+
+namespace longlp {
+  // The position of the next line to read in a list of input files.
+  struct InputPosition {
+    // index of the file in the list
+    uint32_t file{0};
+    // byte offset of the next line in the file
+    uint64_t offset{0};
+    // number of lines read from the file
+    uint64_t line{0};
+  };
+
+  // The state of a symbol, which is restored to continue its feed.
+  struct SymbolCheckpoint {
+    std::string symbol{};
+    OrderBookRecord book{};
+    std::vector<TradeRecord> trades{};
+    // size of its output file, whose later bytes are dropped on restore.
+    uint64_t output_size{0};
+  };
+
+  // A snapshot of a run at a line boundary of its input: every line before
+  // |position| has been classified and written out, and none after it.
+  struct Checkpoint {
+    std::vector<std::string> inputs{};
+    InputPosition position{};
+    // number of lines before |position| over every file
+    uint64_t lines{0};
+    // the symbols which have received a book
+    std::vector<SymbolCheckpoint> symbols{};
+  };
+
+  // Write |checkpoint| into |path| in a compact binary format, which
+  // replaces the previous checkpoint at once. Every value is stored in the
+  // byte order of the host.
+  //
+  //   header  magic "OBWCKPT1", version, price and quantity decimals,
+  //           input count, symbol count, then the input position (u32 file,
+  //           u64 offset, u64 line) and u64 line count
+  //   inputs  u32 length then the bytes of each input path
+  //   symbols u32 length then the bytes of the symbol, u64 output size,
+  //           u32 bid count, u32 ask count, u32 trade count, then the bid
+  //           and ask levels (i64 price, i32 quantity, u32 count) and the
+  //           trades (i64 price, i32 quantity)
+  //
+  // Return false on failure.
+  auto SaveCheckpoint(const Checkpoint& checkpoint, const std::string& path)
+    -> bool;
+
+  // Read the checkpoint of |path| into |checkpoint|. Return false if there
+  // is none, or if it is malformed or written with other decimals.
+  auto LoadCheckpoint(const std::string& path, Checkpoint& checkpoint)
+    -> bool;
+}   // namespace longlp
+
+#endif   // CHECKPOINT_HPP_
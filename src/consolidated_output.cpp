@@ -0,0 +1,339 @@
+// Copyright 2022 Long Le Phi. All rights reserved.
+// Use of this source code is governed by a MIT license that can be
+// found in the LICENSE file.
+
+#include "consolidated_output.hpp"
+
+#include <fmt/core.h>
+#include <fmt/format.h>
+#include <algorithm>
+#include <array>
+#include <charconv>
+#include <iterator>
+#include "async_writer.hpp"
+#include "binary_codec.hpp"
+
+namespace longlp {
+  namespace {
+    constexpr std::array<char, 8> kMagic =
+      {'O', 'B', 'W', 'I', 'N', 'D', 'X', '1'};
+    constexpr uint32_t kVersion = 1;
+
+    struct IndexHeader {
+      std::array<char, 8> magic{kMagic};
+      uint32_t version{kVersion};
+      uint32_t format{0};
+      uint32_t segment_count{0};
+      uint32_t symbol_count{0};
+    };
+
+    static_assert(sizeof(IndexHeader) == 24,
+                  "the index header should not be padded");
+
+    struct RecordHeader {
+      uint32_t symbol{0};
+      uint32_t events{0};
+      uint64_t sequence{0};
+      uint64_t length{0};
+    };
+
+    static_assert(sizeof(RecordHeader) == 24,
+                  "the record header should not be padded");
+
+    auto SegmentPath(const std::string_view out_dir, const uint32_t segment)
+      -> std::string {
+      return fmt::format("{}/events.{:05}.log", out_dir, segment);
+    }
+
+    auto IndexPath(const std::string_view out_dir) -> std::string {
+      return fmt::format("{}/events.idx", out_dir);
+    }
+
+    // Parse the unsigned number which ends at the next space of |line|,
+    // from |offset|. Move |offset| past the space.
+    auto ReadNumber(const std::string_view line,
+                    size_t& offset,
+                    uint64_t& value) -> bool {
+      const auto end = line.find(' ', offset);
+      if (end == std::string_view::npos) {
+        return false;
+      }
+      const auto [ptr, error] =
+        std::from_chars(line.data() + offset, line.data() + end, value);
+      if (error != std::errc{} || ptr != line.data() + end) {
+        return false;
+      }
+      offset = end + 1;
+      return true;
+    }
+  }   // namespace
+
+  ConsolidatedWriter::~ConsolidatedWriter() {
+    Close();
+  }
+
+  auto ConsolidatedWriter::Open(const std::string& out_dir,
+                                const ConsolidatedOptions& options,
+                                AsyncWriter* async_writer) -> bool {
+    Close();
+
+    const std::lock_guard<std::mutex> lock{mutex_};
+    out_dir_       = out_dir;
+    options_       = options;
+    async_writer_  = async_writer;
+    segment_count_ = 0;
+    streams_.clear();
+    open_ = StartSegment();
+    return open_;
+  }
+
+  auto ConsolidatedWriter::AddSymbol(const std::string_view symbol)
+    -> uint32_t {
+    const std::lock_guard<std::mutex> lock{mutex_};
+    streams_.emplace_back().name = symbol;
+    return static_cast<uint32_t>(streams_.size() - 1);
+  }
+
+  void ConsolidatedWriter::Write(const uint32_t symbol, std::string& bytes) {
+    if (bytes.empty()) {
+      return;
+    }
+
+    const std::lock_guard<std::mutex> lock{mutex_};
+    if (!open_) {
+      bytes.clear();
+      return;
+    }
+
+    auto& stream      = streams_[symbol];
+    const auto events = static_cast<uint64_t>(
+      std::count(bytes.begin(), bytes.end(), '\n'));
+    record_.clear();
+    if (options_.format == RecordFormat::kBinary) {
+      RecordHeader header{};
+      header.symbol   = symbol;
+      header.events   = static_cast<uint32_t>(events);
+      header.sequence = stream.events;
+      header.length   = bytes.size();
+      detail::Append(record_, header);
+      record_.append(bytes);
+    }
+    else {
+      // the outputs are whole lines, so every flush starts with an event.
+      auto sequence = stream.events;
+      for (size_t begin = 0; begin < bytes.size();) {
+        auto end = bytes.find('\n', begin);
+        end      = end == std::string::npos ? bytes.size() : end + 1;
+        fmt::format_to(std::back_inserter(record_),
+                       "{} {} ",
+                       symbol,
+                       sequence++);
+        record_.append(bytes, begin, end - begin);
+        begin = end;
+      }
+    }
+
+    if (segment_size_ > 0 &&
+        segment_size_ + record_.size() > options_.segment_bytes &&
+        !StartSegment()) {
+      open_ = false;
+      bytes.clear();
+      return;
+    }
+    stream.records.push_back(
+      RecordLocation{segment_count_ - 1, segment_size_, record_.size()});
+    stream.events += events;
+    segment_size_ += record_.size();
+    segment_.Append(record_);
+    bytes.clear();
+  }
+
+  auto ConsolidatedWriter::Flush() -> bool {
+    const std::lock_guard<std::mutex> lock{mutex_};
+    if (!open_) {
+      return false;
+    }
+    return segment_.Flush();
+  }
+
+  auto ConsolidatedWriter::Finish() -> bool {
+    const std::lock_guard<std::mutex> lock{mutex_};
+    if (!open_) {
+      return false;
+    }
+    const auto flushed = segment_.Flush();
+    return WriteIndex() && flushed;
+  }
+
+  void ConsolidatedWriter::Close() {
+    if (!open_) {
+      return;
+    }
+    Finish();
+
+    const std::lock_guard<std::mutex> lock{mutex_};
+    segment_.Close();
+    open_ = false;
+  }
+
+  auto ConsolidatedWriter::StartSegment() -> bool {
+    const auto path = SegmentPath(out_dir_, segment_count_);
+    ++segment_count_;
+    segment_size_ = 0;
+    if (async_writer_ != nullptr) {
+      segment_.Attach(*async_writer_, async_writer_->AddFile(path, 0), 0);
+      return true;
+    }
+    if (!segment_.Open(path)) {
+      fmt::print("Cannot open {}\n", path);
+      return false;
+    }
+    return true;
+  }
+
+  auto ConsolidatedWriter::WriteIndex() -> bool {
+    IndexHeader header{};
+    header.format        = static_cast<uint32_t>(options_.format);
+    header.segment_count = segment_count_;
+    header.symbol_count  = static_cast<uint32_t>(streams_.size());
+
+    std::string index{};
+    detail::Append(index, header);
+    for (const auto& stream : streams_) {
+      detail::AppendString(index, stream.name);
+      detail::Append(index, stream.events);
+      const uint64_t records = stream.records.size();
+      detail::Append(index, records);
+      for (const auto& record : stream.records) {
+        detail::Append(index, record.segment);
+        detail::Append(index, record.offset);
+        detail::Append(index, record.length);
+      }
+    }
+
+    // the index is replaced at once, a reader never sees a partial one.
+    const auto path = IndexPath(out_dir_);
+    if (!detail::ReplaceFile(path, index)) {
+      fmt::print("Cannot write {}\n", path);
+      return false;
+    }
+    return true;
+  }
+
+  auto ConsolidatedReader::Open(const std::string& out_dir) -> bool {
+    symbols_ = SymbolTable{};
+    streams_.clear();
+    segments_.clear();
+
+    MappedFile file{};
+    if (!file.Open(IndexPath(out_dir))) {
+      return false;
+    }
+    const auto index = file.View();
+
+    size_t offset = 0;
+    IndexHeader header{};
+    if (!detail::Read(index, offset, header) || header.magic != kMagic ||
+        header.version != kVersion ||
+        header.format > static_cast<uint32_t>(RecordFormat::kText)) {
+      return false;
+    }
+    format_ = static_cast<RecordFormat>(header.format);
+
+    for (uint32_t i = 0; i < header.symbol_count; ++i) {
+      std::string_view name{};
+      if (!detail::ReadString(index, offset, name)) {
+        return false;
+      }
+      auto inserted = false;
+      symbols_.Intern(name, inserted);
+      if (!inserted) {
+        return false;
+      }
+
+      auto& stream     = streams_.emplace_back();
+      uint64_t records = 0;
+      if (!detail::Read(index, offset, stream.events) ||
+          !detail::Read(index, offset, records)) {
+        return false;
+      }
+      for (uint64_t j = 0; j < records; ++j) {
+        auto& record = stream.records.emplace_back();
+        if (!detail::Read(index, offset, record.segment) ||
+            !detail::Read(index, offset, record.offset) ||
+            !detail::Read(index, offset, record.length) ||
+            record.segment >= header.segment_count) {
+          return false;
+        }
+      }
+    }
+
+    segments_.resize(header.segment_count);
+    for (uint32_t i = 0; i < header.segment_count; ++i) {
+      if (!segments_[i].Open(SegmentPath(out_dir, i))) {
+        return false;
+      }
+    }
+    return true;
+  }
+
+  auto ConsolidatedReader::Extract(const std::string_view symbol,
+                                   std::string& output) -> bool {
+    const auto id = symbols_.Find(symbol);
+    if (id == kInvalidSymbolId) {
+      return false;
+    }
+
+    const auto& stream = streams_[id];
+    uint64_t sequence  = 0;
+    for (const auto& location : stream.records) {
+      const auto segment = segments_[location.segment].View();
+      if (location.offset > segment.size() ||
+          segment.size() - location.offset < location.length) {
+        return false;
+      }
+      const auto record = segment.substr(location.offset, location.length);
+      if (!ExtractRecord(record, id, sequence, output)) {
+        return false;
+      }
+    }
+    return sequence == stream.events;
+  }
+
+  auto ConsolidatedReader::ExtractRecord(const std::string_view record,
+                                         const SymbolId symbol,
+                                         uint64_t& sequence,
+                                         std::string& output) const -> bool {
+    if (format_ == RecordFormat::kBinary) {
+      size_t offset = 0;
+      RecordHeader header{};
+      if (!detail::Read(record, offset, header) || header.symbol != symbol ||
+          header.sequence != sequence ||
+          header.length != record.size() - offset) {
+        return false;
+      }
+      output.append(record.substr(offset));
+      sequence += header.events;
+      return true;
+    }
+
+    for (size_t begin = 0; begin < record.size();) {
+      auto end = record.find('\n', begin);
+      end      = end == std::string_view::npos ? record.size() : end + 1;
+      const auto line = record.substr(begin, end - begin);
+      begin           = end;
+
+      size_t offset          = 0;
+      uint64_t id            = 0;
+      uint64_t line_sequence = 0;
+      if (!ReadNumber(line, offset, id) ||
+          !ReadNumber(line, offset, line_sequence) || id != symbol ||
+          line_sequence != sequence) {
+        return false;
+      }
+      output.append(line.substr(offset));
+      ++sequence;
+    }
+    return true;
+  }
+}   // namespace longlp
@@ -0,0 +1,158 @@
+// Copyright 2022 Long Le Phi. All rights reserved.
+// Use of this source code is governed by a MIT license that can be
+// found in the LICENSE file.
+
+#ifndef CONSOLIDATED_OUTPUT_HPP_
+#define CONSOLIDATED_OUTPUT_HPP_
+
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "mapped_file.hpp"
+#include "output_file.hpp"
+#include "symbol_table.hpp"
+
+namespace longlp {
+  enum class RecordFormat {
+    // a fixed header before the events of each record
+    kBinary,
+    // every event line is prefixed with its symbol id and sequence number
+    kText,
+  };
+
+  struct ConsolidatedOptions {
+    RecordFormat format{RecordFormat::kBinary};
+    // a new segment file is started once a record would not fit in this
+    // size, a record is never split across segments.
+    uint64_t segment_bytes{256ULL << 20U};
+  };
+
+  // The place of a record in the segments of a consolidated output.
+  struct RecordLocation {
+    uint32_t segment{0};
+    uint64_t offset{0};
+    uint64_t length{0};
+  };
+
+  // A single append-only output of the classified events of every symbol,
+  // as an alternative to one <symbol>.txt file per symbol. The events of a
+  // symbol are written as records, each holding the lines of one flush of
+  // its buffer. Every value is stored in the byte order of the host.
+  //
+  //   segments <out_dir>/events.00000.log, events.00001.log...
+  //            binary record: u32 symbol id, u32 event count, u64 sequence,
+  //                           u64 length, then |length| bytes of events
+  //            text record:   "<symbol id> <sequence> <event>\n" per event
+  //   index    <out_dir>/events.idx: magic "OBWINDX1", version, format,
+  //            segment count, symbol count, then per symbol in id order:
+  //            u32 length then the bytes of its name, u64 event count,
+  //            u64 record count, then the location of every record in
+  //            order (u32 segment, u64 offset, u64 length)
+  //
+  // The sequence of an event is its number in the stream of its symbol,
+  // from 0. The sequence of a binary record is the one of its first event.
+  class ConsolidatedWriter {
+   public:
+    ConsolidatedWriter() = default;
+    ConsolidatedWriter(const ConsolidatedWriter&)                    = delete;
+    auto operator=(const ConsolidatedWriter&) -> ConsolidatedWriter& = delete;
+    ConsolidatedWriter(ConsolidatedWriter&&)                         = delete;
+    auto operator=(ConsolidatedWriter&&) -> ConsolidatedWriter&      = delete;
+    ~ConsolidatedWriter();
+
+    // Start the first segment in |out_dir|. The segments are written
+    // through |async_writer| if it is not nullptr, which must outlive this
+    // writer. Return false on failure.
+    auto Open(const std::string& out_dir,
+              const ConsolidatedOptions& options,
+              AsyncWriter* async_writer) -> bool;
+
+    // Register |symbol|. Return its identifier for Write(), which is also
+    // the symbol id of its records.
+    auto AddSymbol(std::string_view symbol) -> uint32_t;
+
+    // Append the events of |bytes| as a record of |symbol|, from any
+    // thread. |bytes| is cleared and keeps its capacity.
+    void Write(uint32_t symbol, std::string& bytes);
+
+    // Write out the buffered records. Return false on failure.
+    auto Flush() -> bool;
+
+    // Write out the buffered records then the index, so the output is
+    // complete. The whole index is written, so this is done once the
+    // records are written, e.g. at the end of a run, rather than on every
+    // flush. Return false on failure.
+    auto Finish() -> bool;
+
+    // Finish then close the segment.
+    void Close();
+
+   private:
+    struct Stream {
+      std::string name{};
+      uint64_t events{0};
+      std::vector<RecordLocation> records{};
+    };
+
+    // Close the current segment and start the next one. Return false on
+    // failure. |mutex_| must be held.
+    auto StartSegment() -> bool;
+
+    // Replace the index with the locations known so far. |mutex_| must be
+    // held.
+    auto WriteIndex() -> bool;
+
+    std::mutex mutex_{};
+    std::string out_dir_{};
+    ConsolidatedOptions options_{};
+    AsyncWriter* async_writer_{nullptr};
+
+    OutputFile segment_{};
+    uint32_t segment_count_{0};
+    uint64_t segment_size_{0};
+    std::deque<Stream> streams_{};
+    // the record being formatted, reused between records.
+    std::string record_{};
+    bool open_{false};
+  };
+
+  // Read the streams of the symbols back from a consolidated output.
+  class ConsolidatedReader {
+   public:
+    // Read the index of the consolidated output in |out_dir|. Return false
+    // if there is none or it is malformed.
+    auto Open(const std::string& out_dir) -> bool;
+
+    auto Symbols() const -> const SymbolTable& {
+      return symbols_;
+    }
+
+    // Append the events of |symbol| to |output|, byte-identical to the
+    // <symbol>.txt file of the per-symbol output. Return false if |symbol|
+    // is unknown or one of its records is malformed.
+    auto Extract(std::string_view symbol, std::string& output) -> bool;
+
+   private:
+    struct Stream {
+      uint64_t events{0};
+      std::vector<RecordLocation> records{};
+    };
+
+    // Append the events of |record|, which should be a record of |symbol|
+    // from |sequence|. Move |sequence| past its events.
+    auto ExtractRecord(std::string_view record,
+                       SymbolId symbol,
+                       uint64_t& sequence,
+                       std::string& output) const -> bool;
+
+    RecordFormat format_{RecordFormat::kBinary};
+    SymbolTable symbols_{};
+    std::vector<Stream> streams_{};
+    std::vector<MappedFile> segments_{};
+  };
+}   // namespace longlp
+
+#endif   // CONSOLIDATED_OUTPUT_HPP_
@@ -5,20 +5,57 @@
 #ifndef DEFINITIONS_HPP_
 #define DEFINITIONS_HPP_
 
+#include <cmath>
 #include <cstdint>
+#include <string>
 #include <string_view>
 #include <variant>
 #include <vector>
+#include "longlp_config.hpp"
 
 namespace longlp {
+  // Prices and quantities are fixed-point integers, so the levels are matched
+  // exactly. A price is a number of ticks of 10^-price_decimals, a quantity a
+  // number of lots of 10^-quantity_decimals. They are only converted back to
+  // decimals when formatting the output.
+  using Price    = int64_t;
+  using Quantity = int32_t;
+
+  // Sum of quantities, e.g. the total quantity of consecutive trades.
+  using Volume = int64_t;
+
+  namespace detail {
+    constexpr auto Pow10(const int32_t exponent) -> int64_t {
+      int64_t result = 1;
+      for (auto i = 0; i < exponent; ++i) {
+        result *= 10;
+      }
+      return result;
+    }
+  }   // namespace detail
+
+  constexpr int64_t kPriceScale    = detail::Pow10(config::price_decimals);
+  constexpr int64_t kQuantityScale = detail::Pow10(config::quantity_decimals);
+
+  // Convert decimal values to the nearest fixed-point values.
+  inline auto ToPrice(const double price) -> Price {
+    return std::llround(price * static_cast<double>(kPriceScale));
+  }
+
+  inline auto ToQuantity(const double quantity) -> Quantity {
+    return static_cast<Quantity>(
+      std::llround(quantity * static_cast<double>(kQuantityScale)));
+  }
 
   // A row in a order book side.
   struct Level {
-    double count{0};
-    double quantity{0};
-    double price{0};
+    Price price{0};
+    Quantity quantity{0};
+    uint32_t count{0};
   };
 
+  static_assert(sizeof(Level) <= 16, "a level should fit in 16 bytes");
+
   using SideList = std::vector<Level>;
 
   struct OrderBookRecord {
@@ -27,8 +64,19 @@ namespace longlp {
   };
 
   struct TradeRecord {
-    double quantity;
-    double price;
+    Quantity quantity;
+    Price price;
+  };
+
+  // A parsed line of the market feeds, either a book or a trade record.
+  // Both records are kept so a reused FeedRecord keeps its book storage.
+  struct FeedRecord {
+    enum class Type : uint8_t { kBook = 0, kTrade = 1 };
+
+    Type type{Type::kBook};
+    std::string symbol{};
+    OrderBookRecord book{};
+    TradeRecord trade{};
   };
 
 }   // namespace longlp
@@ -0,0 +1,97 @@
+// Copyright 2022 Long Le Phi. All rights reserved.
+// Use of this source code is governed by a MIT license that can be
+// found in the LICENSE file.
+
+#include <fmt/core.h>
+#include <fmt/format.h>
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <string_view>
+#include "binary_feed.hpp"
+#include "definitions.hpp"
+#include "feed_parser.hpp"
+#include "longlp_config.hpp"
+
+// Convert a json lines feed file into the binary replay format, which can be
+// replayed by the watcher as its input.
+namespace {
+  namespace chrono = std::chrono;
+
+  // Command line options, passed as `--name=value`.
+  struct Options {
+    std::string input{
+      fmt::format("{}/input/input.json", longlp::config::data_dir)};
+    // default to the input path with the .bin extension.
+    std::string output{};
+  };
+
+  auto ParseOptions(const int32_t argc, char** argv) -> Options {
+    Options options{};
+    for (auto i = 1; i < argc; ++i) {
+      const std::string_view arg = argv[i];
+      const auto separator       = arg.find('=');
+      const auto name            = arg.substr(0, separator);
+      const auto value =
+        separator == std::string_view::npos ? "" : arg.substr(separator + 1);
+
+      if (name == "--input") {
+        options.input = value;
+      }
+      else if (name == "--output") {
+        options.output = value;
+      }
+      else {
+        fmt::print("Unknown option {}\n", arg);
+      }
+    }
+
+    if (options.output.empty()) {
+      options.output =
+        std::filesystem::path{options.input}.replace_extension(".bin").string();
+    }
+    return options;
+  }
+}   // namespace
+
+auto main(int32_t argc, char** argv) -> int32_t {
+  const auto options = ParseOptions(argc, argv);
+
+  std::ifstream opener(options.input);
+  if (!opener.is_open()) {
+    fmt::print("Cannot open {}\n", options.input);
+    return 1;
+  }
+
+  longlp::BinaryFeedWriter writer{};
+  if (!writer.Open(options.output)) {
+    fmt::print("Cannot open {}\n", options.output);
+    return 1;
+  }
+
+  fmt::print("Converting {} into {}\n", options.input, options.output);
+  auto start = chrono::high_resolution_clock::now();
+
+  longlp::FeedRecord record{};
+  std::string line{};
+  for (auto i = 1; std::getline(opener, line); ++i) {
+    if (!longlp::ParseFeedLine(line, record)) {
+      // as the watcher, the lines after an invalid one are ignored.
+      fmt::print("parse {} error at line {}\n", options.input, i);
+      break;
+    }
+    writer.Write(record);
+  }
+
+  if (!writer.Close()) {
+    fmt::print("Cannot write {}\n", options.output);
+    return 1;
+  }
+
+  fmt::print("Execution time {}ms\n",
+             chrono::duration_cast<chrono::milliseconds>(
+               chrono::high_resolution_clock::now() - start)
+               .count());
+  return 0;
+}
@@ -0,0 +1,391 @@
+// Copyright 2022 Long Le Phi. All rights reserved.
+// Use of this source code is governed by a MIT license that can be
+// found in the LICENSE file.
+
+#include "feed_generator.hpp"
+
+#include <fmt/format.h>
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstddef>
+#include <iterator>
+#include <string_view>
+#include "definitions.hpp"
+
+namespace longlp {
+  namespace {
+    // xoshiro256** seeded with splitmix64. The standard distributions are not
+    // used since their outputs differ between the standard libraries.
+    class Random {
+     public:
+      explicit Random(uint64_t seed) {
+        for (auto& word : state_) {
+          seed += 0x9E3779B97F4A7C15ULL;
+          auto mixed = seed;
+          mixed      = (mixed ^ (mixed >> 30U)) * 0xBF58476D1CE4E5B9ULL;
+          mixed      = (mixed ^ (mixed >> 27U)) * 0x94D049BB133111EBULL;
+          word       = mixed ^ (mixed >> 31U);
+        }
+      }
+
+      auto Next() -> uint64_t {
+        const auto result  = Rotate(state_[1] * 5, 7) * 9;
+        const auto shifted = state_[1] << 17U;
+        state_[2] ^= state_[0];
+        state_[3] ^= state_[1];
+        state_[1] ^= state_[2];
+        state_[0] ^= state_[3];
+        state_[2] ^= shifted;
+        state_[3] = Rotate(state_[3], 45);
+        return result;
+      }
+
+      // uniform in [0, 1)
+      auto Uniform() -> double {
+        return static_cast<double>(Next() >> 11U) * 0x1.0p-53;
+      }
+
+      // uniform in [0, bound), the modulo bias is negligible here.
+      auto Below(const uint64_t bound) -> uint64_t {
+        return Next() % bound;
+      }
+
+     private:
+      static auto Rotate(const uint64_t value, const uint32_t shift)
+        -> uint64_t {
+        return (value << shift) | (value >> (64U - shift));
+      }
+
+      std::array<uint64_t, 4> state_{};
+    };
+
+    // Draw the symbols with a Zipf popularity: the symbol of rank r has a
+    // weight of 1 / r^exponent.
+    class ZipfSampler {
+     public:
+      ZipfSampler(const uint32_t count, const double exponent) :
+        cumulative_(count) {
+        auto total = 0.0;
+        for (uint32_t i = 0; i < count; ++i) {
+          total += 1.0 / std::pow(static_cast<double>(i) + 1.0, exponent);
+          cumulative_[i] = total;
+        }
+        for (auto& weight : cumulative_) {
+          weight /= total;
+        }
+      }
+
+      auto Sample(Random& random) const -> uint32_t {
+        const auto it = std::upper_bound(cumulative_.begin(),
+                                         cumulative_.end(),
+                                         random.Uniform());
+        const auto index = std::min<ptrdiff_t>(
+          it - cumulative_.begin(),
+          static_cast<ptrdiff_t>(cumulative_.size()) - 1);
+        return static_cast<uint32_t>(index);
+      }
+
+     private:
+      std::vector<double> cumulative_;
+    };
+
+    enum class Side : size_t { kBuy = 0, kSell = 1 };
+
+    constexpr std::array<std::string_view, 2> kSideStrings = {"BUY", "SELL"};
+
+    // The generated quantities are multiples of a lot.
+    constexpr Quantity kLot = 100;
+
+    // A level is not grown past this quantity, it is cancelled instead.
+    constexpr Quantity kMaxLevelQuantity = 1000000;
+
+    // The book of a symbol. The prices are in cents.
+    struct SymbolBook {
+      std::string symbol{};
+      SideList bids{};   // price descending
+      SideList asks{};   // price ascending
+      // the initial mid price
+      Price reference{0};
+      bool started{false};
+      std::string expected{};
+    };
+
+    class Generator {
+     public:
+      Generator(const FeedGeneratorOptions& options, std::ostream& feed) :
+        options_(options),
+        feed_(feed),
+        random_(options.seed),
+        zipf_(std::max(options.symbols, 1U), options.zipf_exponent),
+        books_(std::max(options.symbols, 1U)) {
+        const auto width = fmt::format("{}", books_.size() - 1).size();
+        for (size_t i = 0; i < books_.size(); ++i) {
+          books_[i].symbol = fmt::format("S{:0{}}", i, width);
+        }
+      }
+
+      auto Run() -> std::vector<GeneratedSymbol> {
+        for (uint64_t i = 0; i < options_.messages; ++i) {
+          Step(books_[zipf_.Sample(random_)]);
+        }
+
+        std::vector<GeneratedSymbol> result{};
+        for (auto& book : books_) {
+          if (book.started) {
+            result.push_back({book.symbol, std::move(book.expected)});
+          }
+        }
+        return result;
+      }
+
+     private:
+      void Step(SymbolBook& book) {
+        if (!book.started) {
+          Start(book);
+        }
+        else {
+          const auto side =
+            random_.Below(2) == 0 ? Side::kBuy : Side::kSell;
+          const auto aggressive =
+            random_.Uniform() < options_.burst_frequency;
+          const auto cancel = random_.Uniform() < options_.cancel_ratio;
+          if (!(aggressive && Aggressive(book, side)) &&
+              !(cancel && Cancel(book, side))) {
+            Passive(book, side);
+          }
+        }
+        WriteBook(book);
+      }
+
+      // The first book of a symbol, it has no expected output.
+      void Start(SymbolBook& book) {
+        book.started   = true;
+        book.reference = 1000 + 4 * Price{options_.depth} +
+                         static_cast<Price>(random_.Below(9000));
+
+        auto bid = book.reference;
+        auto ask = book.reference;
+        for (auto i = 0U; i < options_.depth; ++i) {
+          bid -= 1 + static_cast<Price>(random_.Below(2));
+          ask += 1 + static_cast<Price>(random_.Below(2));
+          book.bids.push_back({bid, RandomQuantity(), 1});
+          book.asks.push_back({ask, RandomQuantity(), 1});
+        }
+      }
+
+      // An aggressive order of |side| which sweeps the best levels of the
+      // other side. The last swept level may be partially filled, or the
+      // remaining quantity may rest at the last trade price.
+      // Return false if the other side is empty.
+      auto Aggressive(SymbolBook& book, const Side side) -> bool {
+        auto& levels = side == Side::kBuy ? book.asks : book.bids;
+        if (levels.empty()) {
+          return false;
+        }
+
+        const auto max_swept = std::min<uint64_t>(
+          std::max(options_.max_burst, 1U), levels.size());
+        const auto swept = 1 + random_.Below(max_swept);
+        Volume total    = 0;
+        auto last_price = levels.front().price;
+        auto last_fill  = levels.front().quantity;
+        for (uint64_t i = 0; i < swept; ++i) {
+          const auto& level = levels[i];
+          auto fill         = level.quantity;
+          if (i + 1 == swept && level.quantity > kLot &&
+              random_.Below(2) == 0) {
+            fill = RandomLots(level.quantity / kLot - 1);
+          }
+
+          // the fill may be printed as two trades at the same price.
+          if (fill >= 2 * kLot && random_.Below(2) == 0) {
+            const auto first = RandomLots(fill / kLot - 1);
+            WriteTrade(book, first, level.price);
+            WriteTrade(book, fill - first, level.price);
+          }
+          else {
+            WriteTrade(book, fill, level.price);
+          }
+
+          total += fill;
+          last_price = level.price;
+          last_fill  = fill;
+        }
+
+        // the last swept level is left with the unfilled quantity.
+        const auto last_full = last_fill == levels[swept - 1].quantity;
+        levels[swept - 1].quantity -= last_fill;
+        const auto full_levels = last_full ? swept : swept - 1;
+        levels.erase(levels.begin(),
+                     levels.begin() + static_cast<ptrdiff_t>(full_levels));
+
+        if (last_full && random_.Below(2) == 0) {
+          const auto remaining = RandomQuantity();
+          auto& own            = side == Side::kBuy ? book.bids : book.asks;
+          own.insert(own.begin(), {last_price, remaining, 1});
+          total += remaining;
+        }
+
+        AppendExpected(book, "AGGRESSIVE", side, total, last_price);
+        return true;
+      }
+
+      // Cancel a part or the whole of a level of |side|.
+      // Return false if the side is empty.
+      auto Cancel(SymbolBook& book, const Side side) -> bool {
+        auto& levels = side == Side::kBuy ? book.bids : book.asks;
+        if (levels.empty()) {
+          return false;
+        }
+
+        const auto index = random_.Below(levels.size());
+        CancelLevel(book, side, index);
+        return true;
+      }
+
+      void CancelLevel(SymbolBook& book, const Side side, const size_t index) {
+        auto& levels = side == Side::kBuy ? book.bids : book.asks;
+        auto& level  = levels[index];
+        if (level.quantity > kLot && random_.Below(2) == 0) {
+          const auto cancelled = RandomLots(level.quantity / kLot - 1);
+          level.quantity -= cancelled;
+          AppendExpected(book, "CANCEL", side, -Volume{cancelled}, level.price);
+          return;
+        }
+
+        AppendExpected(book, "CANCEL", side, level.quantity, level.price);
+        levels.erase(levels.begin() + static_cast<ptrdiff_t>(index));
+      }
+
+      // Add a passive order of |side|, on an existing level or on a new one
+      // which does not cross the other side.
+      void Passive(SymbolBook& book, const Side side) {
+        auto& levels       = side == Side::kBuy ? book.bids : book.asks;
+        const auto& others = side == Side::kBuy ? book.asks : book.bids;
+        const auto spread  = 2 * Price{options_.depth} + 1;
+
+        Price price = 0;
+        if (!levels.empty() &&
+            (levels.size() >= options_.depth || random_.Below(2) == 0)) {
+          price = levels[random_.Below(levels.size())].price;
+        }
+        else if (side == Side::kBuy) {
+          const auto best_ask =
+            others.empty() ? book.reference + 1 : others.front().price;
+          price = std::max<Price>(
+            best_ask - 1 - static_cast<Price>(random_.Below(
+                             static_cast<uint64_t>(spread))),
+            1);
+        }
+        else {
+          const auto best_bid =
+            others.empty() ? book.reference - 1 : others.front().price;
+          price = best_bid + 1 +
+                  static_cast<Price>(
+                    random_.Below(static_cast<uint64_t>(spread)));
+        }
+
+        // the levels are sorted from the best price.
+        const auto is_better = [side](const Level& level, const Price value) {
+          return side == Side::kBuy ? level.price > value : level.price < value;
+        };
+        auto level_it =
+          std::lower_bound(levels.begin(), levels.end(), price, is_better);
+        if (level_it != levels.end() && level_it->price == price &&
+            level_it->quantity >= kMaxLevelQuantity) {
+          CancelLevel(book,
+                      side,
+                      static_cast<size_t>(level_it - levels.begin()));
+          return;
+        }
+
+        const auto quantity = RandomQuantity();
+        if (level_it != levels.end() && level_it->price == price) {
+          level_it->quantity += quantity;
+          ++level_it->count;
+        }
+        else {
+          levels.insert(level_it, {price, quantity, 1});
+        }
+        AppendExpected(book, "PASSIVE", side, quantity, price);
+      }
+
+      auto RandomQuantity() -> Quantity {
+        return RandomLots(10);
+      }
+
+      // between 1 and |lots| lots.
+      auto RandomLots(const Quantity lots) -> Quantity {
+        return kLot * (1 + static_cast<Quantity>(
+                             random_.Below(static_cast<uint64_t>(lots))));
+      }
+
+      void AppendExpected(SymbolBook& book,
+                          const std::string_view intention,
+                          const Side side,
+                          const Volume quantity,
+                          const Price price) {
+        fmt::format_to(std::back_inserter(book.expected),
+                       "{} {} {}.00 @ {}.{:02}\n",
+                       intention,
+                       kSideStrings.at(static_cast<size_t>(side)),
+                       quantity,
+                       price / 100,
+                       price % 100);
+      }
+
+      void WriteTrade(const SymbolBook& book,
+                      const Quantity quantity,
+                      const Price price) {
+        line_.clear();
+        fmt::format_to(std::back_inserter(line_),
+                       R"({{"trade":{{"symbol":"{}", "quantity":{}, )"
+                       R"("price":{}.{:02}}}}})"
+                       "\n",
+                       book.symbol,
+                       quantity,
+                       price / 100,
+                       price % 100);
+        feed_ << line_;
+      }
+
+      void WriteBook(const SymbolBook& book) {
+        const auto append_levels = [this](const SideList& levels) {
+          for (size_t i = 0; i < levels.size(); ++i) {
+            fmt::format_to(
+              std::back_inserter(line_),
+              R"({}{{"count":{}, "quantity":{}, "price":{}.{:02}}})",
+              i == 0 ? "" : ", ",
+              levels[i].count,
+              levels[i].quantity,
+              levels[i].price / 100,
+              levels[i].price % 100);
+          }
+        };
+
+        line_.clear();
+        fmt::format_to(std::back_inserter(line_),
+                       R"({{"book":{{"symbol":"{}", "bid": [)",
+                       book.symbol);
+        append_levels(book.bids);
+        line_ += R"(], "ask": [)";
+        append_levels(book.asks);
+        line_ += "]}}\n";
+        feed_ << line_;
+      }
+
+      const FeedGeneratorOptions& options_;
+      std::ostream& feed_;
+      Random random_;
+      ZipfSampler zipf_;
+      std::vector<SymbolBook> books_;
+      std::string line_{};
+    };
+  }   // namespace
+
+  auto GenerateFeed(const FeedGeneratorOptions& options, std::ostream& feed)
+    -> std::vector<GeneratedSymbol> {
+    return Generator{options, feed}.Run();
+  }
+}   // namespace longlp
@@ -0,0 +1,48 @@
+// Copyright 2022 Long Le Phi. All rights reserved.
+// Use of this source code is governed by a MIT license that can be
+// found in the LICENSE file.
+
+#ifndef FEED_GENERATOR_HPP_
+#define FEED_GENERATOR_HPP_
+
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <vector>
+
+namespace longlp {
+  struct FeedGeneratorOptions {
+    uint64_t seed{1};
+    uint32_t symbols{100};
+    // number of book messages, the trades of a burst are not counted.
+    uint64_t messages{100000};
+    // number of levels per side of the books.
+    uint32_t depth{10};
+    // probability that a message is an aggressive order, which sweeps the
+    // other side with a burst of trades.
+    double burst_frequency{0.1};
+    // maximum number of levels swept by an aggressive order.
+    uint32_t max_burst{5};
+    // probability that a passive change is a cancel.
+    double cancel_ratio{0.4};
+    // exponent of the Zipf popularity of the symbols, 0 for uniform.
+    double zipf_exponent{1.0};
+  };
+
+  // The expected output of a symbol, as written by the watcher.
+  struct GeneratedSymbol {
+    std::string symbol{};
+    std::string expected{};
+  };
+
+  // Write a synthetic feed of json lines into |feed|. Every book message
+  // applies one known change to the book of its symbol (a passive order, a
+  // cancel, or an aggressive order preceded by its trades), so its expected
+  // classification is known without running the watcher. The feed only
+  // depends on |options|.
+  // Return the expected outputs of the symbols which received a book.
+  auto GenerateFeed(const FeedGeneratorOptions& options, std::ostream& feed)
+    -> std::vector<GeneratedSymbol>;
+}   // namespace longlp
+
+#endif   // FEED_GENERATOR_HPP_
@@ -0,0 +1,117 @@
+// Copyright 2022 Long Le Phi. All rights reserved.
+// Use of this source code is governed by a MIT license that can be
+// found in the LICENSE file.
+
+#include <fmt/core.h>
+#include <fmt/format.h>
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <string_view>
+#include "feed_generator.hpp"
+#include "output_file.hpp"
+
+// Generate a synthetic json lines feed with its expected outputs, one file
+// per symbol as written by the watcher, so large runs can be checked with
+// `diff -r`.
+namespace {
+  namespace chrono = std::chrono;
+
+  // Command line options, passed as `--name=value`.
+  struct Options {
+    std::string output{"generated.json"};
+    std::string expected{"generated-expected"};
+    longlp::FeedGeneratorOptions generator{};
+  };
+
+  auto ParseOptions(const int32_t argc, char** argv) -> Options {
+    Options options{};
+    auto& generator = options.generator;
+    for (auto i = 1; i < argc; ++i) {
+      const std::string_view arg = argv[i];
+      const auto separator       = arg.find('=');
+      const auto name            = arg.substr(0, separator);
+      const auto value =
+        std::string{separator == std::string_view::npos
+                      ? ""
+                      : arg.substr(separator + 1)};
+
+      if (name == "--output") {
+        options.output = value;
+      }
+      else if (name == "--expected") {
+        options.expected = value;
+      }
+      else if (name == "--seed") {
+        generator.seed = std::stoull(value);
+      }
+      else if (name == "--symbols") {
+        generator.symbols = static_cast<uint32_t>(std::stoul(value));
+      }
+      else if (name == "--messages") {
+        generator.messages = std::stoull(value);
+      }
+      else if (name == "--depth") {
+        generator.depth = static_cast<uint32_t>(std::stoul(value));
+      }
+      else if (name == "--burst-frequency") {
+        generator.burst_frequency = std::stod(value);
+      }
+      else if (name == "--max-burst") {
+        generator.max_burst = static_cast<uint32_t>(std::stoul(value));
+      }
+      else if (name == "--cancel-ratio") {
+        generator.cancel_ratio = std::stod(value);
+      }
+      else if (name == "--zipf") {
+        generator.zipf_exponent = std::stod(value);
+      }
+      else {
+        fmt::print("Unknown option {}\n", arg);
+      }
+    }
+    return options;
+  }
+}   // namespace
+
+auto main(int32_t argc, char** argv) -> int32_t {
+  const auto options = ParseOptions(argc, argv);
+
+  std::ofstream feed(options.output, std::ios::binary);
+  if (!feed.is_open()) {
+    fmt::print("Cannot open {}\n", options.output);
+    return 1;
+  }
+
+  std::error_code error{};
+  std::filesystem::create_directories(options.expected, error);
+  if (error) {
+    fmt::print("Cannot create {}\n", options.expected);
+    return 1;
+  }
+
+  fmt::print("Generating {} messages of {} symbols into {}\n",
+             options.generator.messages,
+             options.generator.symbols,
+             options.output);
+  auto start = chrono::high_resolution_clock::now();
+
+  const auto symbols = longlp::GenerateFeed(options.generator, feed);
+  feed.close();
+
+  for (const auto& [symbol, expected] : symbols) {
+    longlp::OutputFile file{};
+    if (!file.Open(fmt::format("{}/{}.txt", options.expected, symbol))) {
+      fmt::print("Cannot open the expected output of {}\n", symbol);
+      return 1;
+    }
+    file.Append(expected);
+  }
+
+  fmt::print("Execution time {}ms\n",
+             chrono::duration_cast<chrono::milliseconds>(
+               chrono::high_resolution_clock::now() - start)
+               .count());
+  return 0;
+}
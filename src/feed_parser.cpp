@@ -0,0 +1,481 @@
+// Copyright 2022 Long Le Phi. All rights reserved.
+// Use of this source code is governed by a MIT license that can be
+// found in the LICENSE file.
+
+#include "feed_parser.hpp"
+
+#include <charconv>
+#include <cmath>
+#include <cstdlib>
+#include <limits>
+#include <nlohmann/json.hpp>
+#include <string>
+#include "metrics.hpp"
+
+namespace longlp {
+  namespace {
+    namespace json = nlohmann;
+
+    // 2^63, the fixed-point values are below it.
+    constexpr double kFixedLimit = 9223372036854775808.0;
+
+    // Convert |value| to a fixed-point value of |decimals| decimals, rounded
+    // to the nearest. Return false if it does not fit an int64_t.
+    auto ToFixed(const double value, const int32_t decimals, int64_t& fixed)
+      -> bool {
+      const auto scaled =
+        value * static_cast<double>(detail::Pow10(decimals));
+      // also false for a nan
+      if (!(std::fabs(scaled) < kFixedLimit)) {
+        return false;
+      }
+      fixed = std::llround(scaled);
+      return true;
+    }
+
+    // Narrow a fixed-point |value| to a quantity. Return false if it is out
+    // of the range of Quantity.
+    auto ToQuantity(const int64_t value, Quantity& quantity) -> bool {
+      if (value < std::numeric_limits<Quantity>::min() ||
+          value > std::numeric_limits<Quantity>::max()) {
+        return false;
+      }
+      quantity = static_cast<Quantity>(value);
+      return true;
+    }
+
+    // Return false if |value| is not an integral count in the range of
+    // uint32_t, e.g. a count of 1.7 is not rounded nor truncated.
+    auto ToCount(const double value, uint32_t& count) -> bool {
+      auto integral = 0.0;
+      if (!(value >= 0.0 &&
+            value <= static_cast<double>(
+                       std::numeric_limits<uint32_t>::max())) ||
+          std::modf(value, &integral) > 0.0) {
+        return false;
+      }
+      count = static_cast<uint32_t>(integral);
+      return true;
+    }
+
+    // A forward-only reader over a json line.
+    class Cursor {
+     public:
+      explicit Cursor(const std::string_view line) :
+        it_(line.data()),
+        end_(line.data() + line.size()) {}
+
+      void SkipWhitespace() {
+        while (it_ != end_ && (*it_ == ' ' || *it_ == '\t' || *it_ == '\r' ||
+                               *it_ == '\n')) {
+          ++it_;
+        }
+      }
+
+      // Consume |expected| after the leading whitespaces.
+      auto Consume(const char expected) -> bool {
+        SkipWhitespace();
+        if (it_ == end_ || *it_ != expected) {
+          return false;
+        }
+        ++it_;
+        return true;
+      }
+
+      // Peek the next non-whitespace character, '\0' at the end.
+      auto Peek() -> char {
+        SkipWhitespace();
+        return it_ == end_ ? '\0' : *it_;
+      }
+
+      // Read a string without escape sequences, as a view of the line.
+      auto String(std::string_view& value) -> bool {
+        if (!Consume('"')) {
+          return false;
+        }
+
+        const auto* const begin = it_;
+        while (it_ != end_ && *it_ != '"') {
+          if (*it_ == '\\') {
+            return false;
+          }
+          ++it_;
+        }
+
+        if (it_ == end_) {
+          return false;
+        }
+        value = std::string_view(begin, static_cast<size_t>(it_ - begin));
+        ++it_;
+        return true;
+      }
+
+      // Read an object key and its colon.
+      auto Key(std::string_view& key) -> bool {
+        return String(key) && Consume(':');
+      }
+
+      auto Number(double& value) -> bool {
+        SkipWhitespace();
+#if defined(__cpp_lib_to_chars)
+        const auto [ptr, error] = std::from_chars(it_, end_, value);
+        if (error != std::errc{}) {
+          return false;
+        }
+        it_ = ptr;
+#else
+        // a json number is always followed by a delimiter in a valid line,
+        // thus strtod cannot read past the line.
+        char* ptr = nullptr;
+        value     = std::strtod(it_, &ptr);
+        if (ptr == it_ || ptr > end_) {
+          return false;
+        }
+        it_ = ptr;
+#endif
+        return true;
+      }
+
+      // Read a decimal number as a fixed-point integer of |decimals|
+      // decimals, rounded half up. It is exact, unlike a conversion from
+      // double. Numbers with an exponent are read through a double.
+      // Return false if the value does not fit an int64_t.
+      auto Decimal(const int32_t decimals, int64_t& value) -> bool {
+        SkipWhitespace();
+        const auto* const begin = it_;
+
+        const auto negative = it_ != end_ && *it_ == '-';
+        if (negative) {
+          ++it_;
+        }
+
+        const auto is_digit = [this] {
+          return it_ != end_ && *it_ >= '0' && *it_ <= '9';
+        };
+        if (!is_digit()) {
+          return false;
+        }
+
+        // append a digit to |result|, or set |overflow| if it does not fit
+        constexpr auto kMax = std::numeric_limits<int64_t>::max();
+        int64_t result      = 0;
+        auto overflow       = false;
+        const auto append   = [&result, &overflow](const int64_t digit) {
+          overflow = overflow || result > (kMax - digit) / 10;
+          result   = overflow ? 0 : result * 10 + digit;
+        };
+
+        for (; is_digit(); ++it_) {
+          append(*it_ - '0');
+        }
+
+        auto scale = 0;
+        auto round = false;
+        if (it_ != end_ && *it_ == '.') {
+          ++it_;
+          for (; is_digit(); ++it_) {
+            if (scale < decimals) {
+              append(*it_ - '0');
+              ++scale;
+            }
+            else if (scale == decimals) {
+              round = *it_ >= '5';
+              ++scale;
+            }
+          }
+        }
+        for (; scale < decimals; ++scale) {
+          append(0);
+        }
+        if (round) {
+          if (result == kMax) {
+            overflow = true;
+          }
+          else {
+            ++result;
+          }
+        }
+
+        if (it_ != end_ && (*it_ == 'e' || *it_ == 'E')) {
+          it_ = begin;
+          auto number = 0.0;
+          return Number(number) && ToFixed(number, decimals, value);
+        }
+
+        if (overflow) {
+          return false;
+        }
+        value = negative ? -result : result;
+        return true;
+      }
+
+      // Parse the members of an object with |member(key)| until the closing
+      // brace, the opening brace must have been consumed.
+      template <typename Member>
+      auto Members(Member&& member) -> bool {
+        if (Peek() == '}') {
+          ++it_;
+          return true;
+        }
+
+        for (;;) {
+          std::string_view key{};
+          if (!Key(key) || !member(key)) {
+            return false;
+          }
+          if (Consume('}')) {
+            return true;
+          }
+          if (!Consume(',')) {
+            return false;
+          }
+        }
+      }
+
+      auto AtEnd() -> bool {
+        SkipWhitespace();
+        return it_ == end_;
+      }
+
+     private:
+      const char* it_;
+      const char* end_;
+    };
+
+    // Mark a parsed member in |fields|, return false if it is duplicated.
+    auto MarkField(uint32_t& fields, const uint32_t field) -> bool {
+      if ((fields & field) != 0) {
+        return false;
+      }
+      fields |= field;
+      return true;
+    }
+
+    constexpr uint32_t kAllFields = 0b111;
+
+    auto ParsePrice(Cursor& cursor, Price& price) -> bool {
+      return cursor.Decimal(config::price_decimals, price);
+    }
+
+    auto ParseQuantity(Cursor& cursor, Quantity& quantity) -> bool {
+      int64_t value = 0;
+      return cursor.Decimal(config::quantity_decimals, value) &&
+             ToQuantity(value, quantity);
+    }
+
+    // the counts are below 2^53, thus exact as a double.
+    auto ParseCount(Cursor& cursor, uint32_t& count) -> bool {
+      auto value = 0.0;
+      return cursor.Number(value) && ToCount(value, count);
+    }
+
+    auto ParseLevel(Cursor& cursor, Level& level) -> bool {
+      auto fields = 0U;
+      const auto parsed =
+        cursor.Consume('{') && cursor.Members([&](std::string_view key) {
+          if (key == "price") {
+            return MarkField(fields, 0b001) && ParsePrice(cursor, level.price);
+          }
+          if (key == "quantity") {
+            return MarkField(fields, 0b010) &&
+                   ParseQuantity(cursor, level.quantity);
+          }
+          if (key == "count") {
+            return MarkField(fields, 0b100) && ParseCount(cursor, level.count);
+          }
+          return false;
+        });
+      return parsed && fields == kAllFields;
+    }
+
+    // copy the symbol into |symbol|, which keeps its capacity.
+    auto ParseSymbol(Cursor& cursor, std::string& symbol) -> bool {
+      std::string_view value{};
+      if (!cursor.String(value)) {
+        return false;
+      }
+      symbol.assign(value);
+      return true;
+    }
+
+    auto ParseSideList(Cursor& cursor, SideList& side) -> bool {
+      side.clear();
+      if (!cursor.Consume('[')) {
+        return false;
+      }
+      if (cursor.Consume(']')) {
+        return true;
+      }
+
+      for (;;) {
+        if (!ParseLevel(cursor, side.emplace_back())) {
+          return false;
+        }
+        if (cursor.Consume(']')) {
+          return true;
+        }
+        if (!cursor.Consume(',')) {
+          return false;
+        }
+      }
+    }
+
+    auto ParseBook(Cursor& cursor, FeedRecord& record) -> bool {
+      record.type = FeedRecord::Type::kBook;
+
+      auto fields = 0U;
+      const auto parsed =
+        cursor.Consume('{') && cursor.Members([&](std::string_view key) {
+          if (key == "symbol") {
+            return MarkField(fields, 0b001) &&
+                   ParseSymbol(cursor, record.symbol);
+          }
+          if (key == "bid") {
+            return MarkField(fields, 0b010) &&
+                   ParseSideList(cursor, record.book.bids);
+          }
+          if (key == "ask") {
+            return MarkField(fields, 0b100) &&
+                   ParseSideList(cursor, record.book.asks);
+          }
+          return false;
+        });
+      return parsed && fields == kAllFields;
+    }
+
+    auto ParseTrade(Cursor& cursor, FeedRecord& record) -> bool {
+      record.type = FeedRecord::Type::kTrade;
+
+      auto fields = 0U;
+      const auto parsed =
+        cursor.Consume('{') && cursor.Members([&](std::string_view key) {
+          if (key == "symbol") {
+            return MarkField(fields, 0b001) &&
+                   ParseSymbol(cursor, record.symbol);
+          }
+          if (key == "price") {
+            return MarkField(fields, 0b010) &&
+                   ParsePrice(cursor, record.trade.price);
+          }
+          if (key == "quantity") {
+            return MarkField(fields, 0b100) &&
+                   ParseQuantity(cursor, record.trade.quantity);
+          }
+          return false;
+        });
+      return parsed && fields == kAllFields;
+    }
+
+    // The members of the json parser, with the same checks as the in-place
+    // parser: false if a member is missing, of another type or out of range.
+    auto JsonNumber(const json::json& object,
+                    const char* const key,
+                    double& value) -> bool {
+      const auto member = object.find(key);
+      if (member == object.end() || !member->is_number()) {
+        return false;
+      }
+      value = member->get<double>();
+      return true;
+    }
+
+    auto JsonPrice(const json::json& object, Price& price) -> bool {
+      auto value = 0.0;
+      return JsonNumber(object, "price", value) &&
+             ToFixed(value, config::price_decimals, price);
+    }
+
+    auto JsonQuantity(const json::json& object, Quantity& quantity) -> bool {
+      auto value    = 0.0;
+      int64_t fixed = 0;
+      return JsonNumber(object, "quantity", value) &&
+             ToFixed(value, config::quantity_decimals, fixed) &&
+             ToQuantity(fixed, quantity);
+    }
+
+    auto JsonSymbol(const json::json& object, std::string& symbol) -> bool {
+      const auto member = object.find("symbol");
+      if (member == object.end() || !member->is_string()) {
+        return false;
+      }
+      symbol = member->get<std::string>();
+      return true;
+    }
+
+    auto JsonSideList(const json::json& object,
+                      const char* const key,
+                      SideList& side) -> bool {
+      side.clear();
+      const auto member = object.find(key);
+      if (member == object.end() || !member->is_array()) {
+        return false;
+      }
+      for (const auto& level_json : *member) {
+        auto& level = side.emplace_back();
+        auto count  = 0.0;
+        if (!level_json.is_object() || !JsonPrice(level_json, level.price) ||
+            !JsonQuantity(level_json, level.quantity) ||
+            !JsonNumber(level_json, "count", count) ||
+            !ToCount(count, level.count)) {
+          return false;
+        }
+      }
+      return true;
+    }
+  }   // namespace
+
+  auto ParseFeedLine(const std::string_view line, FeedRecord& record) -> bool {
+    const metrics::ScopedTimer timer{metrics::Histogram::kParse};
+    return ParseFeedLineInPlace(line, record) ||
+           ParseFeedLineJson(line, record);
+  }
+
+  auto ParseFeedLineInPlace(const std::string_view line, FeedRecord& record)
+    -> bool {
+    Cursor cursor{line};
+    std::string_view type{};
+    if (!cursor.Consume('{') || !cursor.Key(type)) {
+      return false;
+    }
+
+    auto parsed = false;
+    if (type == "book") {
+      parsed = ParseBook(cursor, record);
+    }
+    else if (type == "trade") {
+      parsed = ParseTrade(cursor, record);
+    }
+
+    return parsed && cursor.Consume('}') && cursor.AtEnd();
+  }
+
+  auto ParseFeedLineJson(const std::string_view line, FeedRecord& record)
+    -> bool {
+    const auto& record_json =
+      json::json::parse(line.begin(), line.end(), nullptr, false);
+
+    if (record_json.is_discarded()) {
+      return false;
+    }
+
+    // Detected a order book record
+    if (record_json.contains("book")) {
+      const auto& book_json = record_json["book"];
+      record.type           = FeedRecord::Type::kBook;
+      return JsonSymbol(book_json, record.symbol) &&
+             JsonSideList(book_json, "bid", record.book.bids) &&
+             JsonSideList(book_json, "ask", record.book.asks);
+    }
+
+    // Detected a trade record
+    if (record_json.contains("trade")) {
+      const auto& trade_json = record_json["trade"];
+      record.type            = FeedRecord::Type::kTrade;
+      return JsonSymbol(trade_json, record.symbol) &&
+             JsonPrice(trade_json, record.trade.price) &&
+             JsonQuantity(trade_json, record.trade.quantity);
+    }
+
+    return false;
+  }
+}   // namespace longlp
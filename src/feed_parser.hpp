@@ -0,0 +1,32 @@
+// Copyright 2022 Long Le Phi. All rights reserved.
+// Use of this source code is governed by a MIT license that can be
+// found in the LICENSE file.
+
+#ifndef FEED_PARSER_HPP_
+#define FEED_PARSER_HPP_
+
+#include <string_view>
+#include "definitions.hpp"
+
+namespace longlp {
+  // Parse a line of the market feeds into |record|. The dedicated schema
+  // parser is tried first, the generic json parser is the fallback for the
+  // lines which do not fit the schema.
+  // Return false if the line is neither a book nor a trade record.
+  auto ParseFeedLine(std::string_view line, FeedRecord& record) -> bool;
+
+  // Parser dedicated to the fixed schema of the market feeds:
+  //   {"book":{"symbol":"...","bid":[{"count":..,"quantity":..,"price":..}],
+  //            "ask":[...]}}
+  //   {"trade":{"symbol":"...","quantity":..,"price":..}}
+  // Keys may be in any order. It reads the line buffer in place and does not
+  // build any json DOM, the storage of |record| is reused.
+  // Return false if the line does not fit the schema, e.g. unknown keys,
+  // escaped strings or a malformed line.
+  auto ParseFeedLineInPlace(std::string_view line, FeedRecord& record) -> bool;
+
+  // Generic parser based on nlohmann::json.
+  auto ParseFeedLineJson(std::string_view line, FeedRecord& record) -> bool;
+}   // namespace longlp
+
+#endif   // FEED_PARSER_HPP_
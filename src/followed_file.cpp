@@ -0,0 +1,80 @@
+// Copyright 2022 Long Le Phi. All rights reserved.
+// Use of this source code is governed by a MIT license that can be
+// found in the LICENSE file.
+
+#include "followed_file.hpp"
+
+#include <array>
+#include <thread>
+
+#if defined(__linux__)
+#  include <poll.h>
+#  include <sys/inotify.h>
+#  include <unistd.h>
+#endif
+
+namespace longlp {
+  FollowedFile::~FollowedFile() {
+    Close();
+  }
+
+  auto FollowedFile::Open(const std::string& path) -> bool {
+    Close();
+    stream_.open(path, std::ios::binary);
+    if (!stream_.is_open()) {
+      return false;
+    }
+
+#if defined(__linux__)
+    // fall back to polling if the file cannot be watched.
+    watcher_ = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (watcher_ >= 0 &&
+        inotify_add_watch(watcher_, path.c_str(), IN_MODIFY) < 0) {
+      close(watcher_);
+      watcher_ = -1;
+    }
+#endif
+    return true;
+  }
+
+  auto FollowedFile::ReadSome(std::string& buffer) -> size_t {
+    const auto size = buffer.size();
+    buffer.resize(size + kReadBytes);
+    stream_.read(buffer.data() + size, kReadBytes);
+    const auto count = static_cast<size_t>(stream_.gcount());
+    buffer.resize(size + count);
+
+    // the end of the file is only the end of what has been written so far.
+    stream_.clear();
+    return count;
+  }
+
+  void FollowedFile::WaitForGrowth(const std::chrono::microseconds timeout) {
+#if defined(__linux__)
+    if (watcher_ >= 0) {
+      pollfd watched{watcher_, POLLIN, 0};
+      const auto timeout_ms = static_cast<int>(
+        std::chrono::ceil<std::chrono::milliseconds>(timeout).count());
+      if (poll(&watched, 1, timeout_ms) > 0) {
+        // drain the events, only the wake up matters.
+        std::array<char, 4096> events{};
+        while (read(watcher_, events.data(), events.size()) > 0) {
+        }
+      }
+      return;
+    }
+#endif
+    std::this_thread::sleep_for(timeout);
+  }
+
+  void FollowedFile::Close() {
+#if defined(__linux__)
+    if (watcher_ >= 0) {
+      close(watcher_);
+      watcher_ = -1;
+    }
+#endif
+    stream_.close();
+    stream_.clear();
+  }
+}   // namespace longlp
@@ -0,0 +1,51 @@
+// Copyright 2022 Long Le Phi. All rights reserved.
+// Use of this source code is governed by a MIT license that can be
+// found in the LICENSE file.
+
+#ifndef FOLLOWED_FILE_HPP_
+#define FOLLOWED_FILE_HPP_
+
+#include <chrono>
+#include <fstream>
+#include <string>
+
+namespace longlp {
+  // A file which is read while another process keeps appending to it, as
+  // `tail -f`. The growth of the file is watched with inotify on Linux, and
+  // polled on the other platforms.
+  class FollowedFile {
+   public:
+    // maximum number of bytes returned by a ReadSome() call. The lines of a
+    // read share its time as their arrival time, the reads are small so this
+    // time stays close to the writing of each line of a burst.
+    static constexpr size_t kReadBytes = 4 * 1024;
+
+    FollowedFile() = default;
+    FollowedFile(const FollowedFile&)                    = delete;
+    auto operator=(const FollowedFile&) -> FollowedFile& = delete;
+    FollowedFile(FollowedFile&&)                         = delete;
+    auto operator=(FollowedFile&&) -> FollowedFile&      = delete;
+    ~FollowedFile();
+
+    // Open |path| from its beginning, a previous file is closed. Return
+    // false on failure.
+    auto Open(const std::string& path) -> bool;
+
+    // Append at most kReadBytes of the bytes written since the last call to
+    // |buffer|. Return the number of appended bytes, 0 if there is nothing
+    // new.
+    auto ReadSome(std::string& buffer) -> size_t;
+
+    // Block until the file may have grown, or |timeout| has elapsed.
+    void WaitForGrowth(std::chrono::microseconds timeout);
+
+    void Close();
+
+   private:
+    std::ifstream stream_{};
+    // the inotify instance watching the file, -1 if the file is polled.
+    int watcher_{-1};
+  };
+}   // namespace longlp
+
+#endif   // FOLLOWED_FILE_HPP_
@@ -0,0 +1,277 @@
+// Copyright 2022 Long Le Phi. All rights reserved.
+// Use of this source code is governed by a MIT license that can be
+// found in the LICENSE file.
+
+#include "ingest_engine.hpp"
+
+#include <fmt/format.h>
+#include <algorithm>
+#include <condition_variable>
+#include <thread>
+#include <utility>
+#include "instrument_feeds_worker.hpp"
+#include "latency_histogram.hpp"
+#include "mpmc_queue.hpp"
+#include "output_file.hpp"
+
+namespace longlp {
+  namespace {
+    using Clock = std::chrono::steady_clock;
+
+    // A blocked producer checks the queue again after this delay, even if
+    // it has not been woken up.
+    constexpr auto kBlockTimeout = std::chrono::milliseconds{1};
+
+    // A message in a shard queue.
+    struct IngestMessage {
+      SymbolId symbol{kInvalidSymbolId};
+      FeedRecord record{};
+      Clock::time_point submitted{};
+    };
+
+    // The state of a symbol, owned by the consumer thread of its shard.
+    struct SymbolState {
+      InstrumentFeedsWorker worker{};
+      OutputFile writer{};
+      // the writer buffer holds outputs which have not been written out.
+      bool dirty{false};
+      // the trades before the first book of the symbol are ignored.
+      bool has_book{false};
+    };
+  }   // namespace
+
+  struct IngestEngine::Shard {
+    Shard(IngestEngine& owner, const size_t queue_capacity) :
+      engine(owner),
+      queue(queue_capacity) {}
+
+    // Drain the queue until the engine is stopped. The buffered outputs are
+    // written out whenever the queue is empty.
+    void Consume() {
+      const auto process = [this](IngestMessage& message) {
+        Process(message);
+      };
+
+      for (;;) {
+        if (queue.TryPop(process)) {
+          NotifyProducers();
+          continue;
+        }
+
+        FlushWriters();
+        if (done.load(std::memory_order_acquire)) {
+          // the producers may push the last messages right before done
+          if (queue.TryPop(process)) {
+            continue;
+          }
+          FlushWriters();
+          return;
+        }
+        std::this_thread::yield();
+      }
+    }
+
+    void Process(IngestMessage& message) {
+      auto& state  = State(message.symbol);
+      auto& record = message.record;
+      if (record.type == FeedRecord::Type::kBook) {
+        state.has_book = true;
+        if (engine.options_.sink) {
+          output.clear();
+          state.worker.UpdateBookChanges(record.book, output);
+          if (!output.empty()) {
+            engine.options_.sink(message.symbol, output);
+          }
+        }
+        else {
+          state.worker.UpdateBookChanges(record.book, state.writer.Buffer());
+          if (!state.dirty && !state.writer.Buffer().empty()) {
+            state.dirty = true;
+            dirty_states.push_back(&state);
+          }
+          state.writer.FlushIfFull();
+        }
+      }
+      else if (state.has_book) {
+        state.worker.RecordNewTrade(record.trade);
+      }
+
+      latencies.Record(static_cast<uint64_t>(
+        std::chrono::duration_cast<std::chrono::nanoseconds>(
+          Clock::now() - message.submitted)
+          .count()));
+    }
+
+    // the state of |symbol|, created on its first message.
+    auto State(const SymbolId symbol) -> SymbolState& {
+      if (symbols.size() <= symbol) {
+        symbols.resize(symbol + 1);
+      }
+
+      auto& state = symbols[symbol];
+      if (state == nullptr) {
+        state = std::make_unique<SymbolState>();
+        if (!engine.options_.sink) {
+          state->writer.Open(fmt::format("{}/{}.txt",
+                                         engine.options_.out_dir,
+                                         engine.SymbolName(symbol)));
+        }
+      }
+      return *state;
+    }
+
+    void FlushWriters() {
+      for (auto* state : dirty_states) {
+        state->writer.Flush();
+        state->dirty = false;
+      }
+      dirty_states.clear();
+    }
+
+    // Wait until |push()| succeeds, the consumer wakes up the blocked
+    // producers whenever it frees a slot.
+    template <typename Push>
+    void WaitToPush(Push&& push) {
+      std::unique_lock lock{mutex};
+      waiting.fetch_add(1);
+      while (!push()) {
+        slot_freed.wait_for(lock, kBlockTimeout);
+      }
+      waiting.fetch_sub(1);
+    }
+
+    void NotifyProducers() {
+      if (waiting.load() > 0) {
+        const std::lock_guard lock{mutex};
+        slot_freed.notify_all();
+      }
+    }
+
+    IngestEngine& engine;
+    MpmcQueue<IngestMessage> queue;
+    std::atomic<bool> done{false};
+    std::atomic<size_t> dropped{0};
+    std::thread consumer{};
+
+    // the blocked producers
+    std::atomic<size_t> waiting{0};
+    std::mutex mutex{};
+    std::condition_variable slot_freed{};
+
+    // owned by the consumer thread until it is joined.
+    std::vector<std::unique_ptr<SymbolState>> symbols{};
+    std::vector<SymbolState*> dirty_states{};
+    std::string output{};
+    LatencyHistogram latencies{};
+  };
+
+  IngestEngine::IngestEngine(IngestOptions options) :
+    options_(std::move(options)) {
+    const auto shards = std::max<size_t>(options_.shards, 1);
+    shards_.reserve(shards);
+    for (auto i = 0U; i < shards; ++i) {
+      auto& shard = shards_.emplace_back(
+        std::make_unique<Shard>(*this, options_.queue_capacity));
+      shard->consumer =
+        std::thread([shard = shard.get()] { shard->Consume(); });
+    }
+  }
+
+  IngestEngine::~IngestEngine() {
+    if (!stopped_) {
+      Stop();
+    }
+  }
+
+  auto IngestEngine::RegisterSymbol(const std::string_view symbol)
+    -> SymbolId {
+    const std::lock_guard lock{symbols_mutex_};
+    auto inserted = false;
+    const auto id = symbols_.Intern(symbol, inserted);
+    symbol_count_.store(symbols_.Size(), std::memory_order_release);
+    return id;
+  }
+
+  auto IngestEngine::SymbolName(const SymbolId symbol) -> std::string {
+    const std::lock_guard lock{symbols_mutex_};
+    return symbols_.Name(symbol);
+  }
+
+  template <typename Fill>
+  auto IngestEngine::Push(const SymbolId symbol, Fill&& fill) -> bool {
+    if (symbol >= symbol_count_.load(std::memory_order_acquire)) {
+      return false;
+    }
+
+    auto& shard     = *shards_[symbol % shards_.size()];
+    const auto push = [&] {
+      return shard.queue.TryPush([&](IngestMessage& message) {
+        message.symbol    = symbol;
+        message.submitted = Clock::now();
+        fill(message.record);
+      });
+    };
+
+    if (options_.backpressure == Backpressure::kBlock) {
+      if (!push()) {
+        shard.WaitToPush(push);
+      }
+    }
+    else if (options_.backpressure == Backpressure::kDropOldest) {
+      while (!push()) {
+        if (shard.queue.TryPop([](const IngestMessage& /*message*/) {})) {
+          shard.dropped.fetch_add(1, std::memory_order_relaxed);
+        }
+      }
+    }
+    else {
+      while (!push()) {
+        std::this_thread::yield();
+      }
+    }
+    return true;
+  }
+
+  auto IngestEngine::Submit(const SymbolId symbol, OrderBookRecord& book)
+    -> bool {
+    return Push(symbol, [&book](FeedRecord& record) {
+      record.type = FeedRecord::Type::kBook;
+      std::swap(record.book, book);
+    });
+  }
+
+  auto IngestEngine::Submit(const SymbolId symbol, const TradeRecord& trade)
+    -> bool {
+    return Push(symbol, [&trade](FeedRecord& record) {
+      record.type  = FeedRecord::Type::kTrade;
+      record.trade = trade;
+    });
+  }
+
+  auto IngestEngine::Stop() -> IngestReport {
+    stopped_ = true;
+
+    IngestReport report{};
+    LatencyHistogram latencies{};
+    for (auto& shard : shards_) {
+      shard->done.store(true, std::memory_order_release);
+    }
+    for (auto& shard : shards_) {
+      if (shard->consumer.joinable()) {
+        shard->consumer.join();
+      }
+      latencies.Merge(shard->latencies);
+      report.dropped += shard->dropped.load(std::memory_order_relaxed);
+    }
+
+    const auto to_duration = [](const uint64_t nanoseconds) {
+      return std::chrono::nanoseconds{static_cast<int64_t>(nanoseconds)};
+    };
+    report.messages     = latencies.Count();
+    report.p50_latency  = to_duration(latencies.ValueAt(50.0));
+    report.p99_latency  = to_duration(latencies.ValueAt(99.0));
+    report.p999_latency = to_duration(latencies.ValueAt(99.9));
+    report.max_latency  = to_duration(latencies.Max());
+    return report;
+  }
+}   // namespace longlp
@@ -0,0 +1,116 @@
+// Copyright 2022 Long Le Phi. All rights reserved.
+// Use of this source code is governed by a MIT license that can be
+// found in the LICENSE file.
+
+#ifndef INGEST_ENGINE_HPP_
+#define INGEST_ENGINE_HPP_
+
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "definitions.hpp"
+#include "symbol_table.hpp"
+
+namespace longlp {
+  // What a producer does when the queue of a shard is full.
+  enum class Backpressure {
+    // sleep until the consumer has freed a slot.
+    kBlock,
+    // drop the oldest queued message of the shard, the submitted one is
+    // always queued. The classification of the symbols which lost a message
+    // may be wrong.
+    kDropOldest,
+    // retry at once, yielding the processor between the attempts.
+    kSpin,
+  };
+
+  // Receive the classified orders of a book update of |symbol|, formatted as
+  // the lines of the output files. It is called on the shard threads: the
+  // calls of a symbol are ordered, the calls of symbols of different shards
+  // are concurrent.
+  using EventSink =
+    std::function<void(SymbolId symbol, std::string_view events)>;
+
+  struct IngestOptions {
+    size_t shards{1};
+    size_t queue_capacity{4096};
+    Backpressure backpressure{Backpressure::kBlock};
+    // the classified orders go to |sink| if it is set, otherwise to the
+    // <symbol>.txt files of |out_dir|.
+    EventSink sink{};
+    std::string out_dir{};
+  };
+
+  // Summary of an ingest run. The latency of a message is measured from its
+  // submission until it has been classified.
+  struct IngestReport {
+    size_t messages{0};
+    size_t dropped{0};
+    std::chrono::nanoseconds p50_latency{0};
+    std::chrono::nanoseconds p99_latency{0};
+    std::chrono::nanoseconds p999_latency{0};
+    std::chrono::nanoseconds max_latency{0};
+  };
+
+  // An execution engine for messages which are pushed in-process by any
+  // number of producer threads, without any serialization. Every symbol is
+  // assigned to a fixed shard, which owns a bounded lock-free queue and one
+  // consumer thread. The consumer owns the workers and output files of its
+  // symbols, which it creates on their first message.
+  //
+  // The messages of a symbol are classified in their submission order. The
+  // submissions of a symbol from several threads must be ordered by the
+  // caller, e.g. by submitting each symbol from a single thread.
+  class IngestEngine {
+   public:
+    explicit IngestEngine(IngestOptions options);
+    IngestEngine(const IngestEngine&)                    = delete;
+    auto operator=(const IngestEngine&) -> IngestEngine& = delete;
+    IngestEngine(IngestEngine&&)                         = delete;
+    auto operator=(IngestEngine&&) -> IngestEngine&      = delete;
+    ~IngestEngine();
+
+    // Return the identifier of |symbol|, a new one is assigned to an unknown
+    // symbol. It is thread safe, but takes a lock: the identifiers should be
+    // registered once and kept by the producers.
+    auto RegisterSymbol(std::string_view symbol) -> SymbolId;
+
+    // Queue a book of a registered symbol. The storage of |book| is swapped
+    // with a recycled queue slot. Return false if |symbol| is unknown.
+    auto Submit(SymbolId symbol, OrderBookRecord& book) -> bool;
+
+    // Queue a trade of a registered symbol. Return false if |symbol| is
+    // unknown.
+    auto Submit(SymbolId symbol, const TradeRecord& trade) -> bool;
+
+    // Drain every shard and join the consumer threads. No message should be
+    // submitted after it.
+    auto Stop() -> IngestReport;
+
+   private:
+    struct Shard;
+
+    // A copy of the name of |symbol|.
+    auto SymbolName(SymbolId symbol) -> std::string;
+
+    template <typename Fill>
+    auto Push(SymbolId symbol, Fill&& fill) -> bool;
+
+    IngestOptions options_;
+
+    std::mutex symbols_mutex_{};
+    SymbolTable symbols_{};
+    // number of registered symbols, read by the producers without the lock.
+    std::atomic<size_t> symbol_count_{0};
+
+    std::vector<std::unique_ptr<Shard>> shards_{};
+    bool stopped_{false};
+  };
+}   // namespace longlp
+
+#endif   // INGEST_ENGINE_HPP_
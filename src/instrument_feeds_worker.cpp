@@ -6,9 +6,12 @@
 
 #include <fmt/format.h>
 #include <array>
-#include <cmath>
+#include <iterator>
+#include <limits>
 #include <numeric>
-#include <sstream>
+#include <utility>
+#include "book_analytics.hpp"
+#include "side_list_diff.hpp"
 
 namespace longlp {
   namespace {
@@ -16,212 +19,266 @@ namespace longlp {
       "CANCEL",
       "PASSIVE",
       "AGGRESSIVE"};
-    enum class Intention : std::size_t {
-      kCancelled  = 0,
-      kPassive    = 1,
-      kAggressive = 2,
-    };
+
+    constexpr std::array<metrics::Counter, 3> kIntentionCounters = {
+      metrics::Counter::kCancelEvents,
+      metrics::Counter::kPassiveEvents,
+      metrics::Counter::kAggressiveEvents};
 
     constexpr std::array<std::string_view, 2> kSideStrings = {"BUY", "SELL"};
-    enum class Side : std::size_t { kBuy = 0, kSell = 1 };
 
-    // fast floating point comparision
-    auto IsSame(const double left, const double right) -> bool {
-      return std::fabs(left - right) < std::numeric_limits<double>::epsilon();
+    // Append the fixed-point |value| of |decimals| decimals to |output| with
+    // two decimals, as "{:.2f}" would format its decimal value.
+    template <int32_t decimals>
+    void AppendDecimal(const int64_t value, std::string& output) {
+      if constexpr (decimals <= 2) {
+        // exact, there is nothing to round.
+        const auto hundredths = value * detail::Pow10(2 - decimals);
+        const auto magnitude  = hundredths < 0
+                                ? 0U - static_cast<uint64_t>(hundredths)
+                                : static_cast<uint64_t>(hundredths);
+        if (hundredths < 0) {
+          output += '-';
+        }
+        const fmt::format_int units{magnitude / 100};
+        output.append(units.data(), units.size());
+        output += '.';
+        output += static_cast<char>('0' + magnitude / 10 % 10);
+        output += static_cast<char>('0' + magnitude % 10);
+      }
+      else {
+        // keep the rounding of the double value.
+        fmt::format_to(std::back_inserter(output),
+                       "{:.2f}",
+                       static_cast<double>(value) /
+                         static_cast<double>(detail::Pow10(decimals)));
+      }
     }
 
-    // generate formatted orders.
-    auto GenerateStatus(const Intention intention,
+    // append a formatted order to |output|:
+    // "{intention} {side} {quantity:.2f} @ {price:.2f}\n"
+    // The fixed-point values are converted back to decimals only here.
+    void GenerateStatus(const Intention intention,
                         const Side side,
-                        const double quantity,
-                        const double price) {
-      static constexpr std::string_view format =
-        "{intention} {side} {quantity:.2f} @ {price:.2f}\n";
-      return fmt::format(
-        format,
-        fmt::arg("intention",
-                 kIntentionStrings.at(static_cast<size_t>(intention))),
-        fmt::arg("side", kSideStrings.at(static_cast<size_t>(side))),
-        fmt::arg("quantity", quantity),
-        fmt::arg("price", price));
-    };
+                        const Volume quantity,
+                        const Price price,
+                        std::string& output) {
+      metrics::Count(kIntentionCounters.at(static_cast<size_t>(intention)));
+
+      output += kIntentionStrings.at(static_cast<size_t>(intention));
+      output += ' ';
+      output += kSideStrings.at(static_cast<size_t>(side));
+      output += ' ';
+      AppendDecimal<config::quantity_decimals>(quantity, output);
+      output += " @ ";
+      AppendDecimal<config::price_decimals>(price, output);
+      output += '\n';
+    }
 
     // Compare the changes of a side between old and new order book records.
-    template <Side side>
-    auto CompareSideListChange(const SideList& old_list,
-                               const SideList& new_list,
-                               std::ostream& writer) {
-      auto old_it = old_list.begin();
-      auto new_it = new_list.begin();
-
-      using is_new_order_placed_comparer =
-        std::conditional_t<side == Side::kBuy,
-                           std::greater<double>,
-                           std::less<double>>;
-      const is_new_order_placed_comparer is_new_order_placed{};
-
-      for (; old_it != old_list.end() || new_it != new_list.end();) {
-        if (old_it == old_list.end()) {
-          // new order
-          writer << GenerateStatus(Intention::kPassive,
-                                   side,
-                                   new_it->quantity,
-                                   new_it->price);
-          ++new_it;
-          continue;
-        }
+    template <Side side, typename Levels>
+    void CompareSideListChange(const Levels& old_list,
+                               const Levels& new_list,
+                               std::string& output) {
+      DiffSideList<side>(
+        old_list,
+        new_list,
+        [&output](const Intention intention,
+                  const Volume quantity,
+                  const Price price) {
+          GenerateStatus(intention, side, quantity, price, output);
+        });
+    }
+  }   // namespace
 
-        if (new_it == new_list.end()) {
-          // cancel order
-          writer << GenerateStatus(Intention::kCancelled,
-                                   side,
-                                   old_it->quantity,
-                                   old_it->price);
-          ++old_it;
-          continue;
-        }
+  template <typename Book>
+  auto BasicInstrumentFeedsWorker<Book>::UpdateBookChangesUnsafe(
+    std::unique_ptr<Book> new_book) -> std::string {
+    if (new_book == nullptr) {
+      return "update invalid book\n";
+    }
+    return std::string{UpdateBookChanges(*new_book)};
+  }
 
-        if (IsSame(old_it->price, new_it->price)) {
-          // Log if there is a change in quantity
-          if (const auto quant_diff = new_it->quantity - old_it->quantity;
-              !IsSame(quant_diff, 0.0)) {
-            writer << GenerateStatus(
-              quant_diff > 0 ? Intention::kPassive : Intention::kCancelled,
-              side,
-              quant_diff,
-              new_it->price);
-          }
-
-          ++new_it;
-          ++old_it;
-          continue;
-        }
+  template <typename Book>
+  auto BasicInstrumentFeedsWorker<Book>::UpdateBookChanges(Book& new_book)
+    -> std::string_view {
+    output_.clear();
+    UpdateBookChanges(new_book, output_);
+    return output_;
+  }
 
-        // There is a new order which changes the positions in order book
-        if (is_new_order_placed(new_it->price, old_it->price)) {
-          writer << GenerateStatus(Intention::kPassive,
-                                   side,
-                                   new_it->quantity,
-                                   new_it->price);
-          ++new_it;
-          continue;
-        }
+  template <typename Book>
+  void BasicInstrumentFeedsWorker<Book>::UpdateBookChanges(
+    Book& new_book,
+    std::string& output) {
+    // the books without their own swap, e.g. OrderBookRecord, use std::swap
+    using std::swap;
 
-        // There is a cancel order which changes the positions in order
-        // book
-        writer << GenerateStatus(Intention::kCancelled,
-                                 side,
-                                 old_it->quantity,
-                                 old_it->price);
-        ++old_it;
-      }
+    const metrics::ScopedTimer timer{metrics::Histogram::kBookUpdate};
+    if constexpr (config::enable_metrics) {
+      messages_.Add();
+      metrics::Count(metrics::Counter::kBooks);
+      metrics::Record(metrics::Histogram::kBookDepth, new_book.bids.size());
+      metrics::Record(metrics::Histogram::kBookDepth, new_book.asks.size());
+      metrics::Record(metrics::Histogram::kTradeRun, trade_run_);
+      trade_run_ = 0;
     }
-  }   // namespace
 
-  auto InstrumentFeedsWorker::UpdateBookChangesUnsafe(
-    std::unique_ptr<OrderBookRecord> new_book) -> std::string {
-    std::ostringstream result;
-    if (new_book == nullptr) {
-      result << "update invalid book\n";
-      return result.str();
+    // the trades since the live book lead to |new_book|.
+    if (analytics_ != nullptr) {
+      analytics_->Record(new_book, trades_);
     }
 
     // Since there is no previous book, update and early exit.
-    if (old_book_ == nullptr) {
-      old_book_ = std::move(new_book);
-      return result.str();
+    if (!has_live_book_) {
+      swap(live_book_, new_book);
+      has_live_book_ = true;
+      return;
     }
 
     // The case where there are no trades between order book records.
-    if (trades_ == nullptr || trades_->empty()) {
-      CompareSideListChange<Side::kBuy>(old_book_->bids,
-                                        new_book->bids,
-                                        result);
-      CompareSideListChange<Side::kSell>(old_book_->asks,
-                                         new_book->asks,
-                                         result);
+    if (trades_.empty()) {
+      CompareSideListChange<Side::kBuy>(live_book_.bids,
+                                        new_book.bids,
+                                        output);
+      CompareSideListChange<Side::kSell>(live_book_.asks,
+                                         new_book.asks,
+                                         output);
 
-      old_book_ = std::move(new_book);
-      return result.str();
+      swap(live_book_, new_book);
+      return;
     }
 
     const auto total_trade_quantity =
-      std::accumulate(trades_->begin(),
-                      trades_->end(),
-                      0.0,
-                      [](const double quantity, const TradeRecord& trade) {
+      std::accumulate(trades_.begin(),
+                      trades_.end(),
+                      Volume{0},
+                      [](const Volume quantity, const TradeRecord& trade) {
                         return quantity + trade.quantity;
                       });
 
     auto quantity    = total_trade_quantity;
-    auto order_price = trades_->back().price;
+    auto order_price = trades_.back().price;
 
     // aggressive sell
     // trades are guaranteed in price-descending order
     //
     // first trade (largest trade price) should <= old book's best bid
     // (largest buy price)
-    if (!old_book_->bids.empty() &&
-        trades_->front().price <= old_book_->bids.front().price) {
-      if (!new_book->asks.empty() &&
-          trades_->back().price >= new_book->asks.front().price) {
-        order_price = new_book->asks.front().price;
-        quantity += new_book->asks.front().quantity;
+    if (!live_book_.bids.empty() &&
+        trades_.front().price <= live_book_.bids.front().price) {
+      if (!new_book.asks.empty() &&
+          trades_.back().price >= new_book.asks.front().price) {
+        order_price = new_book.asks.front().price;
+        quantity += new_book.asks.front().quantity;
       }
 
-      result << GenerateStatus(Intention::kAggressive,
-                               Side::kSell,
-                               quantity,
-                               order_price);
+      GenerateStatus(Intention::kAggressive,
+                     Side::kSell,
+                     quantity,
+                     order_price,
+                     output);
     }
     // aggressive buy
     // trades are guaranteed in price-ascending order
     //
     // first trade (smallest trade price) should >= old book's best ask
     // (smallest sell price)
-    else if (!old_book_->asks.empty() &&
-             trades_->front().price >= old_book_->asks.front().price) {
-      if (!new_book->bids.empty() &&
-          trades_->back().price <= new_book->bids.front().price) {
-        order_price = new_book->bids.front().price;
-        quantity += new_book->bids.front().quantity;
+    else if (!live_book_.asks.empty() &&
+             trades_.front().price >= live_book_.asks.front().price) {
+      if (!new_book.bids.empty() &&
+          trades_.back().price <= new_book.bids.front().price) {
+        order_price = new_book.bids.front().price;
+        quantity += new_book.bids.front().quantity;
       }
-      result << GenerateStatus(Intention::kAggressive,
-                               Side::kBuy,
-                               quantity,
-                               order_price);
+      GenerateStatus(Intention::kAggressive,
+                     Side::kBuy,
+                     quantity,
+                     order_price,
+                     output);
     }
     // Should not reach here
     else {
-      result << "invalid trade\n";
+      metrics::Count(metrics::Counter::kInvalidTrades);
+      output += "invalid trade\n";
     }
 
     // Always update new states to prepare for the next call
-    trades_->clear();
-    old_book_ = std::move(new_book);
-
-    return result.str();
+    trades_.clear();
+    swap(live_book_, new_book);
   }
 
-  auto InstrumentFeedsWorker::RecordNewTrade(
+  template <typename Book>
+  auto BasicInstrumentFeedsWorker<Book>::RecordNewTrade(
     std::unique_ptr<TradeRecord> new_trade) -> bool {
     if (new_trade == nullptr) {
       return false;
     }
 
-    if (trades_ == nullptr) {
-      trades_ = std::make_unique<std::deque<TradeRecord>>();
+    RecordNewTrade(*new_trade);
+    return true;
+  }
+
+  template <typename Book>
+  void BasicInstrumentFeedsWorker<Book>::RecordNewTrade(
+    const TradeRecord& new_trade) {
+    if constexpr (config::enable_metrics) {
+      messages_.Add();
+      metrics::Count(metrics::Counter::kTrades);
+      ++trade_run_;
     }
 
-    if (trades_->empty() || !IsSame(trades_->back().price, new_trade->price)) {
-      trades_->push_back(*new_trade);
-      return true;
+    if (trades_.empty() || trades_.back().price != new_trade.price) {
+      trades_.push_back(new_trade);
+      return;
     }
 
     // Accumulate the trades which have the same price because there is no
-    // requirement to analyze each record.
-    trades_->back().quantity += new_trade->quantity;
-    return true;
+    // requirement to analyze each record. A sum beyond Quantity is kept as
+    // another trade of this price, the trades are summed as a Volume.
+    auto& last     = trades_.back();
+    const auto sum = Volume{last.quantity} + new_trade.quantity;
+    if (sum > std::numeric_limits<Quantity>::max() ||
+        sum < std::numeric_limits<Quantity>::min()) {
+      trades_.push_back(new_trade);
+      return;
+    }
+    last.quantity = static_cast<Quantity>(sum);
+  }
+
+  template <typename Book>
+  void BasicInstrumentFeedsWorker<Book>::StartFrom(const Book& book) {
+    live_book_     = book;
+    has_live_book_ = true;
+    trades_.clear();
+    trade_run_ = 0;
+  }
+
+  template <typename Book>
+  void BasicInstrumentFeedsWorker<Book>::ContinueWith(
+    BasicInstrumentFeedsWorker& next) {
+    using std::swap;
+
+    if (next.has_live_book_) {
+      swap(live_book_, next.live_book_);
+      has_live_book_ = true;
+    }
+    trades_.swap(next.trades_);
+    messages_.Add(next.messages_.Load());
+    trade_run_ = next.trade_run_;
+  }
+
+  template <typename Book>
+  void BasicInstrumentFeedsWorker<Book>::Restore(
+    const Book& book,
+    const std::vector<TradeRecord>& trades) {
+    StartFrom(book);
+    trades_    = trades;
+    trade_run_ = trades.size();
   }
 
+  template class BasicInstrumentFeedsWorker<OrderBookRecord>;
+  template class BasicInstrumentFeedsWorker<BookT<16>>;
+  template class BasicInstrumentFeedsWorker<BookT<64>>;
 }   // namespace longlp
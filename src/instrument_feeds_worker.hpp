@@ -5,34 +5,111 @@
 #ifndef INSTRUMENT_FEEDS_WORKER_HPP_
 #define INSTRUMENT_FEEDS_WORKER_HPP_
 
-#include <deque>
-#include <fstream>
 #include <memory>
 #include <string>
 #include <string_view>
+#include <vector>
 #include "definitions.hpp"
+#include "metrics.hpp"
+#include "soa_book.hpp"
 
 namespace longlp {
+  class BookAnalytics;
+
   // A Worker who analyzes the order book and trade messages of a single
   // instrument. It is designed to only keep the previous order book record.
   // Thus minimizing the memory usage.
-  class InstrumentFeedsWorker {
+  //
+  // |Book| is either OrderBookRecord, whose sides are vectors of levels, or
+  // BookT<MaxDepth>, whose sides of up to |MaxDepth| levels are inline
+  // structures of arrays.
+  template <typename Book>
+  class BasicInstrumentFeedsWorker {
    public:
     // Compares changes with previous logged order book. Return the formatted
     // and classified orders (Intention Side Quantity @ Price)
-    auto UpdateBookChangesUnsafe(std::unique_ptr<OrderBookRecord> new_book)
+    auto UpdateBookChangesUnsafe(std::unique_ptr<Book> new_book)
       -> std::string;
 
+    // Compares |new_book| with the live book, which is the previous logged
+    // order book. Return the formatted and classified orders, as a view of
+    // the output buffer of the worker which is valid until the next call.
+    // The new book is then applied in place by swapping the storage of both
+    // books: the live book becomes |new_book| and |new_book| receives the
+    // storage of the previous book, so the caller can reuse it for the next
+    // snapshot. Thus no book nor output is allocated per message.
+    auto UpdateBookChanges(Book& new_book) -> std::string_view;
+
+    // Same as above, but append the classified orders to |output|, e.g. the
+    // buffer of the output file of the instrument.
+    void UpdateBookChanges(Book& new_book, std::string& output);
+
     // Log the trades between order book records.
     auto RecordNewTrade(std::unique_ptr<TradeRecord> new_trade) -> bool;
 
+    void RecordNewTrade(const TradeRecord& new_trade);
+
+    // Start classifying a segment of the feed of the instrument, from |book|
+    // which is the last book of the previous segment. The book is not
+    // classified, and there is no pending trade.
+    void StartFrom(const Book& book);
+
+    // Continue after |next|, the worker of the following segment of the
+    // feed: take its live book, pending trades and message counts.
+    void ContinueWith(BasicInstrumentFeedsWorker& next);
+
+    // the live book, nullptr before the first book.
+    auto LiveBook() const -> const Book* {
+      return has_live_book_ ? &live_book_ : nullptr;
+    }
+
+    // the trades recorded since the live book.
+    auto PendingTrades() const -> const std::vector<TradeRecord>& {
+      return trades_;
+    }
+
+    // Restore the live book and pending trades of a checkpoint, the next
+    // book is classified against them.
+    void Restore(const Book& book, const std::vector<TradeRecord>& trades);
+
+    // Record the analytics of every next book into |analytics|, nullptr to
+    // stop. Nothing is computed without analytics.
+    void AttachAnalytics(BookAnalytics* analytics) {
+      analytics_ = analytics;
+    }
+
+    // number of books and trades received, 0 if the metrics are disabled.
+    auto Messages() const -> uint64_t {
+      return messages_.Load();
+    }
+
    private:
-    std::unique_ptr<OrderBookRecord> old_book_{nullptr};
+    // the live book, valid once a book has been recorded.
+    Book live_book_{};
+    bool has_live_book_{false};
+
+    // trade records are guaranteed in sorted order, so the front and back
+    // are the min and max prices. Cleared (keeping its capacity) after each
+    // book update.
+    std::vector<TradeRecord> trades_{};
 
-    // trade records are guaranteed in sorted order. Thus using a queue will
-    // help to fast access the max and min prices without losing info.
-    std::unique_ptr<std::deque<TradeRecord>> trades_{nullptr};
+    // the classified orders of the last book update, reused between calls.
+    std::string output_{};
+
+    BookAnalytics* analytics_{nullptr};
+
+    metrics::SymbolCounter messages_{};
+    // number of trades since the last book, only counted for the metrics.
+    uint64_t trade_run_{0};
   };
+
+  // The worker of the parsed feeds.
+  using InstrumentFeedsWorker = BasicInstrumentFeedsWorker<OrderBookRecord>;
+
+  // instantiated in instrument_feeds_worker.cpp
+  extern template class BasicInstrumentFeedsWorker<OrderBookRecord>;
+  extern template class BasicInstrumentFeedsWorker<BookT<16>>;
+  extern template class BasicInstrumentFeedsWorker<BookT<64>>;
 }   // namespace longlp
 
 #endif   // INSTRUMENT_FEEDS_WORKER_HPP_
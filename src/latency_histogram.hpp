@@ -0,0 +1,136 @@
+// Copyright 2022 Long Le Phi. All rights reserved.
+// Use of this source code is governed by a MIT license that can be
+// found in the LICENSE file.
+
+#ifndef LATENCY_HISTOGRAM_HPP_
+#define LATENCY_HISTOGRAM_HPP_
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+
+namespace longlp {
+  // A fixed size log-linear histogram (HDR-like) of non-negative values, e.g.
+  // latencies in nanoseconds. Every power of two range is split into
+  // kSubBuckets linear buckets, so the relative error is below 1/kSubBuckets.
+  // Recording is a few integer operations without any allocation.
+  // It is not thread safe, use one histogram per thread then Merge() them.
+  class LatencyHistogram {
+   public:
+    void Record(const uint64_t value) {
+      ++counts_[IndexOf(value)];
+      ++total_;
+      if (value > max_) {
+        max_ = value;
+      }
+    }
+
+    void Merge(const LatencyHistogram& other) {
+      for (auto i = 0U; i < kBuckets; ++i) {
+        counts_[i] += other.counts_[i];
+      }
+      total_ += other.total_;
+      if (other.max_ > max_) {
+        max_ = other.max_;
+      }
+    }
+
+    // Return the upper bound of the bucket which contains the |percentile|
+    // (in range [0, 100]) value.
+    auto ValueAt(const double percentile) const -> uint64_t {
+      if (total_ == 0) {
+        return 0;
+      }
+
+      const auto rank = static_cast<uint64_t>(
+        percentile / 100.0 * static_cast<double>(total_ - 1));
+      uint64_t seen = 0;
+      for (auto i = 0U; i < kBuckets; ++i) {
+        seen += counts_[i];
+        if (seen > rank) {
+          const auto upper = UpperBoundOf(i);
+          return upper < max_ ? upper : max_;
+        }
+      }
+      return max_;
+    }
+
+    auto Count() const -> uint64_t { return total_; }
+
+    auto Max() const -> uint64_t { return max_; }
+
+   private:
+    friend class SharedLatencyHistogram;
+
+    static constexpr uint32_t kSubBucketBits = 3;
+    static constexpr uint32_t kSubBuckets    = 1U << kSubBucketBits;
+    static constexpr uint32_t kBuckets       = 64 * kSubBuckets;
+
+    static auto IndexOf(const uint64_t value) -> uint32_t {
+      if (value < kSubBuckets) {
+        return static_cast<uint32_t>(value);
+      }
+
+      // position of the most significant bit
+      uint32_t msb = kSubBucketBits;
+      while ((value >> (msb + 1)) != 0) {
+        ++msb;
+      }
+      const auto sub = static_cast<uint32_t>(value >> (msb - kSubBucketBits)) -
+                       kSubBuckets;
+      return (msb - kSubBucketBits + 1) * kSubBuckets + sub;
+    }
+
+    static auto UpperBoundOf(const uint32_t index) -> uint64_t {
+      if (index < kSubBuckets) {
+        return index;
+      }
+
+      const auto shift = index / kSubBuckets - 1;
+      const auto sub   = uint64_t{index % kSubBuckets} + kSubBuckets;
+      return ((sub + 1) << shift) - 1;
+    }
+
+    std::array<uint64_t, kBuckets> counts_{};
+    uint64_t total_{0};
+    uint64_t max_{0};
+  };
+
+  // Same buckets as LatencyHistogram, recorded by a single thread while any
+  // thread can take a Snapshot(). The counts are relaxed atomics which the
+  // owner increments without any read-modify-write instruction, so recording
+  // costs the same as the plain histogram.
+  class SharedLatencyHistogram {
+   public:
+    void Record(const uint64_t value) {
+      Bump(counts_[LatencyHistogram::IndexOf(value)]);
+      if (value > max_.load(std::memory_order_relaxed)) {
+        max_.store(value, std::memory_order_relaxed);
+      }
+    }
+
+    // Return a copy of the recorded values, it may miss the values being
+    // recorded concurrently.
+    auto Snapshot() const -> LatencyHistogram {
+      LatencyHistogram result{};
+      for (auto i = 0U; i < LatencyHistogram::kBuckets; ++i) {
+        result.counts_[i] = counts_[i].load(std::memory_order_relaxed);
+        result.total_ += result.counts_[i];
+      }
+      result.max_ = max_.load(std::memory_order_relaxed);
+      return result;
+    }
+
+   private:
+    // only the owner thread writes, thus a load and a store are enough.
+    static void Bump(std::atomic<uint64_t>& counter) {
+      counter.store(counter.load(std::memory_order_relaxed) + 1,
+                    std::memory_order_relaxed);
+    }
+
+    std::array<std::atomic<uint64_t>, LatencyHistogram::kBuckets> counts_{};
+    std::atomic<uint64_t> max_{0};
+  };
+}   // namespace longlp
+
+#endif   // LATENCY_HISTOGRAM_HPP_
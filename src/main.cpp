@@ -4,43 +4,602 @@
 
 #include <fmt/core.h>
 #include <fmt/format.h>
+#include <algorithm>
+#include <atomic>
 #include <chrono>
+#include <csignal>
+#include <filesystem>
+#include <memory>
+#include <string>
+#include <string_view>
 #include <thread>
+#include <vector>
+#include "binary_feed.hpp"
 #include "definitions.hpp"
 #include "longlp_config.hpp"
+#include "metrics.hpp"
 #include "order_book_feeds_manager.hpp"
+#include "peak_memory.hpp"
 
 namespace {
   namespace chrono = std::chrono;
-}   // namespace
 
-auto main() -> int32_t {
-  longlp::OrderBookFeedsManager manager{};
+  // Command line options, passed as `--name=value`.
+  struct Options {
+    // two-phase: parse the whole input, then run the task flow. The input
+    //            can also be a binary feed file of the feed converter.
+    // streaming: parse and run the task flow in bounded batches.
+    // sharded: run the feeds on per-shard queues instead of the task flow.
+    // stealing: run the feeds on per-symbol mailboxes, which are run by
+    //           their home thread or stolen by an idle thread.
+    // mapped: memory map the input then parse its chunks in parallel.
+    // partitioned: memory map the input, parse its chunks in parallel and
+    //              group the records by symbol, then run one task per
+    //              symbol without any dependency graph.
+    // follow: classify the new lines of a growing input file as they are
+    //         written, until interrupted.
+    std::string mode{"two-phase"};
+    // comma separated list of feed files and directories, read in order.
+    std::string input{
+      fmt::format("{}/input/input.json", longlp::config::data_dir)};
+    // the feed files of |input|
+    std::vector<std::string> input_files{};
+    std::string output{fmt::format("{}/output", longlp::config::data_dir)};
+    size_t threads{std::thread::hardware_concurrency()};
+    size_t batch_lines{1U << 16U};
+    size_t shards{std::thread::hardware_concurrency()};
+    size_t queue_capacity{1U << 12U};
+    // maximum capacity of the mailbox of every symbol of the stealing mode.
+    size_t mailbox_capacity{longlp::StealingOptions{}.mailbox_capacity};
+    // messages of a symbol run at once by the stealing mode.
+    size_t steal_batch{64};
+    size_t chunks{std::thread::hardware_concurrency()};
+    // split the symbols with more books into segments classified in
+    // parallel by the mapped mode, 0 to never split a symbol.
+    size_t segment_books{0};
+    size_t flush_us{1000};
+    size_t poll_us{1000};
+    // stop following after this idle time, 0 to follow until interrupted.
+    size_t idle_exit_ms{0};
+    // write the outputs asynchronously: auto, io_uring or threads. Empty to
+    // write them from the analysis threads. Not used by the follow mode.
+    std::string async_output{};
+    size_t max_open_files{256};
+    // write the outputs into a single segmented file with an index: binary
+    // or text records. Empty for one file per symbol. Not used by the follow
+    // mode.
+    std::string consolidated_output{};
+    size_t segment_mb{256};
+    // write a checkpoint of the streaming mode into this file every
+    // |checkpoint_lines| lines and at the end, if not empty.
+    std::string checkpoint{};
+    size_t checkpoint_lines{1U << 20U};
+    // continue the streaming mode from |checkpoint|, e.g. once more lines
+    // are appended to the input or after an interrupted run.
+    bool resume{false};
+    // write the analytics series of every symbol into
+    // <output>/<symbol>.analytics.csv, with the depth imbalance over
+    // |analytics_depth| levels. Not used by the ingest.
+    bool analytics{false};
+    size_t analytics_depth{5};
+    // dump the metrics into this file periodically, if not empty. The
+    // metrics are only recorded by a build with LONGLP_ENABLE_METRICS.
+    std::string metrics_file{};
+    size_t metrics_interval_ms{1000};
+  };
+
+  // Return the feed files of a comma separated list of files and
+  // directories. The .json and .bin files of a directory are read in name
+  // order, e.g. one capture per session named by date.
+  auto ListInputFiles(const std::string_view input)
+    -> std::vector<std::string> {
+    std::vector<std::string> result{};
+    for (size_t begin = 0; begin <= input.size();) {
+      auto end = input.find(',', begin);
+      end      = end == std::string_view::npos ? input.size() : end;
+      const std::filesystem::path path{input.substr(begin, end - begin)};
+      begin = end + 1;
+
+      if (path.empty()) {
+        continue;
+      }
+      if (!std::filesystem::is_directory(path)) {
+        result.push_back(path.string());
+        continue;
+      }
+
+      std::vector<std::string> directory_files{};
+      for (const auto& entry : std::filesystem::directory_iterator{path}) {
+        const auto extension = entry.path().extension();
+        if (entry.is_regular_file() &&
+            (extension == ".json" || extension == ".bin")) {
+          directory_files.push_back(entry.path().string());
+        }
+      }
+      std::sort(directory_files.begin(), directory_files.end());
+      result.insert(result.end(),
+                    directory_files.begin(),
+                    directory_files.end());
+    }
+    return result;
+  }
+
+  auto ParseOptions(const int32_t argc, char** argv) -> Options {
+    Options options{};
+    for (auto i = 1; i < argc; ++i) {
+      const std::string_view arg = argv[i];
+      const auto separator       = arg.find('=');
+      const auto name            = arg.substr(0, separator);
+      const auto value =
+        separator == std::string_view::npos ? "" : arg.substr(separator + 1);
+
+      if (name == "--mode") {
+        options.mode = value;
+      }
+      else if (name == "--input") {
+        options.input = value;
+      }
+      else if (name == "--output") {
+        options.output = value;
+      }
+      else if (name == "--threads") {
+        options.threads = std::stoul(std::string{value});
+      }
+      else if (name == "--batch-lines") {
+        options.batch_lines = std::stoul(std::string{value});
+      }
+      else if (name == "--shards") {
+        options.shards = std::stoul(std::string{value});
+      }
+      else if (name == "--queue-capacity") {
+        options.queue_capacity = std::stoul(std::string{value});
+      }
+      else if (name == "--mailbox-capacity") {
+        options.mailbox_capacity = std::stoul(std::string{value});
+      }
+      else if (name == "--steal-batch") {
+        options.steal_batch = std::stoul(std::string{value});
+      }
+      else if (name == "--chunks") {
+        options.chunks = std::stoul(std::string{value});
+      }
+      else if (name == "--segment-books") {
+        options.segment_books = std::stoul(std::string{value});
+      }
+      else if (name == "--flush-us") {
+        options.flush_us = std::stoul(std::string{value});
+      }
+      else if (name == "--poll-us") {
+        options.poll_us = std::stoul(std::string{value});
+      }
+      else if (name == "--idle-exit-ms") {
+        options.idle_exit_ms = std::stoul(std::string{value});
+      }
+      else if (name == "--async-output") {
+        options.async_output = value;
+      }
+      else if (name == "--max-open-files") {
+        options.max_open_files = std::stoul(std::string{value});
+      }
+      else if (name == "--consolidated-output") {
+        options.consolidated_output = value;
+      }
+      else if (name == "--segment-mb") {
+        options.segment_mb = std::stoul(std::string{value});
+      }
+      else if (name == "--analytics") {
+        options.analytics = true;
+      }
+      else if (name == "--analytics-depth") {
+        options.analytics_depth = std::stoul(std::string{value});
+      }
+      else if (name == "--checkpoint") {
+        options.checkpoint = value;
+      }
+      else if (name == "--checkpoint-lines") {
+        options.checkpoint_lines = std::stoul(std::string{value});
+      }
+      else if (name == "--resume") {
+        options.resume = true;
+      }
+      else if (name == "--metrics-file") {
+        options.metrics_file = value;
+      }
+      else if (name == "--metrics-interval-ms") {
+        options.metrics_interval_ms = std::stoul(std::string{value});
+      }
+      else {
+        fmt::print("Unknown option {}\n", arg);
+      }
+    }
+    options.input_files = ListInputFiles(options.input);
+    return options;
+  }
+
+  // print the metrics summary of a run, if the metrics are enabled.
+  void PrintMetrics(const longlp::OrderBookFeedsManager& manager) {
+    if constexpr (longlp::config::enable_metrics) {
+      fmt::print("{}", manager.MetricsSummary());
+    }
+  }
+
+  // Enable the analytics of |manager| if they are requested.
+  void EnableAnalytics(const Options& options,
+                       longlp::OrderBookFeedsManager& manager) {
+    if (options.analytics) {
+      longlp::AnalyticsOptions analytics{};
+      analytics.depth_levels = options.analytics_depth;
+      manager.EnableAnalytics(analytics);
+    }
+  }
+
+  // Enable the analytics, consolidated and asynchronous outputs of |manager|
+  // if they are requested.
+  void EnableOutputs(const Options& options,
+                     longlp::OrderBookFeedsManager& manager) {
+    EnableAnalytics(options, manager);
+    if (!options.consolidated_output.empty()) {
+      longlp::ConsolidatedOptions consolidated{};
+      consolidated.segment_bytes = uint64_t{options.segment_mb} << 20U;
+      if (options.consolidated_output == "text") {
+        consolidated.format = longlp::RecordFormat::kText;
+      }
+      else if (options.consolidated_output != "binary") {
+        fmt::print("Unknown record format {}, using binary\n",
+                   options.consolidated_output);
+      }
+      manager.EnableConsolidatedOutput(consolidated);
+    }
+
+    if (options.async_output.empty()) {
+      return;
+    }
+
+    longlp::AsyncWriterOptions writer{};
+    writer.max_open_files = options.max_open_files;
+    if (options.async_output == "io_uring") {
+      writer.backend = longlp::OutputBackend::kIoUring;
+    }
+    else if (options.async_output == "threads") {
+      writer.backend = longlp::OutputBackend::kThreads;
+    }
+    else if (options.async_output != "auto") {
+      fmt::print("Unknown output backend {}, using auto\n",
+                 options.async_output);
+    }
+    manager.EnableAsyncOutput(writer);
+  }
+
+  // print the summary of the asynchronous output of a run, if enabled.
+  void PrintOutputReport(const longlp::OrderBookFeedsManager& manager) {
+    const auto report = manager.OutputReport();
+    if (report.writes + report.failures == 0) {
+      return;
+    }
+    fmt::print("Output {}: {} writes of {:.1f}MB, {} submissions, {} opens, "
+               "{} failures, stalled {}ms\n",
+               report.io_uring ? "io_uring" : "threads",
+               report.writes,
+               static_cast<double>(report.bytes) / (1024.0 * 1024.0),
+               report.submissions,
+               report.opens,
+               report.failures,
+               chrono::duration_cast<chrono::milliseconds>(report.stall)
+                 .count());
+  }
+
+  void RunTwoPhase(const Options& options) {
+    longlp::OrderBookFeedsManager manager{};
+    EnableOutputs(options, manager);
+    const auto run_start = chrono::steady_clock::now();
+
+    fmt::print("Parsing input and setting up tasks\n");
+    {
+      auto start = chrono::high_resolution_clock::now();
+
+      manager.InitFeedsAndGenerateTaskFlow(options.input_files,
+                                           options.output);
+
+      fmt::print("Execution time {}ms\n",
+                 chrono::duration_cast<chrono::milliseconds>(
+                   chrono::high_resolution_clock::now() - start)
+                   .count());
+    }
+
+    fmt::print("Running task flow with {} threads\n", options.threads);
+    {
+      auto start = chrono::high_resolution_clock::now();
+
+      manager.RunTaskFlow(options.threads);
+
+      fmt::print("Execution time {}ms\n",
+                 chrono::duration_cast<chrono::milliseconds>(
+                   chrono::high_resolution_clock::now() - start)
+                   .count());
+    }
+    fmt::print("Time to first output {}ms\n",
+               chrono::duration_cast<chrono::milliseconds>(
+                 manager.FirstOutputSince(run_start))
+                 .count());
+    PrintOutputReport(manager);
+    PrintMetrics(manager);
+  }
+
+  void RunStreaming(const Options& options) {
+    longlp::OrderBookFeedsManager manager{};
+    EnableOutputs(options, manager);
+    if (!options.checkpoint.empty()) {
+      longlp::CheckpointOptions checkpoints{};
+      checkpoints.path           = options.checkpoint;
+      checkpoints.interval_lines = options.checkpoint_lines;
+      checkpoints.resume         = options.resume;
+      manager.EnableCheckpoints(checkpoints);
+    }
+
+    fmt::print("Streaming input with {} threads, {} lines per batch\n",
+               options.threads,
+               options.batch_lines);
+
+    auto start         = chrono::high_resolution_clock::now();
+    const auto report  = manager.StreamFeeds(options.input_files,
+                                            options.output,
+                                            options.threads,
+                                            options.batch_lines);
+    const auto elapsed = chrono::high_resolution_clock::now() - start;
+
+    fmt::print("Processed {} lines in {} batches\n",
+               report.lines,
+               report.batches);
+    if (!options.checkpoint.empty()) {
+      fmt::print("Resumed after {} lines, wrote {} checkpoints\n",
+                 report.resumed_lines,
+                 report.checkpoints);
+    }
+    fmt::print("Time to first output {}ms\n",
+               chrono::duration_cast<chrono::milliseconds>(report.first_output)
+                 .count());
+    fmt::print(
+      "Execution time {}ms\n",
+      chrono::duration_cast<chrono::milliseconds>(elapsed).count());
+    PrintOutputReport(manager);
+    PrintMetrics(manager);
+  }
+
+  void RunSharded(const Options& options) {
+    longlp::OrderBookFeedsManager manager{};
+    EnableOutputs(options, manager);
+
+    fmt::print("Running sharded queues with {} shards\n", options.shards);
+
+    auto start         = chrono::high_resolution_clock::now();
+    const auto report  = manager.RunShardedFeeds(options.input_files,
+                                                options.output,
+                                                options.shards,
+                                                options.queue_capacity);
+    const auto elapsed = chrono::high_resolution_clock::now() - start;
+
+    const auto to_us = [](const chrono::nanoseconds duration) {
+      return chrono::duration_cast<chrono::microseconds>(duration).count();
+    };
+    fmt::print("Processed {} messages, {:.0f} messages/s\n",
+               report.messages,
+               static_cast<double>(report.messages) /
+                 chrono::duration<double>(elapsed).count());
+    fmt::print("Latency p50 {}us, p99 {}us, p99.9 {}us, max {}us\n",
+               to_us(report.p50_latency),
+               to_us(report.p99_latency),
+               to_us(report.p999_latency),
+               to_us(report.max_latency));
+    fmt::print(
+      "Execution time {}ms\n",
+      chrono::duration_cast<chrono::milliseconds>(elapsed).count());
+    PrintOutputReport(manager);
+    PrintMetrics(manager);
+  }
+
+  void RunStealing(const Options& options) {
+    longlp::OrderBookFeedsManager manager{};
+    EnableOutputs(options, manager);
+
+    fmt::print("Running symbol mailboxes with {} threads\n", options.threads);
+
+    longlp::StealingOptions stealing{};
+    stealing.threads          = options.threads;
+    stealing.mailbox_capacity = options.mailbox_capacity;
+    stealing.batch            = options.steal_batch;
 
-  fmt::print("Parsing input and setting up tasks\n");
-  {
     auto start = chrono::high_resolution_clock::now();
+    const auto report =
+      manager.RunStealingFeeds(options.input_files, options.output, stealing);
+    const auto elapsed = chrono::high_resolution_clock::now() - start;
+
+    fmt::print("Processed {} messages, {:.0f} messages/s\n",
+               report.messages,
+               static_cast<double>(report.messages) /
+                 chrono::duration<double>(elapsed).count());
+    for (size_t i = 0; i < report.threads.size(); ++i) {
+      const auto& load = report.threads[i];
+      fmt::print("Thread {}: {} messages in {} runs, {} stolen, busy {}ms\n",
+                 i,
+                 load.messages,
+                 load.runs,
+                 load.steals,
+                 chrono::duration_cast<chrono::milliseconds>(load.busy)
+                   .count());
+    }
+    fmt::print("Load imbalance {:.2f}{}\n",
+               report.imbalance,
+               report.rebalance ? ", the symbols should be rebalanced" : "");
+    fmt::print(
+      "Execution time {}ms\n",
+      chrono::duration_cast<chrono::milliseconds>(elapsed).count());
+    PrintOutputReport(manager);
+    PrintMetrics(manager);
+  }
 
-    manager.InitFeedsAndGenerateTaskFlow(
-      fmt::format("{}/input/input.json", longlp::config::data_dir),
-      fmt::format("{}/output", longlp::config::data_dir));
+  void RunMapped(const Options& options) {
+    longlp::OrderBookFeedsManager manager{};
+    EnableOutputs(options, manager);
+
+    fmt::print("Parsing {} mapped chunks and running with {} threads\n",
+               options.chunks,
+               options.threads);
+
+    auto start = chrono::high_resolution_clock::now();
+
+    manager.RunMappedFeeds(options.input_files,
+                           options.output,
+                           options.threads,
+                           options.chunks,
+                           options.segment_books);
 
     fmt::print("Execution time {}ms\n",
                chrono::duration_cast<chrono::milliseconds>(
                  chrono::high_resolution_clock::now() - start)
                  .count());
+    PrintOutputReport(manager);
+    PrintMetrics(manager);
   }
 
-  const auto threads = std::thread::hardware_concurrency();
-  fmt::print("Running task flow with {} threads\n", threads);
-  {
+  void RunPartitioned(const Options& options) {
+    longlp::OrderBookFeedsManager manager{};
+    EnableOutputs(options, manager);
+
+    fmt::print("Partitioning {} chunks by symbol with {} threads\n",
+               options.chunks,
+               options.threads);
+
     auto start = chrono::high_resolution_clock::now();
 
-    manager.RunTaskFlow(threads);
+    manager.RunPartitionedFeeds(options.input_files,
+                                options.output,
+                                options.threads,
+                                options.chunks);
 
     fmt::print("Execution time {}ms\n",
                chrono::duration_cast<chrono::milliseconds>(
                  chrono::high_resolution_clock::now() - start)
                  .count());
+    PrintOutputReport(manager);
+    PrintMetrics(manager);
+  }
+
+  // set by SIGINT to stop the follow mode.
+  std::atomic<bool> stop_following{false};
+
+  void StopFollowing(const int32_t /*signal*/) {
+    stop_following.store(true, std::memory_order_relaxed);
+  }
+
+  void RunFollow(const Options& options) {
+    longlp::OrderBookFeedsManager manager{};
+    EnableAnalytics(options, manager);
+
+    const auto& input = options.input_files.front();
+    fmt::print("Following {} with a {}us flush budget\n",
+               input,
+               options.flush_us);
+
+    std::signal(SIGINT, StopFollowing);
+    longlp::FollowOptions follow{};
+    follow.flush_budget = chrono::microseconds{
+      static_cast<chrono::microseconds::rep>(options.flush_us)};
+    follow.poll_interval = chrono::microseconds{
+      static_cast<chrono::microseconds::rep>(options.poll_us)};
+    follow.idle_timeout = chrono::milliseconds{
+      static_cast<chrono::milliseconds::rep>(options.idle_exit_ms)};
+    follow.stop = &stop_following;
+
+    const auto report = manager.FollowFeeds(input, options.output, follow);
+
+    const auto to_us = [](const chrono::nanoseconds duration) {
+      return chrono::duration_cast<chrono::microseconds>(duration).count();
+    };
+    fmt::print("Followed {} lines, {} of them with outputs\n",
+               report.lines,
+               report.output_lines);
+    fmt::print("Latency p50 {}us, p99 {}us, max {}us, {} over budget\n",
+               to_us(report.p50_latency),
+               to_us(report.p99_latency),
+               to_us(report.max_latency),
+               report.over_budget);
+    PrintMetrics(manager);
+  }
+}   // namespace
+
+auto main(int32_t argc, char** argv) -> int32_t {
+  const auto options = ParseOptions(argc, argv);
+
+  if (options.input_files.empty()) {
+    fmt::print("There is no feed file in {}\n", options.input);
+    return 1;
+  }
+
+  if (options.mode == "follow" && options.input_files.size() != 1) {
+    fmt::print("The follow mode reads a single feed file\n");
+    return 1;
+  }
+
+  if ((options.mode == "streaming" || options.mode == "sharded" ||
+       options.mode == "stealing" || options.mode == "mapped" ||
+       options.mode == "partitioned" || options.mode == "follow") &&
+      std::any_of(options.input_files.begin(),
+                  options.input_files.end(),
+                  [](const std::string& file) {
+                    return longlp::IsBinaryFeedFile(file);
+                  })) {
+    fmt::print("Binary feeds are only replayed in the two-phase mode\n");
+    return 1;
+  }
+
+  if ((!options.checkpoint.empty() || options.resume) &&
+      options.mode != "streaming") {
+    fmt::print("Checkpoints are only written by the streaming mode\n");
+    return 1;
+  }
+
+  if (options.resume && options.checkpoint.empty()) {
+    fmt::print("--resume needs the --checkpoint file\n");
+    return 1;
+  }
+
+  std::unique_ptr<longlp::metrics::PeriodicDump> metrics_dump{nullptr};
+  if (!options.metrics_file.empty()) {
+    if constexpr (longlp::config::enable_metrics) {
+      metrics_dump = std::make_unique<longlp::metrics::PeriodicDump>(
+        options.metrics_file,
+        chrono::milliseconds{
+          static_cast<chrono::milliseconds::rep>(options.metrics_interval_ms)});
+    }
+    else {
+      fmt::print("Metrics are disabled, configure with "
+                 "-DLONGLP_ENABLE_METRICS=ON to record them\n");
+    }
+  }
+
+  if (options.mode == "streaming") {
+    RunStreaming(options);
+  }
+  else if (options.mode == "sharded") {
+    RunSharded(options);
+  }
+  else if (options.mode == "stealing") {
+    RunStealing(options);
+  }
+  else if (options.mode == "mapped") {
+    RunMapped(options);
+  }
+  else if (options.mode == "partitioned") {
+    RunPartitioned(options);
+  }
+  else if (options.mode == "follow") {
+    RunFollow(options);
+  }
+  else {
+    RunTwoPhase(options);
+  }
+
+  if (const auto peak = longlp::PeakResidentKilobytes(); peak > 0.0) {
+    fmt::print("Peak memory {:.1f}MB\n", peak / 1024.0);
   }
 }
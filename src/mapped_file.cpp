@@ -0,0 +1,167 @@
+// Copyright 2022 Long Le Phi. All rights reserved.
+// Use of this source code is governed by a MIT license that can be
+// found in the LICENSE file.
+
+#include "mapped_file.hpp"
+
+#include <algorithm>
+#include <utility>
+
+#if defined(_WIN32)
+#  ifndef WIN32_LEAN_AND_MEAN
+#    define WIN32_LEAN_AND_MEAN
+#  endif
+#  ifndef NOMINMAX
+#    define NOMINMAX
+#  endif
+#  include <windows.h>
+#else
+#  include <fcntl.h>
+#  include <sys/mman.h>
+#  include <sys/stat.h>
+#  include <unistd.h>
+#endif
+
+namespace longlp {
+  MappedFile::MappedFile(MappedFile&& other) noexcept {
+    *this = std::move(other);
+  }
+
+  auto MappedFile::operator=(MappedFile&& other) noexcept -> MappedFile& {
+    if (this != &other) {
+      Close();
+      std::swap(data_, other.data_);
+      std::swap(size_, other.size_);
+#if defined(_WIN32)
+      std::swap(file_handle_, other.file_handle_);
+      std::swap(mapping_handle_, other.mapping_handle_);
+#endif
+    }
+    return *this;
+  }
+
+  MappedFile::~MappedFile() {
+    Close();
+  }
+
+#if defined(_WIN32)
+  auto MappedFile::Open(const std::string& path) -> bool {
+    Close();
+
+    file_handle_ = CreateFileA(path.c_str(),
+                               GENERIC_READ,
+                               FILE_SHARE_READ,
+                               nullptr,
+                               OPEN_EXISTING,
+                               FILE_FLAG_SEQUENTIAL_SCAN,
+                               nullptr);
+    if (file_handle_ == INVALID_HANDLE_VALUE) {
+      file_handle_ = nullptr;
+      return false;
+    }
+
+    LARGE_INTEGER size{};
+    if (GetFileSizeEx(file_handle_, &size) == 0) {
+      Close();
+      return false;
+    }
+    // an empty file cannot be mapped, it is an empty view.
+    if (size.QuadPart == 0) {
+      return true;
+    }
+
+    mapping_handle_ =
+      CreateFileMappingA(file_handle_, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if (mapping_handle_ == nullptr) {
+      Close();
+      return false;
+    }
+
+    data_ = static_cast<const char*>(
+      MapViewOfFile(mapping_handle_, FILE_MAP_READ, 0, 0, 0));
+    if (data_ == nullptr) {
+      Close();
+      return false;
+    }
+    size_ = static_cast<size_t>(size.QuadPart);
+    return true;
+  }
+
+  void MappedFile::Close() {
+    if (data_ != nullptr) {
+      UnmapViewOfFile(data_);
+    }
+    if (mapping_handle_ != nullptr) {
+      CloseHandle(mapping_handle_);
+    }
+    if (file_handle_ != nullptr) {
+      CloseHandle(file_handle_);
+    }
+    data_           = nullptr;
+    size_           = 0;
+    mapping_handle_ = nullptr;
+    file_handle_    = nullptr;
+  }
+#else
+  auto MappedFile::Open(const std::string& path) -> bool {
+    Close();
+
+    const auto descriptor = open(path.c_str(), O_RDONLY);
+    if (descriptor < 0) {
+      return false;
+    }
+
+    struct stat status {};
+    if (fstat(descriptor, &status) != 0) {
+      close(descriptor);
+      return false;
+    }
+    // an empty file cannot be mapped, it is an empty view.
+    if (status.st_size == 0) {
+      close(descriptor);
+      return true;
+    }
+
+    const auto size = static_cast<size_t>(status.st_size);
+    auto* address =
+      mmap(nullptr, size, PROT_READ, MAP_PRIVATE, descriptor, 0);
+    // the mapping keeps its own reference to the file.
+    close(descriptor);
+    if (address == MAP_FAILED) {
+      return false;
+    }
+
+    // the file is read once from the beginning to the end.
+    madvise(address, size, MADV_SEQUENTIAL);
+    data_ = static_cast<const char*>(address);
+    size_ = size;
+    return true;
+  }
+
+  void MappedFile::Close() {
+    if (data_ != nullptr) {
+      munmap(const_cast<char*>(data_), size_);
+    }
+    data_ = nullptr;
+    size_ = 0;
+  }
+#endif
+
+  auto SplitAtLines(const std::string_view content, const size_t chunks)
+    -> std::vector<std::string_view> {
+    std::vector<std::string_view> result{};
+    const auto chunk_size = content.size() / std::max<size_t>(chunks, 1) + 1;
+
+    for (size_t begin = 0; begin < content.size();) {
+      auto end = std::min(begin + chunk_size, content.size());
+      if (end < content.size()) {
+        // extend the chunk to the end of its last line.
+        end = content.find('\n', end - 1);
+        end = end == std::string_view::npos ? content.size() : end + 1;
+      }
+      result.emplace_back(content.substr(begin, end - begin));
+      begin = end;
+    }
+    return result;
+  }
+}   // namespace longlp
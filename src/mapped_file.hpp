@@ -0,0 +1,49 @@
+// Copyright 2022 Long Le Phi. All rights reserved.
+// Use of this source code is governed by a MIT license that can be
+// found in the LICENSE file.
+
+#ifndef MAPPED_FILE_HPP_
+#define MAPPED_FILE_HPP_
+
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace longlp {
+  // A read-only memory mapping of a whole file.
+  class MappedFile {
+   public:
+    MappedFile() = default;
+    MappedFile(const MappedFile&)                    = delete;
+    auto operator=(const MappedFile&) -> MappedFile& = delete;
+    MappedFile(MappedFile&& other) noexcept;
+    auto operator=(MappedFile&& other) noexcept -> MappedFile&;
+    ~MappedFile();
+
+    // Map |path|, a previous mapping is released. Return false on failure.
+    auto Open(const std::string& path) -> bool;
+
+    void Close();
+
+    // the mapped content, empty if nothing is mapped.
+    auto View() const -> std::string_view {
+      return {data_, size_};
+    }
+
+   private:
+    const char* data_{nullptr};
+    size_t size_{0};
+#if defined(_WIN32)
+    void* file_handle_{nullptr};
+    void* mapping_handle_{nullptr};
+#endif
+  };
+
+  // Split |content| into at most |chunks| chunks of similar size. Every chunk
+  // ends right after a new line (or at the end of |content|), so no line is
+  // split between chunks.
+  auto SplitAtLines(std::string_view content, size_t chunks)
+    -> std::vector<std::string_view>;
+}   // namespace longlp
+
+#endif   // MAPPED_FILE_HPP_
@@ -0,0 +1,146 @@
+// Copyright 2022 Long Le Phi. All rights reserved.
+// Use of this source code is governed by a MIT license that can be
+// found in the LICENSE file.
+
+#include "metrics.hpp"
+
+#include <fmt/format.h>
+#include <deque>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <string_view>
+#include <utility>
+
+namespace longlp::metrics {
+  namespace {
+    constexpr std::array<std::string_view, kHistogramCount> kHistogramNames = {
+      "parse_ns",
+      "graph_ns",
+      "task_gap_ns",
+      "book_update_ns",
+      "write_ns",
+      "trade_run",
+      "book_depth"};
+
+    constexpr std::array<std::string_view, kCounterCount> kCounterNames = {
+      "books",
+      "trades",
+      "cancel_events",
+      "passive_events",
+      "aggressive_events",
+      "invalid_trades",
+      "bytes_written"};
+
+    // The metrics of every thread which has recorded something. A deque never
+    // moves its elements, thus the threads keep a pointer to their own.
+    struct Registry {
+      std::mutex mutex{};
+      std::deque<ThreadMetrics> threads{};
+    };
+
+    auto GlobalRegistry() -> Registry& {
+      static Registry registry{};
+      return registry;
+    }
+  }   // namespace
+
+  namespace detail {
+    auto RegisterThread() -> ThreadMetrics& {
+      auto& registry = GlobalRegistry();
+      const std::lock_guard lock{registry.mutex};
+      return registry.threads.emplace_back();
+    }
+  }   // namespace detail
+
+  auto TakeSnapshot() -> Snapshot {
+    Snapshot result{};
+
+    auto& registry = GlobalRegistry();
+    const std::lock_guard lock{registry.mutex};
+    for (const auto& thread : registry.threads) {
+      for (size_t i = 0; i < kHistogramCount; ++i) {
+        result.histograms[i].Merge(thread.histograms[i].Snapshot());
+      }
+      for (size_t i = 0; i < kCounterCount; ++i) {
+        result.counters[i] += thread.counters[i].Load();
+      }
+    }
+    result.threads = registry.threads.size();
+    return result;
+  }
+
+  void AppendSummary(const Snapshot& snapshot, std::string& output) {
+    auto out = std::back_inserter(output);
+    fmt::format_to(out, "Metrics of {} threads\n", snapshot.threads);
+    fmt::format_to(out,
+                   "{:<16}{:>12}{:>12}{:>12}{:>12}{:>12}\n",
+                   "histogram",
+                   "count",
+                   "p50",
+                   "p99",
+                   "p99.9",
+                   "max");
+    for (size_t i = 0; i < kHistogramCount; ++i) {
+      const auto& histogram = snapshot.histograms[i];
+      fmt::format_to(out,
+                     "{:<16}{:>12}{:>12}{:>12}{:>12}{:>12}\n",
+                     kHistogramNames.at(i),
+                     histogram.Count(),
+                     histogram.ValueAt(50.0),
+                     histogram.ValueAt(99.0),
+                     histogram.ValueAt(99.9),
+                     histogram.Max());
+    }
+
+    fmt::format_to(out, "{:<16}{:>12}\n", "counter", "value");
+    for (size_t i = 0; i < kCounterCount; ++i) {
+      fmt::format_to(out,
+                     "{:<16}{:>12}\n",
+                     kCounterNames.at(i),
+                     snapshot.counters[i]);
+    }
+  }
+
+  PeriodicDump::PeriodicDump(std::string path,
+                             const std::chrono::milliseconds interval) :
+    path_(std::move(path)),
+    interval_(interval) {
+    thread_ = std::thread{[this] { Run(); }};
+  }
+
+  PeriodicDump::~PeriodicDump() {
+    {
+      const std::lock_guard lock{mutex_};
+      stopping_ = true;
+    }
+    stopped_.notify_one();
+    thread_.join();
+  }
+
+  void PeriodicDump::Run() {
+    const auto temporary_path = path_ + ".tmp";
+
+    // the last dump is taken once stopped, so the file ends with the final
+    // values.
+    std::string summary{};
+    for (auto stopping = false; !stopping;) {
+      {
+        std::unique_lock lock{mutex_};
+        stopping =
+          stopped_.wait_for(lock, interval_, [this] { return stopping_; });
+      }
+
+      summary.clear();
+      AppendSummary(TakeSnapshot(), summary);
+
+      // replace the previous dump at once, a reader never sees a partial one.
+      {
+        std::ofstream file(temporary_path, std::ios::binary | std::ios::trunc);
+        file << summary;
+      }
+      std::error_code error{};
+      std::filesystem::rename(temporary_path, path_, error);
+    }
+  }
+}   // namespace longlp::metrics
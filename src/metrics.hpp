@@ -0,0 +1,219 @@
+// Copyright 2022 Long Le Phi. All rights reserved.
+// Use of this source code is governed by a MIT license that can be
+// found in the LICENSE file.
+
+#ifndef METRICS_HPP_
+#define METRICS_HPP_
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <type_traits>
+#include "latency_histogram.hpp"
+#include "longlp_config.hpp"
+
+// Hot path instrumentation, enabled at compile time with the
+// LONGLP_ENABLE_METRICS cmake option. Every thread records into its own
+// histograms and counters without any lock nor atomic read-modify-write, the
+// threads are merged only when a summary is taken. When the metrics are
+// disabled, the recording functions are empty and compiled out.
+namespace longlp::metrics {
+  // The recorded distributions, the stages are timed in nanoseconds.
+  enum class Histogram : size_t {
+    kParse      = 0,   // parsing a json line
+    kGraph      = 1,   // emplacing the task of a record into the flow graph
+    kTaskGap    = 2,   // idle time of an executor thread between two tasks
+    kBookUpdate = 3,   // classifying a book against the live book
+    kWrite      = 4,   // writing out the buffer of an output file
+    kTradeRun   = 5,   // number of trades between two books of a symbol
+    kBookDepth  = 6,   // number of levels of a side of a book
+  };
+
+  constexpr size_t kHistogramCount = 7;
+
+  enum class Counter : size_t {
+    kBooks            = 0,
+    kTrades           = 1,
+    kCancelEvents     = 2,
+    kPassiveEvents    = 3,
+    kAggressiveEvents = 4,
+    kInvalidTrades    = 5,
+    kBytesWritten     = 6,
+  };
+
+  constexpr size_t kCounterCount = 7;
+
+  // A counter which is incremented by a single thread and read by any thread.
+  class RelaxedCounter {
+   public:
+    RelaxedCounter() = default;
+
+    RelaxedCounter(const RelaxedCounter& other) : value_(other.Load()) {}
+
+    auto operator=(const RelaxedCounter& other) -> RelaxedCounter& {
+      value_.store(other.Load(), std::memory_order_relaxed);
+      return *this;
+    }
+
+    ~RelaxedCounter() = default;
+
+    void Add(const uint64_t count = 1) {
+      value_.store(Load() + count, std::memory_order_relaxed);
+    }
+
+    auto Load() const -> uint64_t {
+      return value_.load(std::memory_order_relaxed);
+    }
+
+   private:
+    std::atomic<uint64_t> value_{0};
+  };
+
+  // The counter of a disabled build, which keeps nothing.
+  class DisabledCounter {
+   public:
+    void Add(const uint64_t /*count*/ = 1) {}
+
+    auto Load() const -> uint64_t {
+      return 0;
+    }
+  };
+
+  // A counter owned by a per-symbol object, e.g. the messages of a worker.
+  using SymbolCounter = std::conditional_t<config::enable_metrics,
+                                           RelaxedCounter,
+                                           DisabledCounter>;
+
+  // The metrics recorded by a thread.
+  struct ThreadMetrics {
+    std::array<SharedLatencyHistogram, kHistogramCount> histograms{};
+    std::array<RelaxedCounter, kCounterCount> counters{};
+    // end of the last task run by the thread, 0 before the first one. It is
+    // only read by the thread itself.
+    uint64_t last_task_end{0};
+  };
+
+  // The metrics of every thread merged together.
+  struct Snapshot {
+    std::array<LatencyHistogram, kHistogramCount> histograms{};
+    std::array<uint64_t, kCounterCount> counters{};
+    size_t threads{0};
+  };
+
+  namespace detail {
+    // Return new metrics for the calling thread, which are kept until the
+    // end of the program.
+    auto RegisterThread() -> ThreadMetrics&;
+
+    inline thread_local ThreadMetrics* thread_metrics = nullptr;
+
+    inline auto Local() -> ThreadMetrics& {
+      if (thread_metrics == nullptr) {
+        thread_metrics = &RegisterThread();
+      }
+      return *thread_metrics;
+    }
+  }   // namespace detail
+
+  // monotonic time in nanoseconds.
+  inline auto Now() -> uint64_t {
+    return static_cast<uint64_t>(
+      std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch())
+        .count());
+  }
+
+  inline void Record(const Histogram histogram, const uint64_t value) {
+    if constexpr (config::enable_metrics) {
+      detail::Local().histograms[static_cast<size_t>(histogram)].Record(value);
+    }
+  }
+
+  inline void Count(const Counter counter, const uint64_t count = 1) {
+    if constexpr (config::enable_metrics) {
+      detail::Local().counters[static_cast<size_t>(counter)].Add(count);
+    }
+  }
+
+  // Record the duration of its scope into a histogram.
+  class ScopedTimer {
+   public:
+    explicit ScopedTimer(const Histogram histogram) :
+      histogram_(histogram),
+      start_(config::enable_metrics ? Now() : 0) {}
+
+    ScopedTimer(const ScopedTimer&)                    = delete;
+    auto operator=(const ScopedTimer&) -> ScopedTimer& = delete;
+
+    ~ScopedTimer() {
+      if constexpr (config::enable_metrics) {
+        Record(histogram_, Now() - start_);
+      }
+    }
+
+   private:
+    Histogram histogram_;
+    uint64_t start_;
+  };
+
+  // Mark the body of an executor task, the idle time of the thread since its
+  // previous task is recorded as the scheduling overhead.
+  class TaskScope {
+   public:
+    TaskScope() {
+      if constexpr (config::enable_metrics) {
+        const auto& local = detail::Local();
+        if (local.last_task_end != 0) {
+          Record(Histogram::kTaskGap, Now() - local.last_task_end);
+        }
+      }
+    }
+
+    TaskScope(const TaskScope&)                    = delete;
+    auto operator=(const TaskScope&) -> TaskScope& = delete;
+
+    ~TaskScope() {
+      if constexpr (config::enable_metrics) {
+        detail::Local().last_task_end = Now();
+      }
+    }
+  };
+
+  // Merge the metrics of every thread, the values being recorded
+  // concurrently may be missed.
+  auto TakeSnapshot() -> Snapshot;
+
+  // Append a human readable table of |snapshot| to |output|.
+  void AppendSummary(const Snapshot& snapshot, std::string& output);
+
+  // Write the summary of the metrics into a file every |interval| from a
+  // background thread, and once more when it is destroyed. Each dump
+  // replaces the previous one, so the file always holds a complete summary.
+  class PeriodicDump {
+   public:
+    PeriodicDump(std::string path, std::chrono::milliseconds interval);
+
+    PeriodicDump(const PeriodicDump&)                    = delete;
+    auto operator=(const PeriodicDump&) -> PeriodicDump& = delete;
+
+    ~PeriodicDump();
+
+   private:
+    void Run();
+
+    std::string path_;
+    std::chrono::milliseconds interval_;
+
+    std::mutex mutex_{};
+    std::condition_variable stopped_{};
+    bool stopping_{false};
+    std::thread thread_{};
+  };
+}   // namespace longlp::metrics
+
+#endif   // METRICS_HPP_
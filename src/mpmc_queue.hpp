@@ -0,0 +1,123 @@
+// Copyright 2022 Long Le Phi. All rights reserved.
+// Use of this source code is governed by a MIT license that can be
+// found in the LICENSE file.
+
+#ifndef MPMC_QUEUE_HPP_
+#define MPMC_QUEUE_HPP_
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+namespace longlp {
+  // A bounded lock-free queue for any number of producer and consumer
+  // threads (D. Vyukov's design): every slot has a sequence number which
+  // tells whether it is free for the push or ready for the pop of a given
+  // position, so the threads only contend on the head or tail counter.
+  // As SpscQueue, the slots are constructed once and reused.
+  template <typename T>
+  class MpmcQueue {
+   public:
+    // |capacity| is rounded up to the next power of two.
+    explicit MpmcQueue(size_t capacity) :
+      slots_(RoundUpToPowerOfTwo(capacity)),
+      mask_(slots_.size() - 1) {
+      for (size_t i = 0; i < slots_.size(); ++i) {
+        slots_[i].sequence.store(i, std::memory_order_relaxed);
+      }
+    }
+
+    MpmcQueue(const MpmcQueue&)                    = delete;
+    auto operator=(const MpmcQueue&) -> MpmcQueue& = delete;
+    MpmcQueue(MpmcQueue&&)                         = delete;
+    auto operator=(MpmcQueue&&) -> MpmcQueue&      = delete;
+    ~MpmcQueue()                                   = default;
+
+    // Fill the next free slot with |fill(T&)|.
+    // Return false if the queue is full.
+    template <typename Fill>
+    auto TryPush(Fill&& fill) -> bool {
+      auto tail = tail_.load(std::memory_order_relaxed);
+      for (;;) {
+        auto& slot          = slots_[tail & mask_];
+        const auto sequence = slot.sequence.load(std::memory_order_acquire);
+        const auto distance =
+          static_cast<intptr_t>(sequence) - static_cast<intptr_t>(tail);
+        if (distance == 0) {
+          if (tail_.compare_exchange_weak(tail,
+                                          tail + 1,
+                                          std::memory_order_relaxed)) {
+            std::forward<Fill>(fill)(slot.value);
+            slot.sequence.store(tail + 1, std::memory_order_release);
+            return true;
+          }
+        }
+        else if (distance < 0) {
+          // the slot still holds the message of the previous lap
+          return false;
+        }
+        else {
+          tail = tail_.load(std::memory_order_relaxed);
+        }
+      }
+    }
+
+    // Pass the oldest slot to |consume(T&)|, then release the slot.
+    // Return false if the queue is empty.
+    template <typename Consume>
+    auto TryPop(Consume&& consume) -> bool {
+      auto head = head_.load(std::memory_order_relaxed);
+      for (;;) {
+        auto& slot          = slots_[head & mask_];
+        const auto sequence = slot.sequence.load(std::memory_order_acquire);
+        const auto distance =
+          static_cast<intptr_t>(sequence) - static_cast<intptr_t>(head + 1);
+        if (distance == 0) {
+          if (head_.compare_exchange_weak(head,
+                                          head + 1,
+                                          std::memory_order_relaxed)) {
+            std::forward<Consume>(consume)(slot.value);
+            slot.sequence.store(head + slots_.size(),
+                                std::memory_order_release);
+            return true;
+          }
+        }
+        else if (distance < 0) {
+          // the slot has not been filled yet
+          return false;
+        }
+        else {
+          head = head_.load(std::memory_order_relaxed);
+        }
+      }
+    }
+
+    auto Capacity() const -> size_t { return slots_.size(); }
+
+   private:
+    static constexpr size_t kCacheLineSize = 64;
+
+    static auto RoundUpToPowerOfTwo(const size_t value) -> size_t {
+      size_t result = 1;
+      while (result < value) {
+        result <<= 1U;
+      }
+      return result;
+    }
+
+    struct Slot {
+      std::atomic<size_t> sequence{0};
+      T value{};
+    };
+
+    std::vector<Slot> slots_;
+    size_t mask_;
+
+    alignas(kCacheLineSize) std::atomic<size_t> head_{0};
+    alignas(kCacheLineSize) std::atomic<size_t> tail_{0};
+  };
+}   // namespace longlp
+
+#endif   // MPMC_QUEUE_HPP_
@@ -0,0 +1,46 @@
+// Copyright 2022 Long Le Phi. All rights reserved.
+// Use of this source code is governed by a MIT license that can be
+// found in the LICENSE file.
+
+#ifndef OBJECT_POOL_HPP_
+#define OBJECT_POOL_HPP_
+
+#include <cstddef>
+#include <utility>
+#include "spsc_queue.hpp"
+
+namespace longlp {
+  // A bounded pool which recycles the storage of objects (e.g. the vectors of
+  // an order book) from one releasing thread to one acquiring thread. Objects
+  // are exchanged with std::swap, so the pool never allocates after its
+  // construction.
+  template <typename T>
+  class ObjectPool {
+   public:
+    explicit ObjectPool(size_t capacity) : recycled_(capacity) {}
+
+    // Acquiring thread. Swap |object| with a recycled object.
+    // Return false if there is no recycled object, |object| is left as is.
+    auto Acquire(T& object) -> bool {
+      auto* recycled = recycled_.Front();
+      if (recycled == nullptr) {
+        return false;
+      }
+      std::swap(object, *recycled);
+      recycled_.Pop();
+      return true;
+    }
+
+    // Releasing thread. Hand the storage of |object| to the pool, |object|
+    // gets back an empty (or stale) object. If the pool is full, |object| is
+    // left as is.
+    auto Release(T& object) -> bool {
+      return recycled_.TryPush([&object](T& slot) { std::swap(slot, object); });
+    }
+
+   private:
+    SpscQueue<T> recycled_;
+  };
+}   // namespace longlp
+
+#endif   // OBJECT_POOL_HPP_
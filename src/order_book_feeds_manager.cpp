@@ -7,145 +7,1325 @@
 #include <fmt/core.h>
 #include <fmt/format.h>
 #include <algorithm>
+#include <deque>
+#include <filesystem>
 #include <fstream>
-#include <nlohmann/json.hpp>
+#include <future>
+#include <iterator>
+#include <limits>
+#include <system_error>
 #include <taskflow/taskflow.hpp>
+#include <utility>
+#include "binary_feed.hpp"
+#include "feed_parser.hpp"
+#include "followed_file.hpp"
+#include "latency_histogram.hpp"
+#include "mapped_file.hpp"
+#include "metrics.hpp"
 
 namespace longlp {
   namespace {
-    namespace json = nlohmann;
+    // Number of recycled books kept per symbol. A symbol rarely has more
+    // books in flight between its tasks and the parsing thread.
+    constexpr size_t kBookPoolCapacity = 64;
 
+    // Number of the busiest symbols listed in the metrics summary.
+    constexpr size_t kMetricsTopSymbols = 10;
+
+    // The output files of a symbol: <out_dir>/<symbol><suffix>.
+    constexpr std::string_view kEventsSuffix    = ".txt";
+    constexpr std::string_view kAnalyticsSuffix = ".analytics.csv";
+
+    // Whether one of |files| is a binary feed file, which is only replayed
+    // by the task flow of InitFeedsAndGenerateTaskFlow(). The error is
+    // printed.
+    auto HasBinaryFeedFile(const std::vector<std::string>& files) -> bool {
+      for (const auto& file : files) {
+        if (IsBinaryFeedFile(file)) {
+          fmt::print("Binary feeds are only replayed in the two-phase mode, "
+                     "{} cannot be read\n",
+                     file);
+          return true;
+        }
+      }
+      return false;
+    }
+
+    // The records of a chunk of the input, grouped by symbol in file order,
+    // with the symbols interned per chunk.
+    struct ChunkRecords {
+      // the records, then the number of books, by chunk identifier
+      std::vector<std::vector<FeedRecord>> symbols{};
+      std::vector<size_t> books{};
+      SymbolTable table{};
+      // the chunk stopped at an invalid line
+      bool failed{false};
+    };
+
+    // Parse every line of |chunk|, stop at the first invalid line.
+    void ParseChunk(const std::string_view chunk, ChunkRecords& result) {
+      FeedRecord record{};
+      for (size_t begin = 0; begin < chunk.size();) {
+        auto end = chunk.find('\n', begin);
+        end      = end == std::string_view::npos ? chunk.size() : end;
+
+        if (!ParseFeedLine(chunk.substr(begin, end - begin), record)) {
+          result.failed = true;
+          return;
+        }
+
+        auto inserted = false;
+        const auto id = result.table.Intern(record.symbol, inserted);
+        if (inserted) {
+          result.symbols.emplace_back();
+          result.books.push_back(0);
+        }
+        if (record.type == FeedRecord::Type::kBook) {
+          ++result.books[id];
+        }
+        result.symbols[id].emplace_back(std::move(record));
+        begin = end + 1;
+      }
+    }
+
+    // The records of a symbol of the run in every chunk, in file order.
+    struct SymbolChunks {
+      std::vector<std::vector<FeedRecord>*> chunks{};
+      size_t books{0};
+    };
+
+    // The records of a chunk of the input in file order, with the symbols
+    // interned per chunk. Then the position of the next record of every
+    // symbol in the partitioned records.
+    struct ChunkPartition {
+      std::vector<FeedRecord> records{};
+      // the chunk identifier of the symbol of every record
+      std::vector<SymbolId> symbols{};
+      SymbolTable table{};
+      // number of records, then next position, by chunk identifier
+      std::vector<size_t> counts{};
+      // number of books by chunk identifier
+      std::vector<size_t> books{};
+      // the chunk stopped at an invalid line
+      bool failed{false};
+    };
+
+    // Parse every line of |chunk|, stop at the first invalid line.
+    void ParsePartitionChunk(const std::string_view chunk,
+                             ChunkPartition& result) {
+      for (size_t begin = 0; begin < chunk.size();) {
+        auto end = chunk.find('\n', begin);
+        end      = end == std::string_view::npos ? chunk.size() : end;
+
+        auto& record = result.records.emplace_back();
+        if (!ParseFeedLine(chunk.substr(begin, end - begin), record)) {
+          result.records.pop_back();
+          result.failed = true;
+          return;
+        }
+
+        auto inserted = false;
+        const auto id = result.table.Intern(record.symbol, inserted);
+        if (inserted) {
+          result.counts.push_back(0);
+          result.books.push_back(0);
+        }
+        ++result.counts[id];
+        if (record.type == FeedRecord::Type::kBook) {
+          ++result.books[id];
+        }
+        result.symbols.push_back(id);
+        begin = end + 1;
+      }
+    }
+
+    // A segment of the records of a hot symbol, with the outputs of its
+    // books. The segments after the first one start from a copy of the last
+    // book of their previous segment, so every segment is classified in
+    // parallel by its own worker.
+    struct SymbolSegment {
+      std::vector<FeedRecord*> records{};
+      InstrumentFeedsWorker worker{};
+      std::string output{};
+    };
+
+    // Split the records of |symbol| into segments of |segment_books| books,
+    // appended to |segments|. Return the number of segments, 0 if the
+    // symbol has too few books to be split.
+    auto SplitIntoSegments(const SymbolChunks& symbol,
+                           const size_t segment_books,
+                           std::deque<SymbolSegment>& segments) -> size_t {
+      if (symbol.books <= segment_books) {
+        return 0;
+      }
+
+      const auto first = segments.size();
+      auto* segment    = &segments.emplace_back();
+      size_t books     = 0;
+      for (auto* symbol_records : symbol.chunks) {
+        for (auto& record : *symbol_records) {
+          segment->records.push_back(&record);
+          if (record.type != FeedRecord::Type::kBook ||
+              ++books < segment_books) {
+            continue;
+          }
+
+          // the last book of a segment is the start of the next one, it is
+          // copied before its storage is swapped by the classification.
+          books   = 0;
+          segment = &segments.emplace_back();
+          segment->worker.StartFrom(record.book);
+        }
+      }
+      if (segment->records.empty()) {
+        segments.pop_back();
+      }
+
+      const auto count = segments.size() - first;
+      if (count == 1) {
+        segments.pop_back();
+        return 0;
+      }
+      return count;
+    }
+
+    // Classify the next |record| of a symbol with its |worker|, appending the
+    // outputs to |output|. |has_book| is set once the worker has a live book,
+    // the trades before are ignored.
+    void ClassifyRecord(FeedRecord& record,
+                        InstrumentFeedsWorker& worker,
+                        bool& has_book,
+                        std::string& output) {
+      if (record.type == FeedRecord::Type::kBook) {
+        has_book = true;
+        worker.UpdateBookChanges(record.book, output);
+      }
+      else if (has_book) {
+        worker.RecordNewTrade(record.trade);
+      }
+      else {
+        fmt::print("There is no book recorded with symbol {}\n",
+                   record.symbol);
+      }
+    }
+
+    // Read the lines of json files one after the other.
+    class JsonLinesReader {
+     public:
+      explicit JsonLinesReader(const std::vector<std::string>& files) :
+        files_(files) {}
+
+      // Leave the last line of the last file if it has no line feed, e.g. a
+      // capture which is still being written is cut in the middle of a line.
+      void StopBeforeCutLine() {
+        stop_before_cut_line_ = true;
+      }
+
+      // Read the next line into |line|. Return false after the last line of
+      // the last file, or if a file cannot be opened.
+      auto Next(std::string& line) -> bool {
+        while (!stream_.is_open() || !std::getline(stream_, line)) {
+          if (next_file_ == files_.size()) {
+            return false;
+          }
+
+          stream_.close();
+          stream_.open(files_[next_file_]);
+          ++next_file_;
+          line_number_ = 0;
+          offset_      = 0;
+          if (!stream_.is_open()) {
+            fmt::print("Cannot open {}", File());
+            return false;
+          }
+        }
+        // the last line of a file may have no line feed.
+        if (stream_.eof() && stop_before_cut_line_ &&
+            next_file_ == files_.size()) {
+          return false;
+        }
+        ++line_number_;
+        offset_ += line.size() + (stream_.eof() ? 0U : 1U);
+        return true;
+      }
+
+      // the position of the next line to read.
+      auto Position() const -> InputPosition {
+        if (next_file_ == 0) {
+          return {};
+        }
+        return {static_cast<uint32_t>(next_file_ - 1), offset_, line_number_};
+      }
+
+      // Continue from |position| of a previous read of the same files.
+      // Return false if the file is shorter or cannot be opened.
+      auto Seek(const InputPosition& position) -> bool {
+        if (position.file >= files_.size()) {
+          return false;
+        }
+
+        stream_.close();
+        stream_.open(files_[position.file]);
+        next_file_   = position.file + 1U;
+        line_number_ = position.line;
+        offset_      = position.offset;
+        if (!stream_.is_open()) {
+          fmt::print("Cannot open {}\n", File());
+          return false;
+        }
+
+        std::error_code error{};
+        const auto size = std::filesystem::file_size(File(), error);
+        if (error || size < offset_) {
+          fmt::print("{} is shorter than its checkpoint\n", File());
+          return false;
+        }
+        stream_.seekg(static_cast<std::streamoff>(offset_));
+        return true;
+      }
+
+      // the file and the line number of the last line
+      auto File() const -> const std::string& {
+        return files_[next_file_ - 1];
+      }
+
+      auto LineNumber() const -> size_t {
+        return line_number_;
+      }
+
+     private:
+      const std::vector<std::string>& files_;
+      size_t next_file_{0};
+      size_t line_number_{0};
+      // byte offset of the next line in the file
+      uint64_t offset_{0};
+      std::ifstream stream_{};
+      bool stop_before_cut_line_{false};
+    };
   }   // namespace
 
   void OrderBookFeedsManager::InitFeedsAndGenerateTaskFlow(
-    const std::string& json_file,
+    const std::vector<std::string>& files,
     std::string_view out_dir) {
-    std::ifstream opener(json_file);
-    if (!opener.is_open()) {
-      fmt::print("Cannot open {}", json_file);
+    ResetChannels();
+    flow_ = std::make_unique<tf::Taskflow>();
+
+    // the tasks of a symbol are chained across the files.
+    PrevTaskList prev_task{};
+    for (const auto& file : files) {
+      const auto emplaced =
+        IsBinaryFeedFile(file)
+          ? EmplaceBinaryFeedTasks(file, out_dir, prev_task)
+          : EmplaceJsonFeedTasks(file, out_dir, prev_task);
+      if (!emplaced) {
+        return;
+      }
+    }
+  }
+
+  void OrderBookFeedsManager::RunTaskFlow(const size_t threads) {
+    if (flow_ == nullptr || flow_->empty()) {
+      fmt::print("No flow task declared\n");
       return;
     }
 
-    workers_ = std::make_unique<WorkerList>();
-    writers_ = std::make_unique<WriterList>();
-    flow_    = std::make_unique<tf::Taskflow>();
+    executor_ = std::make_unique<tf::Executor>(threads);
+    executor_->run(*flow_).wait();
+    FinishWriters();
+  }
+
+  auto OrderBookFeedsManager::StreamFeeds(
+    const std::vector<std::string>& json_files,
+    std::string_view out_dir,
+    const size_t threads,
+    const size_t batch_lines) -> StreamingReport {
+    using Clock      = std::chrono::steady_clock;
+    const auto start = Clock::now();
 
-    // record the previous task for setting up the flow graph.
-    std::map<std::string /* symbol */, tf::Task> prev_task{};
+    StreamingReport report{};
+    if (HasBinaryFeedFile(json_files)) {
+      return report;
+    }
+    JsonLinesReader reader{json_files};
 
+    ResetChannels();
+    if (checkpoints_ != nullptr && consolidated_output_ != nullptr) {
+      fmt::print("The checkpoints do not support the consolidated output\n");
+      return report;
+    }
+    if (checkpoints_ != nullptr && analytics_output_ != nullptr) {
+      fmt::print("The checkpoints do not support the analytics\n");
+      return report;
+    }
+    // the checkpoint is at the last complete line, the cut line is read by
+    // the run which resumes once the capture is complete.
+    if (checkpoints_ != nullptr) {
+      reader.StopBeforeCutLine();
+    }
+    if (checkpoints_ != nullptr && checkpoints_->resume) {
+      Checkpoint checkpoint{};
+      if (!LoadCheckpoint(checkpoints_->path, checkpoint) ||
+          checkpoint.inputs != json_files) {
+        fmt::print("Cannot resume from {}\n", checkpoints_->path);
+        return report;
+      }
+      for (const auto& symbol : checkpoint.symbols) {
+        if (!RestoreChannel(symbol, out_dir)) {
+          fmt::print("Cannot restore the output of {}\n", symbol.symbol);
+          return report;
+        }
+      }
+      if (!reader.Seek(checkpoint.position)) {
+        return report;
+      }
+      report.resumed_lines = checkpoint.lines;
+    }
+    executor_ = std::make_unique<tf::Executor>(threads);
+
+    // the flow which is running on the executor while |flow_| is filled.
+    std::unique_ptr<tf::Taskflow> running_flow{nullptr};
+    std::future<void> running{};
+
+    // Wait for the running batch then write out its outputs. Every task of
+    // the previous batches is done after that, thus the per-symbol order is
+    // preserved across batches.
+    const auto wait_running_batch = [&] {
+      if (!running.valid()) {
+        return;
+      }
+      running.wait();
+      running = {};
+      FlushWriters();
+      ++report.batches;
+    };
+
+    // Write a checkpoint at the position of the reader. The first book of a
+    // new symbol is classified while parsing, so the running batch is
+    // waited for before the next one is parsed. The outputs are written out
+    // up to the sizes of the checkpoint.
+    size_t checkpoint_lines = 0;
+    const auto save_checkpoint = [&] {
+      wait_running_batch();
+      FinishWriters();
+      checkpoint_lines = report.lines;
+      if (!SaveStreamingCheckpoint(json_files,
+                                   reader.Position(),
+                                   report.resumed_lines + report.lines)) {
+        fmt::print("Cannot write the checkpoint {}\n", checkpoints_->path);
+        return;
+      }
+      ++report.checkpoints;
+    };
+
+    PrevTaskList prev_task{};
     std::string line{};
-    for (auto i = 1; std::getline(opener, line); ++i) {
-      const auto& record_json = json::json::parse(line, nullptr, false);
+    auto failed = false;
+    for (auto parsing = true; parsing;) {
+      if (checkpoints_ != nullptr &&
+          report.lines - checkpoint_lines >= checkpoints_->interval_lines) {
+        save_checkpoint();
+      }
 
-      if (record_json.is_discarded()) {
-        fmt::print("parse {} error at line {}", json_file, i);
+      flow_ = std::make_unique<tf::Taskflow>();
+      prev_task.clear();
+
+      auto lines = 0U;
+      for (; lines < batch_lines; ++lines) {
+        if (!reader.Next(line)) {
+          parsing = false;
+          break;
+        }
+
+        ++report.lines;
+        if (!EmplaceFeedTask(line, out_dir, prev_task)) {
+          fmt::print("parse {} error at line {}",
+                     reader.File(),
+                     reader.LineNumber());
+          parsing = false;
+          failed  = true;
+          break;
+        }
+      }
+
+      wait_running_batch();
+      running_flow = std::move(flow_);
+      running      = executor_->run(*running_flow);
+    }
+
+    wait_running_batch();
+    FinishWriters();
+    // the next run continues after the last line, e.g. once more lines are
+    // appended to the capture.
+    if (checkpoints_ != nullptr && !failed) {
+      save_checkpoint();
+    }
+    report.first_output = first_flush_.Since(start);
+    return report;
+  }
+
+  template <typename Engine>
+  void OrderBookFeedsManager::PushFeeds(
+    const std::vector<std::string>& json_files,
+    std::string_view out_dir,
+    Engine& engine) {
+    if (HasBinaryFeedFile(json_files)) {
+      return;
+    }
+    JsonLinesReader reader{json_files};
+    FeedRecord record{};
+    for (std::string line{}; reader.Next(line);) {
+      if (!ParseFeedLine(line, record)) {
+        fmt::print("parse {} error at line {}",
+                   reader.File(),
+                   reader.LineNumber());
+        break;
+      }
+
+      auto created       = false;
+      const auto channel = record.type == FeedRecord::Type::kBook
+                           ? CreateChannel(record.symbol, out_dir, created)
+                           : FindChannel(record.symbol);
+      if (channel.worker == nullptr) {
+        fmt::print("There is no book recorded with symbol {}\n",
+                   record.symbol);
+        continue;
+      }
+
+      engine.Push(channel.id, *channel.worker, channel.writer, record);
+    }
+  }
+
+  auto OrderBookFeedsManager::RunShardedFeeds(
+    const std::vector<std::string>& json_files,
+    std::string_view out_dir,
+    const size_t shards,
+    const size_t queue_capacity) -> ShardedRunReport {
+    ResetChannels();
+
+    ShardedFeedsEngine engine{shards, queue_capacity};
+    PushFeeds(json_files, out_dir, engine);
+
+    const auto report = engine.Stop();
+    FinishWriters();
+    return report;
+  }
+
+  auto OrderBookFeedsManager::RunStealingFeeds(
+    const std::vector<std::string>& json_files,
+    std::string_view out_dir,
+    const StealingOptions& options) -> StealingRunReport {
+    ResetChannels();
+
+    StealingFeedsEngine engine{options};
+    PushFeeds(json_files, out_dir, engine);
+
+    const auto report = engine.Stop();
+    FinishWriters();
+    return report;
+  }
+
+  void OrderBookFeedsManager::RunMappedFeeds(
+    const std::vector<std::string>& json_files,
+    std::string_view out_dir,
+    const size_t threads,
+    const size_t chunks,
+    const size_t segment_books) {
+    if (HasBinaryFeedFile(json_files)) {
+      return;
+    }
+    // the chunks of every file in file order, with the index of their file.
+    std::vector<MappedFile> files(json_files.size());
+    std::vector<std::string_view> chunk_views{};
+    std::vector<size_t> chunk_files{};
+    for (auto i = 0U; i < files.size(); ++i) {
+      if (!files[i].Open(json_files[i])) {
+        fmt::print("Cannot open {}", json_files[i]);
         return;
       }
 
-      // Detected a order book record
-      if (record_json.contains("book")) {
-        const auto& book_json = record_json["book"];
-        const auto& symbol    = book_json["symbol"].get<std::string>();
-
-        OrderBookRecord book{};
-        for (const auto& bid : book_json["bid"]) {
-          book.bids.emplace_back(Level{bid["count"].get<double>(),
-                                       bid["quantity"].get<double>(),
-                                       bid["price"].get<double>()});
-        }
-
-        for (const auto& ask : book_json["ask"]) {
-          book.asks.emplace_back(Level{ask["count"].get<double>(),
-                                       ask["quantity"].get<double>(),
-                                       ask["price"].get<double>()});
-        }
-
-        if (workers_->find(symbol) == workers_->end()) {
-          // Whenever detected a new symbol, we should create a new worker and
-          // writer synchronously for thread safety in data writting.
-          auto writer_it = writers_->try_emplace(symbol, std::ofstream{}).first;
-          writer_it->second.open(fmt::format("{out_dir}/{symbol}.txt",
-                                             fmt::arg("out_dir", out_dir),
-                                             fmt::arg("symbol", symbol)));
-          UpdateBookChangesUnsafe(symbol,
-                                  std::make_unique<OrderBookRecord>(book));
-        }
-        else {
-          // Setup the task and create the dependency on the previous one with
-          // the same symbol
-          auto task = flow_->emplace([this, symbol, book] {
-            UpdateBookChangesUnsafe(symbol,
-                                    std::make_unique<OrderBookRecord>(book));
-          });
-
-          // the new task should be run after the previous one
-          if (auto prev_it = prev_task.find(symbol);
-              prev_it != prev_task.end()) {
-            task.succeed(prev_it->second);
+      for (const auto view : SplitAtLines(files[i].View(), chunks)) {
+        chunk_views.push_back(view);
+        chunk_files.push_back(i);
+      }
+    }
+
+    ResetChannels();
+    executor_ = std::make_unique<tf::Executor>(threads);
+
+    // Parse the chunks of all the files in parallel
+    std::vector<ChunkRecords> chunk_records(chunk_views.size());
+    flow_ = std::make_unique<tf::Taskflow>();
+    for (auto i = 0U; i < chunk_views.size(); ++i) {
+      flow_->emplace([view = chunk_views[i], &records = chunk_records[i]] {
+        ParseChunk(view, records);
+      });
+    }
+    executor_->run(*flow_).wait();
+
+    // As the sequential parsing, the lines after the first invalid one are
+    // ignored.
+    auto valid_chunks = chunk_records.size();
+    for (auto i = 0U; i < chunk_records.size(); ++i) {
+      if (chunk_records[i].failed) {
+        fmt::print("parse {} error in chunk {}\n",
+                   json_files[chunk_files[i]],
+                   i);
+        valid_chunks = i + 1;
+        break;
+      }
+    }
+    chunk_records.resize(valid_chunks);
+
+    // Gather the records of every symbol across the chunks, in the order of
+    // their first record.
+    SymbolTable run_symbols{};
+    std::vector<SymbolChunks> symbol_chunks{};
+    for (auto& records : chunk_records) {
+      for (SymbolId id = 0; id < records.table.Size(); ++id) {
+        auto inserted = false;
+        const auto run_id =
+          run_symbols.Intern(records.table.Name(id), inserted);
+        if (inserted) {
+          symbol_chunks.emplace_back();
+        }
+        symbol_chunks[run_id].chunks.push_back(&records.symbols[id]);
+        symbol_chunks[run_id].books += records.books[id];
+      }
+    }
+
+    // Create the channels synchronously, then analyze each symbol in parallel
+    flow_ = std::make_unique<tf::Taskflow>();
+    std::deque<SymbolSegment> segments{};
+    for (SymbolId run_id = 0; run_id < run_symbols.Size(); ++run_id) {
+      const auto& symbol = symbol_chunks[run_id];
+      // as the sequential parsing, a symbol without book has no channel
+      // and each of its trades is reported.
+      if (symbol.books == 0) {
+        for (const auto* records : symbol.chunks) {
+          for (const auto& record : *records) {
+            fmt::print("There is no book recorded with symbol {}\n",
+                       record.symbol);
           }
-          prev_task[symbol] = task;
         }
+        continue;
+      }
+
+      auto created       = false;
+      const auto channel =
+        CreateChannel(run_symbols.Name(run_id), out_dir, created);
 
+      // a hot symbol is classified by segments in parallel, then their
+      // outputs are written in order. The analytics of a symbol are
+      // recorded in order by its own worker, so it is not split.
+      const auto count =
+        segment_books == 0 || analytics_output_ != nullptr
+          ? 0
+          : SplitIntoSegments(symbol, segment_books, segments);
+      if (count > 0) {
+        const auto first = segments.size() - count;
+        auto join = flow_->emplace([channel, &segments, first, count] {
+          for (auto i = first; i < first + count; ++i) {
+            channel.writer->Append(segments[i].output);
+            if (i != first) {
+              channel.worker->ContinueWith(segments[i].worker);
+            }
+          }
+        });
+        for (auto i = first; i < first + count; ++i) {
+          auto& worker = i == first ? *channel.worker : segments[i].worker;
+          flow_
+            ->emplace([&segment = segments[i], &worker, i, first] {
+              const metrics::TaskScope task_scope{};
+              auto has_book = i != first;
+              for (auto* record : segment.records) {
+                ClassifyRecord(*record, worker, has_book, segment.output);
+              }
+            })
+            .precede(join);
+        }
         continue;
       }
 
-      // Detected a trade record
-      if (record_json.contains("trade")) {
-        const auto& trade_json = record_json["trade"];
-        const auto& symbol     = trade_json["symbol"].get<std::string>();
+      flow_->emplace([channel, &symbol] {
+        const metrics::TaskScope task_scope{};
+        auto has_book = false;
+        for (auto* records : symbol.chunks) {
+          for (auto& record : *records) {
+            ClassifyRecord(record,
+                           *channel.worker,
+                           has_book,
+                           channel.writer->Buffer());
+            channel.writer->FlushIfFull();
+          }
+        }
+      });
+    }
+    executor_->run(*flow_).wait();
+    FinishWriters();
+  }
+
+  void OrderBookFeedsManager::RunPartitionedFeeds(
+    const std::vector<std::string>& json_files,
+    std::string_view out_dir,
+    const size_t threads,
+    const size_t chunks) {
+    if (HasBinaryFeedFile(json_files)) {
+      return;
+    }
+    // the chunks of every file in file order
+    std::vector<MappedFile> files(json_files.size());
+    std::vector<ChunkPartition> partitions{};
+    std::vector<std::string_view> chunk_views{};
+    for (auto i = 0U; i < files.size(); ++i) {
+      if (!files[i].Open(json_files[i])) {
+        fmt::print("Cannot open {}", json_files[i]);
+        return;
+      }
 
-        TradeRecord trade{};
-        trade.price    = trade_json["price"].get<double>();
-        trade.quantity = trade_json["quantity"].get<double>();
+      for (const auto view : SplitAtLines(files[i].View(), chunks)) {
+        chunk_views.push_back(view);
+      }
+    }
 
-        // Setup the task and create the dependency on the previous one with
-        // the same symbol
-        auto task = flow_->emplace([this, symbol, trade] {
-          RecordNewTradeUnsafe(symbol, std::make_unique<TradeRecord>(trade));
+    ResetChannels();
+    executor_ = std::make_unique<tf::Executor>(threads);
+
+    // Parse the chunks in parallel
+    partitions.resize(chunk_views.size());
+    flow_ = std::make_unique<tf::Taskflow>();
+    for (auto i = 0U; i < chunk_views.size(); ++i) {
+      flow_->emplace([view = chunk_views[i], &partition = partitions[i]] {
+        ParsePartitionChunk(view, partition);
+      });
+    }
+    executor_->run(*flow_).wait();
+
+    // As the sequential parsing, the lines after the first invalid one are
+    // ignored.
+    for (auto i = 0U; i < partitions.size(); ++i) {
+      if (partitions[i].failed) {
+        fmt::print("parse error in chunk {}\n", i);
+        partitions.resize(i + 1);
+        break;
+      }
+    }
+
+    // Intern the symbols of the chunks in file order with their number of
+    // books across the chunks.
+    SymbolTable run_symbols{};
+    std::vector<size_t> run_books{};
+    std::vector<std::vector<SymbolId>> run_ids(partitions.size());
+    for (auto i = 0U; i < partitions.size(); ++i) {
+      const auto& partition = partitions[i];
+      for (SymbolId id = 0; id < partition.table.Size(); ++id) {
+        auto inserted = false;
+        const auto run_id =
+          run_symbols.Intern(partition.table.Name(id), inserted);
+        if (inserted) {
+          run_books.push_back(0);
+        }
+        run_books[run_id] += partition.books[id];
+        run_ids[i].push_back(run_id);
+      }
+    }
+
+    // Then lay out the records of every symbol contiguously: the records of
+    // a symbol in a chunk start after those of the previous chunks. As the
+    // sequential parsing, a symbol without book has no channel and each of
+    // its trades is reported.
+    constexpr auto kNoChannel = std::numeric_limits<SymbolId>::max();
+    std::vector<Channel> channels{};
+    std::vector<size_t> symbol_ends{};
+    std::vector<std::vector<SymbolId>> chunk_ids(partitions.size());
+    for (auto i = 0U; i < partitions.size(); ++i) {
+      auto& partition = partitions[i];
+      for (SymbolId id = 0; id < partition.table.Size(); ++id) {
+        if (run_books[run_ids[i][id]] == 0) {
+          for (size_t j = 0; j < partition.counts[id]; ++j) {
+            fmt::print("There is no book recorded with symbol {}\n",
+                       partition.table.Name(id));
+          }
+          chunk_ids[i].push_back(kNoChannel);
+          continue;
+        }
+
+        auto created       = false;
+        const auto channel =
+          CreateChannel(partition.table.Name(id), out_dir, created);
+        if (created) {
+          channels.push_back(channel);
+          symbol_ends.push_back(0);
+        }
+        chunk_ids[i].push_back(channel.id);
+
+        // the count becomes the position of the first record in the symbol
+        const auto count     = partition.counts[id];
+        partition.counts[id] = symbol_ends[channel.id];
+        symbol_ends[channel.id] += count;
+      }
+    }
+    size_t total = 0;
+    for (auto& end : symbol_ends) {
+      total += end;
+      end = total;
+    }
+
+    // Move the records to their symbol in parallel
+    std::vector<FeedRecord> records(total);
+    flow_ = std::make_unique<tf::Taskflow>();
+    for (auto i = 0U; i < partitions.size(); ++i) {
+      flow_->emplace([&partition = partitions[i],
+                      &ids = chunk_ids[i],
+                      &symbol_ends,
+                      &records] {
+        for (auto j = 0U; j < partition.records.size(); ++j) {
+          const auto id = partition.symbols[j];
+          if (ids[id] == kNoChannel) {
+            continue;
+          }
+          const auto begin = ids[id] == 0 ? 0 : symbol_ends[ids[id] - 1];
+          records[begin + partition.counts[id]++] =
+            std::move(partition.records[j]);
+        }
+        partition.records = {};
+      });
+    }
+    executor_->run(*flow_).wait();
+
+    // Analyze each symbol in one task, with no dependency between the tasks
+    flow_ = std::make_unique<tf::Taskflow>();
+    for (SymbolId id = 0; id < channels.size(); ++id) {
+      const auto begin = id == 0 ? 0 : symbol_ends[id - 1];
+      flow_->emplace(
+        [channel = channels[id], &records, begin, end = symbol_ends[id]] {
+          const metrics::TaskScope task_scope{};
+          auto has_book = false;
+          for (auto i = begin; i < end; ++i) {
+            ClassifyRecord(records[i],
+                           *channel.worker,
+                           has_book,
+                           channel.writer->Buffer());
+            channel.writer->FlushIfFull();
+          }
         });
+    }
+    executor_->run(*flow_).wait();
+    FinishWriters();
+  }
+
+  auto OrderBookFeedsManager::FollowFeeds(const std::string& json_file,
+                                          std::string_view out_dir,
+                                          const FollowOptions& options)
+    -> FollowReport {
+    using Clock = std::chrono::steady_clock;
 
-        // the new task should be run after the previous one
-        if (auto prev_it = prev_task.find(symbol); prev_it != prev_task.end()) {
-          task.succeed(prev_it->second);
+    FollowReport report{};
+    FollowedFile file{};
+    if (HasBinaryFeedFile({json_file})) {
+      return report;
+    }
+    if (!file.Open(json_file)) {
+      fmt::print("Cannot open {}", json_file);
+      return report;
+    }
+
+    ResetChannels();
+
+    // the writers which have buffered outputs, and the read time of the
+    // lines whose outputs are in these buffers.
+    std::vector<OutputFile*> dirty_writers{};
+    std::vector<Clock::time_point> pending_reads{};
+    LatencyHistogram latencies{};
+
+    const auto flush = [&] {
+      for (auto* writer : dirty_writers) {
+        writer->Flush();
+      }
+      dirty_writers.clear();
+
+      const auto now = Clock::now();
+      for (const auto read : pending_reads) {
+        const auto latency = now - read;
+        latencies.Record(static_cast<uint64_t>(
+          std::chrono::duration_cast<std::chrono::nanoseconds>(latency)
+            .count()));
+        if (latency > options.flush_budget) {
+          ++report.over_budget;
         }
-        prev_task[symbol] = task;
+      }
+      report.output_lines += pending_reads.size();
+      pending_reads.clear();
+    };
+
+    const auto process_line = [&](const std::string_view line,
+                                  const Clock::time_point read) {
+      ++report.lines;
+      if (!ParseFeedLine(line, record_)) {
+        // a live feed goes on, only the invalid line is skipped.
+        fmt::print("parse {} error at line {}\n", json_file, report.lines);
+        return;
+      }
 
+      auto created       = false;
+      const auto channel = record_.type == FeedRecord::Type::kBook
+                           ? CreateChannel(record_.symbol, out_dir, created)
+                           : FindChannel(record_.symbol);
+      if (channel.worker == nullptr) {
+        fmt::print("There is no book recorded with symbol {}\n",
+                   record_.symbol);
+        return;
+      }
+
+      if (record_.type == FeedRecord::Type::kTrade) {
+        channel.worker->RecordNewTrade(record_.trade);
+        return;
+      }
+
+      auto& output    = channel.writer->Buffer();
+      const auto size = output.size();
+      channel.worker->UpdateBookChanges(record_.book, output);
+      if (output.size() == size) {
+        return;
+      }
+      // every buffer is empty after a flush.
+      if (size == 0) {
+        dirty_writers.push_back(channel.writer);
+      }
+      pending_reads.push_back(read);
+    };
+
+    const auto stopped = [&options] {
+      return options.stop != nullptr &&
+             options.stop->load(std::memory_order_relaxed);
+    };
+
+    // the bytes read after the last complete line, a line which is being
+    // written is kept until its end is read.
+    std::string buffer{};
+    auto last_growth = Clock::now();
+    while (!stopped()) {
+      const auto count = file.ReadSome(buffer);
+      const auto now   = Clock::now();
+      if (count == 0) {
+        if (options.idle_timeout.count() > 0 &&
+            now - last_growth >= options.idle_timeout) {
+          break;
+        }
+        file.WaitForGrowth(options.poll_interval);
         continue;
       }
+      last_growth = now;
 
-      fmt::print("Invalid json line {}", i);
-      return;
+      size_t begin = 0;
+      for (auto end = buffer.find('\n'); end != std::string::npos;
+           end      = buffer.find('\n', begin)) {
+        process_line(std::string_view{buffer}.substr(begin, end - begin), now);
+        begin = end + 1;
+      }
+      buffer.erase(0, begin);
+
+      // Write out at once when the end of the file is reached, otherwise
+      // keep batching the burst for at most half of the budget.
+      if (!pending_reads.empty() &&
+          (count < FollowedFile::kReadBytes ||
+           Clock::now() - pending_reads.front() >= options.flush_budget / 2)) {
+        flush();
+      }
     }
+    flush();
+    FinishWriters();
+
+    const auto to_duration = [](const uint64_t nanoseconds) {
+      return std::chrono::nanoseconds{static_cast<int64_t>(nanoseconds)};
+    };
+    report.p50_latency = to_duration(latencies.ValueAt(50.0));
+    report.p99_latency = to_duration(latencies.ValueAt(99.0));
+    report.max_latency = to_duration(latencies.Max());
+    return report;
   }
 
-  void OrderBookFeedsManager::RunTaskFlow(const size_t threads) {
-    if (flow_ == nullptr || flow_->empty()) {
-      fmt::print("No flow task declared\n");
+  auto OrderBookFeedsManager::MetricsSummary() const -> std::string {
+    std::string result{};
+    metrics::AppendSummary(metrics::TakeSnapshot(), result);
+    if (workers_ == nullptr || workers_->empty()) {
+      return result;
+    }
+
+    std::vector<SymbolId> ids(workers_->size());
+    for (SymbolId id = 0; id < ids.size(); ++id) {
+      ids[id] = id;
+    }
+    const auto top = std::min(kMetricsTopSymbols, ids.size());
+    std::partial_sort(ids.begin(),
+                      ids.begin() + static_cast<ptrdiff_t>(top),
+                      ids.end(),
+                      [this](const SymbolId lhs, const SymbolId rhs) {
+                        return (*workers_)[lhs].Messages() >
+                               (*workers_)[rhs].Messages();
+                      });
+
+    fmt::format_to(std::back_inserter(result),
+                   "{:<16}{:>12}\n",
+                   "symbol",
+                   "messages");
+    for (auto i = 0U; i < top; ++i) {
+      fmt::format_to(std::back_inserter(result),
+                     "{:<16}{:>12}\n",
+                     symbols_->Name(ids[i]),
+                     (*workers_)[ids[i]].Messages());
+    }
+    return result;
+  }
+
+  void OrderBookFeedsManager::StartIngest(IngestOptions options) {
+    // a previous ingest is drained by its destructor
+    ingest_ = std::make_unique<IngestEngine>(std::move(options));
+  }
+
+  auto OrderBookFeedsManager::RegisterSymbol(const std::string_view symbol)
+    -> SymbolId {
+    if (ingest_ == nullptr) {
+      return kInvalidSymbolId;
+    }
+    return ingest_->RegisterSymbol(symbol);
+  }
+
+  auto OrderBookFeedsManager::Submit(const SymbolId symbol,
+                                     OrderBookRecord& book) -> bool {
+    return ingest_ != nullptr && ingest_->Submit(symbol, book);
+  }
+
+  auto OrderBookFeedsManager::Submit(const SymbolId symbol,
+                                     const TradeRecord& trade) -> bool {
+    return ingest_ != nullptr && ingest_->Submit(symbol, trade);
+  }
+
+  auto OrderBookFeedsManager::StopIngest() -> IngestReport {
+    if (ingest_ == nullptr) {
+      return {};
+    }
+    const auto report = ingest_->Stop();
+    ingest_.reset();
+    return report;
+  }
+
+  void OrderBookFeedsManager::ResetChannels() {
+    symbols_   = std::make_unique<SymbolTable>();
+    workers_   = std::make_unique<WorkerList>();
+    writers_   = std::make_unique<WriterList>();
+    pools_     = std::make_unique<BookPoolList>();
+    analytics_ = std::make_unique<AnalyticsList>();
+    first_flush_.Reset();
+
+    // after the writers of the previous run, which write into them.
+    consolidated_writer_.reset();
+    async_writer_.reset();
+    if (async_output_ != nullptr) {
+      async_writer_ = std::make_unique<AsyncWriter>(*async_output_);
+    }
+  }
+
+  void OrderBookFeedsManager::FlushWriters() {
+    if (writers_ == nullptr) {
       return;
     }
+    for (auto& writer : *writers_) {
+      writer.Flush();
+    }
+    for (auto& analytics : *analytics_) {
+      analytics.Output().Flush();
+    }
+    if (consolidated_writer_ != nullptr) {
+      consolidated_writer_->Flush();
+    }
+    if (async_writer_ != nullptr) {
+      async_writer_->Drain();
+    }
+  }
 
-    executor_ = std::make_unique<tf::Executor>(threads);
-    executor_->run(*flow_).wait();
+  void OrderBookFeedsManager::FinishWriters() {
+    FlushWriters();
+    // the index only locates the records once they are on the disk.
+    if (consolidated_writer_ != nullptr) {
+      consolidated_writer_->Finish();
+    }
+  }
+
+  void OrderBookFeedsManager::EnableAsyncOutput(
+    const AsyncWriterOptions& options) {
+    async_output_ = std::make_unique<AsyncWriterOptions>(options);
+  }
+
+  void OrderBookFeedsManager::EnableConsolidatedOutput(
+    const ConsolidatedOptions& options) {
+    consolidated_output_ = std::make_unique<ConsolidatedOptions>(options);
+  }
+
+  void OrderBookFeedsManager::EnableAnalytics(
+    const AnalyticsOptions& options) {
+    analytics_output_ = std::make_unique<AnalyticsOptions>(options);
+  }
+
+  void OrderBookFeedsManager::EnableCheckpoints(
+    const CheckpointOptions& options) {
+    checkpoints_ = std::make_unique<CheckpointOptions>(options);
+  }
+
+  auto OrderBookFeedsManager::OutputReport() const -> AsyncWriterReport {
+    return async_writer_ != nullptr ? async_writer_->Report()
+                                    : AsyncWriterReport{};
+  }
+
+  auto OrderBookFeedsManager::CreateChannel(const std::string_view symbol,
+                                            std::string_view out_dir,
+                                            bool& created) -> Channel {
+    const auto id = symbols_->Intern(symbol, created);
+
+    // Whenever detected a new symbol, we should create a new worker and
+    // writer synchronously for thread safety in data writting.
+    if (created) {
+      auto& writer = writers_->emplace_back();
+      writer.RecordFirstFlush(&first_flush_);
+      if (consolidated_output_ != nullptr) {
+        // the segments are started in the output directory of the run.
+        if (consolidated_writer_ == nullptr) {
+          consolidated_writer_ = std::make_unique<ConsolidatedWriter>();
+          consolidated_writer_->Open(std::string{out_dir},
+                                     *consolidated_output_,
+                                     async_writer_.get());
+        }
+        writer.Attach(*consolidated_writer_,
+                      consolidated_writer_->AddSymbol(symbol));
+      }
+      else {
+        OpenWriter(writer, symbol, kEventsSuffix, out_dir, 0);
+      }
+      auto& worker = workers_->emplace_back();
+      pools_->emplace_back(kBookPoolCapacity);
+
+      if (analytics_output_ != nullptr) {
+        auto& analytics = analytics_->emplace_back(*analytics_output_);
+        OpenWriter(analytics.Output(), symbol, kAnalyticsSuffix, out_dir, 0);
+        worker.AttachAnalytics(&analytics);
+      }
+    }
+    return {id, &(*workers_)[id], &(*writers_)[id], &(*pools_)[id]};
+  }
+
+  auto OrderBookFeedsManager::OpenWriter(OutputFile& writer,
+                                         const std::string_view symbol,
+                                         const std::string_view suffix,
+                                         std::string_view out_dir,
+                                         const uint64_t size) -> bool {
+    auto path = fmt::format("{out_dir}/{symbol}{suffix}",
+                            fmt::arg("out_dir", out_dir),
+                            fmt::arg("symbol", symbol),
+                            fmt::arg("suffix", suffix));
+    if (async_writer_ == nullptr) {
+      return writer.OpenAt(path, size);
+    }
+
+    // the kept bytes are dropped here, the asynchronous writer appends after
+    // them.
+    if (size > 0 && !detail::KeepPrefix(path, size)) {
+      return false;
+    }
+    writer.Attach(*async_writer_,
+                  async_writer_->AddFile(std::move(path), size),
+                  size);
+    return true;
+  }
+
+  auto OrderBookFeedsManager::RestoreChannel(const SymbolCheckpoint& symbol,
+                                             std::string_view out_dir)
+    -> bool {
+    auto created  = false;
+    const auto id = symbols_->Intern(symbol.symbol, created);
+    if (!created) {
+      return false;
+    }
+
+    auto& writer = writers_->emplace_back();
+    writer.RecordFirstFlush(&first_flush_);
+    if (!OpenWriter(writer,
+                    symbol.symbol,
+                    kEventsSuffix,
+                    out_dir,
+                    symbol.output_size)) {
+      return false;
+    }
+    workers_->emplace_back();
+    (*workers_)[id].Restore(symbol.book, symbol.trades);
+    pools_->emplace_back(kBookPoolCapacity);
+    return true;
+  }
+
+  auto OrderBookFeedsManager::SaveStreamingCheckpoint(
+    const std::vector<std::string>& json_files,
+    const InputPosition& position,
+    const uint64_t lines) const -> bool {
+    Checkpoint checkpoint{};
+    checkpoint.inputs   = json_files;
+    checkpoint.position = position;
+    checkpoint.lines    = lines;
+    for (SymbolId id = 0; id < symbols_->Size(); ++id) {
+      const auto* book = (*workers_)[id].LiveBook();
+      if (book == nullptr) {
+        continue;
+      }
+      auto& symbol       = checkpoint.symbols.emplace_back();
+      symbol.symbol      = symbols_->Name(id);
+      symbol.book        = *book;
+      symbol.trades      = (*workers_)[id].PendingTrades();
+      symbol.output_size = (*writers_)[id].Size();
+    }
+    return SaveCheckpoint(checkpoint, checkpoints_->path);
+  }
+
+  auto OrderBookFeedsManager::FindChannel(const std::string_view symbol)
+    -> Channel {
+    const auto id = symbols_->Find(symbol);
+    if (id == kInvalidSymbolId) {
+      return {};
+    }
+    return {id, &(*workers_)[id], &(*writers_)[id], &(*pools_)[id]};
+  }
+
+  auto OrderBookFeedsManager::EmplaceJsonFeedTasks(
+    const std::string& json_file,
+    std::string_view out_dir,
+    PrevTaskList& prev_task) -> bool {
+    std::ifstream opener(json_file);
+    if (!opener.is_open()) {
+      fmt::print("Cannot open {}", json_file);
+      return false;
+    }
+
+    std::string line{};
+    for (auto i = 1; std::getline(opener, line); ++i) {
+      if (!EmplaceFeedTask(line, out_dir, prev_task)) {
+        fmt::print("parse {} error at line {}", json_file, i);
+        return false;
+      }
+    }
+    return true;
+  }
+
+  auto OrderBookFeedsManager::EmplaceBinaryFeedTasks(
+    const std::string& binary_file,
+    std::string_view out_dir,
+    PrevTaskList& prev_task) -> bool {
+    BinaryFeedReader reader{};
+    if (!reader.Open(binary_file)) {
+      fmt::print("Cannot open binary feeds {}\n", binary_file);
+      return false;
+    }
+
+    // the channel of every symbol of the file by its identifier in the file,
+    // so a symbol is only looked up by name on its first record.
+    std::vector<Channel> channels(reader.SymbolCount());
+    for (SymbolId id = 0; reader.Next(record_, id);) {
+      auto& channel      = channels[id];
+      auto is_new_symbol = false;
+      if (channel.worker == nullptr) {
+        const auto symbol = reader.Symbol(id);
+        channel = record_.type == FeedRecord::Type::kBook
+                  ? CreateChannel(symbol, out_dir, is_new_symbol)
+                  : FindChannel(symbol);
+        if (channel.worker == nullptr) {
+          fmt::print("There is no book recorded with symbol {}\n", symbol);
+          continue;
+        }
+      }
+      EmplaceChannelTask(channel, is_new_symbol, prev_task);
+    }
+
+    if (reader.Failed()) {
+      fmt::print("read {} error\n", binary_file);
+      return false;
+    }
+    return true;
   }
 
-  void OrderBookFeedsManager::UpdateBookChangesUnsafe(
-    const std::string& symbol,
-    std::unique_ptr<OrderBookRecord> new_book) {
-    auto worker_it = workers_->try_emplace(symbol).first;
+  auto OrderBookFeedsManager::EmplaceFeedTask(const std::string& line,
+                                              std::string_view out_dir,
+                                              PrevTaskList& prev_task)
+    -> bool {
+    if (!ParseFeedLine(line, record_)) {
+      return false;
+    }
 
-    writers_->at(symbol) << worker_it->second.UpdateBookChangesUnsafe(
-      std::move(new_book));
+    EmplaceRecordTask(out_dir, prev_task);
+    return true;
   }
 
-  void OrderBookFeedsManager::RecordNewTradeUnsafe(
-    const std::string& symbol,
-    std::unique_ptr<TradeRecord> new_trade) {
-    if (auto worker_it = workers_->find(symbol); worker_it != workers_->end()) {
-      worker_it->second.RecordNewTrade(std::move(new_trade));
+  void OrderBookFeedsManager::EmplaceRecordTask(std::string_view out_dir,
+                                                PrevTaskList& prev_task) {
+    Channel channel{};
+    auto is_new_symbol = false;
+    if (record_.type == FeedRecord::Type::kBook) {
+      channel = CreateChannel(record_.symbol, out_dir, is_new_symbol);
     }
     else {
-      fmt::print("There is no book recorded with symbol {}\n", symbol);
+      channel = FindChannel(record_.symbol);
+      if (channel.worker == nullptr) {
+        fmt::print("There is no book recorded with symbol {}\n",
+                   record_.symbol);
+        return;
+      }
+    }
+    EmplaceChannelTask(channel, is_new_symbol, prev_task);
+  }
+
+  void OrderBookFeedsManager::EmplaceChannelTask(const Channel& channel,
+                                                 const bool is_new_symbol,
+                                                 PrevTaskList& prev_task) {
+    const metrics::ScopedTimer timer{metrics::Histogram::kGraph};
+    auto& record = record_;
+
+    tf::Task task{};
+    if (record.type == FeedRecord::Type::kBook) {
+      // The first book of a symbol is recorded synchronously, there is no
+      // task of this symbol yet.
+      if (is_new_symbol) {
+        channel.worker->UpdateBookChanges(record.book,
+                                          channel.writer->Buffer());
+        return;
+      }
+
+      // The task takes the parsed book, the record is refilled with a
+      // recycled book of the symbol for the next lines.
+      OrderBookRecord book{};
+      channel.pool->Acquire(book);
+      std::swap(book, record.book);
+
+      // Setup the task and create the dependency on the previous one with
+      // the same symbol
+      task = flow_->emplace([channel, book = std::move(book)]() mutable {
+        const metrics::TaskScope task_scope{};
+        channel.worker->UpdateBookChanges(book, channel.writer->Buffer());
+        channel.writer->FlushIfFull();
+        // |book| got the storage of the previous live book.
+        channel.pool->Release(book);
+      });
+    }
+    else {
+      // Setup the task and create the dependency on the previous one with
+      // the same symbol
+      task = flow_->emplace([channel, trade = record.trade] {
+        const metrics::TaskScope task_scope{};
+        channel.worker->RecordNewTrade(trade);
+      });
+    }
+
+    // the new task should be run after the previous one
+    if (prev_task.size() <= channel.id) {
+      prev_task.resize(channel.id + 1);
+    }
+    if (!prev_task[channel.id].empty()) {
+      task.succeed(prev_task[channel.id]);
     }
+    prev_task[channel.id] = task;
   }
 
 }   // namespace longlp
@@ -5,51 +5,353 @@
 #ifndef ORDER_BOOK_FEEDS_MANAGER_HPP_
 #define ORDER_BOOK_FEEDS_MANAGER_HPP_
 
-#include <fstream>
-#include <map>
+#include <atomic>
+#include <chrono>
+#include <deque>
 #include <memory>
 #include <string>
 #include <string_view>
 #include <taskflow/taskflow.hpp>
+#include <vector>
+#include "async_writer.hpp"
+#include "book_analytics.hpp"
+#include "checkpoint.hpp"
+#include "consolidated_output.hpp"
+#include "definitions.hpp"
+#include "ingest_engine.hpp"
 #include "instrument_feeds_worker.hpp"
+#include "object_pool.hpp"
+#include "output_file.hpp"
+#include "sharded_feeds_engine.hpp"
+#include "stealing_feeds_engine.hpp"
+#include "symbol_table.hpp"
 
 namespace longlp {
+  // Summary of a streaming run, for comparing with the two-phase path.
+  struct StreamingReport {
+    // elapsed time from the start until the first outputs are written out,
+    // or handed to the asynchronous or consolidated writer. 0 if there is
+    // no output.
+    std::chrono::nanoseconds first_output{0};
+    size_t batches{0};
+    // number of lines read by the run, after the resumed ones
+    size_t lines{0};
+    size_t checkpoints{0};
+    // number of lines before the checkpoint which the run resumed from
+    size_t resumed_lines{0};
+  };
+
+  // Checkpoints of a streaming run, see EnableCheckpoints.
+  struct CheckpointOptions {
+    // the checkpoint file, replaced by every checkpoint
+    std::string path{};
+    // minimum number of lines between two checkpoints
+    size_t interval_lines{1U << 20U};
+    // resume from the checkpoint of |path| instead of the first line
+    bool resume{false};
+  };
+
+  struct FollowOptions {
+    // maximum delay from reading a line to writing out its outputs. The
+    // outputs are written at once when the end of the file is reached, and
+    // every half budget while a burst of lines is being read.
+    std::chrono::microseconds flush_budget{1000};
+    // maximum wait for the growth of the file between two checks of |stop|.
+    std::chrono::microseconds poll_interval{1000};
+    // stop once the file has not grown for this long, 0 to never stop.
+    std::chrono::milliseconds idle_timeout{0};
+    // stop once it is set, e.g. from a signal handler.
+    const std::atomic<bool>* stop{nullptr};
+  };
+
+  // Summary of a follow run. The latency of a line is measured from its read
+  // until its outputs are written, only for the lines which have outputs.
+  struct FollowReport {
+    size_t lines{0};
+    // number of the lines which have outputs
+    size_t output_lines{0};
+    size_t over_budget{0};
+    std::chrono::nanoseconds p50_latency{0};
+    std::chrono::nanoseconds p99_latency{0};
+    std::chrono::nanoseconds max_latency{0};
+  };
+
   // The manager which has responsibility for parsing the market feeds (JSON
   // lines formatted) and generating parallel and heterogeneous tasks for high
   // performance analysis.
+  // The input of a run is a list of feed files which are read in order as a
+  // single feed, e.g. one capture per trading session: the workers keep
+  // their state from a file to the next one.
   class OrderBookFeedsManager {
    public:
-    // parsing json feeds then setup the task flow.
-    void InitFeedsAndGenerateTaskFlow(const std::string& json_file,
+    // parsing the feed files then setup the task flow. A file written by the
+    // feed converter is replayed as a binary feed, which skips the json
+    // parsing. The other runs only read json feeds and print an error for a
+    // binary one.
+    void InitFeedsAndGenerateTaskFlow(const std::vector<std::string>& files,
                                       std::string_view out_dir);
 
     // parallel run the analysis with assigned number of threads.
     // It should be called after InitFeedsAndGenerateTaskFlow
     void RunTaskFlow(size_t threads);
 
+    // the elapsed time from |start| until the first outputs of the last run
+    // are written out, see StreamingReport::first_output. 0 if there is no
+    // output.
+    auto FirstOutputSince(const std::chrono::steady_clock::time_point start)
+      const -> std::chrono::nanoseconds {
+      return first_flush_.Since(start);
+    }
+
+    // Streaming alternative of InitFeedsAndGenerateTaskFlow + RunTaskFlow.
+    // The feeds are parsed in batches of |batch_lines| lines, each batch runs
+    // on the executor while the next one is being parsed. At most two batches
+    // are alive at any time, so the memory usage does not depend on the input
+    // size.
+    auto StreamFeeds(const std::vector<std::string>& json_files,
+                     std::string_view out_dir,
+                     size_t threads,
+                     size_t batch_lines) -> StreamingReport;
+
+    // Alternative execution engine of the task flow. Every symbol is assigned
+    // to one of |shards| shards, the feeds are parsed on the calling thread
+    // and pushed to the shard queues, each shard is drained in order by its
+    // own consumer thread.
+    auto RunShardedFeeds(const std::vector<std::string>& json_files,
+                         std::string_view out_dir,
+                         size_t shards,
+                         size_t queue_capacity) -> ShardedRunReport;
+
+    // Alternative execution engine where every symbol has a home thread,
+    // and an idle thread steals whole waiting symbols from the others. The
+    // feeds are parsed on the calling thread and pushed to the per-symbol
+    // mailboxes. The report has the load of every thread.
+    auto RunStealingFeeds(const std::vector<std::string>& json_files,
+                          std::string_view out_dir,
+                          const StealingOptions& options)
+      -> StealingRunReport;
+
+    // Alternative input of the task flow for large or many files. Every file
+    // is memory mapped and split at line boundaries into |chunks| chunks. The
+    // chunks of all the files are parsed in parallel into per-chunk,
+    // per-symbol record buffers. Then each symbol is analyzed by one task
+    // which walks its buffers in file order.
+    //
+    // If |segment_books| is not 0, a hot symbol with more books is split into
+    // segments of |segment_books| books, which are classified in parallel
+    // from the known start book of each segment, then written in order.
+    void RunMappedFeeds(const std::vector<std::string>& json_files,
+                        std::string_view out_dir,
+                        size_t threads,
+                        size_t chunks,
+                        size_t segment_books);
+
+    // Batch alternative of the task flow for a complete input, without any
+    // dependency graph. The files are split into |chunks| chunks as above,
+    // which are parsed in parallel, then a parallel pass moves the records
+    // of every symbol into one contiguous array in file order. Then each
+    // symbol is analyzed by one independent task.
+    void RunPartitionedFeeds(const std::vector<std::string>& json_files,
+                             std::string_view out_dir,
+                             size_t threads,
+                             size_t chunks);
+
+    // Live alternative for a feed file which is still being written. Every
+    // new line is classified as soon as it is read and the outputs are
+    // appended to the files of the symbols within the flush budget. It runs
+    // on the calling thread until stopped by |options|.
+    auto FollowFeeds(const std::string& json_file,
+                     std::string_view out_dir,
+                     const FollowOptions& options) -> FollowReport;
+
+    // Hand the outputs of the next runs to an asynchronous writer of
+    // |options|, instead of writing them from the analysis threads. The
+    // latencies of the follow mode are then measured until the outputs are
+    // handed to the writer. The ingest keeps writing its outputs itself.
+    void EnableAsyncOutput(const AsyncWriterOptions& options);
+
+    // Write the outputs of the next runs into the single segmented file of
+    // |options| in the output directory, with an index of the records of
+    // every symbol, instead of one <symbol>.txt file per symbol. The
+    // segments are written by the asynchronous writer if it is enabled.
+    void EnableConsolidatedOutput(const ConsolidatedOptions& options);
+
+    // Record the analytics of every book of the next runs into the
+    // <symbol>.analytics.csv file of each symbol, see BookAnalytics. They
+    // are computed by the workers while they classify the books, in every
+    // mode but the ingest. The hot symbols are then not split by the mapped
+    // mode, and the checkpoints are not supported.
+    void EnableAnalytics(const AnalyticsOptions& options);
+
+    // Write a checkpoint of the streaming runs every |interval_lines| lines
+    // of |options| and once the input is read: the input position, the live
+    // book and pending trades of every symbol and the sizes of their outputs.
+    // A run of |options| which resumes continues from the checkpoint of the
+    // same input files, the outputs after it are dropped, so the outputs are
+    // the same as a run from the first line. The consolidated output is not
+    // supported.
+    void EnableCheckpoints(const CheckpointOptions& options);
+
+    // the summary of the asynchronous writes of the last run, empty if the
+    // asynchronous output is disabled.
+    auto OutputReport() const -> AsyncWriterReport;
+
+    // Return the merged metrics of every thread and the symbols which
+    // received the most messages in the last run. Everything is 0 if the
+    // metrics are disabled.
+    auto MetricsSummary() const -> std::string;
+
+    // In-process alternative to the feed files: start the shards of an
+    // ingest, then any thread can submit the records of the symbols it has
+    // registered. See IngestEngine for the ordering guarantees.
+    void StartIngest(IngestOptions options);
+
+    // Return the identifier of |symbol| in the started ingest.
+    auto RegisterSymbol(std::string_view symbol) -> SymbolId;
+
+    // Queue a record of a registered symbol. Return false if no ingest is
+    // started or |symbol| is unknown.
+    auto Submit(SymbolId symbol, OrderBookRecord& book) -> bool;
+    auto Submit(SymbolId symbol, const TradeRecord& trade) -> bool;
+
+    // Drain and stop the started ingest, an empty report if there is none.
+    auto StopIngest() -> IngestReport;
+
    private:
-    // assign the corresponded worker for analyzing the order book changes.
-    // Marked as unsafe because of thread safety awareness.
-    void UpdateBookChangesUnsafe(const std::string& symbol,
-                                 std::unique_ptr<OrderBookRecord> new_book);
+    // Manage worker by symbol id. Lazy initialzation
+    // The per-symbol lists are deques: they are indexed by symbol id and
+    // never move their elements when a new symbol is appended, so the
+    // running tasks can keep pointers to them.
+    using WorkerList = std::deque<InstrumentFeedsWorker>;
+
+    // Manage file writer by symbol id. Lazy initialzation
+    using WriterList = std::deque<OutputFile>;
+
+    // Recycle the book storage of a symbol from its tasks, which release the
+    // replaced live books, to the parsing thread. Lazy initialzation
+    using BookPool     = ObjectPool<OrderBookRecord>;
+    using BookPoolList = std::deque<BookPool>;
+
+    // Manage the analytics by symbol id, if they are enabled. Lazy
+    // initialzation
+    using AnalyticsList = std::deque<BookAnalytics>;
+
+    // record the previous task of each symbol id for setting up the flow
+    // graph, an empty task if there is none.
+    using PrevTaskList = std::vector<tf::Task>;
+
+    // The worker, file writer and book pool of a symbol.
+    struct Channel {
+      SymbolId id{kInvalidSymbolId};
+      InstrumentFeedsWorker* worker{nullptr};
+      OutputFile* writer{nullptr};
+      BookPool* pool{nullptr};
+    };
+
+    // Reset the symbols, workers, writers and book pools before a run.
+    void ResetChannels();
+
+    // Write out the buffered outputs of every writer, e.g. after every batch
+    // of the streaming mode. The index of the consolidated output is not
+    // written.
+    void FlushWriters();
+
+    // Write out the buffered outputs, then the index of the consolidated
+    // output, at the end of a run or before a checkpoint.
+    void FinishWriters();
 
-    // assign the corresponded worker for caching the trade records.
-    // Marked as unsafe because of thread safety awareness.
-    void RecordNewTradeUnsafe(const std::string& symbol,
-                              std::unique_ptr<TradeRecord> new_trade);
+    // Find the channel of |symbol|, a new worker, writer and book pool are
+    // created for an unknown symbol. |created| is set if the symbol is new.
+    auto CreateChannel(std::string_view symbol,
+                       std::string_view out_dir,
+                       bool& created) -> Channel;
 
-    // Manage worker by instrument symbol. Lazy initialzation
-    using WorkerList =
-      std::map<std::string /* symbol */, InstrumentFeedsWorker>;
+    // Open the output file <out_dir>/<symbol><suffix> and keep its first
+    // |size| bytes. Return false on failure.
+    auto OpenWriter(OutputFile& writer,
+                    std::string_view symbol,
+                    std::string_view suffix,
+                    std::string_view out_dir,
+                    uint64_t size) -> bool;
 
-    // Manage file writer by instrument symbol. Lazy initialzation
-    using WriterList = std::map<std::string /* symbol */, std::ofstream>;
+    // Create the channel of a checkpointed symbol with its state. Return
+    // false if the symbol is already known or its output cannot be restored.
+    auto RestoreChannel(const SymbolCheckpoint& symbol,
+                        std::string_view out_dir) -> bool;
+
+    // Write the checkpoint of the streaming run of |json_files|, which has
+    // read |lines| lines until |position|. Return false on failure.
+    auto SaveStreamingCheckpoint(const std::vector<std::string>& json_files,
+                                 const InputPosition& position,
+                                 uint64_t lines) const -> bool;
+
+    // Find the channel of |symbol|, nullptr members for an unknown symbol.
+    auto FindChannel(std::string_view symbol) -> Channel;
+
+    // Parse the feeds on the calling thread and push every record to
+    // |engine|, which classifies them on its own threads.
+    template <typename Engine>
+    void PushFeeds(const std::vector<std::string>& json_files,
+                   std::string_view out_dir,
+                   Engine& engine);
+
+    // emplace the tasks of every line of |json_file| into |flow_|.
+    // Return false if the file cannot be opened or a line is invalid.
+    auto EmplaceJsonFeedTasks(const std::string& json_file,
+                              std::string_view out_dir,
+                              PrevTaskList& prev_task) -> bool;
+
+    // emplace the tasks of every record of |binary_file| into |flow_|.
+    // Return false if the file cannot be opened or is corrupted.
+    auto EmplaceBinaryFeedTasks(const std::string& binary_file,
+                                std::string_view out_dir,
+                                PrevTaskList& prev_task) -> bool;
+
+    // parse a json line into |record_| then emplace its task into |flow_|.
+    // Return false if the line is invalid.
+    auto EmplaceFeedTask(const std::string& line,
+                         std::string_view out_dir,
+                         PrevTaskList& prev_task) -> bool;
+
+    // emplace the task of |record_| into |flow_|.
+    // The channel of the symbol is resolved here, on the parsing thread, so
+    // the tasks never touch |symbols_|, |workers_|, |writers_| and |pools_|.
+    void EmplaceRecordTask(std::string_view out_dir, PrevTaskList& prev_task);
+
+    // emplace the task of |record_| into |flow_|, on the resolved |channel|
+    // of its symbol. The first book of a new symbol is classified at once.
+    // A book task takes the parsed book and |record_| gets a recycled one in
+    // exchange.
+    void EmplaceChannelTask(const Channel& channel,
+                            bool is_new_symbol,
+                            PrevTaskList& prev_task);
 
     std::unique_ptr<tf::Executor> executor_{nullptr};
     std::unique_ptr<tf::Taskflow> flow_{nullptr};
 
+    std::unique_ptr<AsyncWriterOptions> async_output_{nullptr};
+    // declared before |writers_|, which write into it until destroyed.
+    std::unique_ptr<AsyncWriter> async_writer_{nullptr};
+    std::unique_ptr<ConsolidatedOptions> consolidated_output_{nullptr};
+    // declared before |writers_| too, after |async_writer_| which writes its
+    // segments.
+    std::unique_ptr<ConsolidatedWriter> consolidated_writer_{nullptr};
+    std::unique_ptr<CheckpointOptions> checkpoints_{nullptr};
+    // declared before |writers_|, which record their first flush into it.
+    FirstFlushClock first_flush_{};
+
+    std::unique_ptr<SymbolTable> symbols_{nullptr};
     std::unique_ptr<WorkerList> workers_{nullptr};
     std::unique_ptr<WriterList> writers_{nullptr};
+    std::unique_ptr<BookPoolList> pools_{nullptr};
+    std::unique_ptr<AnalyticsOptions> analytics_output_{nullptr};
+    // declared after |async_writer_| too, which writes their series.
+    std::unique_ptr<AnalyticsList> analytics_{nullptr};
+
+    std::unique_ptr<IngestEngine> ingest_{nullptr};
+
+    // the record which every line is read into, reused between lines.
+    FeedRecord record_{};
   };
 }   // namespace longlp
 
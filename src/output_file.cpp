@@ -0,0 +1,284 @@
+// Copyright 2022 Long Le Phi. All rights reserved.
+// Use of this source code is governed by a MIT license that can be
+// found in the LICENSE file.
+
+#include "output_file.hpp"
+
+#include <cerrno>
+#include <filesystem>
+#include <system_error>
+#include "async_writer.hpp"
+#include "consolidated_output.hpp"
+#include "metrics.hpp"
+
+#if defined(_WIN32)
+#  include <fcntl.h>
+#  include <io.h>
+#  include <sys/stat.h>
+#else
+#  include <fcntl.h>
+#  include <unistd.h>
+#endif
+
+namespace longlp {
+  namespace {
+#if defined(_WIN32)
+    auto WriteSome(const int descriptor, const char* data, const size_t size)
+      -> long long {
+      // _write takes at most UINT_MAX bytes.
+      constexpr size_t kMaxWrite = 1U << 30U;
+      return _write(descriptor,
+                    data,
+                    static_cast<unsigned int>(size < kMaxWrite ? size
+                                                               : kMaxWrite));
+    }
+
+    // there is no positional write on Windows, the descriptor is only used
+    // by one thread at a time.
+    auto WriteSomeAt(const int descriptor,
+                     const char* data,
+                     const size_t size,
+                     const uint64_t offset) -> long long {
+      if (_lseeki64(descriptor, static_cast<long long>(offset), SEEK_SET) <
+          0) {
+        return -1;
+      }
+      return WriteSome(descriptor, data, size);
+    }
+#else
+    auto WriteSome(const int descriptor, const char* data, const size_t size)
+      -> long long {
+      return write(descriptor, data, size);
+    }
+
+    auto WriteSomeAt(const int descriptor,
+                     const char* data,
+                     const size_t size,
+                     const uint64_t offset) -> long long {
+      return pwrite(descriptor, data, size, static_cast<off_t>(offset));
+    }
+#endif
+  }   // namespace
+
+  namespace detail {
+#if defined(_WIN32)
+    auto OpenForWriting(const std::string& path, const OpenMode mode) -> int {
+      auto flags = _O_WRONLY | _O_CREAT | _O_BINARY;
+      if (mode == OpenMode::kTruncate) {
+        flags |= _O_TRUNC;
+      }
+      else if (mode == OpenMode::kAppend) {
+        flags |= _O_APPEND;
+      }
+      return _open(path.c_str(), flags, _S_IREAD | _S_IWRITE);
+    }
+
+    void CloseDescriptor(const int descriptor) {
+      _close(descriptor);
+    }
+
+    auto SyncDescriptor(const int descriptor) -> bool {
+      return _commit(descriptor) == 0;
+    }
+
+    // the entries of a directory cannot be flushed on Windows, a rename is
+    // durable once it returns.
+    auto SyncDirectory(const std::string& /*path*/) -> bool {
+      return true;
+    }
+#else
+    auto OpenForWriting(const std::string& path, const OpenMode mode) -> int {
+      auto flags = O_WRONLY | O_CREAT;
+      if (mode == OpenMode::kTruncate) {
+        flags |= O_TRUNC;
+      }
+      else if (mode == OpenMode::kAppend) {
+        flags |= O_APPEND;
+      }
+      return open(path.c_str(), flags, 0644);
+    }
+
+    void CloseDescriptor(const int descriptor) {
+      close(descriptor);
+    }
+
+    auto SyncDescriptor(const int descriptor) -> bool {
+      return fsync(descriptor) == 0;
+    }
+
+    auto SyncDirectory(const std::string& path) -> bool {
+      const auto descriptor = open(path.c_str(), O_RDONLY | O_DIRECTORY);
+      if (descriptor < 0) {
+        return false;
+      }
+      const auto synced = SyncDescriptor(descriptor);
+      CloseDescriptor(descriptor);
+      return synced;
+    }
+#endif
+
+    auto WriteAll(const int descriptor, const std::string_view bytes)
+      -> bool {
+      for (size_t offset = 0; offset < bytes.size();) {
+        const auto written = WriteSome(descriptor,
+                                       bytes.data() + offset,
+                                       bytes.size() - offset);
+        if (written < 0) {
+          // interrupted before writing anything, retry.
+          if (errno != EINTR) {
+            return false;
+          }
+          continue;
+        }
+        offset += static_cast<size_t>(written);
+      }
+      return true;
+    }
+
+    auto WriteAllAt(const int descriptor,
+                    const std::string_view bytes,
+                    const uint64_t offset) -> bool {
+      for (size_t done = 0; done < bytes.size();) {
+        const auto written = WriteSomeAt(descriptor,
+                                         bytes.data() + done,
+                                         bytes.size() - done,
+                                         offset + done);
+        if (written < 0) {
+          // interrupted before writing anything, retry.
+          if (errno != EINTR) {
+            return false;
+          }
+          continue;
+        }
+        done += static_cast<size_t>(written);
+      }
+      return true;
+    }
+
+    auto KeepPrefix(const std::string& path, const uint64_t size) -> bool {
+      std::error_code error{};
+      const auto file_size = std::filesystem::file_size(path, error);
+      if (error || file_size < size) {
+        return false;
+      }
+      std::filesystem::resize_file(path, size, error);
+      return !error;
+    }
+
+    auto ReplaceFile(const std::string& path, const std::string_view bytes)
+      -> bool {
+      const auto temporary  = path + ".tmp";
+      const auto descriptor = OpenForWriting(temporary, OpenMode::kTruncate);
+      if (descriptor < 0) {
+        return false;
+      }
+      // the bytes are on the disk before the rename, otherwise a crash may
+      // leave an empty or partial file at |path|.
+      const auto written =
+        WriteAll(descriptor, bytes) && SyncDescriptor(descriptor);
+      CloseDescriptor(descriptor);
+
+      std::error_code error{};
+      if (!written) {
+        std::filesystem::remove(temporary, error);
+        return false;
+      }
+      std::filesystem::rename(temporary, path, error);
+      if (error) {
+        return false;
+      }
+      // and so is the rename, through the entry of the directory.
+      auto directory = std::filesystem::path{path}.parent_path();
+      if (directory.empty()) {
+        directory = ".";
+      }
+      return SyncDirectory(directory.string());
+    }
+  }   // namespace detail
+
+  OutputFile::~OutputFile() {
+    Close();
+  }
+
+  auto OutputFile::Open(const std::string& path) -> bool {
+    Close();
+    descriptor_ = detail::OpenForWriting(path, detail::OpenMode::kTruncate);
+    size_       = 0;
+    return descriptor_ >= 0;
+  }
+
+  auto OutputFile::OpenAt(const std::string& path, const uint64_t size)
+    -> bool {
+    if (size == 0) {
+      return Open(path);
+    }
+
+    Close();
+    if (!detail::KeepPrefix(path, size)) {
+      return false;
+    }
+    descriptor_ = detail::OpenForWriting(path, detail::OpenMode::kAppend);
+    size_       = size;
+    return descriptor_ >= 0;
+  }
+
+  void OutputFile::Attach(AsyncWriter& writer,
+                          const uint32_t file,
+                          const uint64_t size) {
+    Close();
+    async_writer_ = &writer;
+    attached_id_  = file;
+    size_         = size;
+  }
+
+  void OutputFile::Attach(ConsolidatedWriter& writer, const uint32_t symbol) {
+    Close();
+    consolidated_writer_ = &writer;
+    attached_id_         = symbol;
+  }
+
+  auto OutputFile::Flush() -> bool {
+    if (buffer_.empty()) {
+      return true;
+    }
+    if (first_flush_ != nullptr) {
+      first_flush_->Record();
+    }
+
+    // the bytes are only counted once, when the segment is written.
+    if (consolidated_writer_ != nullptr) {
+      consolidated_writer_->Write(attached_id_, buffer_);
+      return true;
+    }
+
+    const metrics::ScopedTimer timer{metrics::Histogram::kWrite};
+    metrics::Count(metrics::Counter::kBytesWritten, buffer_.size());
+
+    size_ += buffer_.size();
+    if (async_writer_ != nullptr) {
+      async_writer_->Write(attached_id_, buffer_);
+      return true;
+    }
+
+    const auto flushed =
+      descriptor_ >= 0 && detail::WriteAll(descriptor_, buffer_);
+    buffer_.clear();
+    return flushed;
+  }
+
+  void OutputFile::Close() {
+    if (async_writer_ != nullptr || consolidated_writer_ != nullptr) {
+      Flush();
+      async_writer_        = nullptr;
+      consolidated_writer_ = nullptr;
+      return;
+    }
+    if (descriptor_ < 0) {
+      buffer_.clear();
+      return;
+    }
+    Flush();
+    detail::CloseDescriptor(descriptor_);
+    descriptor_ = -1;
+  }
+}   // namespace longlp
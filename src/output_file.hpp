@@ -0,0 +1,175 @@
+// Copyright 2022 Long Le Phi. All rights reserved.
+// Use of this source code is governed by a MIT license that can be
+// found in the LICENSE file.
+
+#ifndef OUTPUT_FILE_HPP_
+#define OUTPUT_FILE_HPP_
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+namespace longlp {
+  class AsyncWriter;
+  class ConsolidatedWriter;
+
+  namespace detail {
+    enum class OpenMode {
+      // create or truncate the file
+      kTruncate,
+      // append the writes to the file
+      kAppend,
+      // only write at explicit offsets
+      kPositional,
+    };
+
+    // Open |path| for writing. Return its descriptor, -1 on failure.
+    auto OpenForWriting(const std::string& path, OpenMode mode) -> int;
+
+    // Write every byte of |bytes| to |descriptor|. Return false on failure.
+    auto WriteAll(int descriptor, std::string_view bytes) -> bool;
+
+    // Write every byte of |bytes| to |descriptor| at |offset|, which should
+    // be opened with OpenMode::kPositional. Return false on failure.
+    auto WriteAllAt(int descriptor, std::string_view bytes, uint64_t offset)
+      -> bool;
+
+    void CloseDescriptor(int descriptor);
+
+    // Flush the written bytes of |descriptor| to the disk. Return false on
+    // failure.
+    auto SyncDescriptor(int descriptor) -> bool;
+
+    // Flush the entries of the directory of |path| to the disk, e.g. after a
+    // rename. Return false on failure.
+    auto SyncDirectory(const std::string& path) -> bool;
+
+    // Truncate the file of |path| to its first |size| bytes. Return false if
+    // it is shorter, or on failure.
+    auto KeepPrefix(const std::string& path, uint64_t size) -> bool;
+
+    // Replace the file of |path| with |bytes| at once, through a temporary
+    // file, so a reader never sees a partial file, even after a crash.
+    // Return false on failure.
+    auto ReplaceFile(const std::string& path, std::string_view bytes) -> bool;
+  }   // namespace detail
+
+  // The time of the first flush of the output files which record into it,
+  // from any thread, e.g. the time to the first output of a run.
+  class FirstFlushClock {
+   public:
+    using Clock = std::chrono::steady_clock;
+
+    // Record the current time, unless a time is already recorded.
+    void Record() {
+      if (first_.load(std::memory_order_relaxed) != 0) {
+        return;
+      }
+      auto expected = Clock::rep{0};
+      first_.compare_exchange_strong(expected,
+                                     Clock::now().time_since_epoch().count(),
+                                     std::memory_order_relaxed);
+    }
+
+    // the elapsed time from |start| to the recorded time, 0 if there is
+    // none.
+    auto Since(const Clock::time_point start) const
+      -> std::chrono::nanoseconds {
+      const auto first = first_.load(std::memory_order_relaxed);
+      if (first == 0) {
+        return std::chrono::nanoseconds{0};
+      }
+      return Clock::time_point{Clock::duration{first}} - start;
+    }
+
+    void Reset() {
+      first_.store(0, std::memory_order_relaxed);
+    }
+
+   private:
+    std::atomic<Clock::rep> first_{0};
+  };
+
+  // An output file written through a reusable byte buffer. The outputs are
+  // formatted straight into the buffer, which is written out in large
+  // batches once it holds kFlushBytes bytes, and when the file is flushed or
+  // closed.
+  class OutputFile {
+   public:
+    static constexpr size_t kFlushBytes = 32 * 1024;
+
+    OutputFile() = default;
+    OutputFile(const OutputFile&)                    = delete;
+    auto operator=(const OutputFile&) -> OutputFile& = delete;
+    OutputFile(OutputFile&&)                         = delete;
+    auto operator=(OutputFile&&) -> OutputFile&      = delete;
+    ~OutputFile();
+
+    // Create or truncate |path|, a previous file is closed. Return false on
+    // failure.
+    auto Open(const std::string& path) -> bool;
+
+    // Open |path| and keep its first |size| bytes, the outputs are appended
+    // after them. A previous file is closed. Return false if the file is
+    // shorter, or on failure.
+    auto OpenAt(const std::string& path, uint64_t size) -> bool;
+
+    // Hand the full buffers to |file| of |writer|, which writes them
+    // asynchronously, instead of a file of its own. The file already has
+    // |size| bytes. A previous file is closed.
+    void Attach(AsyncWriter& writer, uint32_t file, uint64_t size);
+
+    // Hand the full buffers to |writer| as the records of |symbol|, instead
+    // of a file of its own. A previous file is closed.
+    void Attach(ConsolidatedWriter& writer, uint32_t symbol);
+
+    // the buffer to append the outputs to, FlushIfFull() should be called
+    // after appending.
+    auto Buffer() -> std::string& {
+      return buffer_;
+    }
+
+    void Append(const std::string_view bytes) {
+      buffer_.append(bytes);
+      FlushIfFull();
+    }
+
+    void FlushIfFull() {
+      if (buffer_.size() >= kFlushBytes) {
+        Flush();
+      }
+    }
+
+    // Write out the buffer, which keeps its capacity. Return false on
+    // failure, the buffer is dropped anyway.
+    auto Flush() -> bool;
+
+    // Flush then close the file.
+    void Close();
+
+    // Record the first flush of outputs into |clock|, nullptr to stop it.
+    // The clock must outlive the file.
+    void RecordFirstFlush(FirstFlushClock* clock) {
+      first_flush_ = clock;
+    }
+
+    // the size of the file once flushed, without the buffered outputs.
+    auto Size() const -> uint64_t {
+      return size_;
+    }
+
+   private:
+    int descriptor_{-1};
+    // the file or symbol of the attached writer
+    uint32_t attached_id_{0};
+    AsyncWriter* async_writer_{nullptr};
+    ConsolidatedWriter* consolidated_writer_{nullptr};
+    FirstFlushClock* first_flush_{nullptr};
+    uint64_t size_{0};
+    std::string buffer_{};
+  };
+}   // namespace longlp
+
+#endif   // OUTPUT_FILE_HPP_
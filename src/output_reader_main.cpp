@@ -0,0 +1,115 @@
+// Copyright 2022 Long Le Phi. All rights reserved.
+// Use of this source code is governed by a MIT license that can be
+// found in the LICENSE file.
+
+#include <fmt/core.h>
+#include <fmt/format.h>
+#include <filesystem>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include "consolidated_output.hpp"
+#include "output_file.hpp"
+
+// Extract the streams of the symbols from a consolidated output of the
+// watcher, byte-identical to its per-symbol <symbol>.txt files.
+namespace {
+  // Command line options, passed as `--name=value`.
+  struct Options {
+    // the output directory of the watcher run
+    std::string input{};
+    // the symbol to print, every symbol is extracted into |output| if empty.
+    std::string symbol{};
+    // write <output>/<symbol>.txt files instead of printing the stream.
+    std::string output{};
+  };
+
+  auto ParseOptions(const int32_t argc, char** argv) -> Options {
+    Options options{};
+    for (auto i = 1; i < argc; ++i) {
+      const std::string_view arg = argv[i];
+      const auto separator       = arg.find('=');
+      const auto name            = arg.substr(0, separator);
+      const auto value =
+        separator == std::string_view::npos ? "" : arg.substr(separator + 1);
+
+      if (name == "--input") {
+        options.input = value;
+      }
+      else if (name == "--symbol") {
+        options.symbol = value;
+      }
+      else if (name == "--output") {
+        options.output = value;
+      }
+      else {
+        fmt::print("Unknown option {}\n", arg);
+      }
+    }
+    return options;
+  }
+
+  // Write |events| into <directory>/<symbol>.txt. Return false on failure.
+  auto WriteSymbolFile(const std::string& directory,
+                       const std::string_view symbol,
+                       const std::string_view events) -> bool {
+    longlp::OutputFile file{};
+    if (!file.Open(fmt::format("{}/{}.txt", directory, symbol))) {
+      fmt::print("Cannot open the output of {}\n", symbol);
+      return false;
+    }
+    file.Append(events);
+    return file.Flush();
+  }
+}   // namespace
+
+auto main(int32_t argc, char** argv) -> int32_t {
+  const auto options = ParseOptions(argc, argv);
+  if (options.input.empty() ||
+      (options.symbol.empty() && options.output.empty())) {
+    fmt::print("usage: order-book-output-reader --input=<directory> "
+               "[--symbol=<symbol>] [--output=<directory>]\n");
+    return 1;
+  }
+
+  longlp::ConsolidatedReader reader{};
+  if (!reader.Open(options.input)) {
+    fmt::print("There is no consolidated output in {}\n", options.input);
+    return 1;
+  }
+
+  if (!options.output.empty()) {
+    std::error_code error{};
+    std::filesystem::create_directories(options.output, error);
+    if (error) {
+      fmt::print("Cannot create {}\n", options.output);
+      return 1;
+    }
+  }
+
+  std::string events{};
+  const auto extract = [&](const std::string_view symbol) {
+    events.clear();
+    if (!reader.Extract(symbol, events)) {
+      fmt::print("Cannot extract the records of {}\n", symbol);
+      return false;
+    }
+    if (options.output.empty()) {
+      fmt::print("{}", events);
+      return true;
+    }
+    return WriteSymbolFile(options.output, symbol, events);
+  };
+
+  if (!options.symbol.empty()) {
+    return extract(options.symbol) ? 0 : 1;
+  }
+
+  const auto& symbols = reader.Symbols();
+  for (longlp::SymbolId id = 0; id < symbols.Size(); ++id) {
+    if (!extract(symbols.Name(id))) {
+      return 1;
+    }
+  }
+  return 0;
+}
@@ -0,0 +1,30 @@
+// Copyright 2022 Long Le Phi. All rights reserved.
+// Use of this source code is governed by a MIT license that can be
+// found in the LICENSE file.
+
+#ifndef PEAK_MEMORY_HPP_
+#define PEAK_MEMORY_HPP_
+
+#if defined(__unix__) || defined(__APPLE__)
+#  include <sys/resource.h>
+#endif
+
+namespace longlp {
+  // peak resident set size of the process in kilobytes, 0 if unknown.
+  inline auto PeakResidentKilobytes() -> double {
+#if defined(__unix__) || defined(__APPLE__)
+    rusage usage{};
+    getrusage(RUSAGE_SELF, &usage);
+#  if defined(__APPLE__)
+    // bytes on macOS
+    return static_cast<double>(usage.ru_maxrss) / 1024.0;
+#  else
+    return static_cast<double>(usage.ru_maxrss);
+#  endif
+#else
+    return 0.0;
+#endif
+  }
+}   // namespace longlp
+
+#endif   // PEAK_MEMORY_HPP_
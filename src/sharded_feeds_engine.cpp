@@ -0,0 +1,144 @@
+// Copyright 2022 Long Le Phi. All rights reserved.
+// Use of this source code is governed by a MIT license that can be
+// found in the LICENSE file.
+
+#include "sharded_feeds_engine.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <string>
+#include <thread>
+#include <utility>
+#include "latency_histogram.hpp"
+#include "spsc_queue.hpp"
+#include "thread_affinity.hpp"
+
+namespace longlp {
+  namespace {
+    using Clock = std::chrono::steady_clock;
+
+    // A message in a shard queue.
+    struct ShardMessage {
+      InstrumentFeedsWorker* worker{nullptr};
+      OutputFile* writer{nullptr};
+      FeedRecord record{};
+      Clock::time_point enqueued{};
+    };
+  }   // namespace
+
+  struct ShardedFeedsEngine::Shard {
+    explicit Shard(const size_t queue_capacity) : queue(queue_capacity) {}
+
+    // Drain the queue until the producer is done.
+    void Consume() {
+      for (;;) {
+        auto* message = queue.Front();
+        if (message == nullptr) {
+          if (done.load(std::memory_order_acquire)) {
+            // the producer may push the last messages right before done
+            if (queue.Front() == nullptr) {
+              return;
+            }
+            continue;
+          }
+          std::this_thread::yield();
+          continue;
+        }
+
+        Process(*message);
+        queue.Pop();
+      }
+    }
+
+    void Process(ShardMessage& message) {
+      auto& record = message.record;
+      if (record.type == FeedRecord::Type::kBook) {
+        // the slot gets back the storage of the previous live book, which
+        // is recycled by the producer for a next snapshot.
+        message.worker->UpdateBookChanges(record.book,
+                                          message.writer->Buffer());
+        message.writer->FlushIfFull();
+      }
+      else {
+        message.worker->RecordNewTrade(record.trade);
+      }
+
+      latencies.Record(static_cast<uint64_t>(
+        std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() -
+                                                             message.enqueued)
+          .count()));
+    }
+
+    SpscQueue<ShardMessage> queue;
+    std::atomic<bool> done{false};
+    std::thread consumer{};
+
+    // owned by the consumer thread until it is joined.
+    LatencyHistogram latencies{};
+  };
+
+  ShardedFeedsEngine::ShardedFeedsEngine(const size_t shards,
+                                         const size_t queue_capacity) {
+    const auto cores = std::max(std::thread::hardware_concurrency(), 1U);
+
+    shards_.reserve(shards);
+    for (auto i = 0U; i < std::max<size_t>(shards, 1); ++i) {
+      auto& shard =
+        shards_.emplace_back(std::make_unique<Shard>(queue_capacity));
+      shard->consumer =
+        std::thread([shard = shard.get()] { shard->Consume(); });
+      PinToCore(shard->consumer, i % cores);
+    }
+  }
+
+  ShardedFeedsEngine::~ShardedFeedsEngine() {
+    if (!stopped_) {
+      Stop();
+    }
+  }
+
+  void ShardedFeedsEngine::Push(const SymbolId symbol,
+                                InstrumentFeedsWorker& worker,
+                                OutputFile* writer,
+                                FeedRecord& record) {
+    auto& shard     = *shards_[ShardOf(symbol)];
+    const auto fill = [&](ShardMessage& message) {
+      message.worker   = &worker;
+      message.writer   = writer;
+      message.enqueued = Clock::now();
+      std::swap(message.record, record);
+    };
+
+    while (!shard.queue.TryPush(fill)) {
+      std::this_thread::yield();
+    }
+  }
+
+  auto ShardedFeedsEngine::Stop() -> ShardedRunReport {
+    stopped_ = true;
+
+    LatencyHistogram latencies{};
+    for (auto& shard : shards_) {
+      shard->done.store(true, std::memory_order_release);
+    }
+    for (auto& shard : shards_) {
+      if (shard->consumer.joinable()) {
+        shard->consumer.join();
+      }
+      latencies.Merge(shard->latencies);
+    }
+
+    const auto to_duration = [](const uint64_t nanoseconds) {
+      return std::chrono::nanoseconds{static_cast<int64_t>(nanoseconds)};
+    };
+
+    ShardedRunReport report{};
+    report.messages     = latencies.Count();
+    report.p50_latency  = to_duration(latencies.ValueAt(50.0));
+    report.p99_latency  = to_duration(latencies.ValueAt(99.0));
+    report.p999_latency = to_duration(latencies.ValueAt(99.9));
+    report.max_latency  = to_duration(latencies.Max());
+    return report;
+  }
+
+}   // namespace longlp
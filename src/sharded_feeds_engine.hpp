@@ -0,0 +1,68 @@
+// Copyright 2022 Long Le Phi. All rights reserved.
+// Use of this source code is governed by a MIT license that can be
+// found in the LICENSE file.
+
+#ifndef SHARDED_FEEDS_ENGINE_HPP_
+#define SHARDED_FEEDS_ENGINE_HPP_
+
+#include <chrono>
+#include <memory>
+#include <vector>
+#include "definitions.hpp"
+#include "instrument_feeds_worker.hpp"
+#include "output_file.hpp"
+#include "symbol_table.hpp"
+
+namespace longlp {
+  // Throughput and latency summary of a sharded run. The latency of a message
+  // is measured from its push into a shard queue until its output is written.
+  struct ShardedRunReport {
+    size_t messages{0};
+    std::chrono::nanoseconds p50_latency{0};
+    std::chrono::nanoseconds p99_latency{0};
+    std::chrono::nanoseconds p999_latency{0};
+    std::chrono::nanoseconds max_latency{0};
+  };
+
+  // An execution engine which assigns every symbol to a fixed shard. Each
+  // shard owns a single-producer/single-consumer queue and one consumer
+  // thread (pinned to a core when the platform supports it) which drains the
+  // messages in order. Thus the per-symbol order is preserved without any
+  // dependency graph.
+  //
+  // Push() must always be called from the same producer thread.
+  class ShardedFeedsEngine {
+   public:
+    ShardedFeedsEngine(size_t shards, size_t queue_capacity);
+    ShardedFeedsEngine(const ShardedFeedsEngine&)                    = delete;
+    auto operator=(const ShardedFeedsEngine&) -> ShardedFeedsEngine& = delete;
+    ShardedFeedsEngine(ShardedFeedsEngine&&)                         = delete;
+    auto operator=(ShardedFeedsEngine&&) -> ShardedFeedsEngine&      = delete;
+    ~ShardedFeedsEngine();
+
+    // the shard which owns |symbol|. The dense symbol ids are dealt to the
+    // shards in turn.
+    auto ShardOf(const SymbolId symbol) const -> size_t {
+      return symbol % shards_.size();
+    }
+
+    // Route |record| to the shard of |symbol|, the worker and writer must be
+    // owned by this symbol. Spin while the shard queue is full.
+    // The storage of |record| is swapped with a recycled queue slot.
+    void Push(SymbolId symbol,
+              InstrumentFeedsWorker& worker,
+              OutputFile* writer,
+              FeedRecord& record);
+
+    // Drain every shard and join the consumer threads.
+    auto Stop() -> ShardedRunReport;
+
+   private:
+    struct Shard;
+
+    std::vector<std::unique_ptr<Shard>> shards_{};
+    bool stopped_{false};
+  };
+}   // namespace longlp
+
+#endif   // SHARDED_FEEDS_ENGINE_HPP_
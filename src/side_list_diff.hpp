@@ -0,0 +1,292 @@
+// Copyright 2022 Long Le Phi. All rights reserved.
+// Use of this source code is governed by a MIT license that can be
+// found in the LICENSE file.
+
+#ifndef SIDE_LIST_DIFF_HPP_
+#define SIDE_LIST_DIFF_HPP_
+
+#include <algorithm>
+#include <cstddef>
+#include <functional>
+#include <type_traits>
+#include "definitions.hpp"
+#include "soa_book.hpp"
+
+#if defined(__AVX2__)
+  #include <immintrin.h>
+#elif defined(__SSE2__)
+  #include <emmintrin.h>
+#endif
+
+namespace longlp {
+  enum class Intention : std::size_t {
+    kCancelled  = 0,
+    kPassive    = 1,
+    kAggressive = 2,
+  };
+
+  enum class Side : std::size_t { kBuy = 0, kSell = 1 };
+
+  // How DiffSideList walks the levels which did not change.
+  enum class DiffKernel {
+    // one level at a time, as the other levels.
+    kScalar,
+    // the whole run at once with CountUnchangedLevels.
+    kBlock,
+  };
+
+  namespace detail {
+    // A level is compared as one 16-byte lane: the price and quantity are its
+    // first 12 bytes, the count is ignored as it is never classified.
+    static_assert(sizeof(Level) == 16, "a level should be a 16-byte lane");
+    static_assert(offsetof(Level, price) == 0 &&
+                    offsetof(Level, quantity) == 8,
+                  "the price and quantity should be the first 12 bytes");
+
+    // number of levels compared by an iteration of the block loop.
+    constexpr size_t kBlockLevels = 4;
+
+#if defined(__AVX2__)
+    // the byte mask of the price and quantity of the 2 levels of a register.
+    constexpr int kLanesMask = 0x0FFF0FFF;
+
+    inline auto EqualLanes(const Level* lhs, const Level* rhs) -> __m256i {
+      return _mm256_cmpeq_epi32(
+        _mm256_loadu_si256(reinterpret_cast<const __m256i*>(lhs)),
+        _mm256_loadu_si256(reinterpret_cast<const __m256i*>(rhs)));
+    }
+
+    inline auto EqualBlock(const Level* lhs, const Level* rhs) -> bool {
+      const auto equal =
+        _mm256_and_si256(EqualLanes(lhs, rhs), EqualLanes(lhs + 2, rhs + 2));
+      return (_mm256_movemask_epi8(equal) & kLanesMask) == kLanesMask;
+    }
+
+    // the 4 prices fill a register, the 4 quantities half of one.
+    inline auto EqualBlock(const Price* lhs_prices,
+                           const Quantity* lhs_quantities,
+                           const Price* rhs_prices,
+                           const Quantity* rhs_quantities) -> bool {
+      const auto prices = _mm256_cmpeq_epi64(
+        _mm256_loadu_si256(reinterpret_cast<const __m256i*>(lhs_prices)),
+        _mm256_loadu_si256(reinterpret_cast<const __m256i*>(rhs_prices)));
+      const auto quantities = _mm_cmpeq_epi32(
+        _mm_loadu_si128(reinterpret_cast<const __m128i*>(lhs_quantities)),
+        _mm_loadu_si128(reinterpret_cast<const __m128i*>(rhs_quantities)));
+      return _mm256_movemask_epi8(prices) == -1 &&
+             _mm_movemask_epi8(quantities) == 0xFFFF;
+    }
+#elif defined(__SSE2__)
+    // the byte mask of the price and quantity of the level of a register.
+    constexpr int kLanesMask = 0x0FFF;
+
+    inline auto EqualLanes(const Level* lhs, const Level* rhs) -> __m128i {
+      return _mm_cmpeq_epi32(
+        _mm_loadu_si128(reinterpret_cast<const __m128i*>(lhs)),
+        _mm_loadu_si128(reinterpret_cast<const __m128i*>(rhs)));
+    }
+
+    inline auto EqualBlock(const Level* lhs, const Level* rhs) -> bool {
+      const auto equal =
+        _mm_and_si128(_mm_and_si128(EqualLanes(lhs, rhs),
+                                    EqualLanes(lhs + 1, rhs + 1)),
+                      _mm_and_si128(EqualLanes(lhs + 2, rhs + 2),
+                                    EqualLanes(lhs + 3, rhs + 3)));
+      return (_mm_movemask_epi8(equal) & kLanesMask) == kLanesMask;
+    }
+
+    // the 4 prices fill 2 registers, the 4 quantities one. A price matches
+    // when both of its 32-bit halves match.
+    inline auto EqualBlock(const Price* lhs_prices,
+                           const Quantity* lhs_quantities,
+                           const Price* rhs_prices,
+                           const Quantity* rhs_quantities) -> bool {
+      const auto load = [](const auto* values) {
+        return _mm_loadu_si128(reinterpret_cast<const __m128i*>(values));
+      };
+      const auto equal = _mm_and_si128(
+        _mm_and_si128(_mm_cmpeq_epi32(load(lhs_prices), load(rhs_prices)),
+                      _mm_cmpeq_epi32(load(lhs_prices + 2),
+                                      load(rhs_prices + 2))),
+        _mm_cmpeq_epi32(load(lhs_quantities), load(rhs_quantities)));
+      return _mm_movemask_epi8(equal) == 0xFFFF;
+    }
+#else
+    inline auto EqualBlock(const Level* lhs, const Level* rhs) -> bool {
+      for (size_t i = 0; i < kBlockLevels; ++i) {
+        if (lhs[i].price != rhs[i].price ||
+            lhs[i].quantity != rhs[i].quantity) {
+          return false;
+        }
+      }
+      return true;
+    }
+
+    inline auto EqualBlock(const Price* lhs_prices,
+                           const Quantity* lhs_quantities,
+                           const Price* rhs_prices,
+                           const Quantity* rhs_quantities) -> bool {
+      for (size_t i = 0; i < kBlockLevels; ++i) {
+        if (lhs_prices[i] != rhs_prices[i] ||
+            lhs_quantities[i] != rhs_quantities[i]) {
+          return false;
+        }
+      }
+      return true;
+    }
+#endif
+  }   // namespace detail
+
+  // Return the number of leading positions, among the first |count| ones,
+  // where |old_levels| and |new_levels| have the same price and quantity.
+  // The levels are compared in blocks with AVX2 or SSE2 when the target
+  // has them, one by one otherwise.
+  inline auto CountUnchangedLevels(const Level* old_levels,
+                                   const Level* new_levels,
+                                   const size_t count) -> size_t {
+    size_t result = 0;
+    // skip the unchanged blocks, the first changed level is then found in
+    // the last block, or in the remaining levels.
+    while (result + detail::kBlockLevels <= count &&
+           detail::EqualBlock(old_levels + result, new_levels + result)) {
+      result += detail::kBlockLevels;
+    }
+    while (result < count &&
+           old_levels[result].price == new_levels[result].price &&
+           old_levels[result].quantity == new_levels[result].quantity) {
+      ++result;
+    }
+    return result;
+  }
+
+  // Same as above, for sides stored as structures of arrays: the prices and
+  // the quantities are compared in blocks of their own arrays.
+  inline auto CountUnchangedLevels(const Price* old_prices,
+                                   const Quantity* old_quantities,
+                                   const Price* new_prices,
+                                   const Quantity* new_quantities,
+                                   const size_t count) -> size_t {
+    size_t result = 0;
+    while (result + detail::kBlockLevels <= count &&
+           detail::EqualBlock(old_prices + result,
+                              old_quantities + result,
+                              new_prices + result,
+                              new_quantities + result)) {
+      result += detail::kBlockLevels;
+    }
+    while (result < count && old_prices[result] == new_prices[result] &&
+           old_quantities[result] == new_quantities[result]) {
+      ++result;
+    }
+    return result;
+  }
+
+  namespace detail {
+    // the number of unchanged levels from |old_index| and |new_index|.
+    inline auto CountUnchangedFrom(const SideList& old_list,
+                                   const size_t old_index,
+                                   const SideList& new_list,
+                                   const size_t new_index,
+                                   const size_t count) -> size_t {
+      return CountUnchangedLevels(old_list.data() + old_index,
+                                  new_list.data() + new_index,
+                                  count);
+    }
+
+    template <size_t MaxDepth>
+    auto CountUnchangedFrom(const SoaSide<MaxDepth>& old_list,
+                            const size_t old_index,
+                            const SoaSide<MaxDepth>& new_list,
+                            const size_t new_index,
+                            const size_t count) -> size_t {
+      return CountUnchangedLevels(old_list.Prices() + old_index,
+                                  old_list.Quantities() + old_index,
+                                  new_list.Prices() + new_index,
+                                  new_list.Quantities() + new_index,
+                                  count);
+    }
+  }   // namespace detail
+
+  // Compare the changes of a side between old and new order book records,
+  // calling |emit(intention, quantity, price)| for every classified order.
+  // The levels of a side, a SideList or a SoaSide, are sorted from the best
+  // price. Both kernels emit the same orders: the block kernel only speeds
+  // up the deep books which change a few levels.
+  template <Side side,
+            DiffKernel kernel = DiffKernel::kBlock,
+            typename Levels,
+            typename Emit>
+  void DiffSideList(const Levels& old_list,
+                    const Levels& new_list,
+                    Emit&& emit) {
+    using is_new_order_placed_comparer =
+      std::conditional_t<side == Side::kBuy,
+                         std::greater<Price>,
+                         std::less<Price>>;
+    const is_new_order_placed_comparer is_new_order_placed{};
+
+    const auto old_size = old_list.size();
+    const auto new_size = new_list.size();
+    size_t old_index    = 0;
+    size_t new_index    = 0;
+
+    for (; old_index != old_size || new_index != new_size;) {
+      if (old_index == old_size) {
+        // new order
+        const auto& new_level = new_list[new_index];
+        emit(Intention::kPassive, new_level.quantity, new_level.price);
+        ++new_index;
+        continue;
+      }
+
+      const auto& old_level = old_list[old_index];
+      if (new_index == new_size) {
+        // cancel order
+        emit(Intention::kCancelled, old_level.quantity, old_level.price);
+        ++old_index;
+        continue;
+      }
+
+      const auto& new_level = new_list[new_index];
+      if (old_level.price == new_level.price) {
+        // Log if there is a change in quantity
+        if (const auto quant_diff =
+              Volume{new_level.quantity} - Volume{old_level.quantity};
+            quant_diff != 0) {
+          emit(quant_diff > 0 ? Intention::kPassive : Intention::kCancelled,
+               quant_diff,
+               new_level.price);
+        }
+        else if constexpr (kernel == DiffKernel::kBlock) {
+          // the next levels are likely unchanged too, skip all of them.
+          const auto skipped = detail::CountUnchangedFrom(
+            old_list,
+            old_index + 1,
+            new_list,
+            new_index + 1,
+            std::min(old_size - old_index, new_size - new_index) - 1);
+          old_index += skipped;
+          new_index += skipped;
+        }
+
+        ++new_index;
+        ++old_index;
+        continue;
+      }
+
+      // There is a new order which changes the positions in order book
+      if (is_new_order_placed(new_level.price, old_level.price)) {
+        emit(Intention::kPassive, new_level.quantity, new_level.price);
+        ++new_index;
+        continue;
+      }
+
+      // There is a cancel order which changes the positions in order
+      // book
+      emit(Intention::kCancelled, old_level.quantity, old_level.price);
+      ++old_index;
+    }
+  }
+}   // namespace longlp
+
+#endif   // SIDE_LIST_DIFF_HPP_
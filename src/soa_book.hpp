@@ -0,0 +1,144 @@
+// Copyright 2022 Long Le Phi. All rights reserved.
+// Use of this source code is governed by a MIT license that can be
+// found in the LICENSE file.
+
+#ifndef SOA_BOOK_HPP_
+#define SOA_BOOK_HPP_
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+#include <vector>
+#include "definitions.hpp"
+
+namespace longlp {
+  // A side of a book as a structure of arrays: the prices, quantities and
+  // counts of the levels are stored in their own arrays, so the diff of two
+  // sides compares dense price and quantity blocks. The first |MaxDepth|
+  // levels are stored inline, without any allocation. A deeper side moves
+  // all its levels to heap arrays, which keep their capacity once cleared.
+  //
+  // It has the interface of SideList which the worker uses, but the levels
+  // are returned by value.
+  template <size_t MaxDepth>
+  class SoaSide {
+   public:
+    // the inline levels are swapped in blocks of a fixed size, which are
+    // unrolled and vectorized.
+    static constexpr size_t kSwapBlock = 4;
+    static_assert(MaxDepth > 0 && MaxDepth % kSwapBlock == 0,
+                  "the inline levels should be a multiple of the swap block");
+
+    auto size() const -> size_t { return size_; }
+
+    auto empty() const -> bool { return size_ == 0; }
+
+    auto operator[](const size_t index) const -> Level {
+      return {Prices()[index], Quantities()[index], Counts()[index]};
+    }
+
+    auto front() const -> Level { return (*this)[0]; }
+
+    auto Prices() const -> const Price* {
+      return IsSpilled() ? spilled_prices_.data() : prices_.data();
+    }
+
+    auto Quantities() const -> const Quantity* {
+      return IsSpilled() ? spilled_quantities_.data() : quantities_.data();
+    }
+
+    auto Counts() const -> const uint32_t* {
+      return IsSpilled() ? spilled_counts_.data() : counts_.data();
+    }
+
+    void clear() { size_ = 0; }
+
+    void push_back(const Level& level) {
+      if (size_ < MaxDepth) {
+        prices_[size_]     = level.price;
+        quantities_[size_] = level.quantity;
+        counts_[size_]     = level.count;
+        ++size_;
+        return;
+      }
+
+      if (size_ == MaxDepth) {
+        spilled_prices_.assign(prices_.begin(), prices_.end());
+        spilled_quantities_.assign(quantities_.begin(), quantities_.end());
+        spilled_counts_.assign(counts_.begin(), counts_.end());
+      }
+      spilled_prices_.push_back(level.price);
+      spilled_quantities_.push_back(level.quantity);
+      spilled_counts_.push_back(level.count);
+      ++size_;
+    }
+
+    // Exchange the levels of both sides. Only the inline levels in use are
+    // exchanged, the heap arrays are swapped.
+    friend void swap(SoaSide& lhs, SoaSide& rhs) noexcept {
+      const auto inline_size =
+        std::max(lhs.IsSpilled() ? 0 : lhs.size_,
+                 rhs.IsSpilled() ? 0 : rhs.size_);
+      const auto swap_inline = [inline_size](auto& lhs_array,
+                                             auto& rhs_array) {
+        for (size_t block = 0; block < inline_size; block += kSwapBlock) {
+          for (auto i = block; i < block + kSwapBlock; ++i) {
+            std::swap(lhs_array[i], rhs_array[i]);
+          }
+        }
+      };
+      swap_inline(lhs.prices_, rhs.prices_);
+      swap_inline(lhs.quantities_, rhs.quantities_);
+      swap_inline(lhs.counts_, rhs.counts_);
+
+      lhs.spilled_prices_.swap(rhs.spilled_prices_);
+      lhs.spilled_quantities_.swap(rhs.spilled_quantities_);
+      lhs.spilled_counts_.swap(rhs.spilled_counts_);
+      std::swap(lhs.size_, rhs.size_);
+    }
+
+   private:
+    auto IsSpilled() const -> bool { return size_ > MaxDepth; }
+
+    std::array<Price, MaxDepth> prices_{};
+    std::array<Quantity, MaxDepth> quantities_{};
+    std::array<uint32_t, MaxDepth> counts_{};
+    size_t size_{0};
+
+    // the levels of a side deeper than |MaxDepth|.
+    std::vector<Price> spilled_prices_{};
+    std::vector<Quantity> spilled_quantities_{};
+    std::vector<uint32_t> spilled_counts_{};
+  };
+
+  // An order book whose sides of up to |MaxDepth| levels are stored inline,
+  // e.g. BookT<16> for the usual shallow books: a book is one block of
+  // memory and replacing it does not touch the heap.
+  template <size_t MaxDepth>
+  struct BookT {
+    SoaSide<MaxDepth> bids{};
+    SoaSide<MaxDepth> asks{};
+
+    friend void swap(BookT& lhs, BookT& rhs) noexcept {
+      swap(lhs.bids, rhs.bids);
+      swap(lhs.asks, rhs.asks);
+    }
+  };
+
+  // Copy the levels of |book| into |result|.
+  template <size_t MaxDepth>
+  void ToBook(const OrderBookRecord& book, BookT<MaxDepth>& result) {
+    result.bids.clear();
+    result.asks.clear();
+    for (const auto& level : book.bids) {
+      result.bids.push_back(level);
+    }
+    for (const auto& level : book.asks) {
+      result.asks.push_back(level);
+    }
+  }
+}   // namespace longlp
+
+#endif   // SOA_BOOK_HPP_
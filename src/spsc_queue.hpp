@@ -0,0 +1,99 @@
+// Copyright 2022 Long Le Phi. All rights reserved.
+// Use of this source code is governed by a MIT license that can be
+// found in the LICENSE file.
+
+#ifndef SPSC_QUEUE_HPP_
+#define SPSC_QUEUE_HPP_
+
+#include <atomic>
+#include <cstddef>
+#include <utility>
+#include <vector>
+
+namespace longlp {
+  // A bounded lock-free queue for exactly one producer thread and one consumer
+  // thread. The slots are constructed once and reused, so a slot which owns
+  // heap storage (e.g. an order book) keeps its capacity between messages.
+  template <typename T>
+  class SpscQueue {
+   public:
+    // |capacity| is rounded up to the next power of two.
+    explicit SpscQueue(size_t capacity) :
+      slots_(RoundUpToPowerOfTwo(capacity)),
+      mask_(slots_.size() - 1) {}
+
+    SpscQueue(const SpscQueue&)                    = delete;
+    auto operator=(const SpscQueue&) -> SpscQueue& = delete;
+    SpscQueue(SpscQueue&&)                         = delete;
+    auto operator=(SpscQueue&&) -> SpscQueue&      = delete;
+    ~SpscQueue()                                   = default;
+
+    // Producer side. Fill the next free slot with |fill(T&)|.
+    // Return false if the queue is full.
+    template <typename Fill>
+    auto TryPush(Fill&& fill) -> bool {
+      const auto tail = tail_.load(std::memory_order_relaxed);
+      if (tail - cached_head_ == slots_.size()) {
+        cached_head_ = head_.load(std::memory_order_acquire);
+        if (tail - cached_head_ == slots_.size()) {
+          return false;
+        }
+      }
+
+      std::forward<Fill>(fill)(slots_[tail & mask_]);
+      tail_.store(tail + 1, std::memory_order_release);
+      return true;
+    }
+
+    // Consumer side. Return the oldest slot, or nullptr if the queue is
+    // empty. The slot stays valid until Pop().
+    auto Front() -> T* {
+      const auto head = head_.load(std::memory_order_relaxed);
+      if (head == cached_tail_) {
+        cached_tail_ = tail_.load(std::memory_order_acquire);
+        if (head == cached_tail_) {
+          return nullptr;
+        }
+      }
+      return &slots_[head & mask_];
+    }
+
+    // Consumer side. Release the slot returned by Front().
+    void Pop() {
+      head_.store(head_.load(std::memory_order_relaxed) + 1,
+                  std::memory_order_release);
+    }
+
+    // Any thread. Whether the queue was empty, which may already be stale.
+    auto Empty() const -> bool {
+      return head_.load(std::memory_order_acquire) ==
+             tail_.load(std::memory_order_acquire);
+    }
+
+    auto Capacity() const -> size_t { return slots_.size(); }
+
+   private:
+    static constexpr size_t kCacheLineSize = 64;
+
+    static auto RoundUpToPowerOfTwo(const size_t value) -> size_t {
+      size_t result = 1;
+      while (result < value) {
+        result <<= 1U;
+      }
+      return result;
+    }
+
+    std::vector<T> slots_;
+    size_t mask_;
+
+    // consumer owned, with the last seen producer position.
+    alignas(kCacheLineSize) std::atomic<size_t> head_{0};
+    size_t cached_tail_{0};
+
+    // producer owned, with the last seen consumer position.
+    alignas(kCacheLineSize) std::atomic<size_t> tail_{0};
+    size_t cached_head_{0};
+  };
+}   // namespace longlp
+
+#endif   // SPSC_QUEUE_HPP_
@@ -0,0 +1,347 @@
+// Copyright 2022 Long Le Phi. All rights reserved.
+// Use of this source code is governed by a MIT license that can be
+// found in the LICENSE file.
+
+#include "stealing_feeds_engine.hpp"
+
+#include <algorithm>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include "spsc_queue.hpp"
+#include "thread_affinity.hpp"
+
+namespace longlp {
+  namespace {
+    using Clock = std::chrono::steady_clock;
+
+    // capacity of the first queue segment of a mailbox
+    constexpr size_t kFirstSegmentCapacity = 8;
+  }   // namespace
+
+  // A queue of the messages of a mailbox. Once it is full, the next messages
+  // go to the |next| segment, of twice its capacity: the producer never
+  // pushes into a segment after setting its |next|.
+  struct StealingFeedsEngine::Segment {
+    explicit Segment(const size_t capacity) : queue(capacity) {}
+
+    SpscQueue<FeedRecord> queue;
+    std::atomic<Segment*> next{nullptr};
+  };
+
+  // The pending messages of a symbol, in a chain of segments. It is run by
+  // one thread at a time: the thread which queued it while setting
+  // |scheduled|, or its thief.
+  struct StealingFeedsEngine::Mailbox {
+    Mailbox(const size_t capacity, const size_t home_thread) :
+      head(new Segment(std::min(capacity, kFirstSegmentCapacity))),
+      tail(head),
+      max_capacity(capacity),
+      home(home_thread) {}
+    Mailbox(const Mailbox&)                    = delete;
+    auto operator=(const Mailbox&) -> Mailbox& = delete;
+    Mailbox(Mailbox&&)                         = delete;
+    auto operator=(Mailbox&&) -> Mailbox&      = delete;
+
+    ~Mailbox() {
+      while (head != nullptr) {
+        delete std::exchange(head, head->next.load());
+      }
+    }
+
+    // Producer side. Swap |record| with a free slot, in a new segment if
+    // the last one is full. Return false if it is full at |max_capacity|.
+    auto TryPush(FeedRecord& record) -> bool {
+      const auto fill = [&record](FeedRecord& message) {
+        std::swap(message, record);
+      };
+      if (tail->queue.TryPush(fill)) {
+        return true;
+      }
+      if (tail->queue.Capacity() >= max_capacity) {
+        return false;
+      }
+      auto* next = new Segment(std::min(tail->queue.Capacity() * 2,
+                                        max_capacity));
+      next->queue.TryPush(fill);
+      tail->next.store(next, std::memory_order_release);
+      tail = next;
+      return true;
+    }
+
+    // Consumer side. Return the oldest message, or nullptr if there is
+    // none. The drained segments are released.
+    auto Front() -> FeedRecord* {
+      for (;;) {
+        if (auto* record = head->queue.Front()) {
+          return record;
+        }
+        auto* next = head->next.load(std::memory_order_acquire);
+        if (next == nullptr) {
+          return nullptr;
+        }
+        // the last messages of |head| were pushed before |next| was set.
+        if (auto* record = head->queue.Front()) {
+          return record;
+        }
+        delete std::exchange(head, next);
+      }
+    }
+
+    // Consumer side. Release the message returned by Front().
+    void Pop() {
+      head->queue.Pop();
+      popped.store(popped.load(std::memory_order_relaxed) + 1,
+                   std::memory_order_relaxed);
+    }
+
+    // Any thread. Whether there was no pending message, which may already
+    // be stale.
+    auto Empty() const -> bool {
+      return popped.load() == pushed.load();
+    }
+
+    // consumer owned
+    Segment* head;
+    // producer owned
+    Segment* tail;
+    size_t max_capacity;
+
+    InstrumentFeedsWorker* worker{nullptr};
+    OutputFile* writer{nullptr};
+
+    // set while the symbol is queued on a thread or running.
+    std::atomic<bool> scheduled{false};
+    std::atomic<size_t> home;
+    std::atomic<bool> hot{false};
+
+    // only written by the producer, respectively by the running thread.
+    std::atomic<size_t> pushed{0};
+    std::atomic<size_t> popped{0};
+  };
+
+  struct StealingFeedsEngine::Thread {
+    // the runnable symbols, the owner takes them from the front and the
+    // thieves from the back.
+    std::mutex mutex{};
+    std::deque<Mailbox*> runnable{};
+
+    std::thread thread{};
+
+    // owned by the thread until it is joined.
+    ThreadLoad load{};
+  };
+
+  StealingFeedsEngine::StealingFeedsEngine(const StealingOptions& options) :
+    options_(options) {
+    options_.threads = std::max<size_t>(options_.threads, 1);
+    options_.batch   = std::max<size_t>(options_.batch, 1);
+    const auto cores = std::max(std::thread::hardware_concurrency(), 1U);
+
+    threads_.reserve(options_.threads);
+    for (size_t i = 0; i < options_.threads; ++i) {
+      threads_.emplace_back(std::make_unique<Thread>());
+    }
+    // every thread may steal from the others, which all exist by now.
+    for (size_t i = 0; i < options_.threads; ++i) {
+      threads_[i]->thread = std::thread([this, i] { Run(i); });
+      PinToCore(threads_[i]->thread, i % cores);
+    }
+  }
+
+  StealingFeedsEngine::~StealingFeedsEngine() {
+    if (!stopped_) {
+      Stop();
+    }
+  }
+
+  void StealingFeedsEngine::Push(const SymbolId symbol,
+                                 InstrumentFeedsWorker& worker,
+                                 OutputFile* writer,
+                                 FeedRecord& record) {
+    if (symbol >= mailboxes_.size()) {
+      mailboxes_.resize(symbol + 1);
+    }
+    auto& slot = mailboxes_[symbol];
+    if (slot == nullptr) {
+      // the dense symbol ids are dealt to the threads in turn.
+      slot = std::make_unique<Mailbox>(options_.mailbox_capacity,
+                                       symbol % threads_.size());
+      slot->worker = &worker;
+      slot->writer = writer;
+    }
+    auto& mailbox = *slot;
+
+    while (!mailbox.TryPush(record)) {
+      std::this_thread::yield();
+    }
+
+    ++pushed_;
+    const auto pushed = mailbox.pushed.load(std::memory_order_relaxed) + 1;
+    mailbox.pushed.store(pushed, std::memory_order_relaxed);
+    const auto hot = pushed_ >= options_.hot_min_messages &&
+                     static_cast<double>(pushed) >
+                       options_.hot_share * static_cast<double>(pushed_);
+    if (hot != mailbox.hot.load(std::memory_order_relaxed)) {
+      mailbox.hot.store(hot, std::memory_order_relaxed);
+    }
+
+    // pairs with the fence of Drain(): either the running thread sees this
+    // message, or this push sees that the symbol is not scheduled anymore.
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (!mailbox.scheduled.exchange(true)) {
+      Schedule(mailbox, mailbox.home.load(std::memory_order_relaxed));
+    }
+  }
+
+  void StealingFeedsEngine::Schedule(Mailbox& mailbox, const size_t thread) {
+    {
+      auto& owner = *threads_[thread];
+      const std::lock_guard<std::mutex> lock{owner.mutex};
+      owner.runnable.push_back(&mailbox);
+    }
+
+    // pairs with Park(): either a parked thread is woken up, or it sees
+    // this schedule before waiting. Any thread may steal the symbol.
+    schedules_.fetch_add(1);
+    if (idle_threads_.load() > 0) {
+      const std::lock_guard<std::mutex> lock{idle_mutex_};
+      idle_.notify_all();
+    }
+  }
+
+  void StealingFeedsEngine::Run(const size_t thread) {
+    for (;;) {
+      const auto schedules = schedules_.load();
+      auto* mailbox        = NextMailbox(thread);
+      if (mailbox == nullptr) {
+        if (done_.load(std::memory_order_acquire)) {
+          // after done, only this thread queues symbols on itself: the last
+          // symbols were queued by the producer before done.
+          mailbox = NextMailbox(thread);
+          if (mailbox == nullptr) {
+            return;
+          }
+        }
+        else {
+          Park(schedules);
+          continue;
+        }
+      }
+      Drain(*mailbox, thread);
+    }
+  }
+
+  void StealingFeedsEngine::Park(const uint64_t schedules) {
+    idle_threads_.fetch_add(1);
+    {
+      std::unique_lock<std::mutex> lock{idle_mutex_};
+      idle_.wait(lock, [this, schedules] {
+        return schedules_.load() != schedules || done_.load();
+      });
+    }
+    idle_threads_.fetch_sub(1);
+  }
+
+  auto StealingFeedsEngine::NextMailbox(const size_t thread) -> Mailbox* {
+    auto& self = *threads_[thread];
+    {
+      const std::lock_guard<std::mutex> lock{self.mutex};
+      if (!self.runnable.empty()) {
+        auto* mailbox = self.runnable.front();
+        self.runnable.pop_front();
+        return mailbox;
+      }
+    }
+
+    for (size_t i = 1; i < threads_.size(); ++i) {
+      auto& victim = *threads_[(thread + i) % threads_.size()];
+      const std::lock_guard<std::mutex> lock{victim.mutex};
+      const auto stolen =
+        std::find_if(victim.runnable.rbegin(),
+                     victim.runnable.rend(),
+                     [](const Mailbox* mailbox) {
+                       return !mailbox->hot.load(std::memory_order_relaxed);
+                     });
+      if (stolen != victim.runnable.rend()) {
+        auto* mailbox = *stolen;
+        victim.runnable.erase(std::next(stolen).base());
+        // the next messages of the symbol are queued on its new home.
+        mailbox->home.store(thread, std::memory_order_relaxed);
+        ++self.load.steals;
+        return mailbox;
+      }
+    }
+    return nullptr;
+  }
+
+  void StealingFeedsEngine::Drain(Mailbox& mailbox, const size_t thread) {
+    auto& load       = threads_[thread]->load;
+    const auto start = Clock::now();
+
+    size_t drained = 0;
+    for (; drained < options_.batch; ++drained) {
+      auto* record = mailbox.Front();
+      if (record == nullptr) {
+        break;
+      }
+      if (record->type == FeedRecord::Type::kBook) {
+        // the slot gets back the storage of the previous live book, which
+        // is recycled by the producer for a next snapshot.
+        mailbox.worker->UpdateBookChanges(record->book,
+                                          mailbox.writer->Buffer());
+        mailbox.writer->FlushIfFull();
+      }
+      else {
+        mailbox.worker->RecordNewTrade(record->trade);
+      }
+      mailbox.Pop();
+    }
+
+    load.messages += drained;
+    load.busy += Clock::now() - start;
+    ++load.runs;
+
+    // a message pushed meanwhile is either seen here, or its push queues the
+    // symbol again. The mailbox is only peeked, as the symbol may already be
+    // run by another thread.
+    mailbox.scheduled.store(false);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (!mailbox.Empty() && !mailbox.scheduled.exchange(true)) {
+      Schedule(mailbox, thread);
+    }
+  }
+
+  auto StealingFeedsEngine::Stop() -> StealingRunReport {
+    stopped_ = true;
+    {
+      const std::lock_guard<std::mutex> lock{idle_mutex_};
+      done_.store(true, std::memory_order_release);
+    }
+    idle_.notify_all();
+
+    StealingRunReport report{};
+    for (auto& thread : threads_) {
+      if (thread->thread.joinable()) {
+        thread->thread.join();
+      }
+      report.messages += thread->load.messages;
+      report.threads.push_back(thread->load);
+    }
+
+    if (report.messages > 0) {
+      const auto busiest =
+        std::max_element(report.threads.begin(),
+                         report.threads.end(),
+                         [](const ThreadLoad& lhs, const ThreadLoad& rhs) {
+                           return lhs.messages < rhs.messages;
+                         });
+      const auto mean = static_cast<double>(report.messages) /
+                        static_cast<double>(report.threads.size());
+      report.imbalance = static_cast<double>(busiest->messages) / mean;
+      report.rebalance = report.imbalance > kRebalanceImbalance;
+    }
+    return report;
+  }
+}   // namespace longlp
@@ -0,0 +1,135 @@
+// Copyright 2022 Long Le Phi. All rights reserved.
+// Use of this source code is governed by a MIT license that can be
+// found in the LICENSE file.
+
+#ifndef STEALING_FEEDS_ENGINE_HPP_
+#define STEALING_FEEDS_ENGINE_HPP_
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <vector>
+#include "definitions.hpp"
+#include "instrument_feeds_worker.hpp"
+#include "output_file.hpp"
+#include "symbol_table.hpp"
+
+namespace longlp {
+  struct StealingOptions {
+    size_t threads{1};
+    // maximum capacity of the message queue of every symbol. A queue starts
+    // with a few slots and doubles while its messages are waiting, so the
+    // quiet symbols only hold a few slots.
+    size_t mailbox_capacity{256};
+    // maximum number of messages of a symbol drained by a run, before the
+    // thread picks its next symbol.
+    size_t batch{64};
+    // a symbol which received more than this share of the messages is hot:
+    // it is never stolen, so it keeps its home thread.
+    double hot_share{0.05};
+    // no symbol is hot before this number of messages, the shares of the
+    // first messages say nothing, e.g. every symbol has a large share of
+    // them.
+    size_t hot_min_messages{1024};
+  };
+
+  // The load of a thread of a stealing run.
+  struct ThreadLoad {
+    size_t messages{0};
+    // number of symbol runs, and how many of them were stolen.
+    size_t runs{0};
+    size_t steals{0};
+    // time spent processing the messages
+    std::chrono::nanoseconds busy{0};
+  };
+
+  struct StealingRunReport {
+    size_t messages{0};
+    std::vector<ThreadLoad> threads{};
+    // the messages of the busiest thread over the mean of the threads.
+    double imbalance{0.0};
+    // set if |imbalance| is above kRebalanceImbalance: the homes of the
+    // symbols should be dealt again, e.g. by weighting their activity.
+    bool rebalance{false};
+  };
+
+  // An execution engine where every symbol has a home thread, so its
+  // consecutive messages are classified on the same core while its live book
+  // is still in cache. The messages of a symbol are queued in its mailbox,
+  // and the symbol itself is queued on its home thread once it has pending
+  // messages. A thread runs a symbol by draining a batch of its mailbox.
+  //
+  // A thread without any runnable symbol steals a whole waiting symbol from
+  // another thread, never a single message: the symbol moves home, as its
+  // next messages are also better classified there. The hot symbols are
+  // never stolen, they stay on their home thread.
+  //
+  // Push() must always be called from the same producer thread.
+  class StealingFeedsEngine {
+   public:
+    static constexpr double kRebalanceImbalance = 1.5;
+
+    explicit StealingFeedsEngine(const StealingOptions& options);
+    StealingFeedsEngine(const StealingFeedsEngine&)                    = delete;
+    auto operator=(const StealingFeedsEngine&) -> StealingFeedsEngine& = delete;
+    StealingFeedsEngine(StealingFeedsEngine&&)                         = delete;
+    auto operator=(StealingFeedsEngine&&) -> StealingFeedsEngine&      = delete;
+    ~StealingFeedsEngine();
+
+    // Queue |record| into the mailbox of |symbol|, the worker and writer must
+    // be owned by this symbol. Spin while the mailbox is full at its maximum
+    // capacity.
+    // The storage of |record| is swapped with a recycled mailbox slot.
+    void Push(SymbolId symbol,
+              InstrumentFeedsWorker& worker,
+              OutputFile* writer,
+              FeedRecord& record);
+
+    // Drain every mailbox and join the threads.
+    auto Stop() -> StealingRunReport;
+
+   private:
+    struct Segment;
+    struct Mailbox;
+    struct Thread;
+
+    // Queue |mailbox| on the runnable symbols of |thread|.
+    void Schedule(Mailbox& mailbox, size_t thread);
+
+    // Run the symbols of |thread| until stopped.
+    void Run(size_t thread);
+
+    // Block until a symbol is queued after the |schedules| first ones, or
+    // until stopped.
+    void Park(uint64_t schedules);
+
+    // Take a runnable symbol of |thread|, or steal one from another thread.
+    // Return nullptr if there is none.
+    auto NextMailbox(size_t thread) -> Mailbox*;
+
+    // Classify a batch of the messages of |mailbox| on |thread|.
+    void Drain(Mailbox& mailbox, size_t thread);
+
+    StealingOptions options_;
+
+    // indexed by symbol id, only accessed by the producer.
+    std::vector<std::unique_ptr<Mailbox>> mailboxes_{};
+    size_t pushed_{0};
+
+    std::vector<std::unique_ptr<Thread>> threads_{};
+    std::atomic<bool> done_{false};
+    bool stopped_{false};
+
+    // the threads without any runnable symbol wait for the next Schedule().
+    std::mutex idle_mutex_{};
+    std::condition_variable idle_{};
+    std::atomic<size_t> idle_threads_{0};
+    // number of Schedule() calls
+    std::atomic<uint64_t> schedules_{0};
+  };
+}   // namespace longlp
+
+#endif   // STEALING_FEEDS_ENGINE_HPP_
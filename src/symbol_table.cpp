@@ -0,0 +1,25 @@
+// Copyright 2022 Long Le Phi. All rights reserved.
+// Use of this source code is governed by a MIT license that can be
+// found in the LICENSE file.
+
+#include "symbol_table.hpp"
+
+namespace longlp {
+  auto SymbolTable::Intern(const std::string_view symbol, bool& inserted)
+    -> SymbolId {
+    if (const auto id_it = ids_.find(symbol); id_it != ids_.end()) {
+      inserted = false;
+      return id_it->second;
+    }
+
+    const auto id = static_cast<SymbolId>(names_.size());
+    ids_.emplace(names_.emplace_back(symbol), id);
+    inserted = true;
+    return id;
+  }
+
+  auto SymbolTable::Find(const std::string_view symbol) const -> SymbolId {
+    const auto id_it = ids_.find(symbol);
+    return id_it == ids_.end() ? kInvalidSymbolId : id_it->second;
+  }
+}   // namespace longlp
@@ -0,0 +1,48 @@
+// Copyright 2022 Long Le Phi. All rights reserved.
+// Use of this source code is governed by a MIT license that can be
+// found in the LICENSE file.
+
+#ifndef SYMBOL_TABLE_HPP_
+#define SYMBOL_TABLE_HPP_
+
+#include <cstdint>
+#include <deque>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+namespace longlp {
+  // Dense identifier of an interned symbol: 0, 1, 2... in interning order.
+  using SymbolId = uint32_t;
+
+  constexpr SymbolId kInvalidSymbolId = UINT32_MAX;
+
+  // Intern the instrument symbols into dense identifiers, so the per-symbol
+  // states can live in vectors indexed by identifier instead of string keyed
+  // maps. It is not thread safe.
+  class SymbolTable {
+   public:
+    // Return the identifier of |symbol|, a new one is assigned to an unknown
+    // symbol. |inserted| is set if the symbol is new.
+    auto Intern(std::string_view symbol, bool& inserted) -> SymbolId;
+
+    // Return the identifier of |symbol|, kInvalidSymbolId if it is unknown.
+    auto Find(std::string_view symbol) const -> SymbolId;
+
+    auto Name(SymbolId id) const -> const std::string& {
+      return names_[id];
+    }
+
+    auto Size() const -> size_t {
+      return names_.size();
+    }
+
+   private:
+    // a deque never moves its elements, thus the keys of |ids_| can view the
+    // names.
+    std::deque<std::string> names_{};
+    std::unordered_map<std::string_view, SymbolId> ids_{};
+  };
+}   // namespace longlp
+
+#endif   // SYMBOL_TABLE_HPP_
@@ -0,0 +1,30 @@
+// Copyright 2022 Long Le Phi. All rights reserved.
+// Use of this source code is governed by a MIT license that can be
+// found in the LICENSE file.
+
+#ifndef THREAD_AFFINITY_HPP_
+#define THREAD_AFFINITY_HPP_
+
+#include <cstddef>
+#include <thread>
+
+#if defined(__linux__)
+#  include <pthread.h>
+#  include <sched.h>
+#endif
+
+namespace longlp {
+  // Pin |thread| to |core|. It is a no-op on platforms without a thread
+  // affinity API.
+  inline void PinToCore([[maybe_unused]] std::thread& thread,
+                        [[maybe_unused]] const size_t core) {
+#if defined(__linux__)
+    cpu_set_t cpu_set{};
+    CPU_ZERO(&cpu_set);
+    CPU_SET(core, &cpu_set);
+    pthread_setaffinity_np(thread.native_handle(), sizeof(cpu_set), &cpu_set);
+#endif
+  }
+}   // namespace longlp
+
+#endif   // THREAD_AFFINITY_HPP_
@@ -0,0 +1,183 @@
+// Copyright 2022 Long Le Phi. All rights reserved.
+// Use of this source code is governed by a MIT license that can be
+// found in the LICENSE file.
+
+#include "async_writer.hpp"
+
+#include <fmt/format.h>
+#include <gtest/gtest.h>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <thread>
+#include <vector>
+#include "output_file.hpp"
+
+namespace longlp {
+  namespace {
+    auto ReadFile(const std::filesystem::path& path) -> std::string {
+      std::string content(std::filesystem::file_size(path), '\0');
+      std::ifstream opener(path, std::ios::binary);
+      opener.read(content.data(), static_cast<std::streamsize>(content.size()));
+      return content;
+    }
+
+    // a directory of the running test, so the tests can run in parallel.
+    auto OutputDirectory() -> std::filesystem::path {
+      const auto* test =
+        ::testing::UnitTest::GetInstance()->current_test_info();
+      const auto directory =
+        std::filesystem::temp_directory_path() /
+        (std::string{"async_writer_unittest_"} + test->name());
+      std::filesystem::create_directories(directory);
+      return directory;
+    }
+
+    constexpr OutputBackend kBackends[] = {OutputBackend::kIoUring,
+                                           OutputBackend::kThreads};
+  }   // namespace
+
+  TEST(AsyncWriter, AppendsInOrder) {
+    constexpr auto kFiles  = 20U;
+    constexpr auto kWrites = 400U;
+
+    for (const auto backend : kBackends) {
+      const auto directory = OutputDirectory();
+
+      // every file is truncated by its first write.
+      std::ofstream(directory / "0.txt") << "stale content";
+
+      AsyncWriterOptions options{};
+      options.backend        = backend;
+      options.max_open_files = 3;
+      options.queue_depth    = 4;
+
+      std::vector<std::string> expected(kFiles);
+      AsyncWriterReport report{};
+      {
+        AsyncWriter writer{options};
+        for (auto i = 0U; i < kFiles; ++i) {
+          const auto path = directory / fmt::format("{}.txt", i);
+          EXPECT_EQ(writer.AddFile(path.string(), 0), i);
+        }
+
+        std::string bytes{};
+        for (auto i = 0U; i < kWrites; ++i) {
+          const auto file = (i * 7U) % kFiles;
+          bytes           = fmt::format("write {} of file {}\n", i, file);
+          expected[file] += bytes;
+          writer.Write(file, bytes);
+          EXPECT_TRUE(bytes.empty());
+        }
+        writer.Drain();
+        report = writer.Report();
+      }
+
+      EXPECT_EQ(report.writes, kWrites);
+      EXPECT_EQ(report.failures, 0U);
+      // the files are written in turn, so they are closed then reopened.
+      EXPECT_GT(report.opens, kFiles);
+      for (auto i = 0U; i < kFiles; ++i) {
+        EXPECT_EQ(ReadFile(directory / fmt::format("{}.txt", i)), expected[i])
+          << i;
+      }
+      std::filesystem::remove_all(directory);
+    }
+  }
+
+  TEST(AsyncWriter, BoundedPendingBytes) {
+    constexpr auto kThreads = 4U;
+    constexpr auto kWrites  = 500U;
+
+    for (const auto backend : kBackends) {
+      const auto directory = OutputDirectory();
+
+      // a write waits as soon as another one is pending.
+      AsyncWriterOptions options{};
+      options.backend           = backend;
+      options.max_pending_bytes = 1;
+
+      {
+        AsyncWriter writer{options};
+        std::vector<uint32_t> files{};
+        for (auto i = 0U; i < kThreads; ++i) {
+          const auto path = directory / fmt::format("{}.txt", i);
+          files.push_back(writer.AddFile(path.string(), 0));
+        }
+
+        std::vector<std::thread> threads{};
+        for (auto i = 0U; i < kThreads; ++i) {
+          threads.emplace_back([&writer, &files, i] {
+            std::string bytes{};
+            for (auto j = 0U; j < kWrites; ++j) {
+              bytes = fmt::format("{}\n", j);
+              writer.Write(files[i], bytes);
+            }
+          });
+        }
+        for (auto& thread : threads) {
+          thread.join();
+        }
+        // the destructor writes out the pending bytes.
+      }
+
+      std::string expected{};
+      for (auto j = 0U; j < kWrites; ++j) {
+        expected += fmt::format("{}\n", j);
+      }
+      for (auto i = 0U; i < kThreads; ++i) {
+        EXPECT_EQ(ReadFile(directory / fmt::format("{}.txt", i)), expected)
+          << i;
+      }
+      std::filesystem::remove_all(directory);
+    }
+  }
+
+  TEST(AsyncWriter, AttachedOutputFile) {
+    for (const auto backend : kBackends) {
+      const auto directory = OutputDirectory();
+      const auto path      = directory / "attached.txt";
+
+      AsyncWriterOptions options{};
+      options.backend = backend;
+      AsyncWriter writer{options};
+
+      OutputFile file{};
+      file.Attach(writer, writer.AddFile(path.string(), 0), 0);
+      file.Append("PASSIVE BUY 100.00 @ 1.00\n");
+      EXPECT_TRUE(file.Flush());
+      file.Buffer() += "CANCEL SELL 1.00 @ 2.00\n";
+      file.Close();
+
+      writer.Drain();
+      EXPECT_EQ(ReadFile(path),
+                "PASSIVE BUY 100.00 @ 1.00\nCANCEL SELL 1.00 @ 2.00\n");
+      EXPECT_EQ(writer.Report().writes, 2U);
+      std::filesystem::remove_all(directory);
+    }
+  }
+
+  TEST(AsyncWriter, ResumedFile) {
+    for (const auto backend : kBackends) {
+      const auto directory = OutputDirectory();
+      const auto path      = directory / "resumed.txt";
+      std::ofstream(path) << "kept\n";
+
+      AsyncWriterOptions options{};
+      options.backend        = backend;
+      options.max_open_files = 1;
+      {
+        AsyncWriter writer{options};
+        const auto resumed = writer.AddFile(path.string(), 5);
+        const auto other   = writer.AddFile((directory / "other").string(), 0);
+        for (const auto file : {resumed, other, resumed}) {
+          std::string bytes{"written\n"};
+          writer.Write(file, bytes);
+          writer.Drain();
+        }
+      }
+      EXPECT_EQ(ReadFile(path), "kept\nwritten\nwritten\n");
+      std::filesystem::remove_all(directory);
+    }
+  }
+}   // namespace longlp
@@ -0,0 +1,119 @@
+// Copyright 2022 Long Le Phi. All rights reserved.
+// Use of this source code is governed by a MIT license that can be
+// found in the LICENSE file.
+
+#include "binary_feed.hpp"
+
+#include <gtest/gtest.h>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <vector>
+
+namespace longlp {
+  namespace {
+    auto MakeBookRecord(const std::string& symbol,
+                        const SideList& bids,
+                        const SideList& asks) -> FeedRecord {
+      FeedRecord record{};
+      record.type      = FeedRecord::Type::kBook;
+      record.symbol    = symbol;
+      record.book.bids = bids;
+      record.book.asks = asks;
+      return record;
+    }
+
+    auto MakeTradeRecord(const std::string& symbol,
+                         const Quantity quantity,
+                         const Price price) -> FeedRecord {
+      FeedRecord record{};
+      record.type   = FeedRecord::Type::kTrade;
+      record.symbol = symbol;
+      record.trade  = {quantity, price};
+      return record;
+    }
+
+    void ExpectSameRecord(const FeedRecord& actual,
+                          const FeedRecord& expected) {
+      ASSERT_EQ(actual.type, expected.type);
+      EXPECT_EQ(actual.symbol, expected.symbol);
+      if (expected.type == FeedRecord::Type::kTrade) {
+        EXPECT_EQ(actual.trade.quantity, expected.trade.quantity);
+        EXPECT_EQ(actual.trade.price, expected.trade.price);
+        return;
+      }
+
+      const auto expect_same_side = [](const SideList& lhs,
+                                       const SideList& rhs) {
+        ASSERT_EQ(lhs.size(), rhs.size());
+        for (size_t i = 0; i < lhs.size(); ++i) {
+          EXPECT_EQ(lhs[i].price, rhs[i].price);
+          EXPECT_EQ(lhs[i].quantity, rhs[i].quantity);
+          EXPECT_EQ(lhs[i].count, rhs[i].count);
+        }
+      };
+      expect_same_side(actual.book.bids, expected.book.bids);
+      expect_same_side(actual.book.asks, expected.book.asks);
+    }
+  }   // namespace
+
+  TEST(BinaryFeed, RoundTrip) {
+    const auto path =
+      std::filesystem::temp_directory_path() / "binary_feed_unittest.bin";
+
+    const std::vector<FeedRecord> records = {
+      MakeBookRecord("AAA", {{644, 2400, 2}, {643, 100, 1}}, {{645, 10, 1}}),
+      MakeBookRecord("BBB", {}, {{1000, 5, 1}}),
+      MakeTradeRecord("AAA", 100, 645),
+      MakeBookRecord("AAA", {{644, 2400, 2}}, {}),
+    };
+
+    BinaryFeedWriter writer{};
+    ASSERT_TRUE(writer.Open(path.string()));
+    for (const auto& record : records) {
+      writer.Write(record);
+    }
+    ASSERT_TRUE(writer.Close());
+    EXPECT_TRUE(IsBinaryFeedFile(path.string()));
+
+    BinaryFeedReader reader{};
+    ASSERT_TRUE(reader.Open(path.string()));
+    EXPECT_EQ(reader.RecordCount(), records.size());
+
+    FeedRecord record{};
+    for (const auto& expected : records) {
+      ASSERT_TRUE(reader.Next(record));
+      ExpectSameRecord(record, expected);
+    }
+    EXPECT_FALSE(reader.Next(record));
+    EXPECT_FALSE(reader.Failed());
+
+    // the symbols are also read as their identifiers in the file.
+    ASSERT_TRUE(reader.Open(path.string()));
+    ASSERT_EQ(reader.SymbolCount(), 2U);
+    SymbolId symbol = 0;
+    for (const auto& expected : records) {
+      ASSERT_TRUE(reader.Next(record, symbol));
+      EXPECT_EQ(reader.Symbol(symbol), expected.symbol);
+    }
+    EXPECT_FALSE(reader.Next(record, symbol));
+
+    std::filesystem::remove(path);
+  }
+
+  TEST(BinaryFeed, RejectOtherFiles) {
+    const auto path =
+      std::filesystem::temp_directory_path() / "binary_feed_unittest.json";
+    {
+      std::ofstream writer(path);
+      writer << R"({"book":{"symbol":"AAA","bid":[],"ask":[]}})" << '\n';
+    }
+
+    EXPECT_FALSE(IsBinaryFeedFile(path.string()));
+    BinaryFeedReader reader{};
+    EXPECT_FALSE(reader.Open(path.string()));
+
+    std::filesystem::remove(path);
+    EXPECT_FALSE(IsBinaryFeedFile(path.string()));
+  }
+}   // namespace longlp
@@ -0,0 +1,134 @@
+// Copyright 2022 Long Le Phi. All rights reserved.
+// Use of this source code is governed by a MIT license that can be
+// found in the LICENSE file.
+
+#include "book_analytics.hpp"
+
+#include <gtest/gtest.h>
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include "instrument_feeds_worker.hpp"
+#include "soa_book.hpp"
+#include "test_records.hpp"
+
+namespace longlp {
+  namespace {
+    using test::MakeBook;
+    using test::MakeTrade;
+
+    // a file of the running test, so the tests can run in parallel.
+    auto OutputPath() -> std::string {
+      const auto* test =
+        ::testing::UnitTest::GetInstance()->current_test_info();
+      return (std::filesystem::temp_directory_path() /
+              (std::string{"book_analytics_unittest_"} + test->name() +
+               ".csv"))
+        .string();
+    }
+
+    // Return the fields of every line of the series of |path|, after the
+    // header line.
+    auto ReadSeries(const std::string& path)
+      -> std::vector<std::vector<std::string>> {
+      std::ifstream reader(path);
+      std::string line{};
+      std::getline(reader, line);
+      EXPECT_EQ(line, "book,spread,mid,microprice,imbalance,vwap,volume");
+
+      std::vector<std::vector<std::string>> result{};
+      while (std::getline(reader, line)) {
+        auto& fields = result.emplace_back();
+        std::stringstream stream{line};
+        for (std::string field{}; std::getline(stream, field, ',');) {
+          fields.push_back(field);
+        }
+        // a trailing empty field is not read by getline
+        if (line.back() == ',') {
+          fields.emplace_back();
+        }
+      }
+      return result;
+    }
+
+    // Expect the fields of a line: the empty values are undefined.
+    void ExpectLine(const std::vector<std::string>& fields,
+                    const std::vector<double>& values,
+                    const std::vector<bool>& defined) {
+      ASSERT_EQ(fields.size(), values.size());
+      for (size_t i = 0; i < fields.size(); ++i) {
+        if (!defined[i]) {
+          EXPECT_TRUE(fields[i].empty()) << i;
+          continue;
+        }
+        ASSERT_FALSE(fields[i].empty()) << i;
+        EXPECT_NEAR(std::stod(fields[i]), values[i], 1e-3) << i;
+      }
+    }
+  }   // namespace
+
+  TEST(BookAnalytics, Series) {
+    AnalyticsOptions options{};
+    options.depth_levels = 2;
+    BookAnalytics analytics{options};
+    ASSERT_TRUE(analytics.Output().Open(OutputPath()));
+
+    analytics.Record(MakeBook({{1, 5, 100}, {1, 10, 99}, {1, 100, 98}},
+                              {{1, 15, 101}, {1, 10, 102}}),
+                     {});
+    // a deeper level changes, it is skipped.
+    analytics.Record(MakeBook({{1, 5, 100}, {1, 10, 99}, {1, 50, 98}},
+                              {{1, 15, 101}, {1, 10, 102}}),
+                     {});
+    analytics.Record(MakeBook({{1, 5, 100}}, {{1, 10, 102}}),
+                     {MakeTrade(2, 101), MakeTrade(6, 101.5)});
+    analytics.Record(MakeBook({{1, 5, 100}}, {}), {});
+    analytics.Output().Close();
+
+    const auto series = ReadSeries(OutputPath());
+    ASSERT_EQ(series.size(), 3U);
+    ExpectLine(series[0],
+               {0, 1, 100.5, 100.25, (15 - 25) / 40.0, 0, 0},
+               {true, true, true, true, true, false, false});
+    ExpectLine(series[1],
+               {2, 2, 101, 100.6667, (5 - 10) / 15.0, 101.375, 8},
+               {true, true, true, true, true, true, true});
+    ExpectLine(series[2],
+               {3, 0, 0, 0, 1, 0, 0},
+               {true, false, false, false, true, false, false});
+    std::filesystem::remove(OutputPath());
+  }
+
+  TEST(BookAnalytics, AttachedToWorker) {
+    BookAnalytics analytics{AnalyticsOptions{}};
+    ASSERT_TRUE(analytics.Output().Open(OutputPath()));
+
+    // the inline books have the same series.
+    BasicInstrumentFeedsWorker<BookT<16>> worker{};
+    worker.AttachAnalytics(&analytics);
+
+    BookT<16> book{};
+    std::string output{};
+    ToBook(MakeBook({{1, 100, 10}}, {{1, 100, 11}}), book);
+    worker.UpdateBookChanges(book, output);
+    worker.RecordNewTrade(MakeTrade(40, 11));
+    ToBook(MakeBook({{1, 100, 10}}, {{1, 60, 11}}), book);
+    worker.UpdateBookChanges(book, output);
+    EXPECT_EQ(output, "AGGRESSIVE BUY 40.00 @ 11.00\n");
+
+    // nothing is recorded once detached.
+    worker.AttachAnalytics(nullptr);
+    ToBook(MakeBook({{1, 100, 10}}, {{1, 100, 11}}), book);
+    worker.UpdateBookChanges(book, output);
+    analytics.Output().Close();
+
+    const auto series = ReadSeries(OutputPath());
+    ASSERT_EQ(series.size(), 2U);
+    ExpectLine(series[1],
+               {1, 1, 10.5, 10.625, 0.25, 11, 40},
+               {true, true, true, true, true, true, true});
+    std::filesystem::remove(OutputPath());
+  }
+}   // namespace longlp
@@ -0,0 +1,101 @@
+// Copyright 2022 Long Le Phi. All rights reserved.
+// Use of this source code is governed by a MIT license that can be
+// found in the LICENSE file.
+
+#include "checkpoint.hpp"
+
+#include <gtest/gtest.h>
+#include <filesystem>
+#include <fstream>
+#include <string>
+
+namespace longlp {
+  namespace {
+    auto ReadFile(const std::filesystem::path& path) -> std::string {
+      std::string content(std::filesystem::file_size(path), '\0');
+      std::ifstream opener(path, std::ios::binary);
+      opener.read(content.data(), static_cast<std::streamsize>(content.size()));
+      return content;
+    }
+
+    auto MakeCheckpoint() -> Checkpoint {
+      Checkpoint checkpoint{};
+      checkpoint.inputs   = {"first.json", "second.json"};
+      checkpoint.position = {1, 4096, 37};
+      checkpoint.lines    = 120;
+
+      auto& symbol       = checkpoint.symbols.emplace_back();
+      symbol.symbol      = "AAA";
+      symbol.book.bids   = {{10000, 5, 1}, {9900, 7, 1}};
+      symbol.book.asks   = {{10100, 3, 1}};
+      symbol.trades      = {{2, 10100}, {1, 10000}};
+      symbol.output_size = 1234;
+
+      // a symbol with an empty side and no pending trade.
+      auto& other     = checkpoint.symbols.emplace_back();
+      other.symbol    = "BB";
+      other.book.asks = {{500, 1, 1}};
+      return checkpoint;
+    }
+
+    void ExpectSameSide(const SideList& side, const SideList& expected) {
+      ASSERT_EQ(side.size(), expected.size());
+      for (size_t i = 0; i < side.size(); ++i) {
+        EXPECT_EQ(side[i].price, expected[i].price);
+        EXPECT_EQ(side[i].quantity, expected[i].quantity);
+        EXPECT_EQ(side[i].count, expected[i].count);
+      }
+    }
+  }   // namespace
+
+  TEST(Checkpoint, RoundTrip) {
+    const auto path = std::filesystem::temp_directory_path() /
+                      "checkpoint_unittest_round_trip.bin";
+    const auto checkpoint = MakeCheckpoint();
+    ASSERT_TRUE(SaveCheckpoint(checkpoint, path.string()));
+
+    Checkpoint loaded{};
+    ASSERT_TRUE(LoadCheckpoint(path.string(), loaded));
+    EXPECT_EQ(loaded.inputs, checkpoint.inputs);
+    EXPECT_EQ(loaded.position.file, 1U);
+    EXPECT_EQ(loaded.position.offset, 4096U);
+    EXPECT_EQ(loaded.position.line, 37U);
+    EXPECT_EQ(loaded.lines, 120U);
+    ASSERT_EQ(loaded.symbols.size(), 2U);
+    for (size_t i = 0; i < loaded.symbols.size(); ++i) {
+      const auto& expected = checkpoint.symbols[i];
+      const auto& symbol   = loaded.symbols[i];
+      EXPECT_EQ(symbol.symbol, expected.symbol);
+      ExpectSameSide(symbol.book.bids, expected.book.bids);
+      ExpectSameSide(symbol.book.asks, expected.book.asks);
+      ASSERT_EQ(symbol.trades.size(), expected.trades.size());
+      for (size_t j = 0; j < symbol.trades.size(); ++j) {
+        EXPECT_EQ(symbol.trades[j].price, expected.trades[j].price);
+        EXPECT_EQ(symbol.trades[j].quantity, expected.trades[j].quantity);
+      }
+      EXPECT_EQ(symbol.output_size, expected.output_size);
+    }
+    std::filesystem::remove(path);
+  }
+
+  TEST(Checkpoint, MalformedFile) {
+    const auto path = std::filesystem::temp_directory_path() /
+                      "checkpoint_unittest_malformed.bin";
+
+    Checkpoint loaded{};
+    std::filesystem::remove(path);
+    EXPECT_FALSE(LoadCheckpoint(path.string(), loaded));
+
+    ASSERT_TRUE(SaveCheckpoint(MakeCheckpoint(), path.string()));
+    const auto content = ReadFile(path);
+
+    // truncated, with trailing bytes, then with another magic.
+    for (const auto& malformed : {content.substr(0, content.size() - 1),
+                                  content + "x",
+                                  "X" + content.substr(1)}) {
+      std::ofstream(path, std::ios::binary) << malformed;
+      EXPECT_FALSE(LoadCheckpoint(path.string(), loaded));
+    }
+    std::filesystem::remove(path);
+  }
+}   // namespace longlp
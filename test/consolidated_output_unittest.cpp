@@ -0,0 +1,150 @@
+// Copyright 2022 Long Le Phi. All rights reserved.
+// Use of this source code is governed by a MIT license that can be
+// found in the LICENSE file.
+
+#include "consolidated_output.hpp"
+
+#include <fmt/format.h>
+#include <gtest/gtest.h>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <thread>
+#include <vector>
+#include "async_writer.hpp"
+
+namespace longlp {
+  namespace {
+    constexpr auto kSymbols = 3U;
+    constexpr auto kFlushes = 50U;
+
+    // a directory of the running test, so the tests can run in parallel.
+    auto OutputDirectory() -> std::filesystem::path {
+      const auto* test =
+        ::testing::UnitTest::GetInstance()->current_test_info();
+      const auto directory =
+        std::filesystem::temp_directory_path() /
+        (std::string{"consolidated_output_unittest_"} + test->name());
+      std::filesystem::remove_all(directory);
+      std::filesystem::create_directories(directory);
+      return directory;
+    }
+
+    // Write kFlushes flushes of a few events for each of kSymbols symbols,
+    // every symbol from its own thread. Return the expected streams.
+    auto WriteStreams(ConsolidatedWriter& writer) -> std::vector<std::string> {
+      std::vector<std::string> expected(kSymbols);
+      std::vector<uint32_t> ids{};
+      for (auto i = 0U; i < kSymbols; ++i) {
+        ids.push_back(writer.AddSymbol(fmt::format("S{}", i)));
+      }
+
+      std::vector<std::thread> threads{};
+      for (auto i = 0U; i < kSymbols; ++i) {
+        threads.emplace_back([&writer, &expected, &ids, i] {
+          std::string bytes{};
+          for (auto j = 0U; j < kFlushes; ++j) {
+            for (auto k = 0U; k <= j % 3; ++k) {
+              bytes += fmt::format("PASSIVE BUY {}.00 @ {}.00\n", j, k);
+            }
+            expected[i] += bytes;
+            writer.Write(ids[i], bytes);
+            EXPECT_TRUE(bytes.empty());
+          }
+        });
+      }
+      for (auto& thread : threads) {
+        thread.join();
+      }
+      return expected;
+    }
+  }   // namespace
+
+  TEST(ConsolidatedOutput, RoundTrip) {
+    for (const auto format : {RecordFormat::kBinary, RecordFormat::kText}) {
+      const auto directory = OutputDirectory();
+
+      // small segments, so the records span many of them.
+      ConsolidatedOptions options{};
+      options.format        = format;
+      options.segment_bytes = 256;
+
+      std::vector<std::string> expected{};
+      {
+        ConsolidatedWriter writer{};
+        ASSERT_TRUE(writer.Open(directory.string(), options, nullptr));
+        expected = WriteStreams(writer);
+        // the index is only written once the output is finished.
+        EXPECT_TRUE(writer.Flush());
+        EXPECT_FALSE(std::filesystem::exists(directory / "events.idx"));
+        EXPECT_TRUE(writer.Finish());
+      }
+      EXPECT_TRUE(std::filesystem::exists(directory / "events.00001.log"));
+
+      ConsolidatedReader reader{};
+      ASSERT_TRUE(reader.Open(directory.string()));
+      ASSERT_EQ(reader.Symbols().Size(), kSymbols);
+      for (auto i = 0U; i < kSymbols; ++i) {
+        std::string stream{};
+        EXPECT_TRUE(reader.Extract(fmt::format("S{}", i), stream));
+        EXPECT_EQ(stream, expected[i]) << i;
+      }
+
+      std::string stream{};
+      EXPECT_FALSE(reader.Extract("UNKNOWN", stream));
+      std::filesystem::remove_all(directory);
+    }
+  }
+
+  TEST(ConsolidatedOutput, AsyncSegments) {
+    const auto directory = OutputDirectory();
+
+    ConsolidatedOptions options{};
+    options.segment_bytes = 1024;
+
+    std::vector<std::string> expected{};
+    {
+      // the writer is destroyed before the asynchronous writer, which then
+      // writes out the pending segments.
+      AsyncWriter async_writer{AsyncWriterOptions{}};
+      ConsolidatedWriter writer{};
+      ASSERT_TRUE(writer.Open(directory.string(), options, &async_writer));
+      expected = WriteStreams(writer);
+    }
+
+    ConsolidatedReader reader{};
+    ASSERT_TRUE(reader.Open(directory.string()));
+    for (auto i = 0U; i < kSymbols; ++i) {
+      std::string stream{};
+      EXPECT_TRUE(reader.Extract(fmt::format("S{}", i), stream));
+      EXPECT_EQ(stream, expected[i]) << i;
+    }
+    std::filesystem::remove_all(directory);
+  }
+
+  TEST(ConsolidatedOutput, MalformedRecord) {
+    const auto directory = OutputDirectory();
+
+    ConsolidatedReader reader{};
+    EXPECT_FALSE(reader.Open(directory.string()));
+
+    {
+      ConsolidatedWriter writer{};
+      ASSERT_TRUE(
+        writer.Open(directory.string(), ConsolidatedOptions{}, nullptr));
+      std::string bytes{"CANCEL SELL 1.00 @ 2.00\n"};
+      writer.Write(writer.AddSymbol("A"), bytes);
+    }
+
+    // the symbol id of the record header no longer matches its stream.
+    {
+      std::fstream segment(directory / "events.00000.log",
+                           std::ios::binary | std::ios::in | std::ios::out);
+      segment.put('\x7');
+    }
+    ASSERT_TRUE(reader.Open(directory.string()));
+    std::string stream{};
+    EXPECT_FALSE(reader.Extract("A", stream));
+    std::filesystem::remove_all(directory);
+  }
+}   // namespace longlp
@@ -0,0 +1,71 @@
+// Copyright 2022 Long Le Phi. All rights reserved.
+// Use of this source code is governed by a MIT license that can be
+// found in the LICENSE file.
+
+#include "feed_generator.hpp"
+
+#include <gtest/gtest.h>
+#include <map>
+#include <sstream>
+#include <string>
+#include "feed_parser.hpp"
+#include "instrument_feeds_worker.hpp"
+
+namespace longlp {
+  namespace {
+    auto SmallOptions() -> FeedGeneratorOptions {
+      FeedGeneratorOptions options{};
+      options.seed            = 42;
+      options.symbols         = 8;
+      options.messages        = 5000;
+      options.depth           = 6;
+      options.burst_frequency = 0.2;
+      options.max_burst       = 4;
+      return options;
+    }
+  }   // namespace
+
+  TEST(FeedGenerator, SameSeedSameFeed) {
+    std::ostringstream first{};
+    std::ostringstream second{};
+    const auto first_symbols  = GenerateFeed(SmallOptions(), first);
+    const auto second_symbols = GenerateFeed(SmallOptions(), second);
+    EXPECT_EQ(first.str(), second.str());
+    ASSERT_EQ(first_symbols.size(), second_symbols.size());
+    for (size_t i = 0; i < first_symbols.size(); ++i) {
+      EXPECT_EQ(first_symbols[i].symbol, second_symbols[i].symbol);
+      EXPECT_EQ(first_symbols[i].expected, second_symbols[i].expected);
+    }
+
+    auto options = SmallOptions();
+    ++options.seed;
+    std::ostringstream other{};
+    GenerateFeed(options, other);
+    EXPECT_NE(first.str(), other.str());
+  }
+
+  TEST(FeedGenerator, WorkersMatchExpectedOutputs) {
+    std::stringstream feed{};
+    const auto symbols = GenerateFeed(SmallOptions(), feed);
+    ASSERT_EQ(symbols.size(), SmallOptions().symbols);
+
+    std::map<std::string, InstrumentFeedsWorker> workers{};
+    std::map<std::string, std::string> outputs{};
+    FeedRecord record{};
+    for (std::string line{}; std::getline(feed, line);) {
+      ASSERT_TRUE(ParseFeedLine(line, record)) << line;
+      auto& worker = workers[record.symbol];
+      if (record.type == FeedRecord::Type::kBook) {
+        worker.UpdateBookChanges(record.book, outputs[record.symbol]);
+      }
+      else {
+        worker.RecordNewTrade(record.trade);
+      }
+    }
+
+    for (const auto& [symbol, expected] : symbols) {
+      EXPECT_FALSE(expected.empty());
+      EXPECT_EQ(outputs[symbol], expected) << symbol;
+    }
+  }
+}   // namespace longlp
@@ -0,0 +1,155 @@
+// Copyright 2022 Long Le Phi. All rights reserved.
+// Use of this source code is governed by a MIT license that can be
+// found in the LICENSE file.
+
+#include "feed_parser.hpp"
+
+#include <gtest/gtest.h>
+#include <string_view>
+
+namespace longlp {
+  namespace {
+    void ExpectSameLevels(const SideList& left, const SideList& right) {
+      ASSERT_EQ(left.size(), right.size());
+      for (auto i = 0U; i < left.size(); ++i) {
+        EXPECT_EQ(left[i].count, right[i].count);
+        EXPECT_EQ(left[i].quantity, right[i].quantity);
+        EXPECT_EQ(left[i].price, right[i].price);
+      }
+    }
+
+    // Both parsers must agree on a line which fits the schema.
+    void ExpectSameRecord(const std::string_view line) {
+      FeedRecord in_place{};
+      FeedRecord json{};
+      ASSERT_TRUE(ParseFeedLineInPlace(line, in_place));
+      ASSERT_TRUE(ParseFeedLineJson(line, json));
+
+      EXPECT_EQ(in_place.type, json.type);
+      EXPECT_EQ(in_place.symbol, json.symbol);
+      if (json.type == FeedRecord::Type::kBook) {
+        ExpectSameLevels(in_place.book.bids, json.book.bids);
+        ExpectSameLevels(in_place.book.asks, json.book.asks);
+      }
+      else {
+        EXPECT_EQ(in_place.trade.quantity, json.trade.quantity);
+        EXPECT_EQ(in_place.trade.price, json.trade.price);
+      }
+    }
+  }   // namespace
+
+  TEST(FeedParser, Book) {
+    ExpectSameRecord(
+      R"({"book":{"symbol":"ABBN", "bid": [{"count":1, "quantity":900,)"
+      R"("price":50.120000}, {"count":1, "quantity":1300, "price":50.100000}],)"
+      R"( "ask":[{"count":1, "quantity":1900, "price":50.140000}]}})");
+  }
+
+  TEST(FeedParser, EmptyBook) {
+    ExpectSameRecord(R"({"book":{"symbol":"ABBN", "bid": [], "ask": []}})");
+  }
+
+  TEST(FeedParser, Trade) {
+    ExpectSameRecord(
+      R"({"trade":{"symbol":"ABBN", "price":50.130000, "quantity":200}})");
+  }
+
+  TEST(FeedParser, AnyKeyOrderAndWhitespace) {
+    ExpectSameRecord(
+      " { \"book\" : { \"ask\" : [ ] , \"bid\" : [ { \"price\" : 1.5e1 , "
+      "\"count\" : 2 , \"quantity\" : 10 } ] , \"symbol\" : \"A B\" } }\r");
+  }
+
+  TEST(FeedParser, FixedPoint) {
+    FeedRecord record{};
+    ASSERT_TRUE(ParseFeedLineInPlace(
+      R"({"book":{"symbol":"ABBN", "bid": [{"count":3, "quantity":900,)"
+      R"("price":50.130000}, {"count":1, "quantity":1300, "price":50}],)"
+      R"( "ask": [{"count":1, "quantity":1, "price":50.1449999}]}})",
+      record));
+
+    ASSERT_EQ(record.book.bids.size(), 2U);
+    EXPECT_EQ(record.book.bids[0].price,
+              50 * kPriceScale + 13 * kPriceScale / 100);
+    EXPECT_EQ(record.book.bids[0].quantity, 900 * kQuantityScale);
+    EXPECT_EQ(record.book.bids[0].count, 3U);
+    EXPECT_EQ(record.book.bids[1].price, 50 * kPriceScale);
+    ASSERT_EQ(record.book.asks.size(), 1U);
+    EXPECT_EQ(record.book.asks[0].price, ToPrice(50.1449999));
+  }
+
+  TEST(FeedParser, ReuseRecordStorage) {
+    FeedRecord record{};
+    ASSERT_TRUE(ParseFeedLineInPlace(
+      R"({"book":{"symbol":"ABBN", "bid": [{"count":1, "quantity":900,)"
+      R"("price":50.12}], "ask": []}})",
+      record));
+    const auto* const bids = record.book.bids.data();
+
+    ASSERT_TRUE(ParseFeedLineInPlace(
+      R"({"book":{"symbol":"ABBN", "bid": [{"count":1, "quantity":100,)"
+      R"("price":50.13}], "ask": []}})",
+      record));
+    EXPECT_EQ(record.book.bids.data(), bids);
+    EXPECT_EQ(record.book.bids.front().price, ToPrice(50.13));
+  }
+
+  TEST(FeedParser, FallbackOutOfSchema) {
+    constexpr std::string_view line =
+      R"({"trade":{"symbol":"AB\"N", "price":50.13, "quantity":200}})";
+
+    FeedRecord record{};
+    EXPECT_FALSE(ParseFeedLineInPlace(line, record));
+    ASSERT_TRUE(ParseFeedLine(line, record));
+    EXPECT_EQ(record.type, FeedRecord::Type::kTrade);
+    EXPECT_EQ(record.symbol, "AB\"N");
+  }
+
+  TEST(FeedParser, IntegralCount) {
+    ExpectSameRecord(
+      R"({"book":{"symbol":"ABBN", "bid": [{"count":2.0, "quantity":900,)"
+      R"("price":50.12}], "ask": []}})");
+
+    // neither rounded nor truncated
+    constexpr std::string_view line =
+      R"({"book":{"symbol":"ABBN", "bid": [{"count":1.7, "quantity":900,)"
+      R"("price":50.12}], "ask": []}})";
+    FeedRecord record{};
+    EXPECT_FALSE(ParseFeedLineInPlace(line, record));
+    EXPECT_FALSE(ParseFeedLineJson(line, record));
+    EXPECT_FALSE(ParseFeedLine(line, record));
+    EXPECT_FALSE(ParseFeedLine(
+      R"({"book":{"symbol":"ABBN", "bid": [{"count":-1, "quantity":900,)"
+      R"("price":50.12}], "ask": []}})",
+      record));
+  }
+
+  TEST(FeedParser, OutOfRange) {
+    // beyond a quantity, an int64_t price and a double
+    for (const std::string_view line :
+         {R"({"trade":{"symbol":"ABBN", "price":50.13, "quantity":3e9}})",
+          R"({"trade":{"symbol":"ABBN", "price":50.13,)"
+          R"( "quantity":3000000000}})",
+          R"({"trade":{"symbol":"ABBN", "price":1e30, "quantity":200}})",
+          R"({"trade":{"symbol":"ABBN", "price":1000000000000000000000000,)"
+          R"( "quantity":200}})",
+          R"({"trade":{"symbol":"ABBN", "price":1e999, "quantity":200}})",
+          // INT64_MAX ticks at 2 decimals, then rounded up
+          R"({"trade":{"symbol":"ABBN", "price":92233720368547758.075,)"
+          R"( "quantity":200}})"}) {
+      FeedRecord record{};
+      EXPECT_FALSE(ParseFeedLineInPlace(line, record)) << line;
+      EXPECT_FALSE(ParseFeedLineJson(line, record)) << line;
+    }
+  }
+
+  TEST(FeedParser, InvalidLine) {
+    FeedRecord record{};
+    EXPECT_FALSE(ParseFeedLine("", record));
+    EXPECT_FALSE(ParseFeedLine("{\"book\":", record));
+    EXPECT_FALSE(ParseFeedLine(R"({"quote":{"symbol":"ABBN"}})", record));
+    EXPECT_FALSE(ParseFeedLineInPlace(
+      R"({"trade":{"symbol":"ABBN", "price":50.13}})",
+      record));
+  }
+}   // namespace longlp
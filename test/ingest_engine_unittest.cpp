@@ -0,0 +1,151 @@
+// Copyright 2022 Long Le Phi. All rights reserved.
+// Use of this source code is governed by a MIT license that can be
+// found in the LICENSE file.
+
+#include "ingest_engine.hpp"
+
+#include <gtest/gtest.h>
+#include <map>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+#include "feed_generator.hpp"
+#include "feed_parser.hpp"
+
+namespace longlp {
+  namespace {
+    constexpr size_t kProducers = 3;
+
+    struct GeneratedFeed {
+      std::vector<GeneratedSymbol> symbols{};
+      std::vector<FeedRecord> records{};
+    };
+
+    auto MakeFeed() -> GeneratedFeed {
+      FeedGeneratorOptions options{};
+      options.seed            = 7;
+      options.symbols         = 10;
+      options.messages        = 6000;
+      options.depth           = 6;
+      options.burst_frequency = 0.2;
+
+      GeneratedFeed result{};
+      std::stringstream feed{};
+      result.symbols = GenerateFeed(options, feed);
+      for (std::string line{}; std::getline(feed, line);) {
+        EXPECT_TRUE(ParseFeedLine(line, result.records.emplace_back()));
+      }
+      return result;
+    }
+
+    // Submit |records| from kProducers threads, each one owns the symbols
+    // whose identifier is its index modulo kProducers. Return the outputs
+    // by symbol name.
+    auto RunIngest(IngestOptions options,
+                   const std::vector<FeedRecord>& records,
+                   IngestReport& report)
+      -> std::map<std::string, std::string> {
+      std::vector<std::string> outputs(records.size());
+      options.sink = [&outputs](const SymbolId symbol,
+                                const std::string_view events) {
+        outputs[symbol].append(events);
+      };
+      IngestEngine engine{std::move(options)};
+
+      std::vector<SymbolId> ids{};
+      std::vector<std::string> names{};
+      for (const auto& record : records) {
+        ids.push_back(engine.RegisterSymbol(record.symbol));
+        if (names.size() <= ids.back()) {
+          names.push_back(record.symbol);
+        }
+      }
+
+      std::vector<std::thread> producers{};
+      for (size_t producer = 0; producer < kProducers; ++producer) {
+        producers.emplace_back([&, producer] {
+          for (size_t i = 0; i < records.size(); ++i) {
+            if (ids[i] % kProducers != producer) {
+              continue;
+            }
+            if (records[i].type == FeedRecord::Type::kBook) {
+              auto book = records[i].book;
+              EXPECT_TRUE(engine.Submit(ids[i], book));
+            }
+            else {
+              EXPECT_TRUE(engine.Submit(ids[i], records[i].trade));
+            }
+          }
+        });
+      }
+      for (auto& producer : producers) {
+        producer.join();
+      }
+      report = engine.Stop();
+
+      std::map<std::string, std::string> result{};
+      for (SymbolId id = 0; id < names.size(); ++id) {
+        result[names[id]] = outputs[id];
+      }
+      return result;
+    }
+  }   // namespace
+
+  TEST(IngestEngine, BlockMatchesExpectedOutputs) {
+    const auto feed = MakeFeed();
+    IngestOptions options{};
+    options.shards         = 2;
+    options.queue_capacity = 4;
+    options.backpressure   = Backpressure::kBlock;
+
+    IngestReport report{};
+    const auto outputs = RunIngest(options, feed.records, report);
+    EXPECT_EQ(report.messages, feed.records.size());
+    EXPECT_EQ(report.dropped, 0U);
+    EXPECT_LE(report.p50_latency, report.max_latency);
+    for (const auto& [symbol, expected] : feed.symbols) {
+      EXPECT_EQ(outputs.at(symbol), expected) << symbol;
+    }
+  }
+
+  TEST(IngestEngine, SpinMatchesExpectedOutputs) {
+    const auto feed = MakeFeed();
+    IngestOptions options{};
+    options.shards         = 3;
+    options.queue_capacity = 16;
+    options.backpressure   = Backpressure::kSpin;
+
+    IngestReport report{};
+    const auto outputs = RunIngest(options, feed.records, report);
+    EXPECT_EQ(report.messages, feed.records.size());
+    for (const auto& [symbol, expected] : feed.symbols) {
+      EXPECT_EQ(outputs.at(symbol), expected) << symbol;
+    }
+  }
+
+  TEST(IngestEngine, DropOldestCountsMessages) {
+    const auto feed = MakeFeed();
+    IngestOptions options{};
+    options.queue_capacity = 2;
+    options.backpressure   = Backpressure::kDropOldest;
+
+    IngestReport report{};
+    RunIngest(options, feed.records, report);
+    EXPECT_EQ(report.messages + report.dropped, feed.records.size());
+  }
+
+  TEST(IngestEngine, UnknownSymbol) {
+    IngestOptions options{};
+    options.sink = [](SymbolId /*symbol*/,
+                      std::string_view /*events*/) noexcept {};
+    IngestEngine engine{std::move(options)};
+
+    EXPECT_FALSE(engine.Submit(0, TradeRecord{100, 645}));
+    const auto id = engine.RegisterSymbol("BTCUSDT");
+    EXPECT_EQ(engine.RegisterSymbol("BTCUSDT"), id);
+    EXPECT_TRUE(engine.Submit(id, TradeRecord{100, 645}));
+    EXPECT_FALSE(engine.Submit(id + 1, TradeRecord{100, 645}));
+    EXPECT_EQ(engine.Stop().messages, 1U);
+  }
+}   // namespace longlp
@@ -5,14 +5,20 @@
 #include "instrument_feeds_worker.hpp"
 
 #include <gtest/gtest.h>
+#include <limits>
 #include <sstream>
 #include <string>
 #include <variant>
+#include <vector>
+#include "test_records.hpp"
 
 namespace longlp {
   namespace {
     using Record = std::variant<OrderBookRecord, TradeRecord>;
 
+    using test::MakeBook;
+    using test::MakeTrade;
+
     auto TestHelper(InstrumentFeedsWorker& worker,
                     const std::vector<std::string>& expected,
                     const std::vector<Record>& records) {
@@ -51,6 +57,47 @@ namespace longlp {
       worker.UpdateBookChangesUnsafe(std::make_unique<OrderBookRecord>()));
   }
 
+  TEST(InstrumentFeedsWorker, RecycleBookStorage) {
+    InstrumentFeedsWorker worker{};
+
+    auto first  = MakeBook({{1, 1300, 50.10}}, {});
+    auto second = MakeBook({{1, 900, 50.12}, {1, 1300, 50.10}}, {});
+    const auto* const first_bids = first.bids.data();
+
+    EXPECT_EQ(worker.UpdateBookChanges(first), "");
+    EXPECT_TRUE(first.bids.empty());
+
+    EXPECT_EQ(worker.UpdateBookChanges(second),
+              "PASSIVE BUY 900.00 @ 50.12\n");
+    // the caller gets back the storage of the previous live book
+    ASSERT_EQ(second.bids.size(), 1U);
+    EXPECT_EQ(second.bids.data(), first_bids);
+    EXPECT_EQ(second.bids.front().price, ToPrice(50.10));
+  }
+
+  TEST(InstrumentFeedsWorker, ContinueWithNextSegment) {
+    InstrumentFeedsWorker first{};
+    InstrumentFeedsWorker second{};
+
+    auto book_a = MakeBook({{1, 1380, 11.01}}, {{1, 860, 11.14}});
+    auto book_b =
+      MakeBook({{1, 100, 11.11}, {1, 1380, 11.01}}, {{1, 860, 11.14}});
+    auto book_c = MakeBook({{1, 20, 11.11}}, {{1, 860, 11.14}});
+
+    // the second segment starts from the last book of the first one
+    second.StartFrom(book_b);
+    second.RecordNewTrade(MakeTrade(100, 11.11));
+    second.RecordNewTrade(MakeTrade(1360, 11.01));
+
+    EXPECT_EQ(first.UpdateBookChanges(book_a), "");
+    EXPECT_EQ(first.UpdateBookChanges(book_b), "PASSIVE BUY 100.00 @ 11.11\n");
+
+    // the pending trades of the second segment classify the next book
+    first.ContinueWith(second);
+    EXPECT_EQ(first.UpdateBookChanges(book_c),
+              "AGGRESSIVE SELL 1460.00 @ 11.01\n");
+  }
+
   TEST(InstrumentFeedsWorker, PartialAgressive) {
     InstrumentFeedsWorker worker{};
     const std::vector<std::string> expected = {
@@ -60,10 +107,10 @@ namespace longlp {
 
     // clang-format off
     std::vector<Record> records = {
-      OrderBookRecord{{{1, 100, 11.11}, {1, 1380, 11.01}}, {{1, 860, 11.14}}},
-      TradeRecord{100, 11.11},
-      TradeRecord{1360, 11.01},
-      OrderBookRecord{{{1, 20, 11.11}}, {{1, 860, 11.14}}},
+      MakeBook({{1, 100, 11.11}, {1, 1380, 11.01}}, {{1, 860, 11.14}}),
+      MakeTrade(100, 11.11),
+      MakeTrade(1360, 11.01),
+      MakeBook({{1, 20, 11.11}}, {{1, 860, 11.14}}),
     };
     // clang-format on
 
@@ -79,14 +126,59 @@ namespace longlp {
 
     // clang-format off
     std::vector<Record> records = {
-      OrderBookRecord{
+      MakeBook(
         {{1, 2780, 10.97}, {1, 2300, 10.82}},
-        {{1, 620, 11.07}, {1, 1820, 11.08}, {1, 860, 11.14}}},
-      TradeRecord{620, 11.07},
-      TradeRecord{1820, 11.08},
-      OrderBookRecord{
+        {{1, 620, 11.07}, {1, 1820, 11.08}, {1, 860, 11.14}}),
+      MakeTrade(620, 11.07),
+      MakeTrade(1820, 11.08),
+      MakeBook(
         {{1, 100, 11.11}, {1, 2780, 10.97}, {1, 2300, 10.82}},
-        {{1, 860, 11.14}}},
+        {{1, 860, 11.14}}),
+    };
+    // clang-format on
+
+    TestHelper(worker, expected, records);
+  }
+
+  TEST(InstrumentFeedsWorker, FractionalQuantity) {
+    if constexpr (config::quantity_decimals != 2) {
+      GTEST_SKIP() << "the quantities are written in lots of 0.01";
+    }
+    InstrumentFeedsWorker worker{};
+    const std::vector<std::string> expected = {
+      "",
+      "PASSIVE BUY 12.50 @ 10.00\n",
+    };
+
+    // clang-format off
+    std::vector<Record> records = {
+      MakeBook({{1, 100, 10.00}}, {}),
+      MakeBook({{1, 112.5, 10.00}}, {}),
+    };
+    // clang-format on
+
+    TestHelper(worker, expected, records);
+  }
+
+  TEST(InstrumentFeedsWorker, TradeSumBeyondQuantity) {
+    if constexpr (config::quantity_decimals != 2) {
+      GTEST_SKIP() << "the quantities are written in lots of 0.01";
+    }
+    InstrumentFeedsWorker worker{};
+    const std::vector<std::string> expected = {
+      "",
+      "AGGRESSIVE BUY 42949672.94 @ 11.07\n",
+    };
+
+    // the trades of a price are summed beyond the range of Quantity.
+    const TradeRecord largest{std::numeric_limits<Quantity>::max(),
+                              ToPrice(11.07)};
+    // clang-format off
+    std::vector<Record> records = {
+      MakeBook({{1, 2780, 10.97}}, {{1, 620, 11.07}, {1, 860, 11.14}}),
+      largest,
+      largest,
+      MakeBook({{1, 2780, 10.97}}, {{1, 860, 11.14}}),
     };
     // clang-format on
 
@@ -112,23 +204,23 @@ namespace longlp {
 
     // clang-format off
     std::vector<Record> records = {
-      OrderBookRecord{                                  {},                 {}},
-      OrderBookRecord{                  {{1, 1300, 50.10}},                 {}},
-      OrderBookRecord{ {{1, 900, 50.12}, {1, 1300, 50.10}},                 {}},
-      OrderBookRecord{ {{1, 900, 50.12}, {1, 1300, 50.10}}, {{1, 1900, 50.14}}},
-      OrderBookRecord{{{2, 1300, 50.12}, {1, 1300, 50.10}}, {{1, 1900, 50.14}}},
-      OrderBookRecord{{{3, 1530, 50.12}, {1, 1300, 50.10}}, {{1, 1900, 50.14}}},
-      OrderBookRecord{{{1, 200, 50.13}, {3, 1530, 50.12}, {1,1300,50.10}}, {{1, 1900, 50.14}}},
-      TradeRecord{200, 50.13},
-      OrderBookRecord{{{3, 1530, 50.12}, {1,1300,50.10}}, {{1,220,50.13},{1, 1900, 50.14}}},
-      OrderBookRecord{{{3, 1530, 50.12}, {1,1300,50.10}}, {{2,550,50.13},{1, 1900, 50.14}}},
-      OrderBookRecord{{{3, 1530, 50.12}, {1,1300,50.10}}, {{3,655,50.13},{1, 1900, 50.14}}},
-      OrderBookRecord{{{3, 1530, 50.12}, {1,1300,50.10}}, {{4,1245,50.13},{1, 1900, 50.14}}},
-      TradeRecord{220, 50.13},
-      TradeRecord{330, 50.13},
-      TradeRecord{105, 50.13},
-      TradeRecord{345, 50.13},
-      OrderBookRecord{{{3, 1530, 50.12}, {1,1300,50.10}}, {{1,245,50.13},{1, 1900, 50.14}}},
+      MakeBook(                                  {},                 {}),
+      MakeBook(                  {{1, 1300, 50.10}},                 {}),
+      MakeBook( {{1, 900, 50.12}, {1, 1300, 50.10}},                 {}),
+      MakeBook( {{1, 900, 50.12}, {1, 1300, 50.10}}, {{1, 1900, 50.14}}),
+      MakeBook({{2, 1300, 50.12}, {1, 1300, 50.10}}, {{1, 1900, 50.14}}),
+      MakeBook({{3, 1530, 50.12}, {1, 1300, 50.10}}, {{1, 1900, 50.14}}),
+      MakeBook({{1, 200, 50.13}, {3, 1530, 50.12}, {1,1300,50.10}}, {{1, 1900, 50.14}}),
+      MakeTrade(200, 50.13),
+      MakeBook({{3, 1530, 50.12}, {1,1300,50.10}}, {{1,220,50.13},{1, 1900, 50.14}}),
+      MakeBook({{3, 1530, 50.12}, {1,1300,50.10}}, {{2,550,50.13},{1, 1900, 50.14}}),
+      MakeBook({{3, 1530, 50.12}, {1,1300,50.10}}, {{3,655,50.13},{1, 1900, 50.14}}),
+      MakeBook({{3, 1530, 50.12}, {1,1300,50.10}}, {{4,1245,50.13},{1, 1900, 50.14}}),
+      MakeTrade(220, 50.13),
+      MakeTrade(330, 50.13),
+      MakeTrade(105, 50.13),
+      MakeTrade(345, 50.13),
+      MakeBook({{3, 1530, 50.12}, {1,1300,50.10}}, {{1,245,50.13},{1, 1900, 50.14}}),
     };
     // clang-format on
 
@@ -0,0 +1,71 @@
+// Copyright 2022 Long Le Phi. All rights reserved.
+// Use of this source code is governed by a MIT license that can be
+// found in the LICENSE file.
+
+#include "mapped_file.hpp"
+
+#include <gtest/gtest.h>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <string>
+
+namespace longlp {
+  namespace {
+    // Concatenate the chunks, expecting each of them to end with a line.
+    auto JoinChunks(const std::vector<std::string_view>& chunks,
+                    const std::string_view content) -> std::string {
+      std::string result{};
+      for (const auto& chunk : chunks) {
+        EXPECT_FALSE(chunk.empty());
+        if (result.size() + chunk.size() < content.size()) {
+          EXPECT_EQ(chunk.back(), '\n');
+        }
+        result += chunk;
+      }
+      return result;
+    }
+  }   // namespace
+
+  TEST(MappedFile, SplitAtLines) {
+    constexpr std::string_view content = "a\nbb\nccc\ndddd\neeeee";
+    for (auto chunks = 1U; chunks < 8; ++chunks) {
+      const auto result = SplitAtLines(content, chunks);
+      EXPECT_LE(result.size(), chunks);
+      EXPECT_EQ(JoinChunks(result, content), content);
+    }
+  }
+
+  TEST(MappedFile, SplitLongLine) {
+    constexpr std::string_view content = "aaaaaaaaaaaaaaaaaaaa\nb\n";
+    const auto result                  = SplitAtLines(content, 4);
+    ASSERT_EQ(result.size(), 2U);
+    EXPECT_EQ(result[0], "aaaaaaaaaaaaaaaaaaaa\n");
+    EXPECT_EQ(result[1], "b\n");
+  }
+
+  TEST(MappedFile, SplitEmpty) {
+    EXPECT_TRUE(SplitAtLines("", 4).empty());
+  }
+
+  TEST(MappedFile, MapFile) {
+    const auto path =
+      std::filesystem::temp_directory_path() / "mapped_file_unittest.json";
+    {
+      std::ofstream writer(path);
+      writer << "line 1\nline 2\n";
+    }
+
+    MappedFile file{};
+    ASSERT_TRUE(file.Open(path.string()));
+    EXPECT_EQ(file.View(), "line 1\nline 2\n");
+
+    MappedFile moved{std::move(file)};
+    EXPECT_EQ(moved.View(), "line 1\nline 2\n");
+    moved.Close();
+    EXPECT_TRUE(moved.View().empty());
+
+    std::filesystem::remove(path);
+    EXPECT_FALSE(moved.Open(path.string()));
+  }
+}   // namespace longlp
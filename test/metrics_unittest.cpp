@@ -0,0 +1,77 @@
+// Copyright 2022 Long Le Phi. All rights reserved.
+// Use of this source code is governed by a MIT license that can be
+// found in the LICENSE file.
+
+#include "metrics.hpp"
+
+#include <gtest/gtest.h>
+#include <string>
+#include <thread>
+#include "instrument_feeds_worker.hpp"
+
+namespace longlp {
+  TEST(Metrics, SharedHistogramSnapshot) {
+    LatencyHistogram expected{};
+    SharedLatencyHistogram shared{};
+    for (uint64_t value = 0; value < 5000; value += 7) {
+      expected.Record(value);
+      shared.Record(value);
+    }
+
+    const auto snapshot = shared.Snapshot();
+    EXPECT_EQ(snapshot.Count(), expected.Count());
+    EXPECT_EQ(snapshot.Max(), expected.Max());
+    for (const auto percentile : {0.0, 50.0, 99.0, 99.9, 100.0}) {
+      EXPECT_EQ(snapshot.ValueAt(percentile), expected.ValueAt(percentile));
+    }
+  }
+
+  TEST(Metrics, MergeThreads) {
+    const auto before = metrics::TakeSnapshot();
+
+    const auto record = [] {
+      metrics::Count(metrics::Counter::kTrades, 3);
+      metrics::Record(metrics::Histogram::kTradeRun, 3);
+    };
+    std::thread first{record};
+    std::thread second{record};
+    first.join();
+    second.join();
+
+    const auto after = metrics::TakeSnapshot();
+    const auto trades =
+      after.counters[static_cast<size_t>(metrics::Counter::kTrades)] -
+      before.counters[static_cast<size_t>(metrics::Counter::kTrades)];
+    const auto runs =
+      after.histograms[static_cast<size_t>(metrics::Histogram::kTradeRun)]
+        .Count() -
+      before.histograms[static_cast<size_t>(metrics::Histogram::kTradeRun)]
+        .Count();
+    if constexpr (config::enable_metrics) {
+      EXPECT_EQ(trades, 6U);
+      EXPECT_EQ(runs, 2U);
+      EXPECT_GE(after.threads, before.threads + 2);
+    }
+    else {
+      EXPECT_EQ(trades, 0U);
+      EXPECT_EQ(runs, 0U);
+      EXPECT_EQ(after.threads, 0U);
+    }
+
+    std::string summary{};
+    metrics::AppendSummary(after, summary);
+    EXPECT_NE(summary.find("trade_run"), std::string::npos);
+    EXPECT_NE(summary.find("aggressive_events"), std::string::npos);
+  }
+
+  TEST(Metrics, WorkerMessages) {
+    InstrumentFeedsWorker worker{};
+    OrderBookRecord book{{{644, 2400, 2}}, {{645, 100, 1}}};
+    worker.UpdateBookChanges(book);
+    worker.RecordNewTrade(TradeRecord{100, 645});
+    book = {{{644, 2400, 2}}, {}};
+    worker.UpdateBookChanges(book);
+
+    EXPECT_EQ(worker.Messages(), config::enable_metrics ? 3U : 0U);
+  }
+}   // namespace longlp
@@ -0,0 +1,72 @@
+// Copyright 2022 Long Le Phi. All rights reserved.
+// Use of this source code is governed by a MIT license that can be
+// found in the LICENSE file.
+
+#include "mpmc_queue.hpp"
+
+#include <gtest/gtest.h>
+#include <thread>
+#include <vector>
+
+namespace longlp {
+  TEST(MpmcQueue, PushUntilFull) {
+    MpmcQueue<int32_t> queue{3};
+    EXPECT_EQ(queue.Capacity(), 4U);
+
+    auto popped = 0;
+    const auto pop = [&popped](const int32_t& slot) { popped = slot; };
+    EXPECT_FALSE(queue.TryPop(pop));
+
+    for (auto i = 1; i <= 4; ++i) {
+      EXPECT_TRUE(queue.TryPush([i](int32_t& slot) { slot = i; }));
+    }
+    EXPECT_FALSE(queue.TryPush([](int32_t& slot) { slot = 5; }));
+
+    EXPECT_TRUE(queue.TryPop(pop));
+    EXPECT_EQ(popped, 1);
+    EXPECT_TRUE(queue.TryPush([](int32_t& slot) { slot = 5; }));
+
+    for (auto expected = 2; expected <= 5; ++expected) {
+      EXPECT_TRUE(queue.TryPop(pop));
+      EXPECT_EQ(popped, expected);
+    }
+    EXPECT_FALSE(queue.TryPop(pop));
+  }
+
+  TEST(MpmcQueue, ManyProducers) {
+    constexpr int32_t kProducers = 4;
+    constexpr int32_t kMessages  = 20000;
+    MpmcQueue<int32_t> queue{16};
+
+    std::vector<std::thread> producers{};
+    for (auto producer = 0; producer < kProducers; ++producer) {
+      producers.emplace_back([&queue, producer] {
+        for (auto i = 0; i < kMessages; ++i) {
+          const auto value = producer * kMessages + i;
+          while (!queue.TryPush([value](int32_t& slot) { slot = value; })) {
+            std::this_thread::yield();
+          }
+        }
+      });
+    }
+
+    // the messages of each producer are popped in their push order
+    std::vector<int32_t> next(kProducers, 0);
+    for (auto received = 0; received < kProducers * kMessages;) {
+      const auto popped = queue.TryPop([&next](const int32_t& slot) {
+        auto& expected = next[static_cast<size_t>(slot / kMessages)];
+        EXPECT_EQ(slot % kMessages, expected);
+        ++expected;
+      });
+      if (popped) {
+        ++received;
+        continue;
+      }
+      std::this_thread::yield();
+    }
+    for (auto& producer : producers) {
+      producer.join();
+    }
+    EXPECT_EQ(next, std::vector<int32_t>(kProducers, kMessages));
+  }
+}   // namespace longlp
@@ -0,0 +1,37 @@
+// Copyright 2022 Long Le Phi. All rights reserved.
+// Use of this source code is governed by a MIT license that can be
+// found in the LICENSE file.
+
+#include "object_pool.hpp"
+
+#include <gtest/gtest.h>
+#include <vector>
+
+namespace longlp {
+  TEST(ObjectPool, AcquireFromEmptyPool) {
+    ObjectPool<std::vector<int32_t>> pool{2};
+
+    std::vector<int32_t> object{1, 2, 3};
+    EXPECT_FALSE(pool.Acquire(object));
+    EXPECT_EQ(object, (std::vector<int32_t>{1, 2, 3}));
+  }
+
+  TEST(ObjectPool, RecycleStorage) {
+    ObjectPool<std::vector<int32_t>> pool{1};
+
+    std::vector<int32_t> released(100, 1);
+    const auto* const storage = released.data();
+    EXPECT_TRUE(pool.Release(released));
+    EXPECT_TRUE(released.empty());
+
+    // the pool is full, the object is left as is.
+    std::vector<int32_t> dropped(10, 2);
+    EXPECT_FALSE(pool.Release(dropped));
+    EXPECT_EQ(dropped.size(), 10U);
+
+    std::vector<int32_t> acquired{};
+    EXPECT_TRUE(pool.Acquire(acquired));
+    EXPECT_EQ(acquired.data(), storage);
+    EXPECT_FALSE(pool.Acquire(acquired));
+  }
+}   // namespace longlp
@@ -5,15 +5,28 @@
 #include "order_book_feeds_manager.hpp"
 
 #include <gtest/gtest.h>
+#include <algorithm>
+#include <chrono>
+#include <filesystem>
+#include <fstream>
 #include <sstream>
 #include <string>
+#include <thread>
 #include <variant>
+#include <vector>
+#include "binary_feed.hpp"
+#include "feed_generator.hpp"
+#include "feed_parser.hpp"
 #include "instrument_feeds_worker.hpp"
+#include "test_records.hpp"
 
 namespace longlp {
   namespace {
     using Record = std::variant<OrderBookRecord, TradeRecord>;
 
+    using test::MakeBook;
+    using test::MakeTrade;
+
     auto TestHelper(InstrumentFeedsWorker& worker,
                     const std::vector<std::string>& expected,
                     const std::vector<Record>& records) {
@@ -34,6 +47,57 @@ namespace longlp {
         }
       }
     }
+
+    auto ReadFile(const std::filesystem::path& path) -> std::string {
+      std::ifstream reader(path, std::ios::binary);
+      std::string result(std::filesystem::file_size(path), '\0');
+      reader.read(result.data(), static_cast<std::streamsize>(result.size()));
+      return result;
+    }
+
+    // a temporary directory of the running test, so the tests can run in
+    // parallel.
+    auto TestDirectory() -> std::filesystem::path {
+      const auto* test =
+        ::testing::UnitTest::GetInstance()->current_test_info();
+      return std::filesystem::temp_directory_path() /
+             (std::string{"order_book_feeds_manager_unittest_"} + test->name());
+    }
+
+    // Generate a feed split into |files| files of consecutive lines in a
+    // temporary directory. Return the files and the expected outputs.
+    auto WriteSplitFeed(const std::filesystem::path& directory,
+                        const size_t files,
+                        std::vector<std::string>& paths)
+      -> std::vector<GeneratedSymbol> {
+      FeedGeneratorOptions options{};
+      options.symbols         = 6;
+      options.messages        = 600;
+      options.depth           = 4;
+      options.burst_frequency = 0.2;
+
+      std::stringstream feed{};
+      auto symbols = GenerateFeed(options, feed);
+
+      std::vector<std::string> lines{};
+      for (std::string line{}; std::getline(feed, line);) {
+        lines.push_back(line);
+      }
+
+      std::filesystem::remove_all(directory);
+      std::filesystem::create_directories(directory / "output");
+      const auto lines_per_file = (lines.size() + files - 1) / files;
+      for (size_t i = 0; i < files; ++i) {
+        paths.push_back((directory / (std::to_string(i) + ".json")).string());
+        std::ofstream writer(paths.back());
+        for (auto line = i * lines_per_file;
+             line < std::min(lines.size(), (i + 1) * lines_per_file);
+             ++line) {
+          writer << lines[line] << '\n';
+        }
+      }
+      return symbols;
+    }
   }   // namespace
 
   TEST(OrderBookFeedsManager, InvalidBook) {
@@ -61,10 +125,10 @@ namespace longlp {
 
     // clang-format off
     std::vector<Record> records = {
-      OrderBookRecord{{{1, 100, 11.11}, {1, 1380, 11.01}}, {{1, 860, 11.14}}},
-      TradeRecord{100, 11.11},
-      TradeRecord{1360, 11.01},
-      OrderBookRecord{{{1, 20, 11.11}}, {{1, 860, 11.14}}},
+      MakeBook({{1, 100, 11.11}, {1, 1380, 11.01}}, {{1, 860, 11.14}}),
+      MakeTrade(100, 11.11),
+      MakeTrade(1360, 11.01),
+      MakeBook({{1, 20, 11.11}}, {{1, 860, 11.14}}),
     };
     // clang-format on
 
@@ -80,14 +144,14 @@ namespace longlp {
 
     // clang-format off
     std::vector<Record> records = {
-      OrderBookRecord{
+      MakeBook(
         {{1, 2780, 10.97}, {1, 2300, 10.82}},
-        {{1, 620, 11.07}, {1, 1820, 11.08}, {1, 860, 11.14}}},
-      TradeRecord{620, 11.07},
-      TradeRecord{1820, 11.08},
-      OrderBookRecord{
+        {{1, 620, 11.07}, {1, 1820, 11.08}, {1, 860, 11.14}}),
+      MakeTrade(620, 11.07),
+      MakeTrade(1820, 11.08),
+      MakeBook(
         {{1, 100, 11.11}, {1, 2780, 10.97}, {1, 2300, 10.82}},
-        {{1, 860, 11.14}}},
+        {{1, 860, 11.14}}),
     };
     // clang-format on
 
@@ -113,26 +177,473 @@ namespace longlp {
 
     // clang-format off
     std::vector<Record> records = {
-      OrderBookRecord{                                  {},                 {}},
-      OrderBookRecord{                  {{1, 1300, 50.10}},                 {}},
-      OrderBookRecord{ {{1, 900, 50.12}, {1, 1300, 50.10}},                 {}},
-      OrderBookRecord{ {{1, 900, 50.12}, {1, 1300, 50.10}}, {{1, 1900, 50.14}}},
-      OrderBookRecord{{{2, 1300, 50.12}, {1, 1300, 50.10}}, {{1, 1900, 50.14}}},
-      OrderBookRecord{{{3, 1530, 50.12}, {1, 1300, 50.10}}, {{1, 1900, 50.14}}},
-      OrderBookRecord{{{1, 200, 50.13}, {3, 1530, 50.12}, {1,1300,50.10}}, {{1, 1900, 50.14}}},
-      TradeRecord{200, 50.13},
-      OrderBookRecord{{{3, 1530, 50.12}, {1,1300,50.10}}, {{1,220,50.13},{1, 1900, 50.14}}},
-      OrderBookRecord{{{3, 1530, 50.12}, {1,1300,50.10}}, {{2,550,50.13},{1, 1900, 50.14}}},
-      OrderBookRecord{{{3, 1530, 50.12}, {1,1300,50.10}}, {{3,655,50.13},{1, 1900, 50.14}}},
-      OrderBookRecord{{{3, 1530, 50.12}, {1,1300,50.10}}, {{4,1245,50.13},{1, 1900, 50.14}}},
-      TradeRecord{220, 50.13},
-      TradeRecord{330, 50.13},
-      TradeRecord{105, 50.13},
-      TradeRecord{345, 50.13},
-      OrderBookRecord{{{3, 1530, 50.12}, {1,1300,50.10}}, {{1,245,50.13},{1, 1900, 50.14}}},
+      MakeBook(                                  {},                 {}),
+      MakeBook(                  {{1, 1300, 50.10}},                 {}),
+      MakeBook( {{1, 900, 50.12}, {1, 1300, 50.10}},                 {}),
+      MakeBook( {{1, 900, 50.12}, {1, 1300, 50.10}}, {{1, 1900, 50.14}}),
+      MakeBook({{2, 1300, 50.12}, {1, 1300, 50.10}}, {{1, 1900, 50.14}}),
+      MakeBook({{3, 1530, 50.12}, {1, 1300, 50.10}}, {{1, 1900, 50.14}}),
+      MakeBook({{1, 200, 50.13}, {3, 1530, 50.12}, {1,1300,50.10}}, {{1, 1900, 50.14}}),
+      MakeTrade(200, 50.13),
+      MakeBook({{3, 1530, 50.12}, {1,1300,50.10}}, {{1,220,50.13},{1, 1900, 50.14}}),
+      MakeBook({{3, 1530, 50.12}, {1,1300,50.10}}, {{2,550,50.13},{1, 1900, 50.14}}),
+      MakeBook({{3, 1530, 50.12}, {1,1300,50.10}}, {{3,655,50.13},{1, 1900, 50.14}}),
+      MakeBook({{3, 1530, 50.12}, {1,1300,50.10}}, {{4,1245,50.13},{1, 1900, 50.14}}),
+      MakeTrade(220, 50.13),
+      MakeTrade(330, 50.13),
+      MakeTrade(105, 50.13),
+      MakeTrade(345, 50.13),
+      MakeBook({{3, 1530, 50.12}, {1,1300,50.10}}, {{1,245,50.13},{1, 1900, 50.14}}),
     };
     // clang-format on
 
     TestHelper(worker, expected, records);
   }
+
+  TEST(OrderBookFeedsManager, MultipleFiles) {
+    const auto directory = TestDirectory();
+    const auto output = (directory / "output").string();
+
+    // every mode reads the files as a single feed.
+    const std::vector<void (*)(const std::vector<std::string>&,
+                               const std::string&)>
+      runs = {
+        [](const std::vector<std::string>& files, const std::string& out) {
+          OrderBookFeedsManager manager{};
+          manager.InitFeedsAndGenerateTaskFlow(files, out);
+          manager.RunTaskFlow(2);
+        },
+        [](const std::vector<std::string>& files, const std::string& out) {
+          OrderBookFeedsManager manager{};
+          manager.StreamFeeds(files, out, 2, 50);
+        },
+        [](const std::vector<std::string>& files, const std::string& out) {
+          OrderBookFeedsManager manager{};
+          manager.RunShardedFeeds(files, out, 2, 64);
+        },
+        [](const std::vector<std::string>& files, const std::string& out) {
+          StealingOptions options{};
+          options.threads          = 2;
+          options.mailbox_capacity = 8;
+          OrderBookFeedsManager manager{};
+          manager.RunStealingFeeds(files, out, options);
+        },
+        [](const std::vector<std::string>& files, const std::string& out) {
+          OrderBookFeedsManager manager{};
+          manager.RunMappedFeeds(files, out, 2, 2, 0);
+        },
+        [](const std::vector<std::string>& files, const std::string& out) {
+          OrderBookFeedsManager manager{};
+          manager.RunMappedFeeds(files, out, 2, 2, 3);
+        },
+        [](const std::vector<std::string>& files, const std::string& out) {
+          OrderBookFeedsManager manager{};
+          manager.RunPartitionedFeeds(files, out, 2, 2);
+        },
+        [](const std::vector<std::string>& files, const std::string& out) {
+          AsyncWriterOptions options{};
+          options.max_open_files = 2;
+          OrderBookFeedsManager manager{};
+          manager.EnableAsyncOutput(options);
+          manager.StreamFeeds(files, out, 2, 50);
+        },
+      };
+
+    for (const auto& run : runs) {
+      std::vector<std::string> files{};
+      const auto symbols = WriteSplitFeed(directory, 3, files);
+      run(files, output);
+
+      for (const auto& [symbol, expected] : symbols) {
+        EXPECT_EQ(ReadFile(directory / "output" / (symbol + ".txt")),
+                  expected)
+          << symbol;
+      }
+    }
+    std::filesystem::remove_all(directory);
+  }
+
+  TEST(OrderBookFeedsManager, StreamingReport) {
+    using Clock          = std::chrono::steady_clock;
+    const auto directory = TestDirectory();
+    const auto output    = (directory / "output").string();
+
+    std::vector<std::string> files{};
+    const auto symbols = WriteSplitFeed(directory, 1, files);
+    const auto feed    = ReadFile(files.front());
+    const auto lines   = static_cast<size_t>(
+      std::count(feed.begin(), feed.end(), '\n'));
+
+    const auto start = Clock::now();
+    OrderBookFeedsManager manager{};
+    const auto report  = manager.StreamFeeds(files, output, 2, 50);
+    const auto elapsed = Clock::now() - start;
+    EXPECT_EQ(report.lines, lines);
+    EXPECT_EQ(report.batches, (lines + 49) / 50);
+    EXPECT_GT(report.first_output.count(), 0);
+    EXPECT_LE(report.first_output, elapsed);
+    for (const auto& [symbol, expected] : symbols) {
+      EXPECT_EQ(ReadFile(directory / "output" / (symbol + ".txt")), expected)
+        << symbol;
+    }
+
+    // the two-phase runs report it too.
+    manager.InitFeedsAndGenerateTaskFlow(files, output);
+    manager.RunTaskFlow(2);
+    EXPECT_GT(manager.FirstOutputSince(start), elapsed);
+
+    // there is no output without a book.
+    std::ofstream(files.front())
+      << R"({"trade":{"symbol":"AAA","price":1.0,"quantity":1.0}})" << '\n';
+    EXPECT_EQ(manager.StreamFeeds(files, output, 2, 50).first_output.count(),
+              0);
+    std::filesystem::remove_all(directory);
+  }
+
+  TEST(OrderBookFeedsManager, BinaryFeeds) {
+    const auto directory = TestDirectory();
+    const auto output    = (directory / "output").string();
+
+    // the files are converted with their own symbol tables, the symbols of
+    // the first file have other identifiers in the next ones.
+    std::vector<std::string> files{};
+    const auto symbols = WriteSplitFeed(directory, 3, files);
+    for (auto& file : files) {
+      std::ifstream reader(file);
+      file += ".bin";
+      BinaryFeedWriter writer{};
+      ASSERT_TRUE(writer.Open(file));
+      FeedRecord record{};
+      for (std::string line{}; std::getline(reader, line);) {
+        ASSERT_TRUE(ParseFeedLine(line, record));
+        writer.Write(record);
+      }
+      ASSERT_TRUE(writer.Close());
+    }
+
+    {
+      OrderBookFeedsManager manager{};
+      manager.InitFeedsAndGenerateTaskFlow(files, output);
+      manager.RunTaskFlow(2);
+    }
+    for (const auto& [symbol, expected] : symbols) {
+      EXPECT_EQ(ReadFile(directory / "output" / (symbol + ".txt")), expected)
+        << symbol;
+      std::filesystem::remove(directory / "output" / (symbol + ".txt"));
+    }
+
+    // the other modes only read json feeds.
+    OrderBookFeedsManager manager{};
+    EXPECT_EQ(manager.StreamFeeds(files, output, 2, 50).lines, 0U);
+    manager.RunPartitionedFeeds(files, output, 2, 2);
+    EXPECT_TRUE(std::filesystem::is_empty(output));
+    std::filesystem::remove_all(directory);
+  }
+
+  TEST(OrderBookFeedsManager, SymbolWithoutBook) {
+    const auto directory = TestDirectory();
+    const auto output    = directory / "output";
+    std::filesystem::remove_all(directory);
+    std::filesystem::create_directories(output);
+
+    // ZZZ only has trades, so it has no output, in every chunk.
+    const std::vector<std::string> files = {(directory / "feed.json").string()};
+    {
+      std::ofstream writer(files.front());
+      writer << R"({"trade":{"symbol":"ZZZ","quantity":1,"price":2.0}})" "\n"
+             << R"({"book":{"symbol":"AAA","bid":[],"ask":[]}})" "\n";
+      for (auto i = 1; i <= 8; ++i) {
+        writer << R"({"book":{"symbol":"AAA","bid":[{"count":1,"quantity":)"
+               << i << R"(,"price":1.0}],"ask":[]}})" "\n"
+               << R"({"trade":{"symbol":"ZZZ","quantity":1,"price":2.0}})"
+               << "\n";
+      }
+    }
+
+    {
+      OrderBookFeedsManager manager{};
+      manager.InitFeedsAndGenerateTaskFlow(files, output.string());
+      manager.RunTaskFlow(2);
+    }
+    const auto expected = ReadFile(output / "AAA.txt");
+    EXPECT_FALSE(std::filesystem::exists(output / "ZZZ.txt"));
+
+    for (const auto segment_books : {0U, 2U}) {
+      std::filesystem::remove(output / "AAA.txt");
+      OrderBookFeedsManager manager{};
+      manager.RunMappedFeeds(files, output.string(), 2, 3, segment_books);
+      EXPECT_EQ(ReadFile(output / "AAA.txt"), expected) << segment_books;
+      EXPECT_FALSE(std::filesystem::exists(output / "ZZZ.txt"))
+        << segment_books;
+    }
+
+    std::filesystem::remove(output / "AAA.txt");
+    {
+      OrderBookFeedsManager manager{};
+      manager.RunPartitionedFeeds(files, output.string(), 2, 3);
+    }
+    EXPECT_EQ(ReadFile(output / "AAA.txt"), expected);
+    EXPECT_FALSE(std::filesystem::exists(output / "ZZZ.txt"));
+    std::filesystem::remove_all(directory);
+  }
+
+  TEST(OrderBookFeedsManager, ConsolidatedOutput) {
+    const auto directory = TestDirectory();
+    const auto output = (directory / "output").string();
+
+    for (const auto format : {RecordFormat::kBinary, RecordFormat::kText}) {
+      std::vector<std::string> files{};
+      const auto symbols = WriteSplitFeed(directory, 3, files);
+
+      ConsolidatedOptions options{};
+      options.format        = format;
+      options.segment_bytes = 4096;
+      {
+        OrderBookFeedsManager manager{};
+        manager.EnableConsolidatedOutput(options);
+        manager.EnableAsyncOutput(AsyncWriterOptions{});
+        manager.StreamFeeds(files, output, 2, 50);
+      }
+
+      ConsolidatedReader reader{};
+      ASSERT_TRUE(reader.Open(output));
+      EXPECT_EQ(reader.Symbols().Size(), symbols.size());
+      for (const auto& [symbol, expected] : symbols) {
+        EXPECT_FALSE(std::filesystem::exists(directory / "output" /
+                                             (symbol + ".txt")));
+        std::string stream{};
+        EXPECT_TRUE(reader.Extract(symbol, stream));
+        EXPECT_EQ(stream, expected) << symbol;
+      }
+    }
+    std::filesystem::remove_all(directory);
+  }
+
+  TEST(OrderBookFeedsManager, AnalyticsSeries) {
+    const auto directory = TestDirectory();
+    const auto output = (directory / "output").string();
+
+    // every mode records the same series, next to the same outputs.
+    const std::vector<void (*)(OrderBookFeedsManager&,
+                               const std::vector<std::string>&,
+                               const std::string&)>
+      runs = {
+        [](OrderBookFeedsManager& manager,
+           const std::vector<std::string>& files,
+           const std::string& out) {
+          manager.InitFeedsAndGenerateTaskFlow(files, out);
+          manager.RunTaskFlow(2);
+        },
+        [](OrderBookFeedsManager& manager,
+           const std::vector<std::string>& files,
+           const std::string& out) {
+          manager.EnableAsyncOutput(AsyncWriterOptions{});
+          manager.StreamFeeds(files, out, 2, 50);
+        },
+        [](OrderBookFeedsManager& manager,
+           const std::vector<std::string>& files,
+           const std::string& out) {
+          manager.RunMappedFeeds(files, out, 2, 2, 3);
+        },
+      };
+
+    std::vector<std::string> series{};
+    for (const auto& run : runs) {
+      std::vector<std::string> files{};
+      const auto symbols = WriteSplitFeed(directory, 3, files);
+      {
+        OrderBookFeedsManager manager{};
+        manager.EnableAnalytics(AnalyticsOptions{});
+        run(manager, files, output);
+      }
+
+      for (size_t i = 0; i < symbols.size(); ++i) {
+        const auto& [symbol, expected] = symbols[i];
+        EXPECT_EQ(ReadFile(directory / "output" / (symbol + ".txt")),
+                  expected)
+          << symbol;
+
+        const auto symbol_series =
+          ReadFile(directory / "output" / (symbol + ".analytics.csv"));
+        EXPECT_GT(std::count(symbol_series.begin(), symbol_series.end(), '\n'),
+                  1)
+          << symbol;
+        if (series.size() == i) {
+          series.push_back(symbol_series);
+        }
+        EXPECT_EQ(symbol_series, series[i]) << symbol;
+      }
+    }
+    std::filesystem::remove_all(directory);
+  }
+
+  TEST(OrderBookFeedsManager, ResumeFromCheckpoint) {
+    const auto directory  = TestDirectory();
+    const auto output     = (directory / "output").string();
+    const auto checkpoint = (directory / "checkpoint").string();
+
+    for (const auto async_output : {false, true}) {
+      std::vector<std::string> files{};
+      const auto symbols = WriteSplitFeed(directory, 3, files);
+      const auto feed    = ReadFile(files.back());
+      size_t total       = 0;
+      for (const auto& file : files) {
+        const auto content = ReadFile(file);
+        total += static_cast<size_t>(
+          std::count(content.begin(), content.end(), '\n'));
+      }
+
+      const auto run = [&](const bool resume) {
+        CheckpointOptions options{};
+        options.path           = checkpoint;
+        options.interval_lines = 100;
+        options.resume         = resume;
+        OrderBookFeedsManager manager{};
+        if (async_output) {
+          manager.EnableAsyncOutput(AsyncWriterOptions{});
+        }
+        manager.EnableCheckpoints(options);
+        return manager.StreamFeeds(files, output, 2, 30);
+      };
+
+      // the capture of the last file is cut in the middle.
+      std::ofstream(files.back(), std::ios::binary)
+        << feed.substr(0, feed.find('\n', feed.size() / 2) + 1);
+      const auto first = run(false);
+      EXPECT_GT(first.checkpoints, 1U);
+
+      // an interrupted run has written outputs after the checkpoint.
+      const auto saved = ReadFile(checkpoint);
+      std::ofstream(files.back(), std::ios::binary) << feed;
+      {
+        OrderBookFeedsManager manager{};
+        manager.StreamFeeds(files, output, 2, 30);
+      }
+      std::ofstream(checkpoint, std::ios::binary) << saved;
+
+      const auto resumed = run(true);
+      EXPECT_EQ(resumed.resumed_lines, first.lines);
+      EXPECT_EQ(resumed.lines, total - first.lines);
+      for (const auto& [symbol, expected] : symbols) {
+        EXPECT_EQ(ReadFile(directory / "output" / (symbol + ".txt")),
+                  expected)
+          << symbol;
+      }
+
+      // the input files of the checkpoint are not the input of the run.
+      files.pop_back();
+      EXPECT_EQ(run(true).lines, 0U);
+    }
+    std::filesystem::remove_all(directory);
+  }
+
+  TEST(OrderBookFeedsManager, ResumeAfterCutLine) {
+    const auto directory  = TestDirectory();
+    const auto output     = (directory / "output").string();
+    const auto checkpoint = (directory / "checkpoint").string();
+
+    std::vector<std::string> files{};
+    const auto symbols = WriteSplitFeed(directory, 1, files);
+    const auto feed    = ReadFile(files.front());
+    const auto lines   = [](const std::string& content) {
+      return static_cast<size_t>(
+        std::count(content.begin(), content.end(), '\n'));
+    };
+
+    const auto run = [&](const bool resume) {
+      CheckpointOptions options{};
+      options.path           = checkpoint;
+      options.interval_lines = lines(feed) * 2;
+      options.resume         = resume;
+      OrderBookFeedsManager manager{};
+      manager.EnableCheckpoints(options);
+      return manager.StreamFeeds(files, output, 2, 30);
+    };
+
+    // the capture is still being written, its last line is cut.
+    const auto cut = feed.substr(0, feed.find('\n', feed.size() / 2) + 10);
+    std::ofstream(files.front(), std::ios::binary) << cut;
+    const auto first = run(false);
+    EXPECT_EQ(first.checkpoints, 1U);
+    EXPECT_EQ(first.lines, lines(cut));
+
+    std::ofstream(files.front(), std::ios::binary) << feed;
+    const auto resumed = run(true);
+    EXPECT_EQ(resumed.resumed_lines, lines(cut));
+    EXPECT_EQ(resumed.lines, lines(feed) - lines(cut));
+    for (const auto& [symbol, expected] : symbols) {
+      EXPECT_EQ(ReadFile(directory / "output" / (symbol + ".txt")), expected)
+        << symbol;
+    }
+    std::filesystem::remove_all(directory);
+  }
+
+  TEST(OrderBookFeedsManager, FollowGrowingFile) {
+    const auto directory = TestDirectory();
+    std::vector<std::string> files{};
+    const auto symbols = WriteSplitFeed(directory, 1, files);
+    const auto feed    = ReadFile(files.front());
+    const auto path    = (directory / "growing.json").string();
+    std::ofstream(path, std::ios::binary).close();
+
+    // append the feed in slices which end in the middle of the lines.
+    std::thread writer{[&] {
+      std::ofstream appender(path, std::ios::binary | std::ios::app);
+      for (size_t begin = 0; begin < feed.size(); begin += 997) {
+        appender << feed.substr(begin, 997) << std::flush;
+        std::this_thread::sleep_for(std::chrono::microseconds{200});
+      }
+    }};
+
+    FollowOptions options{};
+    options.idle_timeout = std::chrono::milliseconds{300};
+    OrderBookFeedsManager manager{};
+    const auto report =
+      manager.FollowFeeds(path, (directory / "output").string(), options);
+    writer.join();
+
+    EXPECT_EQ(report.lines,
+              static_cast<size_t>(std::count(feed.begin(), feed.end(), '\n')));
+    EXPECT_GT(report.output_lines, 0U);
+    for (const auto& [symbol, expected] : symbols) {
+      EXPECT_EQ(ReadFile(directory / "output" / (symbol + ".txt")), expected)
+        << symbol;
+    }
+    std::filesystem::remove_all(directory);
+  }
+
+  TEST(OrderBookFeedsManager, IngestToFiles) {
+    const auto directory = TestDirectory();
+    std::vector<std::string> files{};
+    const auto symbols = WriteSplitFeed(directory, 1, files);
+
+    OrderBookFeedsManager manager{};
+    EXPECT_FALSE(manager.Submit(0, TradeRecord{100, 645}));
+
+    IngestOptions options{};
+    options.shards  = 2;
+    options.out_dir = (directory / "output").string();
+    manager.StartIngest(std::move(options));
+
+    std::ifstream reader(files.front());
+    FeedRecord record{};
+    for (std::string line{}; std::getline(reader, line);) {
+      ASSERT_TRUE(ParseFeedLine(line, record));
+      const auto id = manager.RegisterSymbol(record.symbol);
+      if (record.type == FeedRecord::Type::kBook) {
+        EXPECT_TRUE(manager.Submit(id, record.book));
+      }
+      else {
+        EXPECT_TRUE(manager.Submit(id, record.trade));
+      }
+    }
+    const auto report = manager.StopIngest();
+
+    EXPECT_GT(report.messages, 0U);
+    for (const auto& [symbol, expected] : symbols) {
+      EXPECT_EQ(ReadFile(directory / "output" / (symbol + ".txt")), expected)
+        << symbol;
+    }
+    std::filesystem::remove_all(directory);
+  }
 }   // namespace longlp
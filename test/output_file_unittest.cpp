@@ -0,0 +1,107 @@
+// Copyright 2022 Long Le Phi. All rights reserved.
+// Use of this source code is governed by a MIT license that can be
+// found in the LICENSE file.
+
+#include "output_file.hpp"
+
+#include <gtest/gtest.h>
+#include <filesystem>
+#include <fstream>
+#include <string>
+
+namespace longlp {
+  namespace {
+    auto ReadFile(const std::filesystem::path& path) -> std::string {
+      std::string content(std::filesystem::file_size(path), '\0');
+      std::ifstream opener(path, std::ios::binary);
+      opener.read(content.data(), static_cast<std::streamsize>(content.size()));
+      return content;
+    }
+  }   // namespace
+
+  TEST(OutputFile, BufferUntilFlush) {
+    const auto path = std::filesystem::temp_directory_path() /
+                      "output_file_unittest_buffer.txt";
+
+    OutputFile file{};
+    ASSERT_TRUE(file.Open(path.string()));
+    file.Append("PASSIVE BUY 100.00 @ 1.00\n");
+    EXPECT_TRUE(ReadFile(path).empty());
+
+    EXPECT_TRUE(file.Flush());
+    EXPECT_EQ(ReadFile(path), "PASSIVE BUY 100.00 @ 1.00\n");
+
+    file.Buffer() += "CANCEL SELL 1.00 @ 2.00\n";
+    file.Close();
+    EXPECT_EQ(ReadFile(path),
+              "PASSIVE BUY 100.00 @ 1.00\nCANCEL SELL 1.00 @ 2.00\n");
+
+    std::filesystem::remove(path);
+  }
+
+  TEST(OutputFile, FlushWhenFull) {
+    const auto path = std::filesystem::temp_directory_path() /
+                      "output_file_unittest_full.txt";
+
+    OutputFile file{};
+    ASSERT_TRUE(file.Open(path.string()));
+    const std::string chunk(OutputFile::kFlushBytes / 2, 'x');
+    file.Append(chunk);
+    EXPECT_TRUE(ReadFile(path).empty());
+    file.Append(chunk);
+    EXPECT_EQ(ReadFile(path).size(), OutputFile::kFlushBytes);
+    EXPECT_TRUE(file.Buffer().empty());
+
+    file.Close();
+    std::filesystem::remove(path);
+  }
+
+  TEST(OutputFile, OpenAtKeepsPrefix) {
+    const auto path = std::filesystem::temp_directory_path() /
+                      "output_file_unittest_open_at.txt";
+    std::ofstream(path) << "PASSIVE BUY 100.00 @ 1.00\nPARTIAL";
+
+    OutputFile file{};
+    EXPECT_FALSE(file.OpenAt(path.string(), 100));
+    ASSERT_TRUE(file.OpenAt(path.string(), 26));
+    EXPECT_EQ(file.Size(), 26U);
+    file.Append("CANCEL SELL 1.00 @ 2.00\n");
+    file.Close();
+    EXPECT_EQ(file.Size(), 50U);
+    EXPECT_EQ(ReadFile(path),
+              "PASSIVE BUY 100.00 @ 1.00\nCANCEL SELL 1.00 @ 2.00\n");
+
+    std::filesystem::remove(path);
+  }
+
+  TEST(OutputFile, ReplaceFile) {
+    const auto path = std::filesystem::temp_directory_path() /
+                      "output_file_unittest_replace.bin";
+    std::ofstream(path) << "previous content";
+
+    ASSERT_TRUE(detail::ReplaceFile(path.string(), "next"));
+    EXPECT_EQ(ReadFile(path), "next");
+    EXPECT_FALSE(std::filesystem::exists(path.string() + ".tmp"));
+    // a missing directory fails, the file is not replaced.
+    EXPECT_FALSE(detail::ReplaceFile((path / "missing").string(), "next"));
+
+    std::filesystem::remove(path);
+  }
+
+  TEST(OutputFile, WriteAllAt) {
+    const auto path = std::filesystem::temp_directory_path() /
+                      "output_file_unittest_write_at.txt";
+    std::filesystem::remove(path);
+
+    // the writes land at their offsets in any order, as io_uring writes.
+    const auto descriptor =
+      detail::OpenForWriting(path.string(), detail::OpenMode::kPositional);
+    ASSERT_GE(descriptor, 0);
+    EXPECT_TRUE(detail::WriteAllAt(descriptor, "world\n", 6));
+    EXPECT_TRUE(detail::WriteAllAt(descriptor, "hello ", 0));
+    detail::CloseDescriptor(descriptor);
+    EXPECT_EQ(ReadFile(path), "hello world\n");
+
+    std::filesystem::remove(path);
+  }
+}   // namespace longlp
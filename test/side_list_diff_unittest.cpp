@@ -0,0 +1,129 @@
+// Copyright 2022 Long Le Phi. All rights reserved.
+// Use of this source code is governed by a MIT license that can be
+// found in the LICENSE file.
+
+#include "side_list_diff.hpp"
+
+#include <gtest/gtest.h>
+#include <cstdlib>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace longlp {
+  namespace {
+    // A side of |depth| levels from the price of 100.00, best first.
+    auto MakeSide(const size_t depth, const int64_t step) -> SideList {
+      SideList result{};
+      for (size_t i = 0; i < depth; ++i) {
+        const auto price = ToPrice(100.0) + step * static_cast<int64_t>(i);
+        result.push_back(Level{price, ToQuantity(10.0), 1});
+      }
+      return result;
+    }
+
+    template <Side side, DiffKernel kernel, typename Levels>
+    auto Diff(const Levels& old_list, const Levels& new_list)
+      -> std::string {
+      std::string result{};
+      DiffSideList<side, kernel>(
+        old_list,
+        new_list,
+        [&result](const Intention intention,
+                  const Volume quantity,
+                  const Price price) {
+          result += std::to_string(static_cast<size_t>(intention)) + ' ' +
+                    std::to_string(quantity) + ' ' + std::to_string(price) +
+                    '\n';
+        });
+      return result;
+    }
+  }   // namespace
+
+  TEST(SideListDiff, CountUnchangedLevels) {
+    const auto old_list = MakeSide(40, 1);
+    for (size_t count = 0; count <= old_list.size(); ++count) {
+      EXPECT_EQ(CountUnchangedLevels(old_list.data(), old_list.data(), count),
+                count);
+    }
+
+    // a change of the price or the quantity stops the run, not the count.
+    for (size_t changed = 0; changed < old_list.size(); ++changed) {
+      auto new_list = old_list;
+      ++new_list[changed].count;
+      EXPECT_EQ(CountUnchangedLevels(old_list.data(),
+                                     new_list.data(),
+                                     new_list.size()),
+                new_list.size());
+
+      ++new_list[changed].quantity;
+      EXPECT_EQ(CountUnchangedLevels(old_list.data(),
+                                     new_list.data(),
+                                     new_list.size()),
+                changed);
+
+      new_list[changed] = old_list[changed];
+      ++new_list[changed].price;
+      EXPECT_EQ(CountUnchangedLevels(old_list.data(),
+                                     new_list.data(),
+                                     new_list.size()),
+                changed);
+    }
+  }
+
+  TEST(SideListDiff, KernelsEmitSameOrders) {
+    std::mt19937 random{42};
+    std::uniform_int_distribution<size_t> depths{0, 80};
+    std::uniform_int_distribution<int32_t> changes{0, 9};
+
+    for (auto round = 0; round < 500; ++round) {
+      const auto bids = MakeSide(depths(random), -2);
+      const auto asks = MakeSide(depths(random), 2);
+
+      // change, insert and remove a few levels.
+      auto new_bids = bids;
+      auto new_asks = asks;
+      for (auto* side : {&new_bids, &new_asks}) {
+        for (size_t i = 0; i < side->size();) {
+          const auto change = changes(random);
+          if (change == 0) {
+            (*side)[i].quantity += ToQuantity(1.0);
+          }
+          else if (change == 1) {
+            side->erase(side->begin() + static_cast<ptrdiff_t>(i));
+            continue;
+          }
+          else if (change == 2 && i > 0 &&
+                   std::abs((*side)[i].price - (*side)[i - 1].price) > 1) {
+            const auto price = ((*side)[i - 1].price + (*side)[i].price) / 2;
+            side->insert(side->begin() + static_cast<ptrdiff_t>(i),
+                         Level{price, ToQuantity(3.0), 1});
+          }
+          ++i;
+        }
+      }
+
+      EXPECT_EQ((Diff<Side::kBuy, DiffKernel::kBlock>(bids, new_bids)),
+                (Diff<Side::kBuy, DiffKernel::kScalar>(bids, new_bids)));
+      EXPECT_EQ((Diff<Side::kSell, DiffKernel::kBlock>(asks, new_asks)),
+                (Diff<Side::kSell, DiffKernel::kScalar>(asks, new_asks)));
+      EXPECT_EQ((Diff<Side::kSell, DiffKernel::kBlock>(new_asks, asks)),
+                (Diff<Side::kSell, DiffKernel::kScalar>(new_asks, asks)));
+
+      // the same sides as structures of arrays, some of them spilled.
+      const auto as_soa = [](const SideList& levels) {
+        SoaSide<16> result{};
+        for (const auto& level : levels) {
+          result.push_back(level);
+        }
+        return result;
+      };
+      EXPECT_EQ(
+        (Diff<Side::kBuy, DiffKernel::kBlock>(as_soa(bids), as_soa(new_bids))),
+        (Diff<Side::kBuy, DiffKernel::kScalar>(bids, new_bids)));
+      EXPECT_EQ(
+        (Diff<Side::kSell, DiffKernel::kBlock>(as_soa(asks), as_soa(new_asks))),
+        (Diff<Side::kSell, DiffKernel::kScalar>(asks, new_asks)));
+    }
+  }
+}   // namespace longlp
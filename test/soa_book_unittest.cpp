@@ -0,0 +1,109 @@
+// Copyright 2022 Long Le Phi. All rights reserved.
+// Use of this source code is governed by a MIT license that can be
+// found in the LICENSE file.
+
+#include "soa_book.hpp"
+
+#include <gtest/gtest.h>
+#include <map>
+#include <sstream>
+#include <string>
+#include "feed_generator.hpp"
+#include "feed_parser.hpp"
+#include "instrument_feeds_worker.hpp"
+
+namespace longlp {
+  namespace {
+    auto MakeLevel(const int64_t index) -> Level {
+      return {ToPrice(100.0) + index,
+              ToQuantity(10.0) + static_cast<Quantity>(index),
+              static_cast<uint32_t>(index)};
+    }
+
+    template <size_t MaxDepth>
+    void ExpectLevels(const SoaSide<MaxDepth>& side, const int64_t size) {
+      ASSERT_EQ(side.size(), static_cast<size_t>(size));
+      for (int64_t i = 0; i < size; ++i) {
+        const auto level = side[static_cast<size_t>(i)];
+        EXPECT_EQ(level.price, MakeLevel(i).price);
+        EXPECT_EQ(level.quantity, MakeLevel(i).quantity);
+        EXPECT_EQ(level.count, MakeLevel(i).count);
+      }
+    }
+  }   // namespace
+
+  TEST(SoaBook, SpillDeepSide) {
+    SoaSide<4> side{};
+    EXPECT_TRUE(side.empty());
+    for (int64_t i = 0; i < 4; ++i) {
+      side.push_back(MakeLevel(i));
+    }
+    const auto* inline_prices = side.Prices();
+    ExpectLevels(side, 4);
+
+    // the fifth level moves the side to the heap arrays
+    side.push_back(MakeLevel(4));
+    EXPECT_NE(side.Prices(), inline_prices);
+    ExpectLevels(side, 5);
+    EXPECT_EQ(side.front().price, MakeLevel(0).price);
+
+    // a shallow side is inline again
+    side.clear();
+    side.push_back(MakeLevel(0));
+    EXPECT_EQ(side.Prices(), inline_prices);
+    ExpectLevels(side, 1);
+  }
+
+  TEST(SoaBook, SwapInlineAndSpilledSides) {
+    SoaSide<4> shallow{};
+    SoaSide<4> deep{};
+    for (int64_t i = 0; i < 3; ++i) {
+      shallow.push_back(MakeLevel(i));
+    }
+    for (int64_t i = 0; i < 6; ++i) {
+      deep.push_back(MakeLevel(i));
+    }
+
+    swap(shallow, deep);
+    ExpectLevels(shallow, 6);
+    ExpectLevels(deep, 3);
+
+    swap(shallow, deep);
+    ExpectLevels(shallow, 3);
+    ExpectLevels(deep, 6);
+  }
+
+  TEST(SoaBook, WorkerMatchesExpectedOutputs) {
+    // the books are deeper than the inline levels of BookT<16>, some sides
+    // are spilled.
+    FeedGeneratorOptions options{};
+    options.seed            = 3;
+    options.symbols         = 6;
+    options.messages        = 4000;
+    options.depth           = 20;
+    options.burst_frequency = 0.2;
+
+    std::stringstream feed{};
+    const auto symbols = GenerateFeed(options, feed);
+
+    std::map<std::string, BasicInstrumentFeedsWorker<BookT<16>>> workers{};
+    std::map<std::string, std::string> outputs{};
+    FeedRecord record{};
+    BookT<16> book{};
+    for (std::string line{}; std::getline(feed, line);) {
+      ASSERT_TRUE(ParseFeedLine(line, record)) << line;
+      auto& worker = workers[record.symbol];
+      if (record.type == FeedRecord::Type::kBook) {
+        ToBook(record.book, book);
+        worker.UpdateBookChanges(book, outputs[record.symbol]);
+      }
+      else {
+        worker.RecordNewTrade(record.trade);
+      }
+    }
+
+    for (const auto& [symbol, expected] : symbols) {
+      EXPECT_EQ(outputs[symbol], expected) << symbol;
+    }
+  }
+}   // namespace longlp
@@ -0,0 +1,75 @@
+// Copyright 2022 Long Le Phi. All rights reserved.
+// Use of this source code is governed by a MIT license that can be
+// found in the LICENSE file.
+
+#include "spsc_queue.hpp"
+
+#include <gtest/gtest.h>
+#include <thread>
+#include <vector>
+
+namespace longlp {
+  TEST(SpscQueue, RoundUpCapacity) {
+    const SpscQueue<int32_t> queue{5};
+    EXPECT_EQ(queue.Capacity(), 8U);
+  }
+
+  TEST(SpscQueue, PushUntilFull) {
+    SpscQueue<int32_t> queue{2};
+    EXPECT_EQ(queue.Front(), nullptr);
+
+    EXPECT_TRUE(queue.TryPush([](int32_t& slot) { slot = 1; }));
+    EXPECT_TRUE(queue.TryPush([](int32_t& slot) { slot = 2; }));
+    EXPECT_FALSE(queue.TryPush([](int32_t& slot) { slot = 3; }));
+
+    ASSERT_NE(queue.Front(), nullptr);
+    EXPECT_EQ(*queue.Front(), 1);
+    queue.Pop();
+    EXPECT_TRUE(queue.TryPush([](int32_t& slot) { slot = 3; }));
+
+    EXPECT_EQ(*queue.Front(), 2);
+    queue.Pop();
+    EXPECT_EQ(*queue.Front(), 3);
+    queue.Pop();
+    EXPECT_EQ(queue.Front(), nullptr);
+  }
+
+  TEST(SpscQueue, KeepSlotStorage) {
+    SpscQueue<std::vector<int32_t>> queue{1};
+    EXPECT_TRUE(queue.TryPush([](std::vector<int32_t>& slot) {
+      slot.assign(100, 1);
+    }));
+    auto* front = queue.Front();
+    ASSERT_NE(front, nullptr);
+    front->clear();
+    queue.Pop();
+
+    EXPECT_TRUE(queue.TryPush([](std::vector<int32_t>& slot) {
+      EXPECT_GE(slot.capacity(), 100U);
+    }));
+  }
+
+  TEST(SpscQueue, PreserveOrderAcrossThreads) {
+    constexpr int32_t kMessages = 100000;
+    SpscQueue<int32_t> queue{64};
+
+    std::thread producer([&queue] {
+      for (auto i = 0; i < kMessages; ++i) {
+        while (!queue.TryPush([i](int32_t& slot) { slot = i; })) {
+          std::this_thread::yield();
+        }
+      }
+    });
+
+    for (auto expected = 0; expected < kMessages;) {
+      if (const auto* value = queue.Front(); value != nullptr) {
+        EXPECT_EQ(*value, expected);
+        queue.Pop();
+        ++expected;
+        continue;
+      }
+      std::this_thread::yield();
+    }
+    producer.join();
+  }
+}   // namespace longlp
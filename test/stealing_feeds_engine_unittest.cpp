@@ -0,0 +1,141 @@
+// Copyright 2022 Long Le Phi. All rights reserved.
+// Use of this source code is governed by a MIT license that can be
+// found in the LICENSE file.
+
+#include "stealing_feeds_engine.hpp"
+
+#include <gtest/gtest.h>
+#include <deque>
+#include <filesystem>
+#include <fstream>
+#include <map>
+#include <sstream>
+#include <string>
+#include "feed_generator.hpp"
+#include "feed_parser.hpp"
+#include "symbol_table.hpp"
+
+namespace longlp {
+  namespace {
+    auto ReadFile(const std::filesystem::path& path) -> std::string {
+      std::string content(std::filesystem::file_size(path), '\0');
+      std::ifstream opener(path, std::ios::binary);
+      opener.read(content.data(), static_cast<std::streamsize>(content.size()));
+      return content;
+    }
+
+    // Push the generated feed of |generator| into an engine of |options|,
+    // and check the outputs of every symbol.
+    auto RunGeneratedFeed(const FeedGeneratorOptions& generator,
+                          const StealingOptions& options)
+      -> StealingRunReport {
+      // a directory of the running test, so the tests can run in parallel.
+      const auto* test =
+        ::testing::UnitTest::GetInstance()->current_test_info();
+      const auto directory =
+        std::filesystem::temp_directory_path() /
+        (std::string{"stealing_feeds_engine_unittest_"} + test->name());
+      std::filesystem::create_directories(directory);
+
+      std::stringstream feed{};
+      const auto symbols = GenerateFeed(generator, feed);
+
+      SymbolTable table{};
+      std::deque<InstrumentFeedsWorker> workers{};
+      std::deque<OutputFile> writers{};
+      size_t messages = 0;
+
+      StealingFeedsEngine engine{options};
+      FeedRecord record{};
+      for (std::string line{}; std::getline(feed, line);) {
+        EXPECT_TRUE(ParseFeedLine(line, record)) << line;
+        auto inserted = false;
+        const auto id = table.Intern(record.symbol, inserted);
+        if (inserted) {
+          workers.emplace_back();
+          writers.emplace_back().Open(
+            (directory / (record.symbol + ".txt")).string());
+        }
+        engine.Push(id, workers[id], &writers[id], record);
+        ++messages;
+      }
+      const auto report = engine.Stop();
+      for (auto& writer : writers) {
+        writer.Close();
+      }
+
+      EXPECT_EQ(report.messages, messages);
+      for (const auto& [symbol, expected] : symbols) {
+        EXPECT_EQ(ReadFile(directory / (symbol + ".txt")), expected) << symbol;
+      }
+      std::filesystem::remove_all(directory);
+      return report;
+    }
+  }   // namespace
+
+  TEST(StealingFeedsEngine, MatchesExpectedOutputs) {
+    FeedGeneratorOptions generator{};
+    generator.seed          = 11;
+    generator.symbols       = 40;
+    generator.messages      = 20000;
+    generator.zipf_exponent = 1.2;
+
+    // short mailboxes and runs, so the symbols are often queued again and
+    // stolen in the middle of their feed.
+    StealingOptions options{};
+    options.threads          = 3;
+    options.mailbox_capacity = 4;
+    options.batch            = 2;
+
+    const auto report = RunGeneratedFeed(generator, options);
+    ASSERT_EQ(report.threads.size(), 3U);
+    size_t messages = 0;
+    for (const auto& load : report.threads) {
+      messages += load.messages;
+      EXPECT_LE(load.steals, load.runs);
+    }
+    EXPECT_EQ(messages, report.messages);
+    EXPECT_GE(report.imbalance, 1.0);
+  }
+
+  TEST(StealingFeedsEngine, GrowingMailboxes) {
+    FeedGeneratorOptions generator{};
+    generator.seed     = 7;
+    generator.symbols  = 3;
+    generator.messages = 20000;
+
+    // long runs on one thread, so the messages wait in the mailboxes and
+    // they grow by segments, which are released once drained.
+    StealingOptions options{};
+    options.threads          = 1;
+    options.mailbox_capacity = 1024;
+    options.batch            = 512;
+
+    const auto report = RunGeneratedFeed(generator, options);
+    ASSERT_EQ(report.threads.size(), 1U);
+    EXPECT_EQ(report.threads[0].messages, report.messages);
+  }
+
+  TEST(StealingFeedsEngine, HotSymbolStaysHome) {
+    // a single symbol has all the messages, so it is hot and never stolen:
+    // the other thread stays idle and the load should be rebalanced.
+    FeedGeneratorOptions generator{};
+    generator.seed     = 5;
+    generator.symbols  = 1;
+    generator.messages = 2000;
+
+    StealingOptions options{};
+    options.threads          = 2;
+    options.mailbox_capacity = 4;
+    options.batch            = 1;
+    options.hot_min_messages = 1;
+
+    const auto report = RunGeneratedFeed(generator, options);
+    ASSERT_EQ(report.threads.size(), 2U);
+    EXPECT_EQ(report.threads[0].messages, report.messages);
+    EXPECT_EQ(report.threads[1].messages, 0U);
+    EXPECT_EQ(report.threads[1].steals, 0U);
+    EXPECT_DOUBLE_EQ(report.imbalance, 2.0);
+    EXPECT_TRUE(report.rebalance);
+  }
+}   // namespace longlp
@@ -0,0 +1,46 @@
+// Copyright 2022 Long Le Phi. All rights reserved.
+// Use of this source code is governed by a MIT license that can be
+// found in the LICENSE file.
+
+#include "symbol_table.hpp"
+
+#include <gtest/gtest.h>
+#include <string>
+
+namespace longlp {
+  TEST(SymbolTable, InternDenseIds) {
+    SymbolTable symbols{};
+    auto inserted = false;
+
+    EXPECT_EQ(symbols.Intern("AAA", inserted), 0U);
+    EXPECT_TRUE(inserted);
+    EXPECT_EQ(symbols.Intern("BBB", inserted), 1U);
+    EXPECT_TRUE(inserted);
+    EXPECT_EQ(symbols.Intern("AAA", inserted), 0U);
+    EXPECT_FALSE(inserted);
+
+    EXPECT_EQ(symbols.Size(), 2U);
+    EXPECT_EQ(symbols.Name(1), "BBB");
+  }
+
+  TEST(SymbolTable, FindKnownSymbols) {
+    SymbolTable symbols{};
+    auto inserted = false;
+    symbols.Intern("AAA", inserted);
+
+    EXPECT_EQ(symbols.Find("AAA"), 0U);
+    EXPECT_EQ(symbols.Find("BBB"), kInvalidSymbolId);
+  }
+
+  TEST(SymbolTable, KeepNamesWhileGrowing) {
+    SymbolTable symbols{};
+    auto inserted = false;
+    for (auto i = 0; i < 1000; ++i) {
+      symbols.Intern(std::to_string(i), inserted);
+    }
+
+    for (auto i = 0; i < 1000; ++i) {
+      EXPECT_EQ(symbols.Find(std::to_string(i)), static_cast<SymbolId>(i));
+    }
+  }
+}   // namespace longlp
@@ -0,0 +1,41 @@
+// Copyright 2022 Long Le Phi. All rights reserved.
+// Use of this source code is governed by a MIT license that can be
+// found in the LICENSE file.
+
+#ifndef TEST_RECORDS_HPP_
+#define TEST_RECORDS_HPP_
+
+#include <array>
+#include <cstdint>
+#include <vector>
+#include "definitions.hpp"
+
+// The records of the unit tests, written in decimals.
+namespace longlp::test {
+  // A level in decimals: count, quantity, price.
+  using DecimalLevel = std::array<double, 3>;
+
+  inline auto MakeSideList(const std::vector<DecimalLevel>& levels)
+    -> SideList {
+    SideList result{};
+    for (const auto& [count, quantity, price] : levels) {
+      result.emplace_back(Level{ToPrice(price),
+                                ToQuantity(quantity),
+                                static_cast<uint32_t>(count)});
+    }
+    return result;
+  }
+
+  inline auto MakeBook(const std::vector<DecimalLevel>& bids,
+                       const std::vector<DecimalLevel>& asks)
+    -> OrderBookRecord {
+    return {MakeSideList(bids), MakeSideList(asks)};
+  }
+
+  inline auto MakeTrade(const double quantity, const double price)
+    -> TradeRecord {
+    return {ToQuantity(quantity), ToPrice(price)};
+  }
+}   // namespace longlp::test
+
+#endif   // TEST_RECORDS_HPP_